@@ -46,3 +46,54 @@ ALTER TABLE user ADD COLUMN IF NOT EXISTS desc TEXT;
 -- (4, 1),
 -- (1, 5),
 -- (5, 1);
+
+-- 5. 聊天消息表（ChatServer 持久化离线消息）
+-- 离线同步按 (to_uid, id) 做 keyset 分页：WHERE to_uid = ? AND id > ? ORDER BY id LIMIT ?
+CREATE TABLE IF NOT EXISTS messages (
+    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+    from_uid INT NOT NULL,
+    to_uid INT NOT NULL,
+    payload MEDIUMBLOB NOT NULL COMMENT '消息体，编码见 codec',
+    codec TINYINT NOT NULL DEFAULT 0 COMMENT '0:JSON 原文 1:protobuf 2:protobuf+zlib',
+    status TINYINT DEFAULT 0 COMMENT '0:未读 1:已确认',
+    client_msg_id VARCHAR(64) NULL COMMENT '去重键：发送方的 msgid + 消息内容摘要，重试写入时跳过已有的行',
+    create_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_to_uid_id (to_uid, id),
+    UNIQUE KEY uk_client_msg (from_uid, to_uid, client_msg_id)
+);
+
+-- 已有 messages 表时补建分页索引
+-- ALTER TABLE messages ADD INDEX idx_to_uid_id (to_uid, id);
+
+-- 已有 messages 表时改为二进制消息体（老数据 codec = 0，按 JSON 原文读出，无需转换）
+-- ALTER TABLE messages MODIFY payload MEDIUMBLOB NOT NULL, ADD COLUMN codec TINYINT NOT NULL DEFAULT 0 AFTER payload;
+
+-- 已有 messages 表时补建去重键（老数据为 NULL，不参与唯一约束）
+-- ALTER TABLE messages ADD COLUMN client_msg_id VARCHAR(64) NULL AFTER status, ADD UNIQUE KEY uk_client_msg (from_uid, to_uid, client_msg_id);
+
+-- 6. 已读游标表：未读 = messages.id > read_msg_id，确认只需更新一行
+CREATE TABLE IF NOT EXISTS user_read_cursor (
+    uid INT PRIMARY KEY,
+    read_msg_id BIGINT NOT NULL DEFAULT 0,
+    update_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
+);
+
+-- 从 messages.status 迁移到已读游标（部署新版 ChatServer 前执行一次）：
+-- 游标取每个用户最早一条未读消息之前的位置；全部已读的用户取最大 id。
+-- 保守取值：status 不连续时可能重发少量已读消息，客户端本地库按 msg_id 去重。
+INSERT INTO user_read_cursor (uid, read_msg_id)
+SELECT to_uid, IFNULL(MIN(CASE WHEN status = 0 THEN id END) - 1, MAX(id))
+FROM messages
+GROUP BY to_uid
+ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id));
+
+-- 新版本不再读写 status，确认全部服务切换后可删除该列：
+-- ALTER TABLE messages DROP COLUMN status;
+
+-- 7. 收件人写入锁：每个收件人一行，不存数据。
+-- 写消息的事务先锁住本批收件人的行再插入，同一收件人的消息按 id 顺序提交；
+-- 否则多个服务并发写入时 id 大的可能先提交，被分页、确认越过之后 id 小的那条就再也拉不到。
+-- 与 messages 在同一分片
+CREATE TABLE IF NOT EXISTS user_inbox_lock (
+    uid INT PRIMARY KEY
+);
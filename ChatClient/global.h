@@ -45,9 +45,13 @@ enum ReqId{
     // 新增：好友回复结果通知（TCP 下发给发起方）
     ID_NOTIFY_FRIEND_REPLY = 1022,
     ID_GET_OFFLINE_MSG_REQ = 1023,
-    ID_NOTIFY_TEXT_CHAT_MSG_RSP = 1024 // 客户端确认收到通知 (ACK)
+    ID_NOTIFY_TEXT_CHAT_MSG_RSP = 1024, // 客户端确认收到通知 (ACK)
+    ID_GET_OFFLINE_MSG_RSP = 1025       // 离线消息分页回包
 };
 
+// 离线消息每页条数
+const int OFFLINE_PAGE_SIZE = 100;
+
 enum Modules{
     REGISTERMOD = 0,
     FORGETMOD   = 1,
@@ -17,6 +17,19 @@
 #include <QJsonArray>
 #include <QDateTime>
 
+namespace {
+// 生成发送方消息 id（服务端按 (发送方, 接收方, msgid) 去重）：
+// 毫秒时间戳 * 1000 再保证严格递增，同一毫秒内连发多条也不会撞键，且仍按时间有序
+QString NextMsgId()
+{
+    static qint64 last = 0;
+    qint64 id = QDateTime::currentMSecsSinceEpoch() * 1000;
+    if (id <= last) id = last + 1;
+    last = id;
+    return QString::number(id);
+}
+}
+
 // 构造函数：初始化主窗口
 // 
 // 参数：
@@ -377,14 +390,8 @@ void MainWindow::setupUi()
                     qDebug() << "[MainWindow] Duplicate message ignored: " << msgId;
                 }
 
-                // 无论是否重复，都更新 cursor 并发送 ACK
-                // 这里简单实现：立即发送 ACK
-                QJsonObject ackRoot;
-                ackRoot["uid"] = UserMgr::GetInstance()->GetUid();
-                ackRoot["max_msg_id"] = LocalDb::GetInstance()->GetMaxMsgId();
-                
-                QString ackJson = QString::fromUtf8(QJsonDocument(ackRoot).toJson(QJsonDocument::Compact));
-                emit TcpMgr::GetInstance()->sig_send_data(ReqId::ID_NOTIFY_TEXT_CHAT_MSG_RSP, ackJson);
+                // 确认由 TcpMgr 按服务端的 messages.id 发送（在线消息逐条确认，离线分页按游标确认），
+                // 不能用本地最大的 msg_id：它是发送方的时间戳，会把还没收到的消息一并确认掉
 
                 // 如果是重复消息，就不需要更新 UI 了 (除非 UI 没显示出来，但通常 DB 有了就是有了)
                 if (!isNew) return;
@@ -418,7 +425,7 @@ void MainWindow::setupUi()
                                 QJsonArray arr;
                                 QJsonObject elem;
                                 elem["content"] = text;
-                                elem["msgid"] = QString::number(QDateTime::currentMSecsSinceEpoch());
+                                elem["msgid"] = NextMsgId();
                                 arr.append(elem);
                                 root["text_array"] = arr;
 
@@ -717,7 +724,7 @@ void MainWindow::setupContactsWidget()
                         QJsonArray arr;
                         QJsonObject elem;
                         elem["content"] = text;
-                        elem["msgid"] = QString::number(QDateTime::currentMSecsSinceEpoch());
+                        elem["msgid"] = NextMsgId();
                         arr.append(elem);
                         root["text_array"] = arr;
 
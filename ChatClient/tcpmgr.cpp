@@ -198,18 +198,19 @@ void TcpMgr::initHandlers()
         if (jsonObj.contains("name")) UserMgr::GetInstance()->SetName(jsonObj["name"].toString());
         if (jsonObj.contains("token")) UserMgr::GetInstance()->SetToken(jsonObj["token"].toString());
 
-        // 登录成功后，初始化DB并获取Cursor
+        // 登录成功后，初始化DB
         int uid = UserMgr::GetInstance()->GetUid();
         LocalDb::GetInstance()->Init(uid);
-        long long cursor = LocalDb::GetInstance()->GetMaxMsgId();
 
         // 你可以在这里额外 emit 一个专门的信号，或通过 sig_recv_pkg 被 LoginDialog 捕获
         qDebug() << "Chat login handler processed success.";
 
-        // 登录聊天服成功后，主动拉取离线消息（1023），带上 cursor
+        // 登录聊天服成功后，主动拉取离线消息（1023），按页拉取
+        // cursor 是服务端消息 id，从 0 开始；后续页由 ID_GET_OFFLINE_MSG_RSP 的 next_cursor 驱动
         QJsonObject offReq;
         offReq["uid"] = uid;
-        offReq["max_msg_id"] = cursor;
+        offReq["cursor"] = 0;
+        offReq["page_size"] = OFFLINE_PAGE_SIZE;
         QString offJson = QString::fromUtf8(QJsonDocument(offReq).toJson(QJsonDocument::Compact));
         qDebug() << "[OfflineMsg][UI->TCP] send 1023 json=" << offJson;
         emit TcpMgr::GetInstance()->sig_send_data(ReqId::ID_GET_OFFLINE_MSG_REQ, offJson);
@@ -371,9 +372,69 @@ void TcpMgr::initHandlers()
             // 向上层发送专用信号，便于 UI 直接显示
             emit sig_text_notify(fromuid, touid, msgId, content);
         }
+        // 已入库的消息带 id（messages.id）：上层存库后按它确认，服务端据此推进已读游标
+        const qint64 serverId = obj.value("id").toVariant().toLongLong();
+        if (serverId > 0) {
+            QJsonObject ack;
+            ack["uid"] = touid;
+            ack["msg_id"] = serverId;
+            QString ackJson = QString::fromUtf8(QJsonDocument(ack).toJson(QJsonDocument::Compact));
+            emit sig_send_data(ReqId::ID_NOTIFY_TEXT_CHAT_MSG_RSP, ackJson);
+        }
         // 仍然保留通过 sig_recv_pkg 的整包派发（已在上层监听）
     });
 
+    // 离线消息分页回包：逐条派发，再用 next_cursor 拉下一页（同时确认本页）
+    _handlers.insert(ID_GET_OFFLINE_MSG_RSP, [this](ReqId id, int len, QByteArray data) {
+        Q_UNUSED(id);
+        Q_UNUSED(len);
+
+        QJsonParseError jerr;
+        QJsonDocument doc = QJsonDocument::fromJson(data, &jerr);
+        if (jerr.error != QJsonParseError::NoError || !doc.isObject()) {
+            qDebug() << "[OfflineMsg] parse page failed:" << jerr.errorString();
+            return;
+        }
+        auto obj = doc.object();
+        int err = obj.value("error").toInt(-1);
+        if (err != ErrorCodes::SUCCESS) {
+            qDebug() << "[OfflineMsg] page error code=" << err;
+            return;
+        }
+
+        int uid = obj.value("uid").toInt();
+        qint64 nextCursor = obj.value("next_cursor").toVariant().toLongLong();
+        bool hasMore = obj.value("has_more").toBool();
+        auto msgs = obj.value("msgs").toArray();
+        qDebug() << "[OfflineMsg] recv page count=" << msgs.size() << " next_cursor=" << nextCursor << " has_more=" << hasMore;
+
+        for (const auto& m : msgs) {
+            auto msgObj = m.toObject().value("msg").toObject();
+            int fromuid = msgObj.value("fromuid").toInt();
+            int touid = msgObj.value("touid").toInt();
+            for (const auto& v : msgObj.value("text_array").toArray()) {
+                auto o = v.toObject();
+                emit sig_text_notify(fromuid, touid, o.value("msgid").toString(), o.value("content").toString());
+            }
+        }
+
+        QJsonObject req;
+        req["uid"] = uid;
+        if (hasMore) {
+            // 带上 next_cursor 拉下一页，服务端会先确认 <= next_cursor 的消息
+            req["cursor"] = nextCursor;
+            req["page_size"] = OFFLINE_PAGE_SIZE;
+            QString reqJson = QString::fromUtf8(QJsonDocument(req).toJson(QJsonDocument::Compact));
+            emit sig_send_data(ReqId::ID_GET_OFFLINE_MSG_REQ, reqJson);
+        }
+        else if (nextCursor > 0) {
+            // 最后一页，单独确认
+            req["max_msg_id"] = nextCursor;
+            QString ackJson = QString::fromUtf8(QJsonDocument(req).toJson(QJsonDocument::Compact));
+            emit sig_send_data(ReqId::ID_NOTIFY_TEXT_CHAT_MSG_RSP, ackJson);
+        }
+    });
+
 }
 
 void TcpMgr::slot_tcp_connect(ServerInfo si)
@@ -8,37 +8,79 @@
 #include <atomic>
 #include <memory>
 #include <iostream>
+#include <future>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <boost/asio/post.hpp>
 #include "Singleton.h"
 
 // 异步数据库线程池
-// 
+//
 // 作用：
 //   将耗时的数据库操作从主逻辑线程分离，避免阻塞网络IO和业务处理。
 //   采用生产者-消费者模型，主线程生产任务，后台线程池消费任务。
 //
+// 有界队列：
+//   排队中的任务总数（含各 key 的积压）超过 capacity 时拒绝新任务，PostTask 返回 false，
+//   并计入 rejected 统计，避免 DB 变慢时内存无限增长。
+//
+// 按 key 保序：
+//   PostTask(key, task) 中相同 key（例如 uid）的任务严格按投递顺序串行执行，
+//   不同 key 之间仍然并行。实现类似 asio strand：每个 key 同一时刻最多只有一个任务
+//   在公共队列里，执行完再把该 key 的下一个任务放回公共队列。
+//
+// 结果回传：
+//   Submit 返回 std::future；
+//   PostTask(key, func, executor, callback) 在 DB 线程执行 func，
+//   再把 callback(result) post 回指定的 Asio executor（例如会话的 strand）执行；
+//   func 抛异常或任务被拒绝时 callback 拿到默认构造的结果，保证每次投递都恰好回调一次。
+//
 // 使用方式：
 //   AsyncDBPool::GetInstance()->PostTask([=](){
 //       // 执行数据库操作
 //       MysqlMgr::GetInstance()->Query(...);
 //   });
+//   AsyncDBPool::GetInstance()->PostTask(uid, [=](){ ... });   // 同一 uid 保序
 class AsyncDBPool : public Singleton<AsyncDBPool> {
     friend class Singleton<AsyncDBPool>;
 public:
     // 定义任务类型：无参无返回值的函数对象（通常使用Lambda表达式封装）
     using Task = std::function<void()>;
 
+    // 不需要保序的任务使用的 key
+    static constexpr long long NO_KEY = -1;
+    static constexpr size_t DEFAULT_CAPACITY = 100000;
+
+    // 运行统计（快照）
+    struct Stats {
+        unsigned long long submitted = 0;   // 成功入队的任务数
+        unsigned long long rejected = 0;    // 因队列满或已停止被拒绝的任务数
+        unsigned long long completed = 0;   // 执行完成的任务数（含抛异常的）
+        size_t pending = 0;                 // 当前排队中的任务数
+        size_t max_pending = 0;             // 排队任务数历史峰值
+        size_t capacity = 0;                // 队列容量
+    };
+
     // 初始化线程池
     // 参数：
     //   threadNum: 线程池中的工作线程数量，默认为 hardware_concurrency()
+    //   capacity: 排队任务上限，<= 0 时使用 DEFAULT_CAPACITY
     // 注意：
     //   必须在系统启动时调用一次
-    void Init(int threadNum = -1) {
+    void Init(int threadNum = -1, long long capacity = -1) {
         // 如果threadNum为-1，则使用CPU核心数
         if (threadNum <= 0) {
             threadNum = std::max(4, (int)std::thread::hardware_concurrency());
         }
         if (b_stop_) return; // 避免重复初始化
-        
+        if (!threads_.empty()) return;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            capacity_ = capacity > 0 ? static_cast<size_t>(capacity) : DEFAULT_CAPACITY;
+        }
+
         for (int i = 0; i < threadNum; ++i) {
             threads_.emplace_back([this] {
                 while (true) {
@@ -46,36 +88,33 @@ public:
                     {
                         // 获取互斥锁，访问任务队列
                         std::unique_lock<std::mutex> lock(mutex_);
-                        
+
                         // 等待条件满足：停止运行 或 队列不为空
                         cond_.wait(lock, [this] { return b_stop_ || !tasks_.empty(); });
-                        
+
                         // 如果收到停止信号且队列已空，则退出线程
                         if (b_stop_ && tasks_.empty()) return;
-                        
+
                         // 取出任务
                         task = std::move(tasks_.front());
                         tasks_.pop();
+                        --pending_;
                     }
-                    
+
                     // 执行任务（捕获异常防止线程崩溃）
-                    try {
-                        task();
-                    } catch (const std::exception& e) {
-                        std::cerr << "[AsyncDBPool] Task exception: " << e.what() << std::endl;
-                    } catch (...) {
-                        std::cerr << "[AsyncDBPool] Task unknown exception" << std::endl;
-                    }
+                    RunSafe(task);
                 }
             });
         }
+        std::cout << "[AsyncDBPool] started, threads=" << threadNum
+            << " capacity=" << capacity_ << std::endl;
     }
 
     // 停止线程池
     // 作用：
-    //   1. 设置停止标志
+    //   1. 设置停止标志，之后投递的任务一律拒绝
     //   2. 唤醒所有等待中的线程
-    //   3. 等待所有线程安全退出
+    //   3. 等待所有线程把已入队的任务执行完后安全退出
     // 注意：
     //   通常在程序退出或析构时调用
     void Stop() {
@@ -89,17 +128,110 @@ public:
         }
     }
 
-    // 投递任务
+    // 投递任务（不保序）
     // 参数：
     //   task: 要执行的函数对象或Lambda
+    // 返回值：
+    //   队列已满或线程池已停止时返回 false，任务不会被执行
     // 线程安全：
     //   该函数是线程安全的，可以从任意线程调用
-    void PostTask(Task task) {
+    bool PostTask(Task task) {
+        return PostTask(NO_KEY, std::move(task));
+    }
+
+    // 投递任务（相同 key 串行保序），key < 0 等同于不保序
+    bool PostTask(long long key, Task task) {
         {
             std::unique_lock<std::mutex> lock(mutex_);
-            tasks_.push(std::move(task));
+            if (b_stop_ || pending_ >= capacity_) {
+                ++rejected_;
+                if ((rejected_ & 1023) == 1) {
+                    std::cerr << "[AsyncDBPool] task rejected, pending=" << pending_
+                        << " capacity=" << capacity_ << " rejected_total=" << rejected_ << std::endl;
+                }
+                return false;
+            }
+            ++pending_;
+            ++submitted_;
+            if (pending_ > max_pending_) max_pending_ = pending_;
+
+            if (key < 0) {
+                tasks_.push(std::move(task));
+            }
+            else {
+                auto iter = key_backlog_.find(key);
+                if (iter != key_backlog_.end()) {
+                    // 该 key 已有任务在排队或执行，挂到积压队列，等前一个完成后再调度
+                    iter->second.push(std::move(task));
+                    return true;
+                }
+                key_backlog_.emplace(key, std::queue<Task>());
+                tasks_.push(MakeKeyedRunner(key, std::move(task)));
+            }
         }
         cond_.notify_one(); // 唤醒一个工作线程来处理
+        return true;
+    }
+
+    // 投递有返回值的任务，通过 future 取结果
+    // 被拒绝时返回的 future 携带 std::runtime_error
+    template<typename Func>
+    auto Submit(long long key, Func func) -> std::future<std::invoke_result_t<Func>> {
+        using Result = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+        auto fut = task->get_future();
+        if (!PostTask(key, [task]() { (*task)(); })) {
+            std::promise<Result> rejected;
+            rejected.set_exception(std::make_exception_ptr(
+                std::runtime_error("[AsyncDBPool] queue full, task rejected")));
+            return rejected.get_future();
+        }
+        return fut;
+    }
+
+    template<typename Func>
+    auto Submit(Func func) -> std::future<std::invoke_result_t<Func>> {
+        return Submit(NO_KEY, std::move(func));
+    }
+
+    // 在 DB 线程执行 func，把 callback(func 的返回值) post 到 executor 上执行
+    // 常用于把查询结果交回会话所在的 io_context/strand，func 必须有返回值，且返回类型可默认构造。
+    // func 抛异常或任务被拒绝（返回 false）时，callback 以默认构造的结果执行（如 ChatMsgPage::ok 为 false），
+    // 调用方据此回失败包，客户端不会一直等不到回复
+    template<typename Func, typename Executor, typename Callback>
+    bool PostTask(long long key, Func func, const Executor& executor, Callback callback) {
+        using Result = std::invoke_result_t<Func>;
+        bool posted = PostTask(key, [func, executor, callback]() mutable {
+            Result result{};
+            try {
+                result = func();
+            } catch (const std::exception& e) {
+                std::cerr << "[AsyncDBPool] Task exception: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "[AsyncDBPool] Task unknown exception" << std::endl;
+            }
+            boost::asio::post(executor, [callback, result = std::move(result)]() mutable {
+                callback(std::move(result));
+            });
+        });
+        if (!posted) {
+            boost::asio::post(executor, [callback]() mutable {
+                callback(Result{});
+            });
+        }
+        return posted;
+    }
+
+    Stats GetStats() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Stats stats;
+        stats.submitted = submitted_;
+        stats.rejected = rejected_;
+        stats.completed = completed_;
+        stats.pending = pending_;
+        stats.max_pending = max_pending_;
+        stats.capacity = capacity_;
+        return stats;
     }
 
 private:
@@ -109,9 +241,48 @@ private:
     AsyncDBPool(const AsyncDBPool&) = delete;
     AsyncDBPool& operator=(const AsyncDBPool&) = delete;
 
+    void RunSafe(Task& task) {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "[AsyncDBPool] Task exception: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "[AsyncDBPool] Task unknown exception" << std::endl;
+        }
+        ++completed_;
+    }
+
+    // 包装带 key 的任务：执行完后把同 key 的下一个任务放回公共队列
+    Task MakeKeyedRunner(long long key, Task task) {
+        return [this, key, task]() mutable {
+            RunSafe(task);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto iter = key_backlog_.find(key);
+                if (iter == key_backlog_.end()) return;
+                if (iter->second.empty()) {
+                    key_backlog_.erase(iter);
+                    return;
+                }
+                Task next = std::move(iter->second.front());
+                iter->second.pop();
+                tasks_.push(MakeKeyedRunner(key, std::move(next)));
+            }
+            cond_.notify_one();
+        };
+    }
+
     std::vector<std::thread> threads_;  // 线程容器
     std::queue<Task> tasks_;            // 任务队列
+    std::unordered_map<long long, std::queue<Task>> key_backlog_;  // key -> 等待前序任务完成的积压任务
     std::mutex mutex_;                  // 互斥锁，保护任务队列
     std::condition_variable cond_;      // 条件变量，用于线程同步
     std::atomic<bool> b_stop_;          // 停止标志
+
+    size_t capacity_ = DEFAULT_CAPACITY;    // 排队任务上限
+    size_t pending_ = 0;                    // 排队中任务数（公共队列 + 积压）
+    size_t max_pending_ = 0;
+    unsigned long long submitted_ = 0;
+    unsigned long long rejected_ = 0;
+    std::atomic<unsigned long long> completed_{ 0 };
 };
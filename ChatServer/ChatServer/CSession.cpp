@@ -46,6 +46,10 @@ std::shared_ptr<CSession>CSession::SharedSelf() {
 	return shared_from_this();
 }
 
+boost::asio::strand<boost::asio::io_context::executor_type> CSession::GetStrand() {
+	return _strand;
+}
+
 void CSession::Send(std::string msg, short msgid) {
 	std::lock_guard<std::mutex> lock(_send_lock);
 	int send_que_size = _send_que.size();
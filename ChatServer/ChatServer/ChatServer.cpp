@@ -14,10 +14,18 @@
 #include<boost/asio.hpp>
 #include<atomic>
 #include"RedisMgr.h"
+#include "RedisAsync.h"
+#include "MysqlAsync.h"
+#include "RedisStreamConsumer.h"
+#include "RedisSubscriber.h"
+#include "ProfileCache.h"
+#include "ChatGrpcClient.h"
 #include "ChatServiceImpl.h"
 #include "const.h"
 #include <filesystem>
 #include "MysqlDao.h"
+#include "MsgShardMap.h"
+#include "MsgCodec.h"
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -61,6 +69,50 @@ std::string getExecutableDir() {
 }
 
 
+// 好友事件推送（Stream 消费线程或订阅连接的 IO 线程上执行）
+//
+// 事件格式（GateServer 写入）：
+//   type     "apply" | "reply"
+//   payload  { "from_uid": ..., "to_uid": ..., "error": ... }
+//   申请推给 to_uid（1021），回复推给 from_uid（1022），对方不在本服时跳过。
+//   Stream 至少投递一次，进程崩溃后可能重复推送；客户端收到通知只是重新拉取申请列表，重复无害
+void PushFriendEvent(const std::string& type, const std::string& payload)
+{
+    std::cout << "[FriendNotify][Chat][Redis] recv type=" << type << " payload=" << payload << std::endl;
+    Json::Value obj;
+    Json::Reader rd;
+    if (!rd.parse(payload, obj) || !obj.isObject()) {
+        std::cout << "[FriendNotify][Chat][Redis] invalid json payload" << std::endl;
+        return;
+    }
+
+    if (type == "apply") {
+        int to_uid = obj.get("to_uid", 0).asInt();
+        auto sess = UserMgr::GetInstance()->GetSession(to_uid);
+        if (sess) {
+            std::cout << "[FriendNotify][Chat][Redis] send TCP 1021 to_uid=" << to_uid << std::endl;
+            sess->Send(payload, ID_NOTIFY_ADD_FRIEND_REQ);
+        }
+        else {
+            std::cout << "[FriendNotify][Chat][Redis] to_uid offline, skip" << std::endl;
+        }
+    }
+    else if (type == "reply") {
+        int from_uid = obj.get("from_uid", 0).asInt();
+        auto sess = UserMgr::GetInstance()->GetSession(from_uid);
+        if (sess) {
+            std::cout << "[FriendNotify][Chat][Redis] send TCP 1022 from_uid=" << from_uid << std::endl;
+            sess->Send(payload, ID_NOTIFY_FRIEND_REPLY);
+        }
+        else {
+            std::cout << "[FriendNotify][Chat][Redis] from_uid offline, skip" << std::endl;
+        }
+    }
+    else {
+        std::cout << "[FriendNotify][Chat][Redis] unknown event type=" << type << std::endl;
+    }
+}
+
 // 主函数：程序入口
 // 
 // 功能：
@@ -95,14 +147,55 @@ int main()
         std::string mysql_url = "tcp://" + mysql_host + ":" + mysql_port_str;
         using MySqlPoolSingleton = Singleton<MySqlPool>;
         auto mysqlPool = MySqlPoolSingleton::GetInstance();
-        // 根据CPU核心数动态设置MySQL连接池大小
-        size_t mysql_pool_size = std::max(16u, std::thread::hardware_concurrency() * 2);
-        std::cout << "[ChatServer] MySQL pool size: " << mysql_pool_size << std::endl;
-        mysqlPool->Init(mysql_url, mysql_user, mysql_passwd, mysql_schema, mysql_pool_size);
+        // 连接池常驻 PoolMin 个连接，负载高时增长到 PoolMax，上限默认按CPU核心数设置
+        int mysql_pool_min = 4;
+        int mysql_pool_max = static_cast<int>(std::max(16u, std::thread::hardware_concurrency() * 2));
+        try { mysql_pool_min = std::stoi(cfg["Mysql"]["PoolMin"]); }
+        catch (...) {}
+        try { mysql_pool_max = std::stoi(cfg["Mysql"]["PoolMax"]); }
+        catch (...) {}
+        std::cout << "[ChatServer] MySQL pool size: min=" << mysql_pool_min << " max=" << mysql_pool_max << std::endl;
+        mysqlPool->Init(mysql_url, mysql_user, mysql_passwd, mysql_schema, mysql_pool_min, mysql_pool_max);
+
+        // messages 表分片（[MsgShard] Count > 1 时启用）
+        MsgShardMap::GetInstance()->Init(mysqlPool, mysql_pool_min, mysql_pool_max);
+
+        // messages.payload 存储编码（protobuf + 可选 zlib 字典压缩）
+        MsgCodec::GetInstance()->Init();
+
+        // 可选的只读从库：配置 [MysqlReplica] Host 后，只读查询优先走从库
+        // 从库初始化失败不影响启动，所有查询继续走主库
+        std::string replica_host = cfg["MysqlReplica"]["Host"];
+        if (!replica_host.empty()) {
+            auto replica_value = [&cfg](const std::string& key, const std::string& def) {
+                std::string v = cfg["MysqlReplica"][key];
+                return v.empty() ? def : v;
+            };
+            std::string replica_url = "tcp://" + replica_host + ":" + replica_value("Port", mysql_port_str);
+            int replica_min = mysql_pool_min;
+            int replica_max = mysql_pool_max;
+            try { replica_min = std::stoi(replica_value("PoolMin", std::to_string(mysql_pool_min))); }
+            catch (...) {}
+            try { replica_max = std::stoi(replica_value("PoolMax", std::to_string(mysql_pool_max))); }
+            catch (...) {}
+            try {
+                Singleton<MySqlReplicaPool>::GetInstance()->Init(replica_url,
+                    replica_value("User", mysql_user), replica_value("Passwd", mysql_passwd),
+                    replica_value("Schema", mysql_schema), replica_min, replica_max);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "[ChatServer] MySQL replica init failed, reads stay on primary: " << e.what() << std::endl;
+            }
+        }
 
         // 获取IO服务池单例
         auto pool = AsioIOServicePool::GetInstance();
 
+        // 异步 Redis 客户端跑在 IO 线程池上（[RedisAsync] Connections = 0 时不启用）
+        RedisAsync::GetInstance()->Init();
+        // 非阻塞 MySQL 客户端同样跑在 IO 线程池上（[MysqlAsync] Connections = 0 时离线分页、确认走 AsyncDBPool）
+        MysqlAsync::GetInstance()->Init();
+
         // 初始化登录计数为0（在Redis中存储该ChatServer的连接数）
         RedisMgr::GetInstance()->HSet(LOGIN_COUNT, server_name, "0");
 
@@ -124,177 +217,45 @@ int main()
             grpc_server->Wait(); // 阻塞等待 gRPC 服务器关闭
             });
 
-        // 在独立线程中订阅 Redis 事件，并下发 TCP 通知
-        std::thread redis_sub_thread([]() {
-            auto& cfg = ConfigMgr::Inst();
-            auto host = cfg["Redis"]["Host"];
-            auto port_str = cfg["Redis"]["Port"];
-            auto passwd = cfg["Redis"]["Passwd"];
-            int port = 6379;
-            try { port = std::stoi(port_str); }
-            catch (...) {}
+        // 消费好友事件并下发 TCP 通知：GateServer 写入本服 Stream friend_stream_<本服名称>，
+        // 以消费组读取，处理后确认，本服重启期间写入的事件恢复后照常送达
+        int stream_batch = 64;
+        int stream_block_ms = 2000;
+        try { stream_batch = std::stoi(cfg["FriendStream"]["BatchSize"]); }
+        catch (...) {}
+        try { stream_block_ms = std::stoi(cfg["FriendStream"]["BlockMs"]); }
+        catch (...) {}
+        auto friend_stream = std::make_unique<RedisStreamConsumer>(cfg["Redis"]["Host"], std::stoi(cfg["Redis"]["Port"]),
+            cfg["Redis"]["Passwd"], FRIEND_STREAM_PREFIX + server_name, "chatserver", server_name,
+            stream_batch, stream_block_ms, [](const RedisStreamConsumer::Entry& entry) {
+                PushFriendEvent(entry.Field("type"), entry.Field("payload"));
+            });
+        friend_stream->Start();
+
+        // 进程内资料缓存：订阅资料失效频道，每次（重新）订阅成功时清空，断线期间漏掉的失效不会留下旧资料
+        ProfileCache::GetInstance()->Init();
+        std::shared_ptr<RedisSubscriber> profile_sub;
+        if (ProfileCache::GetInstance()->Enabled()) {
+            profile_sub = std::make_shared<RedisSubscriber>(pool->GetIOService(),
+                cfg["Redis"]["Host"], cfg["Redis"]["Port"], cfg["Redis"]["Passwd"], server_name + "-profile",
+                std::vector<std::string>{ PROFILE_CHANNEL },
+                [](const std::string&, const std::string& payload) {
+                    ProfileCache::GetInstance()->OnInvalidate(payload);
+                });
+            profile_sub->SetOnSubscribed([]() {
+                ProfileCache::GetInstance()->Clear();
+            });
+            profile_sub->Start();
+        }
 
-            while (!bstop.load()) {
-                redisContext* ctx = redisConnect(host.c_str(), port);
-                if (ctx == nullptr || ctx->err) {
-                    std::cout << "[FriendNotify][Chat][Redis] connect failed host=" << host << ":" << port << std::endl;
-                    if (ctx) { redisFree(ctx); }
-                    std::this_thread::sleep_for(std::chrono::seconds(2));
-                    continue;
-                }
-
-                if (!passwd.empty()) {
-                    redisReply* auth = (redisReply*)redisCommand(ctx, "AUTH %s", passwd.c_str());
-                    if (!auth || auth->type == REDIS_REPLY_ERROR) {
-                        std::cout << "[FriendNotify][Chat][Redis] AUTH failed" << std::endl;
-                        if (auth) freeReplyObject(auth);
-                        redisFree(ctx);
-                        std::this_thread::sleep_for(std::chrono::seconds(2));
-                        continue;
-                    }
-                    freeReplyObject(auth);
-                }
-
-                // 设置客户端名称，便于在 CLIENT LIST 中识别订阅连接
-                try {
-                    auto myname = cfg["SelfServer"]["Name"];
-                    std::transform(myname.begin(), myname.end(), myname.begin(), ::tolower);
-                    std::string cname = myname + "-sub";
-                    redisReply* setname = (redisReply*)redisCommand(ctx, "CLIENT SETNAME %s", cname.c_str());
-                    if (setname) freeReplyObject(setname);
-                    std::cout << "[FriendNotify][Chat][Redis] SETNAME " << cname << std::endl;
-                }
-                catch (...) {}
-
-                // 设置读超时，避免阻塞无法退出
-                timeval tv{ 1, 0 };
-                redisSetTimeout(ctx, tv);
-
-                redisReply* sub = (redisReply*)redisCommand(ctx, "SUBSCRIBE friend.apply friend.reply");
-                if (!sub) {
-                    std::cout << "[FriendNotify][Chat][Redis] SUBSCRIBE send failed" << std::endl;
-                    redisFree(ctx);
-                    std::this_thread::sleep_for(std::chrono::seconds(2));
-                    continue;
-                }
-                freeReplyObject(sub);
-                std::cout << "[FriendNotify][Chat][Redis] SUBSCRIBED channels: friend.apply, friend.reply" << std::endl;
-                // 订阅后进入读取循环
-                size_t idle_ticks = 0; // 软超时的空转计数，用于周期性打点
-                while (!bstop.load()) {
-                    void* r = nullptr;
-                    int rc = redisGetReply(ctx, &r);
-                    if (rc != REDIS_OK) {
-                        // 可能是超时或暂时无数据：hiredis 在超时/无数据时也会设置 err/errstr
-                        std::string es = ctx->errstr ? ctx->errstr : "";
-                        bool is_soft_timeout = (ctx->err == REDIS_ERR_TIMEOUT)
-                            || (es.find("timed out") != std::string::npos)
-                            || (es.find("Resource temporarily unavailable") != std::string::npos)
-                            || (es.find("EAGAIN") != std::string::npos)
-                            || (es.find("would block") != std::string::npos);
-
-                        if (is_soft_timeout || es.empty()) {
-                            // 视为正常轮询，无需重连
-                            // 某些平台下 err 会被置位，不影响后续读取，这里不强制清零以避免未定义行为
-                            // 修复：部分平台一旦置错将持续返回错误，影响后续读取，这里显式清空错误状态
-                            ctx->err = 0;
-                            if (ctx->errstr) { ctx->errstr[0] = '\0'; }
-                            ++idle_ticks;
-                            if ((idle_ticks % 100) == 0) {
-                                std::cout << "[FriendNotify][Chat][Redis] idle tick (no message)" << std::endl;
-                            }
-                            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                            continue;
-                        }
-
-                        // 确认为真实错误，记录并重连
-                        std::cout << "[FriendNotify][Chat][Redis] redisGetReply error, err=" << ctx->err
-                            << " errstr=" << es << " reconnecting..." << std::endl;
-                        break;
-                    }
-                    std::unique_ptr<redisReply, void(*)(void*)> reply((redisReply*)r, freeReplyObject);
-                    if (!reply) continue;
-                    // 诊断：更全面地记录 Redis 回复形态
-                    if (reply->type == REDIS_REPLY_ARRAY) {
-                        size_t elems = reply->elements;
-                        std::string kind;
-                        if (elems >= 1 && reply->element[0]->type == REDIS_REPLY_STRING && reply->element[0]->str) {
-                            kind.assign(reply->element[0]->str, reply->element[0]->len);
-                        }
-
-                        // 非 message 的数组回复（如 subscribe 确认）也打印，便于诊断
-                        if (kind != "message") {
-                            std::cout << "[FriendNotify][Chat][Redis] kind=" << (kind.empty() ? std::string("<nil>") : kind)
-                                << " elems=" << elems;
-                            if (elems >= 2 && reply->element[1]->type == REDIS_REPLY_STRING && reply->element[1]->str) {
-                                std::string ch(reply->element[1]->str, reply->element[1]->len);
-                                std::cout << " channel=" << ch;
-                            }
-                            if (elems >= 3 && reply->element[2]->type == REDIS_REPLY_INTEGER) {
-                                std::cout << " count=" << reply->element[2]->integer;
-                            }
-                            std::cout << std::endl;
-                        }
-
-                        // 正常的 message 事件
-                        if (kind == "message" && elems >= 3
-                            && reply->element[1]->type == REDIS_REPLY_STRING && reply->element[1]->str
-                            && reply->element[2]->type == REDIS_REPLY_STRING && reply->element[2]->str) {
-                            std::string channel(reply->element[1]->str, reply->element[1]->len);
-                            std::string payload(reply->element[2]->str, reply->element[2]->len);
-                            std::cout << "[FriendNotify][Chat][Redis] recv channel=" << channel << " payload=" << payload << std::endl;
-                            Json::Value obj; Json::Reader rd; bool ok = rd.parse(payload, obj);
-                            if (!ok || !obj.isObject()) {
-                                std::cout << "[FriendNotify][Chat][Redis] invalid json payload" << std::endl;
-                                continue;
-                            }
-                            int error = obj.get("error", -1).asInt();
-                            if (channel == "friend.apply") {
-                                int to_uid = obj.get("to_uid", 0).asInt();
-                                auto sess = UserMgr::GetInstance()->GetSession(to_uid);
-                                if (sess) {
-                                    std::cout << "[FriendNotify][Chat][Redis] send TCP 1021 to_uid=" << to_uid << std::endl;
-                                    sess->Send(payload, ID_NOTIFY_ADD_FRIEND_REQ);
-                                }
-                                else {
-                                    std::cout << "[FriendNotify][Chat][Redis] to_uid offline, skip" << std::endl;
-                                }
-                            }
-                            else if (channel == "friend.reply") {
-                                int from_uid = obj.get("from_uid", 0).asInt();
-                                auto sess = UserMgr::GetInstance()->GetSession(from_uid);
-                                if (sess) {
-                                    std::cout << "[FriendNotify][Chat][Redis] send TCP 1022 from_uid=" << from_uid << std::endl;
-                                    sess->Send(payload, ID_NOTIFY_FRIEND_REPLY);
-                                }
-                                else {
-                                    std::cout << "[FriendNotify][Chat][Redis] from_uid offline, skip" << std::endl;
-                                }
-                            }
-                            continue;
-                        }
-
-                        // 可选：如收到 pmessage（模式订阅），做个提示
-                        if (kind == "pmessage" && elems >= 4
-                            && reply->element[2]->type == REDIS_REPLY_STRING && reply->element[2]->str
-                            && reply->element[3]->type == REDIS_REPLY_STRING && reply->element[3]->str) {
-                            std::string channel(reply->element[2]->str, reply->element[2]->len);
-                            std::string payload(reply->element[3]->str, reply->element[3]->len);
-                            std::cout << "[FriendNotify][Chat][Redis] recv pmessage channel=" << channel << " payload=" << payload << std::endl;
-                        }
-                    }
-                    else {
-                        // 非数组类型的回复，记录类型码以便诊断
-                        std::cout << "[FriendNotify][Chat][Redis] unexpected reply type=" << reply->type << std::endl;
-                    }
-                }
-
-                redisFree(ctx);
-                if (!bstop.load()) {
-                    std::this_thread::sleep_for(std::chrono::seconds(2));
-                }
-            }
+        // 旧版 GateServer 仍以 PUBLISH 广播到 friend.apply / friend.reply，全部升级后可以去掉这条订阅
+        auto friend_sub = std::make_shared<RedisSubscriber>(pool->GetIOService(),
+            cfg["Redis"]["Host"], cfg["Redis"]["Port"], cfg["Redis"]["Passwd"], server_name + "-sub",
+            std::vector<std::string>{ "friend.apply", "friend.reply" },
+            [](const std::string& channel, const std::string& payload) {
+                PushFriendEvent(channel == "friend.apply" ? "apply" : "reply", payload);
             });
+        friend_sub->Start();
 
         // 从 pool 获取 io_context（注意 pool 初始化时已经创建 io_contexts 和线程）
         boost::asio::io_context& io_context = pool->GetIOService();
@@ -307,7 +268,13 @@ int main()
             if (!ec) {
                 std::cout << "signal " << signo << " received, stopping..." << std::endl;
                 // 停止 pool，同时 stop io_context 并 join 线程
+                friend_sub->Stop();
+                if (profile_sub) profile_sub->Stop();
+                friend_stream->Stop();
+                RedisAsync::GetInstance()->Stop();
+                MysqlAsync::GetInstance()->Stop();
                 pool->Stop();
+                ChatGrpcClient::GetInstance()->Stop();
 
                 // 通知主线程退出
                 bstop.store(true);
@@ -352,8 +319,6 @@ int main()
         RedisMgr::GetInstance()->HDel(LOGIN_COUNT, server_name);
         RedisMgr::GetInstance()->Close();
         grpc_server_thread.join(); // 等待 gRPC 线程退出
-        // [FriendNotify]
-        if (redis_sub_thread.joinable()) redis_sub_thread.join();
 
         std::cout << "Woke from cond_quit wait, bstop=" << bstop.load() << "\n";
         std::cout << "Server exiting normally." << std::endl;
@@ -3,8 +3,63 @@
 #include "MysqlMgr.h"
 #include "UserMgr.h"
 #include "AsyncDBPool.h"
+#include "MsgBatchWriter.h"
+#include "MsgJournal.h"
+#include "OfflineInbox.h"
+#include "MsgArchive.h"
+#include "RedisAsync.h"
+#include "ProfileCache.h"
 
 #include "ChatGrpcClient.h"
+#include <algorithm>
+
+namespace {
+	// 用户哈希中的基础资料字段，顺序与登录脚本 HMGET 的返回一致
+	const std::vector<std::string> PROFILE_FIELDS = { "name", "email", "nick", "desc", "sex", "icon" };
+
+	// 登录脚本：一次 HMGET 取回 token 和基础资料，校验 token、登记路由、续期并累加登录计数，一次往返原子完成
+	// KEYS = 用户哈希[, 登录计数]；ARGV = token, 本服名称, 资料未命中时是否照常登记, 过期秒数, 是否取回资料
+	// 返回 {LOGIN_OK, 资料字段...（按 PROFILE_FIELDS 顺序）} 或 {错误码}；任一资料字段缺失都按未命中处理（LOGIN_BASE_MISS），
+	// 避免 GateServer 只写了 name / email 的用户哈希被当成完整资料；
+	// 资料已在进程内缓存时不取回资料字段，只返回 {LOGIN_OK}
+	// 带 KEYS[2] 时登记成功后给本服的登录计数加 1；集群模式下计数键与用户哈希不在同一个槽，不传 KEYS[2]，
+	// 由调用方把 HINCRBY 和脚本放进同一批流水线
+	const char* LOGIN_SCRIPT_NAME = "chat_login";
+	const char* LOGIN_SCRIPT = R"lua(
+local u
+if ARGV[5] == '0' then
+  u = {redis.call('HGET', KEYS[1], 'token')}
+else
+  u = redis.call('HMGET', KEYS[1], 'token', 'name', 'email', 'nick', 'desc', 'sex', 'icon')
+end
+if not u[1] then return {1} end
+if u[1] ~= ARGV[1] then return {2} end
+if ARGV[3] ~= '1' then
+  for i = 2, 7 do
+    if not u[i] then return {3} end
+  end
+end
+redis.call('HSET', KEYS[1], 'server', ARGV[2])
+redis.call('EXPIRE', KEYS[1], ARGV[4])
+if KEYS[2] then redis.call('HINCRBY', KEYS[2], ARGV[2], 1) end
+return {0, u[2], u[3], u[4], u[5], u[6], u[7]}
+)lua";
+
+	enum LoginScriptCode {
+		LOGIN_OK = 0,
+		LOGIN_NO_TOKEN = 1,
+		LOGIN_TOKEN_MISMATCH = 2,
+		LOGIN_BASE_MISS = 3,
+	};
+
+	// 本服名称（小写），与用户哈希 server 字段中记录的一致
+	std::string SelfServerName()
+	{
+		auto server_name = ConfigMgr::Inst().GetValue("SelfServer", "Name");
+		std::transform(server_name.begin(), server_name.end(), server_name.begin(), ::tolower);
+		return server_name;
+	}
+}
 
 // 析构函数：清理资源
 // 
@@ -47,7 +102,23 @@ void LogicSystem::PostMsgToQue(std::shared_ptr<LogicNode> msg)
 LogicSystem::LogicSystem() :_b_stop(false) {
 	RegisterCallBacks();
 	_worker_thread = std::thread(&LogicSystem::DealMsg, this);
-	AsyncDBPool::GetInstance()->Init();
+	// [AsyncDB] Threads / QueueCapacity 未配置时使用默认值
+	auto& cfg = ConfigMgr::Inst();
+	int db_threads = -1;
+	long long db_capacity = -1;
+	try { db_threads = std::stoi(cfg["AsyncDB"]["Threads"]); }
+	catch (...) {}
+	try { db_capacity = std::stoll(cfg["AsyncDB"]["QueueCapacity"]); }
+	catch (...) {}
+	AsyncDBPool::GetInstance()->Init(db_threads, db_capacity);
+	// 离线收件箱热层需在写入器之前就绪，日志重放的消息也要写入热层
+	OfflineInbox::GetInstance()->Init();
+	MsgBatchWriter::GetInstance()->Init();
+	// [MsgJournal] Enable = 1 时消息先写本地日志再异步入库
+	MsgJournal::GetInstance()->Init();
+	// [MsgArchive] Dir 非空时历史查询合并归档，Job = 1 时本服务运行归档任务
+	MsgArchive::GetInstance()->Init();
+	RedisMgr::GetInstance()->RegisterScript(LOGIN_SCRIPT_NAME, LOGIN_SCRIPT);
 }
 
 // 注册回调函数
@@ -69,6 +140,9 @@ void LogicSystem::RegisterCallBacks() {
 
 	_fun_callbacks[ID_NOTIFY_TEXT_CHAT_MSG_RSP] = std::bind(&LogicSystem::OfflineMsgAckHandler, this,
 		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+	_fun_callbacks[ID_GET_HISTORY_MSG_REQ] = std::bind(&LogicSystem::GetHistoryMsgHandler, this,
+		std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 }
 
 // 登录处理函数
@@ -78,11 +152,10 @@ void LogicSystem::RegisterCallBacks() {
 // 
 // 实现逻辑：
 //   1. 解析JSON消息，获取uid和token
-//   2. 从Redis验证token
-//   3. 获取用户基础信息（优先从Redis获取，没有则从MySQL获取）
-//   4. 更新登录计数（Redis中的LOGIN_COUNT）
-//   5. 建立用户会话映射（UserMgr、CSession、Redis）
-//   6. 发送登录成功响应
+//   2. 执行登录脚本：验证token，读取基础资料，写入路由，登录计数（LOGIN_COUNT）加 1，一次往返
+//   3. 基础信息缓存未命中时从MySQL获取并回填，再执行一次脚本完成计数和路由
+//   4. 建立用户会话映射（UserMgr、CSession）
+//   5. 发送登录成功响应
 void LogicSystem::LoginHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data) {
 	Json::Reader reader;
 	Json::Value root;
@@ -91,73 +164,110 @@ void LogicSystem::LoginHandler(std::shared_ptr<CSession> session, const short& m
 	std::string token = root["token"].asString();
 	std::cout << "[LoginHandler] recv uid=" << uid << " token=" << token << std::endl;
 
+	// 登录计数只用于 StatusServer 选服。单机模式下计数键作为 KEYS[2] 由脚本在登记成功时一并累加；
+	// 集群模式下计数键与用户哈希不在同一个槽，HINCRBY 与第一次脚本调用放在同一批流水线里发出，
+	// 不多一次往返，登录最终失败时再减回去（失败路径很少，不等待结果）
+	std::string server_name = SelfServerName();
+	bool clustered = RedisMgr::GetInstance()->Clustered();
+	bool counted = false;
+	auto uncount = [&counted, &server_name]() {
+		if (!counted) return;
+		counted = false;
+		std::vector<std::string> decr = { "HINCRBY", LOGIN_COUNT, server_name, "-1" };
+		if (RedisAsync::GetInstance()->Enabled()) {
+			RedisAsync::GetInstance()->Command(std::move(decr), nullptr);
+		}
+		else {
+			RedisBatch batch;
+			batch.Add(std::move(decr));
+			std::vector<RedisResult> decr_results;
+			RedisMgr::GetInstance()->Exec(batch, decr_results);
+		}
+	};
+
 	Json::Value rtvalue;
-	// 校验 token 是否存在于 redis
-	std::string uid_str = std::to_string(uid);
-	std::string token_key = USERTOKENPREFIX + uid_str;
-	std::string token_value;
-	bool success = RedisMgr::GetInstance()->Get(token_key, token_value);
-	if (!success) {
-		rtvalue["error"] = ErrorCodes::UidInvalid;
+	auto send_error = [&session, &rtvalue, &uncount](int error) {
+		uncount();
+		rtvalue["error"] = error;
 		std::string return_str = rtvalue.toStyledString();
 		std::cout << "[LoginHandler TEST] send before return, body=" << return_str
 			<< " msgid=" << MSG_CHAT_LOGIN_RSP << std::endl;
 		session->Send(return_str, MSG_CHAT_LOGIN_RSP);
+	};
+
+	// token 校验、基础资料读取、路由登记由登录脚本一次完成；资料命中进程内缓存时脚本不再取回资料
+	std::string user_key = USER_HASH_PREFIX + std::to_string(uid);
+	std::string ttl = std::to_string(USER_HASH_TTL);
+	std::vector<std::string> keys = { user_key };
+	RedisBatch count_batch;
+	if (clustered) {
+		count_batch.Add({ "HINCRBY", LOGIN_COUNT, server_name, "1" });
+	}
+	else {
+		keys.push_back(LOGIN_COUNT);
+	}
+	ProfileCache::Ticket ticket = 0;
+	std::shared_ptr<const UserInfo> profile = ProfileCache::GetInstance()->Get(uid, ticket);
+	RedisResult result;
+	std::vector<RedisResult> count_results;
+	bool success = RedisMgr::GetInstance()->EvalScript(LOGIN_SCRIPT_NAME, keys,
+		{ token, server_name, profile ? "1" : "0", ttl, profile ? "0" : "1" }, result, count_batch, count_results)
+		&& result.type == REDIS_REPLY_ARRAY && !result.elements.empty();
+	counted = clustered && !count_results.empty() && count_results[0].type == REDIS_REPLY_INTEGER;
+	long long code = success ? result.elements[0].integer : static_cast<long long>(LOGIN_NO_TOKEN);
+	if (code == LOGIN_NO_TOKEN) {
+		send_error(ErrorCodes::UidInvalid);
 		return;
 	}
 	// 验证token是否匹配
-	if (token_value != token) {
-		rtvalue["error"] = ErrorCodes::TokenInvalid;
-		std::string return_str = rtvalue.toStyledString();
-		std::cout << "[LoginHandler TEST] send before return, body=" << return_str
-			<< " msgid=" << MSG_CHAT_LOGIN_RSP << std::endl;
-		session->Send(return_str, MSG_CHAT_LOGIN_RSP);
+	if (code == LOGIN_TOKEN_MISMATCH) {
+		send_error(ErrorCodes::TokenInvalid);
 		return;
 	}
 
-	// token 验证成功，获取用户信息
-	rtvalue["error"] = ErrorCodes::Success;
-
-	std::string base_key = USER_BASE_INFO + uid_str;
-	auto user_info = std::make_shared<UserInfo>();
-	bool b_base = GetBaseInfo(base_key, uid, user_info);
-	if (!b_base) {
-		rtvalue["error"] = ErrorCodes::UidInvalid;
-		std::string return_str = rtvalue.toStyledString();
-		std::cout << "[LoginHandler TEST] send before return, body=" << return_str
-			<< " msgid=" << MSG_CHAT_LOGIN_RSP << std::endl;
-		session->Send(return_str, MSG_CHAT_LOGIN_RSP);
-		return;
+	// token 验证成功，获取用户信息；用户哈希里也没有资料时先从 MySQL 读取并回填，再执行一次脚本完成登记
+	if (!profile) {
+		auto user_info = std::make_shared<UserInfo>();
+		std::vector<std::optional<std::string>> cached;
+		if (code == LOGIN_OK) {
+			for (size_t i = 1; i < result.elements.size(); ++i) {
+				if (result.elements[i].type == REDIS_REPLY_STRING) {
+					cached.emplace_back(result.elements[i].str);
+				}
+				else {
+					cached.emplace_back(std::nullopt);
+				}
+			}
+		}
+		if (!GetBaseInfo(user_key, uid, cached, user_info)) {
+			send_error(ErrorCodes::UidInvalid);
+			return;
+		}
+		ProfileCache::GetInstance()->Put(*user_info, ticket);
+		profile = user_info;
+	}
+	if (code == LOGIN_BASE_MISS) {
+		success = RedisMgr::GetInstance()->EvalScript(LOGIN_SCRIPT_NAME, keys, { token, server_name, "1", ttl, "0" }, result)
+			&& result.type == REDIS_REPLY_ARRAY && !result.elements.empty();
+		code = success ? result.elements[0].integer : static_cast<long long>(LOGIN_NO_TOKEN);
+		if (code != LOGIN_OK) {
+			send_error(code == LOGIN_TOKEN_MISMATCH ? ErrorCodes::TokenInvalid : ErrorCodes::UidInvalid);
+			return;
+		}
 	}
 
 	// 设置返回的用户信息
+	rtvalue["error"] = ErrorCodes::Success;
 	rtvalue["uid"] = uid;
-	rtvalue["pwd"] = user_info->pwd;
-	rtvalue["name"] = user_info->name;
-	rtvalue["email"] = user_info->email;
-	rtvalue["nick"] = user_info->nick;
-	rtvalue["desc"] = user_info->desc;
-	rtvalue["sex"] = user_info->sex;
-	rtvalue["icon"] = user_info->icon;
-
-	// 更新登录计数和状态
-	auto server_name = ConfigMgr::Inst().GetValue("SelfServer", "Name");
-	std::transform(server_name.begin(), server_name.end(), server_name.begin(), ::tolower);
-
-	// 从Redis读取当前登录计数并加1
-	auto rd_res = RedisMgr::GetInstance()->HGet(LOGIN_COUNT, server_name);
-	int count = 0;
-	if (!rd_res.empty()) {
-		try { count = std::stoi(rd_res); }
-		catch (...) { count = 0; }
-	}
-	++count;
-	RedisMgr::GetInstance()->HSet(LOGIN_COUNT, server_name, std::to_string(count));
-
-	// 在 session中写入 ipkey，同时在 session 和 UserMgr 建立映射
+	rtvalue["name"] = profile->name;
+	rtvalue["email"] = profile->email;
+	rtvalue["nick"] = profile->nick;
+	rtvalue["desc"] = profile->desc;
+	rtvalue["sex"] = profile->sex;
+	rtvalue["icon"] = profile->icon;
+
+	// 在 session 和 UserMgr 建立映射（路由已由脚本写入 Redis）
 	session->SetUserId(uid);
-	std::string ipkey = USERIPPREFIX + uid_str;
-	RedisMgr::GetInstance()->Set(ipkey, server_name);
 	UserMgr::GetInstance()->SetUserSession(uid, session);
 
 	// 统一返回统一发送成功包
@@ -171,6 +281,90 @@ void LogicSystem::LoginHandler(std::shared_ptr<CSession> session, const short& m
 
 
 
+namespace {
+	// 按收件人所在服务器投递文本消息：本服直接下发，跨服走异步 gRPC，都不阻塞调用线程。
+	// 消息已先行入库，任何一步失败（含 gRPC 超时、对端不可达）都只是不推送，对方上线后从收件箱拉取
+	void RouteTextChatMsg(int uid, int touid, const Json::Value& arrays, const std::string& notify_str,
+		const std::string& to_ip_value, long long id)
+	{
+		auto server_name = SelfServerName();
+		std::cout << "[TextChat][Route] to_ip=" << to_ip_value << " self=" << server_name
+			<< " same_server=" << std::boolalpha << (to_ip_value == server_name) << std::endl;
+
+		if (to_ip_value == server_name) {
+			auto to_sess = UserMgr::GetInstance()->GetSession(touid);
+			if (to_sess) {
+				std::cout << "[TextChat][Route] local deliver TCP 1019 to uid=" << touid
+					<< " body_len=" << notify_str.size() << std::endl;
+				to_sess->Send(notify_str, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+			}
+			else {
+				std::cout << "[OfflineMsg] user " << touid << " is offline, message left in inbox" << std::endl;
+			}
+			return;
+		}
+
+		TextChatMsgReq text_msg_req;
+		text_msg_req.set_fromuid(uid);
+		text_msg_req.set_touid(touid);
+		text_msg_req.set_id(id);
+		for (const auto& txt_obj : arrays) {
+			auto content = txt_obj["content"].asString();
+			auto msgid = txt_obj["msgid"].asString();
+			auto* text_msg = text_msg_req.add_textmsgs();
+			text_msg->set_msgid(msgid);
+			text_msg->set_msgcontent(content);
+		}
+
+		std::cout << "[TextChat][Route] cross-server deliver via gRPC target=" << to_ip_value
+			<< " fromuid=" << uid << " touid=" << touid
+			<< " msgs=" << arrays.size() << std::endl;
+		ChatGrpcClient::GetInstance()->NotifyTextChatMsg(to_ip_value, text_msg_req,
+			[touid, to_ip_value](const Status& status, const TextChatMsgRsp& rsp) {
+				// RPC 失败或对方已不在目标服：消息已在收件箱里，等对方上线拉取
+				if (!status.ok()) {
+					std::cout << "[TextChat][Route] gRPC to " << to_ip_value << " failed code=" << status.error_code()
+						<< " msg=" << status.error_message() << ", touid=" << touid << " message left in inbox" << std::endl;
+				}
+				else if (rsp.error() == ErrorCodes::RecipientOffline) {
+					std::cout << "[TextChat][Route] gRPC target offline, touid=" << touid << " message left in inbox" << std::endl;
+				}
+			});
+	}
+
+	// 消息入库拿到 id 后投递给收件人。下行 1019 带上 id，收件人按它确认（见 OfflineMsgAckHandler）。
+	// 在刷盘线程 / 日志投递线程上调用，不能阻塞：路由查询走异步 Redis，未启用时交给 DB 线程池按收件人保序执行
+	void DeliverTextChatMsg(int uid, int touid, const Json::Value& arrays, Json::Value notify, long long id)
+	{
+		notify["id"] = (Json::Int64)id;
+		std::string notify_str = notify.toStyledString();
+		std::string to_ip_key = USER_HASH_PREFIX + std::to_string(touid);
+		// 同一收件人的查询落在同一条连接上，回调按发送顺序执行，投递顺序与 id 顺序一致
+		if (RedisAsync::GetInstance()->Enabled()) {
+			RedisAsync::GetInstance()->Command(touid, { "HGET", to_ip_key, "server" },
+				[uid, touid, arrays, notify_str, to_ip_key, id](const RedisResult& result) {
+					if (result.type != REDIS_REPLY_STRING) {
+						std::cout << "[TextChat][Route] redis miss key=" << to_ip_key
+							<< (result.Ok() ? "" : " err=" + result.str) << " -> no route (msg saved)" << std::endl;
+						return;
+					}
+					// 回调在 IO 线程上：本服投递直接下发，跨服投递是异步 gRPC，由 ChatGrpcClient 按收件人保序发出
+					RouteTextChatMsg(uid, touid, arrays, notify_str, result.str, id);
+				});
+			return;
+		}
+
+		AsyncDBPool::GetInstance()->PostTask(touid, [uid, touid, arrays, notify_str, to_ip_key, id]() {
+			std::string to_ip_value = RedisMgr::GetInstance()->HGet(to_ip_key, "server");
+			if (to_ip_value.empty()) {
+				std::cout << "[TextChat][Route] redis miss key=" << to_ip_key << " -> no route (msg saved)" << std::endl;
+				return;
+			}
+			RouteTextChatMsg(uid, touid, arrays, notify_str, to_ip_value, id);
+			});
+	}
+}
+
 void LogicSystem::DealChatTextMsg(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data)
 {
 	Json::Reader reader;
@@ -187,115 +381,282 @@ void LogicSystem::DealChatTextMsg(std::shared_ptr<CSession> session, const short
 	rtvalue["fromuid"] = uid;
 	rtvalue["touid"] = touid;
 
-	// 统一构造用于下发和持久化的 JSON 文本
+	// 统一构造用于持久化的 JSON 文本
 	std::string notify_str_cache = rtvalue.toStyledString();
 
-	Defer defer([this, &rtvalue, session]() {
-		std::string return_str = rtvalue.toStyledString();
-		session->Send(return_str, ID_TEXT_CHAT_MSG_RSP);
-		});
-
 	// 先持久化，再投递。
-	// 无论对方是在线、离线还是跨服，先将消息入库 (Status=0)。
-	// 这样保证了消息不丢失。当对方收到消息回 ACK 时，再将其删除。
-	AsyncDBPool::GetInstance()->PostTask([uid, touid, notify_str_cache]() {
-		MysqlMgr::GetInstance()->SaveChatMessage(uid, touid, notify_str_cache);
-		});
-
-	std::string to_ip_key = USERIPPREFIX + std::to_string(touid);
-	std::string to_ip_value;
-	bool b_ip = RedisMgr::GetInstance()->Get(to_ip_key, to_ip_value);
-	if (!b_ip) {
-		std::cout << "[TextChat][Route] redis miss key=" << to_ip_key << " -> no route (msg saved)" << std::endl;
+	// 无论对方是在线、离线还是跨服，先将消息入库，这样保证了消息不丢失。
+	// 入库拿到 id 后由写入器写入收件人的离线收件箱热层，这里不再单独写 Redis 离线列表。
+	// 消息交给批量写入器攒批落库，发送方的回包（1018）在事务提交之后才下发，
+	// 回包成功即代表消息已持久化；随后带着 messages.id 投递给收件人。
+	// 开启本地日志时改为先追加到日志，fsync 之后即回包，由日志投递线程入库后再投递。
+	std::weak_ptr<CSession> weak_sess = session;
+	auto on_persisted = [weak_sess, rtvalue](bool ok) mutable {
+		auto sess = weak_sess.lock();
+		if (!sess) {
+			return;
+		}
+		if (!ok) {
+			rtvalue["error"] = ErrorCodes::MsgPersistFailed;
+		}
+		sess->Send(rtvalue.toStyledString(), ID_TEXT_CHAT_MSG_RSP);
+	};
+	auto on_stored = [uid, touid, arrays, rtvalue](long long id) {
+		DeliverTextChatMsg(uid, touid, arrays, rtvalue, id);
+	};
+	if (MsgJournal::GetInstance()->Enabled()) {
+		MsgJournal::GetInstance()->Append(uid, touid, notify_str_cache, on_persisted, on_stored);
+	}
+	else {
+		MsgBatchWriter::GetInstance()->Submit(uid, touid, notify_str_cache,
+			[on_persisted, on_stored](bool ok, long long id) mutable {
+				on_persisted(ok);
+				if (ok && id > 0) {
+					on_stored(id);
+				}
+			});
+	}
+}
+
+// 拉取离线消息（游标分页）
+//
+// 请求格式: { "uid": 1001, "cursor": 10005, "page_size": 100 }
+//   cursor: 上一页回包的 next_cursor，首次为 0；带上 cursor 即表示 <= cursor 的消息客户端已处理，
+//           服务端先确认再取下一页，因此每页都相当于一次 ACK
+//   page_size: 单页条数，最大 OFFLINE_PAGE_MAX_SIZE
+//
+// 回包 ID_GET_OFFLINE_MSG_RSP:
+//   { "error": 0, "uid": 1001, "cursor": 10005, "next_cursor": 10105, "has_more": true,
+//     "msgs": [ { "id": 10006, "msg": {...} }, ... ] }
+//   单页按 OFFLINE_PAGE_MAX_BYTES 截断，被截掉的消息留给下一页。
+//
+// 先查 Redis 热层（OfflineInbox），游标落在热层覆盖范围内时一次往返出页；
+// 热层未命中但未读水位表明没有新消息时直接回空页，登录时的这次拉取不再查库；
+// 否则走 MySQL 上 (to_uid, id) 的 keyset 分页。两层共用 messages.id 作为游标，翻页不会重复或遗漏。
+// 不带 page_size 的老客户端仍按 ID_NOTIFY_TEXT_CHAT_MSG_REQ 逐条下发：老客户端不会翻页，
+// 由服务端一页接一页地取，直到取完，或下发的条数、字节数、耗时超出 OFFLINE_LEGACY_* 预算。
+void LogicSystem::GetOfflineMsgHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data)
+{
+	Json::Reader reader;
+	Json::Value root;
+	reader.parse(msg_data, root);
+	int uid = root["uid"].asInt();
+	bool paged = root.isMember("page_size");
+	long long cursor = root.get("cursor", 0).asInt64();
+	int page_size = paged ? root["page_size"].asInt() : OFFLINE_PAGE_DEFAULT_SIZE;
+	if (page_size <= 0) page_size = OFFLINE_PAGE_DEFAULT_SIZE;
+	if (page_size > OFFLINE_PAGE_MAX_SIZE) page_size = OFFLINE_PAGE_MAX_SIZE;
+	if (cursor < 0) cursor = 0;
+
+	std::cout << "[OfflineMsg] recv get offline msg req, uid=" << uid << " cursor=" << cursor
+		<< " page_size=" << page_size << (paged ? "" : " (legacy)") << std::endl;
+
+	// 确认上一页与查询下一页都按 uid 保序执行（同一条 MysqlAsync 连接或 AsyncDBPool 的同一 key），确认一定先于查询。
+	// MySQL 接受了游标（是该用户已入库消息的 id）才同步到热层，同步 Redis 转交 AsyncDBPool，不占会话的 strand
+	if (paged && cursor > 0) {
+		MysqlMgr::GetInstance()->AckOfflineMessagesAsync(uid, cursor, session->GetStrand(), [uid, cursor](bool accepted) {
+			if (accepted) {
+				AsyncDBPool::GetInstance()->PostTask(uid, [uid, cursor]() {
+					OfflineInbox::GetInstance()->Ack(uid, cursor);
+					});
+			}
+			});
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(OFFLINE_LEGACY_MAX_MS);
+	ChatMsgPage hot_page;
+	if (OfflineInbox::GetInstance()->ReadPage(uid, cursor, page_size, hot_page)) {
+		std::cout << "[OfflineMsg] inbox hit, uid=" << uid << " msgs=" << hot_page.ids.size() << std::endl;
+		SendOfflinePage(session, uid, cursor, paged, hot_page);
+		if (!paged) {
+			ContinueLegacyPull(session, uid, page_size, hot_page, 0, 0, deadline);
+		}
 		return;
 	}
+	QueryOfflinePage(session, uid, cursor, page_size, paged, false, 0, 0, deadline);
+}
 
-	auto server_name = ConfigMgr::Inst().GetValue("SelfServer", "Name");
-	std::transform(server_name.begin(), server_name.end(), server_name.begin(), ::tolower);
-	std::cout << "[TextChat][Route] to_ip=" << to_ip_value << " self=" << server_name
-		<< " same_server=" << std::boolalpha << (to_ip_value == server_name) << std::endl;
-
-	if (to_ip_value == server_name) {
-		auto to_sess = UserMgr::GetInstance()->GetSession(touid);
-		if (to_sess) {
-			std::cout << "[TextChat][Route] local deliver TCP 1019 to uid=" << touid
-				<< " body_len=" << notify_str_cache.size() << std::endl;
-			to_sess->Send(notify_str_cache, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+void LogicSystem::QueryOfflinePage(std::shared_ptr<CSession> session, int uid, long long cursor, int page_size, bool paged,
+	bool try_inbox, size_t sent_msgs, size_t sent_bytes, std::chrono::steady_clock::time_point deadline)
+{
+	// 老客户端续拉的下一页先查热层，与首页一样在 strand 上直接读
+	if (try_inbox) {
+		ChatMsgPage hot_page;
+		if (OfflineInbox::GetInstance()->ReadPage(uid, cursor, page_size, hot_page)) {
+			SendOfflinePage(session, uid, cursor, paged, hot_page);
+			if (!paged) {
+				ContinueLegacyPull(session, uid, page_size, hot_page, sent_msgs, sent_bytes, deadline);
+			}
+			return;
 		}
-		else {
-			// 用户在本机，但离线，存入Redis离线消息（加速拉取）
-			std::string offline_key = OFFLINE_MSG_PREFIX + std::to_string(touid);
-			RedisMgr::GetInstance()->LPush(offline_key, notify_str_cache);
-			std::cout << "[OfflineMsg] user " << touid << " is offline, saved message to redis key=" << offline_key << std::endl;
+	}
+
+	// 使用 weak_ptr 防止回调时 session 已销毁
+	std::weak_ptr<CSession> weak_sess = session;
+
+	// 查询不占线程等待（MysqlAsync，未启用时走 AsyncDBPool），结果 post 回会话的 strand 下发
+	MysqlMgr::GetInstance()->GetUnreadChatMessagesPageAsync(uid, cursor, page_size, session->GetStrand(),
+		[this, uid, cursor, page_size, paged, sent_msgs, sent_bytes, deadline, weak_sess](ChatMsgPage page) {
+		// 本页之后没有更多未读：用查到的位置重建未读水位，下次登录可以不查库
+		if (page.ok && !page.has_more) {
+			long long last = page.ids.empty() ? cursor : page.ids.back();
+			AsyncDBPool::GetInstance()->PostTask(uid, [uid, last]() {
+				OfflineInbox::GetInstance()->Observe(uid, last);
+				});
 		}
+		std::shared_ptr<CSession> shared_sess = weak_sess.lock();
+		if (!shared_sess) {
+			return;
+		}
+		if (!page.ok) {
+			std::cout << "[OfflineMsg] page query failed for uid=" << uid << " cursor=" << cursor << std::endl;
+		}
+		SendOfflinePage(shared_sess, uid, cursor, paged, page);
+		if (!paged) {
+			ContinueLegacyPull(shared_sess, uid, page_size, page, sent_msgs, sent_bytes, deadline);
+		}
+	});
+}
+
+void LogicSystem::ContinueLegacyPull(std::shared_ptr<CSession> session, int uid, int page_size, const ChatMsgPage& page,
+	size_t sent_msgs, size_t sent_bytes, std::chrono::steady_clock::time_point deadline)
+{
+	if (!page.ok || !page.has_more || page.ids.empty()) {
 		return;
 	}
+	sent_msgs += page.payloads.size();
+	for (const auto& payload : page.payloads) {
+		sent_bytes += payload.size();
+	}
+	// 下一页最多 page_size 条，下发后不能超过条数预算（逐条进会话发送队列）
+	if (sent_msgs + page_size > OFFLINE_LEGACY_MAX_MSGS || sent_bytes >= OFFLINE_LEGACY_MAX_BYTES
+		|| std::chrono::steady_clock::now() >= deadline) {
+		std::cout << "[OfflineMsg] legacy client, budget used up after " << sent_msgs << " messages (" << sent_bytes
+			<< " bytes), rest left in inbox for uid=" << uid << std::endl;
+		return;
+	}
+	// 读不确认：老客户端按条回 ACK，这里只把游标挪到本页末尾
+	QueryOfflinePage(session, uid, page.ids.back(), page_size, false, true, sent_msgs, sent_bytes, deadline);
+}
 
-	TextChatMsgReq text_msg_req;
-	text_msg_req.set_fromuid(uid);
-	text_msg_req.set_touid(touid);
-	for (const auto& txt_obj : arrays) {
-		auto content = txt_obj["content"].asString();
-		auto msgid = txt_obj["msgid"].asString();
-		auto* text_msg = text_msg_req.add_textmsgs();
-		text_msg->set_msgid(msgid);
-		text_msg->set_msgcontent(content);
+namespace {
+	// 按字节预算把 page 装入 msgs，至少装一条保证游标前进；返回装入条数，last_id 为最后一条的 id
+	size_t AppendPageMsgs(const ChatMsgPage& page, Json::Value& msgs, long long& last_id)
+	{
+		size_t bytes = 0;
+		size_t count = 0;
+		Json::Reader msg_reader;
+		for (; count < page.ids.size(); ++count) {
+			const std::string& payload = page.payloads[count];
+			if (count > 0 && bytes + payload.size() > OFFLINE_PAGE_MAX_BYTES) {
+				break;
+			}
+			Json::Value item;
+			item["id"] = (Json::Int64)page.ids[count];
+			Json::Value msg;
+			if (msg_reader.parse(payload, msg)) {
+				item["msg"] = msg;
+			}
+			else {
+				item["msg"] = payload;
+			}
+			msgs.append(item);
+			bytes += payload.size();
+			last_id = page.ids[count];
+		}
+		return count;
 	}
+}
 
-	std::cout << "[TextChat][Route] cross-server deliver via gRPC target=" << to_ip_value
-		<< " fromuid=" << uid << " touid=" << touid
-		<< " msgs=" << arrays.size() << std::endl;
-	auto rsp = ChatGrpcClient::GetInstance()->NotifyTextChatMsg(to_ip_value, text_msg_req);
-
-	// 如果RPC调用成功，但业务逻辑返回对方离线
-	if (rsp.error() == ErrorCodes::RecipientOffline) {
-		std::cout << "[TextChat][Route] gRPC target offline, saving to local redis" << std::endl;
-		// 将消息存入本地Redis的离线消息队列（加速拉取）
-		std::string offline_key = OFFLINE_MSG_PREFIX + std::to_string(touid);
-		RedisMgr::GetInstance()->LPush(offline_key, notify_str_cache);
+void LogicSystem::SendOfflinePage(std::shared_ptr<CSession> session, int uid, long long cursor, bool paged, const ChatMsgPage& page)
+{
+	if (!paged) {
+		if (!page.ok) {
+			// 老协议没有错误回包，客户端下次登录时重拉
+			std::cout << "[OfflineMsg] legacy client, page query failed for uid=" << uid << " cursor=" << cursor << std::endl;
+			return;
+		}
+		std::cout << "[OfflineMsg] legacy client, push page of " << page.payloads.size()
+			<< " messages for uid=" << uid << " cursor=" << cursor << std::endl;
+		for (const auto& payload : page.payloads) {
+			session->Send(payload, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+		}
+		return;
 	}
+
+	Json::Value rtvalue;
+	rtvalue["uid"] = uid;
+	rtvalue["cursor"] = (Json::Int64)cursor;
+	rtvalue["msgs"] = Json::Value(Json::arrayValue);
+	if (!page.ok) {
+		rtvalue["error"] = ErrorCodes::RPCFailed;
+		rtvalue["next_cursor"] = (Json::Int64)cursor;
+		rtvalue["has_more"] = false;
+	}
+	else {
+		long long next_cursor = cursor;
+		size_t count = AppendPageMsgs(page, rtvalue["msgs"], next_cursor);
+		rtvalue["error"] = ErrorCodes::Success;
+		rtvalue["next_cursor"] = (Json::Int64)next_cursor;
+		rtvalue["has_more"] = count < page.ids.size() || page.has_more;
+	}
+
+	// 紧凑输出，省掉 toStyledString 的缩进和换行
+	Json::StreamWriterBuilder builder;
+	builder["indentation"] = "";
+	std::string return_str = Json::writeString(builder, rtvalue);
+	std::cout << "[OfflineMsg] send page of " << rtvalue["msgs"].size() << " messages for uid=" << uid
+		<< " next_cursor=" << rtvalue["next_cursor"].asInt64() << " bytes=" << return_str.size() << std::endl;
+	session->Send(return_str, ID_GET_OFFLINE_MSG_RSP);
 }
 
-void LogicSystem::GetOfflineMsgHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data)
+// 收件历史分页
+//
+// 请求：{ "uid": 1001, "before": 0, "page_size": 50 }，before 为上一页最小的 id，0 表示从最新开始
+// 回包：{ "error": 0, "uid": 1001, "before": 0, "msgs": [{ "id": ..., "msg": {...} }], "next_before": ..., "has_more": true }
+// 按 id 从新到旧；近期消息来自 messages 表，更早的来自归档（MsgArchive）
+void LogicSystem::GetHistoryMsgHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data)
 {
 	Json::Reader reader;
 	Json::Value root;
 	reader.parse(msg_data, root);
 	int uid = root["uid"].asInt();
+	long long before = root.get("before", 0).asInt64();
+	int page_size = root.get("page_size", OFFLINE_PAGE_DEFAULT_SIZE).asInt();
+	if (page_size <= 0) page_size = OFFLINE_PAGE_DEFAULT_SIZE;
+	if (page_size > OFFLINE_PAGE_MAX_SIZE) page_size = OFFLINE_PAGE_MAX_SIZE;
+	if (before < 0) before = 0;
 
-	std::cout << "[OfflineMsg] recv get offline msg req, uid=" << uid << std::endl;
-
-	std::string offline_key = OFFLINE_MSG_PREFIX + std::to_string(uid);
-	std::vector<std::string> messages;
-	RedisMgr::GetInstance()->GetAllList(offline_key, messages);
-
-	std::cout << "[OfflineMsg] get " << messages.size() << " offline messages for uid=" << uid << std::endl;
-
-	// 使用 weak_ptr 防止回调时 session 已销毁
 	std::weak_ptr<CSession> weak_sess = session;
-
-	// 投递异步任务到 DB 线程池
-	AsyncDBPool::GetInstance()->PostTask([uid, weak_sess]() {
-		// 在 DB 线程中执行
+	MysqlMgr::GetInstance()->GetChatHistoryPageAsync(uid, before, page_size, session->GetStrand(),
+		[uid, before, weak_sess](ChatMsgPage page) {
 		std::shared_ptr<CSession> shared_sess = weak_sess.lock();
 		if (!shared_sess) {
-			std::cout << "[OfflineMsg][Async] session expired, abort db query for uid=" << uid << std::endl;
 			return;
 		}
 
-		std::vector<long long> ids;
-		std::vector<std::string> db_payloads;
-		
-		// 当前逻辑只在返回 true 时下发离线消息；如果 DB 出现异常导致返回 false，
-		// 不会向客户端返回任何错误信息，也没有做重试控制（例如指数退避重试）。
-		// 阻塞式查询，但现在是在 Worker 线程中，不会阻塞主 Logic 线程
-		if (MysqlMgr::GetInstance()->GetUnreadChatMessages(uid, ids, db_payloads)) {
-			std::cout << "[OfflineMsg][Async] get " << db_payloads.size() << " unread messages for uid=" << uid << std::endl;
-			
-			for (const auto& payload : db_payloads) {
-				shared_sess->Send(payload, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
-			}
+		Json::Value rtvalue;
+		rtvalue["uid"] = uid;
+		rtvalue["before"] = (Json::Int64)before;
+		rtvalue["msgs"] = Json::Value(Json::arrayValue);
+		long long next_before = before;
+		if (!page.ok) {
+			rtvalue["error"] = ErrorCodes::RPCFailed;
+			rtvalue["has_more"] = false;
+		}
+		else {
+			size_t count = AppendPageMsgs(page, rtvalue["msgs"], next_before);
+			rtvalue["error"] = ErrorCodes::Success;
+			rtvalue["has_more"] = count < page.ids.size() || page.has_more;
 		}
+		rtvalue["next_before"] = (Json::Int64)next_before;
+
+		Json::StreamWriterBuilder builder;
+		builder["indentation"] = "";
+		std::string return_str = Json::writeString(builder, rtvalue);
+		std::cout << "[HistoryMsg] send page of " << rtvalue["msgs"].size() << " messages for uid=" << uid
+			<< " before=" << before << " next_before=" << next_before << std::endl;
+		shared_sess->Send(return_str, ID_GET_HISTORY_MSG_RSP);
 	});
 }
 
@@ -304,22 +665,44 @@ void LogicSystem::OfflineMsgAckHandler(std::shared_ptr<CSession> session, const
 	Json::Reader reader;
 	Json::Value root;
 	reader.parse(msg_data, root);
-	// 客户端回包格式: { "uid": 1001, "max_msg_id": 10005 }
+	// 客户端回包格式:
+	//   { "uid": 1001, "msg_id": 10005 }      在线消息逐条确认，msg_id 为下行 1019 带的 messages.id；
+	//                                         它与已读游标之间还有没确认的消息时不推进
+	//   { "uid": 1001, "max_msg_id": 10005 }  离线分页最后一页的 next_cursor，确认 <= 它的全部消息
+	// 两种都必须是该用户已入库消息的 id；老客户端拿本地时间戳当 max_msg_id 的确认会被拒绝，
+	// 否则还没投递的消息会被一并标成已读
 	int uid = root["uid"].asInt();
-	long long max_msg_id = root["max_msg_id"].asInt64();
+	bool single = root.isMember("msg_id");
+	long long ack_id = single ? root["msg_id"].asInt64() : root["max_msg_id"].asInt64();
 	
-	std::cout << "[OfflineMsg][Ack] recv ack for uid=" << uid << " max_msg_id=" << max_msg_id << std::endl;
+	std::cout << "[OfflineMsg][Ack] recv ack for uid=" << uid << (single ? " msg_id=" : " max_msg_id=") << ack_id << std::endl;
+	if (ack_id <= 0) {
+		return;
+	}
 
-	// 异步更新 DB 状态
-	AsyncDBPool::GetInstance()->PostTask([uid, max_msg_id]() {
-		MysqlMgr::GetInstance()->AckOfflineMessages(uid, max_msg_id);
-		});
+	// 异步更新 DB 状态，按 uid 保序：保证排在该用户之前的离线查询之后执行；MySQL 接受后再同步到热层
+	auto on_ack = [uid, ack_id](bool accepted) {
+		if (accepted) {
+			AsyncDBPool::GetInstance()->PostTask(uid, [uid, ack_id]() {
+				OfflineInbox::GetInstance()->Ack(uid, ack_id);
+				});
+		}
+		else {
+			std::cout << "[OfflineMsg][Ack] ack not accepted, uid=" << uid << " id=" << ack_id << std::endl;
+		}
+	};
+	if (single) {
+		MysqlMgr::GetInstance()->AckOfflineMessageAsync(uid, ack_id, session->GetStrand(), on_ack);
+	}
+	else {
+		MysqlMgr::GetInstance()->AckOfflineMessagesAsync(uid, ack_id, session->GetStrand(), on_ack);
+	}
 }
 
 // 获取用户基础信息
 // 
 // 参数：
-//   - base_key: Redis键名（USER_BASE_INFO + uid）
+//   - base_key: Redis键名（USER_HASH_PREFIX + uid）
 //   - uid: 用户ID
 //   - userinfo: 输出参数，用户信息
 // 
@@ -327,50 +710,67 @@ void LogicSystem::OfflineMsgAckHandler(std::shared_ptr<CSession> session, const
 //   成功返回true，否则返回false
 // 
 // 实现逻辑：
-//   1. 先从Redis获取用户信息（提高性能）
-//   2. 如果Redis没有，从MySQL查询
-//   3. 将从MySQL查询到的用户信息写入Redis（缓存）
+//   1. 先查进程内资料缓存（ProfileCache）
+//   2. 未命中时从Redis用户哈希一次 HMGET 取回资料字段
+//   3. 如果Redis没有，从MySQL查询
+//   4. 将从MySQL查询到的用户信息写入Redis用户哈希（缓存，不含密码），并回填进程内缓存
 bool LogicSystem::GetBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo)
 {
-	// 先查 Redis
-	std::string info_str = "";
-	bool b_base = RedisMgr::GetInstance()->Get(base_key, info_str);
-	if (b_base) {
-		// Redis中有数据，解析JSON
-		Json::Reader reader;
-		Json::Value root;
-		reader.parse(info_str, root);
+	ProfileCache::Ticket ticket = 0;
+	if (auto profile = ProfileCache::GetInstance()->Get(uid, ticket)) {
+		userinfo = std::make_shared<UserInfo>(*profile);
+		return true;
+	}
+	// 再查 Redis
+	std::vector<std::optional<std::string>> cached;
+	RedisMgr::GetInstance()->HMGet(base_key, PROFILE_FIELDS, cached);
+	if (!GetBaseInfo(base_key, uid, cached, userinfo)) {
+		return false;
+	}
+	ProfileCache::GetInstance()->Put(*userinfo, ticket);
+	return true;
+}
+
+bool LogicSystem::GetBaseInfo(const std::string& base_key, int uid, const std::vector<std::optional<std::string>>& cached,
+	std::shared_ptr<UserInfo>& userinfo)
+{
+	// 资料字段必须齐全才算命中：只有部分字段（如 GateServer 只写的 name / email）时整体回源 MySQL，
+	// 否则缺的字段会以空值进入进程内缓存
+	bool hit = cached.size() == PROFILE_FIELDS.size()
+		&& std::all_of(cached.begin(), cached.end(), [](const std::optional<std::string>& v) { return v.has_value(); });
+	if (hit) {
+		auto field = [&cached](size_t i) { return *cached[i]; };
 		userinfo = std::make_shared<UserInfo>();
-		userinfo->uid = root["uid"].asInt();
-		userinfo->name = root["name"].asString();
-		userinfo->email = root["email"].asString();
-		userinfo->pwd = root["pwd"].asString();
-		// 默认填充字段，防止 JSON 缺失字段导致错误
-		userinfo->nick = root.isMember("nick") ? root["nick"].asString() : "";
-		userinfo->desc = root.isMember("desc") ? root["desc"].asString() : "";
-		userinfo->sex = root.isMember("sex") ? root["sex"].asInt() : 0;
-		userinfo->icon = root.isMember("icon") ? root["icon"].asString() : "";
+		userinfo->uid = uid;
+		userinfo->name = field(0);
+		userinfo->email = field(1);
+		userinfo->nick = field(2);
+		userinfo->desc = field(3);
+		try { userinfo->sex = std::stoi(field(4)); }
+		catch (...) { userinfo->sex = 0; }
+		userinfo->icon = field(5);
 		std::cout << "user login uid is " << userinfo->uid << " user name is " << userinfo->name
-			<< " user email is " << userinfo->email << " pwd is " << userinfo->pwd << std::endl;
+			<< " user email is " << userinfo->email << std::endl;
 	}
 	else {
-		// Redis 没有数据，从 MySQL 查询
+		// Redis 没有数据或资料不全，从 MySQL 查询
 		userinfo = MysqlMgr::GetInstance()->GetUser(uid);
 		if (userinfo == nullptr) {
 			return false;
 		}
 
-		// 写入 Redis
-		Json::Value redis_root;
-		redis_root["uid"] = userinfo->uid;
-		redis_root["name"] = userinfo->name;
-		redis_root["email"] = userinfo->email;
-		redis_root["pwd"] = userinfo->pwd;
-		redis_root["nick"] = userinfo->nick; // 空值
-		redis_root["desc"] = userinfo->desc; // 空值
-		redis_root["sex"] = userinfo->sex;   // 0
-		redis_root["icon"] = userinfo->icon; // 空值
-		RedisMgr::GetInstance()->Set(base_key, redis_root.toStyledString());
+		// 写入 Redis 用户哈希，并续期
+		RedisBatch batch;
+		batch.Add({ "HSET", base_key,
+			"name", userinfo->name,
+			"email", userinfo->email,
+			"nick", userinfo->nick,
+			"desc", userinfo->desc,
+			"sex", std::to_string(userinfo->sex),
+			"icon", userinfo->icon })
+			.Add({ "EXPIRE", base_key, std::to_string(USER_HASH_TTL) });
+		std::vector<RedisResult> results;
+		RedisMgr::GetInstance()->Exec(batch, results);
 	}
 	return true;
 }
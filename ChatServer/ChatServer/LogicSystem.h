@@ -8,6 +8,8 @@
 #include"data.h"
 #include<memory>
 #include<string>
+#include<optional>
+#include<chrono>
 #include"StatusGrpcClient.h"
 #include "CSession.h"
 
@@ -74,14 +76,30 @@ private:
     void GetOfflineMsgHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
     void OfflineMsgAckHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
 
+    // 在 DB 线程取一页离线消息（try_inbox 时先查热层），结果回到会话的 strand 下发；
+    // 老客户端（paged 为 false）的 sent_msgs / sent_bytes / deadline 为本次拉取已用掉的预算
+    void QueryOfflinePage(std::shared_ptr<CSession> session, int uid, long long cursor, int page_size, bool paged,
+        bool try_inbox, size_t sent_msgs, size_t sent_bytes, std::chrono::steady_clock::time_point deadline);
+    // 下发一页离线消息（热层和 MySQL 共用）
+    void SendOfflinePage(std::shared_ptr<CSession> session, int uid, long long cursor, bool paged, const ChatMsgPage& page);
+    // 老客户端不会翻页：本页之后还有未读且预算未用完时，接着取下一页
+    void ContinueLegacyPull(std::shared_ptr<CSession> session, int uid, int page_size, const ChatMsgPage& page,
+        size_t sent_msgs, size_t sent_bytes, std::chrono::steady_clock::time_point deadline);
+
+    // 收件历史分页（messages 表 + 归档）
+    void GetHistoryMsgHandler(std::shared_ptr<CSession> session, const short& msg_id, const std::string& msg_data);
+
     // 获取用户基础信息
     // 参数：
-    //   - base_key: 基础键名
+    //   - base_key: 用户哈希键名（USER_HASH_PREFIX + uid）
     //   - uid: 用户ID
     //   - userinfo: 输出参数，用户信息
     // 返回值：
     //   成功返回true，否则返回false
     bool GetBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
+    // 同上，资料字段已由调用方读出（与 PROFILE_FIELDS 一一对应；为空或缺任一字段表示未命中，回源 MySQL 并回填）
+    bool GetBaseInfo(const std::string& base_key, int uid, const std::vector<std::optional<std::string>>& cached,
+        std::shared_ptr<UserInfo>& userinfo);
 
     std::queue<std::shared_ptr<LogicNode>> _msg_que;  // 消息队列
     std::mutex _mutex;                                 // 互斥锁
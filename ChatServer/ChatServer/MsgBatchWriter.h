@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "Singleton.h"
+#include "data.h"
+
+// 聊天消息批量持久化（Group Commit）
+//
+// 作用：
+//   原来每条消息都是一个 AsyncDBPool 任务：取连接 -> prepare -> 单行 INSERT -> 提交。
+//   这里把消息先攒在内存队列里，满 MaxRows 条或最早一条等待超过 MaxDelayMs 毫秒时，
+//   由后台刷盘线程用一条多行 INSERT + 一个事务写入 MySQL，把 N 次往返合并为 1 次。
+//
+// 完成通知：
+//   Submit 返回 std::future<bool>，并可附带回调；两者都在事务提交（或失败）之后才完成，
+//   因此调用方可以在消息真正落库后再给发送方回 ACK，并带着 messages.id 投递给收件人。
+//   回调在刷盘线程上执行，不要在里面做阻塞操作。
+//
+// 顺序：
+//   只有一个刷盘线程，入队顺序即 messages.id 的自增顺序。
+class MsgBatchWriter : public Singleton<MsgBatchWriter> {
+    friend class Singleton<MsgBatchWriter>;
+public:
+    // (是否已入库, messages.id)，失败时 id 为 0
+    using Callback = std::function<void(bool, long long)>;
+
+    ~MsgBatchWriter();
+
+    // 启动刷盘线程，参数 <= 0 时读取配置 [MsgBatch] MaxRows / MaxDelayMs
+    void Init(int maxRows = -1, int maxDelayMs = -1);
+
+    // 停止：唤醒刷盘线程，把剩余消息全部写完后退出
+    void Stop();
+
+    // 投递一条消息，线程安全
+    // 返回的 future 在该消息所在批次提交后置为 true，失败置为 false；
+    // 未启动或已停止时立即以 false 完成（回调在调用线程上执行）
+    std::future<bool> Submit(int fromUid, int toUid, std::string payload, Callback cb = nullptr);
+
+private:
+    MsgBatchWriter();
+
+    struct PendingMsg {
+        ChatMsgRecord record;
+        std::promise<bool> done;
+        Callback cb;
+    };
+
+    void Run();
+    void Flush(std::vector<PendingMsg>& batch);
+
+    std::vector<PendingMsg> pending_;                            // 待写入队列
+    std::chrono::steady_clock::time_point first_enqueue_;       // 当前批次第一条消息的入队时间
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread worker_;
+    std::atomic<bool> b_stop_;
+    bool b_started_;
+
+    size_t max_rows_;
+    std::chrono::milliseconds max_delay_;
+
+    static constexpr int DEFAULT_MAX_ROWS = 200;
+    static constexpr int DEFAULT_MAX_DELAY_MS = 5;
+};
@@ -0,0 +1,240 @@
+#include "MsgCodec.h"
+#include "ConfigMgr.h"
+#include "message.pb.h"
+#include <json/json.h>
+#include <zlib.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+MsgCodec::MsgCodec()
+    : b_enabled_(true), compress_min_(256), level_(Z_DEFAULT_COMPRESSION), active_dict_(0) {
+}
+
+void MsgCodec::Init() {
+    auto& cfg = ConfigMgr::Inst();
+    b_enabled_ = cfg["MsgCodec"]["Enable"] != "0";
+    try { compress_min_ = static_cast<size_t>(std::stoul(cfg["MsgCodec"]["CompressMin"])); }
+    catch (...) {}
+    try { level_ = std::stoi(cfg["MsgCodec"]["Level"]); }
+    catch (...) {}
+    if (level_ < Z_DEFAULT_COMPRESSION || level_ > Z_BEST_COMPRESSION) level_ = Z_DEFAULT_COMPRESSION;
+
+    // 逗号分隔的字典文件，第一个用于压缩，其余只用于解压老数据
+    std::stringstream files(cfg["MsgCodec"]["DictFiles"]);
+    std::string file;
+    while (std::getline(files, file, ',')) {
+        file.erase(0, file.find_first_not_of(" \t"));
+        file.erase(file.find_last_not_of(" \t") + 1);
+        if (file.empty()) continue;
+
+        std::ifstream in(file, std::ios::binary);
+        std::string dict;
+        if (in) {
+            dict.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        if (dict.empty()) {
+            std::cerr << "[MsgCodec] failed to load dictionary " << file << std::endl;
+            continue;
+        }
+        unsigned long id = adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(dict.data()),
+            static_cast<uInt>(dict.size()));
+        if (active_dict_ == 0) active_dict_ = id;
+        dicts_[id] = std::move(dict);
+        std::cout << "[MsgCodec] loaded dictionary " << file << " id=" << id << std::endl;
+    }
+
+    std::cout << "[MsgCodec] enabled=" << std::boolalpha << b_enabled_ << " compress_min=" << compress_min_
+        << " level=" << level_ << " dicts=" << dicts_.size() << std::endl;
+}
+
+int MsgCodec::Encode(const std::string& payload, std::string& blob) const {
+    blob = payload;
+    if (!b_enabled_) return CODEC_JSON;
+
+    // 只识别聊天消息的固定结构，其余字段（error / fromuid / touid）读出时由列还原
+    Json::Reader reader;
+    Json::Value root;
+    if (!reader.parse(payload, root) || !root.isObject() || !root["text_array"].isArray()) {
+        return CODEC_JSON;
+    }
+    for (const auto& name : root.getMemberNames()) {
+        if (name != "text_array" && name != "error" && name != "fromuid" && name != "touid") {
+            return CODEC_JSON;
+        }
+    }
+    if (root.get("error", 0).asInt() != 0) {
+        return CODEC_JSON;
+    }
+
+    message::TextChatMsgReq req;
+    for (const auto& item : root["text_array"]) {
+        if (!item.isObject() || item.size() != 2 || !item["content"].isString() || !item["msgid"].isString()) {
+            return CODEC_JSON;
+        }
+        auto* text = req.add_textmsgs();
+        text->set_msgid(item["msgid"].asString());
+        text->set_msgcontent(item["content"].asString());
+    }
+
+    std::string proto;
+    if (!req.SerializeToString(&proto)) {
+        return CODEC_JSON;
+    }
+    std::string zipped;
+    if (proto.size() >= compress_min_ && Compress(proto, zipped) && zipped.size() < proto.size()) {
+        blob.swap(zipped);
+        return CODEC_PROTO_ZLIB;
+    }
+    blob.swap(proto);
+    return CODEC_PROTO;
+}
+
+namespace {
+    constexpr size_t MAX_KEY_MSGID = 47;     // 64 字节的去重键 = msgid（截断） + ":" + 16 位十六进制摘要
+
+    // 取出 text_array 中每一条的 (msgid, content)，不是聊天消息结构时返回 false
+    bool ParseTextItems(const std::string& payload, std::vector<std::pair<std::string, std::string>>& items) {
+        Json::Reader reader;
+        Json::Value root;
+        if (!reader.parse(payload, root) || !root.isObject() || !root["text_array"].isArray()
+            || root["text_array"].empty()) {
+            return false;
+        }
+        for (const auto& item : root["text_array"]) {
+            if (!item.isObject()) return false;
+            const Json::Value& msgid = item["msgid"];
+            const Json::Value& content = item["content"];
+            items.emplace_back(msgid.isString() ? msgid.asString() : std::string(),
+                content.isString() ? content.asString() : std::string());
+        }
+        return true;
+    }
+
+    // FNV-1a 64；每个字段先混入长度，避免 "ab"+"c" 与 "a"+"bc" 得到相同摘要
+    void Fnv1a(unsigned long long& h, const std::string& s) {
+        const unsigned long long prime = 1099511628211ULL;
+        unsigned long long len = s.size();
+        for (int i = 0; i < 8; ++i) {
+            h ^= (len >> (i * 8)) & 0xff;
+            h *= prime;
+        }
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= prime;
+        }
+    }
+} // namespace
+
+std::string MsgCodec::ClientMsgId(const std::string& payload) {
+    std::vector<std::pair<std::string, std::string>> items;
+    if (!ParseTextItems(payload, items) || items.front().first.empty()) {
+        return std::string();
+    }
+    unsigned long long h = 14695981039346656037ULL;
+    for (const auto& item : items) {
+        Fnv1a(h, item.first);
+        Fnv1a(h, item.second);
+    }
+    char digest[17];
+    std::snprintf(digest, sizeof(digest), "%016llx", h);
+    return items.front().first.substr(0, MAX_KEY_MSGID) + ":" + digest;
+}
+
+bool MsgCodec::SameText(const std::string& a, const std::string& b) {
+    std::vector<std::pair<std::string, std::string>> lhs, rhs;
+    return ParseTextItems(a, lhs) && ParseTextItems(b, rhs) && lhs == rhs;
+}
+
+bool MsgCodec::Decode(int codec, const std::string& blob, int fromUid, int toUid, std::string& payload) const {
+    if (codec == CODEC_JSON) {
+        payload = blob;
+        return true;
+    }
+
+    message::TextChatMsgReq req;
+    if (codec == CODEC_PROTO) {
+        if (!req.ParseFromString(blob)) return false;
+    }
+    else if (codec == CODEC_PROTO_ZLIB) {
+        std::string proto;
+        if (!Decompress(blob, proto) || !req.ParseFromString(proto)) return false;
+    }
+    else {
+        return false;
+    }
+
+    Json::Value root;
+    root["error"] = 0;
+    root["fromuid"] = fromUid;
+    root["touid"] = toUid;
+    root["text_array"] = Json::Value(Json::arrayValue);
+    for (const auto& text : req.textmsgs()) {
+        Json::Value item;
+        item["content"] = text.msgcontent();
+        item["msgid"] = text.msgid();
+        root["text_array"].append(item);
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    payload = Json::writeString(builder, root);
+    return true;
+}
+
+bool MsgCodec::Compress(const std::string& in, std::string& out) const {
+    z_stream zs{};
+    if (deflateInit(&zs, level_) != Z_OK) return false;
+    if (active_dict_ != 0) {
+        const std::string& dict = dicts_.at(active_dict_);
+        deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(dict.data()), static_cast<uInt>(dict.size()));
+    }
+
+    out.resize(deflateBound(&zs, static_cast<uLong>(in.size())));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+bool MsgCodec::Decompress(const std::string& in, std::string& out) const {
+    z_stream zs{};
+    if (inflateInit(&zs) != Z_OK) return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+
+    out.clear();
+    char chunk[4096];
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        zs.next_out = reinterpret_cast<Bytef*>(chunk);
+        zs.avail_out = sizeof(chunk);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        if (rc == Z_NEED_DICT) {
+            auto it = dicts_.find(zs.adler);
+            if (it == dicts_.end()) {
+                std::cerr << "[MsgCodec] missing dictionary id=" << zs.adler << std::endl;
+                break;
+            }
+            rc = inflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(it->second.data()),
+                static_cast<uInt>(it->second.size()));
+            if (rc != Z_OK) break;
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END) break;
+        out.append(chunk, sizeof(chunk) - zs.avail_out);
+        if (out.size() > MAX_PAYLOAD) {
+            rc = Z_DATA_ERROR;
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
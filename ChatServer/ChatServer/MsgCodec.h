@@ -0,0 +1,70 @@
+#pragma once
+#include <map>
+#include <string>
+#include "Singleton.h"
+
+// messages.payload 的存储编码
+//
+// 作用：
+//   客户端发来的聊天消息原先以 toStyledString() 的 JSON 整包入库，缩进、换行、重复的字段名、
+//   error / fromuid / touid 这些路由字段占了大半体积，而 from_uid / to_uid 本来就有单独的列。
+//   入库时只保留 text_array，编码成 protobuf TextChatMsgReq（只填 textmsgs），
+//   超过 CompressMin 字节再用 zlib 压缩（可带预置字典）；读出时按列还原成紧凑 JSON 下发，
+//   客户端看到的格式不变。
+//
+// messages.codec 列：
+//   0  JSON 原文（老数据，或无法识别的结构）
+//   1  protobuf
+//   2  protobuf + zlib，流头里带字典的 adler32，解压时按它找字典
+//
+// 字典：
+//   用 tools/train_payload_dict.py 从已有消息生成，文件名即 adler32。
+//   DictFiles 可以列多个，压缩用第一个；换字典时把新字典放在最前，旧字典保留，否则旧数据解不开。
+//
+// 配置（config.ini）：
+//   [MsgCodec]
+//   Enable = 1              // 0 表示新消息仍按 JSON 原文入库
+//   CompressMin = 256       // protobuf 编码后不少于这么多字节才压缩
+//   Level = 6
+//   DictFiles =             // 逗号分隔，为空表示不用字典
+class MsgCodec : public Singleton<MsgCodec> {
+    friend class Singleton<MsgCodec>;
+public:
+    enum Codec {
+        CODEC_JSON = 0,
+        CODEC_PROTO = 1,
+        CODEC_PROTO_ZLIB = 2,
+    };
+
+    // 读取 [MsgCodec] 配置并加载字典
+    void Init();
+
+    // 客户端 JSON -> 存储格式，返回 codec；线程安全
+    int Encode(const std::string& payload, std::string& blob) const;
+
+    // 存储格式 -> 下发给客户端的 JSON；线程安全
+    bool Decode(int codec, const std::string& blob, int fromUid, int toUid, std::string& payload) const;
+
+    // 消息的去重键："第一条 msgid:整个 text_array 的 64 位摘要"（不超过 64 字节）。
+    // 只用 msgid 时同一毫秒发出的两条不同消息会撞键，后一条被当成重发丢掉；
+    // 带上内容摘要后，只有 msgid 和每一条内容都相同的重发才会落到同一个键上。
+    // 不是聊天消息结构时返回空串
+    static std::string ClientMsgId(const std::string& payload);
+
+    // 两个客户端 JSON 的 text_array（逐条 msgid、content）是否完全相同，用于确认去重键命中的确是同一条消息
+    static bool SameText(const std::string& a, const std::string& b);
+
+private:
+    MsgCodec();
+
+    bool Compress(const std::string& in, std::string& out) const;
+    bool Decompress(const std::string& in, std::string& out) const;
+
+    bool b_enabled_;
+    size_t compress_min_;
+    int level_;
+    std::map<unsigned long, std::string> dicts_;   // adler32 -> 字典内容
+    unsigned long active_dict_;                     // 压缩使用的字典，0 表示不用
+
+    static constexpr size_t MAX_PAYLOAD = 1024 * 1024;
+};
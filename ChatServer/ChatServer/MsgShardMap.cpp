@@ -0,0 +1,48 @@
+#include "MsgShardMap.h"
+#include "ConfigMgr.h"
+#include <iostream>
+
+void MsgShardMap::Init(std::shared_ptr<MySqlPool> primary, int defaultMin, int defaultMax)
+{
+    auto& cfg = ConfigMgr::Inst();
+    int count = 0;
+    try { count = std::stoi(cfg["MsgShard"]["Count"]); }
+    catch (...) {}
+    if (count <= 1) {
+        std::cout << "[MsgShardMap] messages not sharded" << std::endl;
+        return;
+    }
+
+    // 未配置的项沿用 [Mysql]
+    auto value = [&cfg](const std::string& section, const std::string& key) {
+        std::string v = cfg[section][key];
+        return v.empty() ? cfg["Mysql"][key] : v;
+    };
+
+    std::vector<std::shared_ptr<MySqlPool>> shards;
+    for (int i = 0; i < count; ++i) {
+        std::string section = "MsgShard" + std::to_string(i);
+        std::string host = cfg[section]["Host"];
+        if (host.empty()) {
+            shards.push_back(primary);
+            std::cout << "[MsgShardMap] shard " << i << " -> primary pool" << std::endl;
+            continue;
+        }
+
+        int pool_min = defaultMin;
+        int pool_max = defaultMax;
+        try { pool_min = std::stoi(cfg[section]["PoolMin"]); }
+        catch (...) {}
+        try { pool_max = std::stoi(cfg[section]["PoolMax"]); }
+        catch (...) {}
+
+        std::string url = "tcp://" + host + ":" + value(section, "Port");
+        auto pool = std::make_shared<MySqlPool>();
+        pool->Init(url, value(section, "User"), value(section, "Passwd"), value(section, "Schema"), pool_min, pool_max);
+        shards.push_back(pool);
+        std::cout << "[MsgShardMap] shard " << i << " -> " << url << "/" << value(section, "Schema") << std::endl;
+    }
+
+    shards_.swap(shards);
+    std::cout << "[MsgShardMap] messages sharded by to_uid % " << shards_.size() << std::endl;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+#include "Singleton.h"
+
+class AsioIOServicePool;
+
+// 一次查询的结果：ok 为 false 时 error 为原因（连接故障、SQL 错误、排队超限等）
+struct MysqlResult {
+    bool ok = false;
+    std::string error;
+    unsigned long long affected = 0;                            // INSERT / UPDATE / DELETE 影响行数
+    std::vector<std::vector<std::optional<std::string>>> rows;  // 按 SELECT 的列顺序，NULL 为 nullopt
+};
+
+// SQL 中 '?' 占位符的参数：整数原样展开，字符串转义后加引号
+using MysqlParam = std::variant<long long, std::string>;
+
+// 非阻塞 MySQL 客户端（libmysqlclient 的 nonblocking API）
+//
+// 作用：
+//   MySqlPool 的连接是阻塞的，每次 DAO 调用都要占住一个线程等完整的往返，
+//   所以要靠十几个线程的 AsyncDBPool 撑并发，连接池取不到连接时还要限时等待。
+//   这里在 AsioIOServicePool 的 io_context 上维护少量长连接，查询发出后立即返回，
+//   socket 可读时在 IO 线程上继续推进，等待中的查询不占任何线程。
+//
+// 实现：
+//   每条连接一个 strand。mysql_real_query_nonblocking / mysql_store_result_nonblocking
+//   返回 NET_ASYNC_NOT_READY 时在 socket 上 async_wait 可读，就绪后再调用一次，直到完成。
+//   参数在连接的 strand 上按连接字符集转义后拼进 SQL（mysql_real_escape_string）。
+//   MySQL 协议不支持流水线，一条连接同一时刻只执行一条查询，其余在连接上排队；
+//   并发度等于连接数，排队的查询只占内存。
+//
+// 顺序：
+//   Query(key, ...) / QueryMsg(uid, ...) 中相同 key 总落在同一条连接上，按提交顺序执行、回调。
+//
+// 路由：
+//   Query 发往 [Mysql] 主库；QueryMsg 发往收件人所在的消息分片（[MsgShard]，规则同 MsgShardMap），
+//   未分片或分片 Host 为空时为主库。不走 [MysqlReplica] 从库，读总能看到自己的写。
+//
+// 失败：
+//   连接断开、查询超过 TimeoutMs 没有完成时关闭连接，在途和排队的查询都以 ok 为 false 回调，
+//   随后按退避间隔重连。断线期间的新查询立即失败，不会堆积。SQL 错误只让这一条查询失败。
+//
+// 回调在 IO 线程上执行，不能做阻塞操作（同步 MySQL、同步 gRPC、同步 RedisMgr），需要时转交 AsyncDBPool。
+//
+// 配置（config.ini）：
+//   [MysqlAsync]
+//   Connections = 4         // 每个库的连接数，0 表示不启用，调用方继续走 AsyncDBPool + MySqlPool
+//   TimeoutMs = 5000        // 建连或一条查询超过这个时间视为连接故障
+//   MaxPending = 100000     // 每条连接排队上限，超出的查询直接失败
+//   地址和账号沿用 [Mysql] / [MsgShardN]
+class MysqlAsync : public Singleton<MysqlAsync> {
+    friend class Singleton<MysqlAsync>;
+public:
+    using Callback = std::function<void(MysqlResult)>;
+
+    ~MysqlAsync();
+
+    // 读取配置并在 AsioIOServicePool 上建立连接，须在 IO 线程池启动之后调用
+    void Init();
+
+    // 关闭所有连接，之后的查询立即失败；须在 AsioIOServicePool::Stop 之前调用
+    void Stop();
+
+    bool Enabled() const { return enabled_; }
+
+    // 在主库上执行，key 相同的查询走同一条连接
+    void Query(long long key, std::string sql, std::vector<MysqlParam> params, Callback callback);
+    // 在 uid 所在的消息分片上执行，同一 uid 的查询走同一条连接
+    void QueryMsg(int uid, std::string sql, std::vector<MysqlParam> params, Callback callback);
+
+private:
+    class Connection;
+    using ConnGroup = std::vector<std::shared_ptr<Connection>>;
+
+    MysqlAsync() = default;
+
+    std::shared_ptr<ConnGroup> MakeConns(const std::string& name, const std::string& host, unsigned int port,
+        const std::string& user, const std::string& pwd, const std::string& schema);
+    void Dispatch(const ConnGroup& conns, size_t index, std::string sql, std::vector<MysqlParam> params, Callback callback);
+
+    // 连接的 socket、定时器属于 IO 线程池的 io_context，持有线程池保证它晚于连接析构
+    std::shared_ptr<AsioIOServicePool> pool_;
+    std::shared_ptr<ConnGroup> main_;
+    std::vector<std::shared_ptr<ConnGroup>> shards_;    // 消息分片，未分片时为空
+    bool enabled_ = false;
+
+    size_t connections_ = 0;
+    std::chrono::milliseconds timeout_{ 5000 };
+    size_t max_pending_ = 0;
+};
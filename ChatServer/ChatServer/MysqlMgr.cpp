@@ -1,4 +1,5 @@
 #include "MysqlMgr.h"
+#include "MsgArchive.h"
 
 MysqlMgr::~MysqlMgr() {
 
@@ -70,17 +71,73 @@ bool MysqlMgr::SaveChatMessage(int fromUid, int toUid, const std::string& payloa
     return _dao.SaveChatMessage(fromUid, toUid, payload);
 }
 
+bool MysqlMgr::SaveChatMessages(std::vector<ChatMsgRecord>& msgs)
+{
+    return _dao.SaveChatMessages(msgs);
+}
+
 bool MysqlMgr::GetUnreadChatMessages(int uid, std::vector<long long>& ids, std::vector<std::string>& payloads)
 {
     return _dao.GetUnreadChatMessagesWithIds(uid, ids, payloads);
 }
 
-bool MysqlMgr::DeleteChatMessagesByIds(const std::vector<long long>& ids)
+bool MysqlMgr::GetUnreadChatMessagesPage(int uid, long long after_id, int limit,
+    std::vector<long long>& ids, std::vector<std::string>& payloads)
 {
-    return _dao.DeleteChatMessagesByIds(ids);
+    return _dao.GetUnreadChatMessagesPage(uid, after_id, limit, ids, payloads);
 }
 
 bool MysqlMgr::AckOfflineMessages(int uid, long long max_msg_id)
 {
     return _dao.AckOfflineMessages(uid, max_msg_id);
-}
\ No newline at end of file
+}
+
+bool MysqlMgr::AckOfflineMessage(int uid, long long msg_id)
+{
+    return _dao.AckOfflineMessage(uid, msg_id);
+}
+
+long long MysqlMgr::GetUnreadCount(int uid)
+{
+    return _dao.GetUnreadCount(uid);
+}
+bool MysqlMgr::GetChatHistoryPage(int uid, long long before_id, int limit, ChatMsgPage& page)
+{
+    page.ok = _dao.GetChatHistoryPage(uid, before_id, limit, page.ids, page.payloads);
+    FillFromArchive(uid, before_id, limit, page);
+    return page.ok;
+}
+
+void MysqlMgr::FillFromArchive(int uid, long long before_id, int limit, ChatMsgPage& page)
+{
+    if (page.ok && (int)page.ids.size() < limit && MsgArchive::GetInstance()->Enabled()) {
+        long long before = page.ids.empty() ? before_id : page.ids.back();
+        page.ok = MsgArchive::GetInstance()->ReadHistory(uid, before, limit - (int)page.ids.size(), page);
+    }
+    page.has_more = page.ok && (int)page.ids.size() >= limit;
+}
+
+bool MysqlMgr::ArchiveEnabled()
+{
+    return MsgArchive::GetInstance()->Enabled();
+}
+
+size_t MysqlMgr::MsgShardCount()
+{
+    return _dao.MsgShardCount();
+}
+
+bool MysqlMgr::GetReadCursors(size_t shard, int after_uid, int limit, std::vector<std::pair<int, long long>>& cursors)
+{
+    return _dao.GetReadCursors(shard, after_uid, limit, cursors);
+}
+
+bool MysqlMgr::GetStoredChatMessages(int uid, long long max_id, int limit, std::vector<StoredChatMsg>& rows)
+{
+    return _dao.GetStoredChatMessages(uid, max_id, limit, rows);
+}
+
+long long MysqlMgr::DeleteChatMessagesUpTo(int uid, long long max_id)
+{
+    return _dao.DeleteChatMessagesUpTo(uid, max_id);
+}
@@ -2,7 +2,12 @@
 #include "const.h"
 #include "MysqlDao.h"
 #include "data.h"
+#include "MysqlAsync.h"
+#include "AsyncDBPool.h"
+#include <boost/asio/post.hpp>
+#include <functional>
 #include <vector>
+#include <memory>
 class MysqlMgr : public Singleton<MysqlMgr>
 {
     friend class Singleton<MysqlMgr>;
@@ -22,11 +27,122 @@ public:
     std::vector<UserInfo> GetMyFriends(int uid);
     bool IsFriend(int uid1, int uid2);
     bool SaveChatMessage(int fromUid, int toUid, const std::string& payload);
+    // 成功的记录回填 _id；只写 _id 为 0 的记录，重试同一批时已成功的不再重写
+    bool SaveChatMessages(std::vector<ChatMsgRecord>& msgs);
     bool GetUnreadChatMessages(int uid, std::vector<long long>& ids, std::vector<std::string>& payloads);
-    bool DeleteChatMessagesByIds(const std::vector<long long>& ids);
+    bool GetUnreadChatMessagesPage(int uid, long long after_id, int limit,
+        std::vector<long long>& ids, std::vector<std::string>& payloads);
     bool AckOfflineMessages(int uid, long long max_msg_id);
+    bool AckOfflineMessage(int uid, long long msg_id);
+    long long GetUnreadCount(int uid);
+    // 收件历史分页：先查 messages 表，不足一页再从归档补齐（归档中的 id 都小于表中剩余的 id）
+    bool GetChatHistoryPage(int uid, long long before_id, int limit, ChatMsgPage& page);
+
+    // 离线分页、确认、历史分页的异步版本：handler 在 executor（例如会话的 strand）上执行，每次调用恰好回调一次。
+    // 启用 MysqlAsync 时查询在 IO 线程上非阻塞执行，否则退回 AsyncDBPool + 同步版本。
+    // 两种方式下同一 uid 的调用都按调用顺序执行
+    template <typename Executor, typename Handler>
+    void GetUnreadChatMessagesPageAsync(int uid, long long after_id, int limit, const Executor& ex, Handler handler);
+    template <typename Executor, typename Handler>
+    void AckOfflineMessagesAsync(int uid, long long max_msg_id, const Executor& ex, Handler handler);
+    template <typename Executor, typename Handler>
+    void AckOfflineMessageAsync(int uid, long long msg_id, const Executor& ex, Handler handler);
+    template <typename Executor, typename Handler>
+    void GetChatHistoryPageAsync(int uid, long long before_id, int limit, const Executor& ex, Handler handler);
+    // 归档任务使用，见 MysqlDao
+    size_t MsgShardCount();
+    bool GetReadCursors(size_t shard, int after_uid, int limit, std::vector<std::pair<int, long long>>& cursors);
+    bool GetStoredChatMessages(int uid, long long max_id, int limit, std::vector<StoredChatMsg>& rows);
+    long long DeleteChatMessagesUpTo(int uid, long long max_id);
+
 private:
     MysqlMgr();
+    // 把 MysqlAsync 回调（IO 线程）里的结果转交到 executor 上执行 handler
+    template <typename Result, typename Executor, typename Handler>
+    static std::function<void(Result)> PostTo(const Executor& ex, Handler handler);
+    // 表里不足一页时从归档补齐并设置 has_more；读归档是阻塞的文件 IO
+    void FillFromArchive(int uid, long long before_id, int limit, ChatMsgPage& page);
+    static bool ArchiveEnabled();
+
     MysqlDao  _dao;
 };
 
+template <typename Result, typename Executor, typename Handler>
+std::function<void(Result)> MysqlMgr::PostTo(const Executor& ex, Handler handler)
+{
+    return [ex, handler](Result result) {
+        boost::asio::post(ex, [handler, result = std::move(result)]() mutable {
+            handler(std::move(result));
+        });
+    };
+}
+
+template <typename Executor, typename Handler>
+void MysqlMgr::GetUnreadChatMessagesPageAsync(int uid, long long after_id, int limit, const Executor& ex, Handler handler)
+{
+    if (!MysqlAsync::GetInstance()->Enabled()) {
+        AsyncDBPool::GetInstance()->PostTask(uid, [this, uid, after_id, limit]() {
+            ChatMsgPage page;
+            page.ok = _dao.GetUnreadChatMessagesPage(uid, after_id, limit, page.ids, page.payloads);
+            page.has_more = page.ok && static_cast<int>(page.ids.size()) >= limit;
+            return page;
+        }, ex, std::move(handler));
+        return;
+    }
+    auto post = PostTo<ChatMsgPage>(ex, std::move(handler));
+    _dao.GetUnreadChatMessagesPageAsync(uid, after_id, limit, [limit, post](ChatMsgPage page) {
+        page.has_more = page.ok && static_cast<int>(page.ids.size()) >= limit;
+        post(std::move(page));
+    });
+}
+
+template <typename Executor, typename Handler>
+void MysqlMgr::AckOfflineMessagesAsync(int uid, long long max_msg_id, const Executor& ex, Handler handler)
+{
+    if (!MysqlAsync::GetInstance()->Enabled()) {
+        AsyncDBPool::GetInstance()->PostTask(uid, [this, uid, max_msg_id]() {
+            return _dao.AckOfflineMessages(uid, max_msg_id);
+        }, ex, std::move(handler));
+        return;
+    }
+    _dao.AckOfflineMessagesAsync(uid, max_msg_id, PostTo<bool>(ex, std::move(handler)));
+}
+
+template <typename Executor, typename Handler>
+void MysqlMgr::AckOfflineMessageAsync(int uid, long long msg_id, const Executor& ex, Handler handler)
+{
+    if (!MysqlAsync::GetInstance()->Enabled()) {
+        AsyncDBPool::GetInstance()->PostTask(uid, [this, uid, msg_id]() {
+            return _dao.AckOfflineMessage(uid, msg_id);
+        }, ex, std::move(handler));
+        return;
+    }
+    _dao.AckOfflineMessageAsync(uid, msg_id, PostTo<bool>(ex, std::move(handler)));
+}
+
+template <typename Executor, typename Handler>
+void MysqlMgr::GetChatHistoryPageAsync(int uid, long long before_id, int limit, const Executor& ex, Handler handler)
+{
+    if (!MysqlAsync::GetInstance()->Enabled()) {
+        AsyncDBPool::GetInstance()->PostTask(uid, [this, uid, before_id, limit]() {
+            ChatMsgPage page;
+            GetChatHistoryPage(uid, before_id, limit, page);
+            return page;
+        }, ex, std::move(handler));
+        return;
+    }
+    _dao.GetChatHistoryPageAsync(uid, before_id, limit, [this, uid, before_id, limit, ex, handler](ChatMsgPage page) {
+        if (!page.ok || static_cast<int>(page.ids.size()) >= limit || !ArchiveEnabled()) {
+            page.has_more = page.ok && static_cast<int>(page.ids.size()) >= limit;
+            PostTo<ChatMsgPage>(ex, handler)(std::move(page));
+            return;
+        }
+        // 不足一页且启用了归档：读归档文件会阻塞，转交 AsyncDBPool
+        AsyncDBPool::GetInstance()->PostTask(uid, [this, uid, before_id, limit, page]() {
+            ChatMsgPage filled = page;
+            FillFromArchive(uid, before_id, limit, filled);
+            return filled;
+        }, ex, handler);
+    });
+}
+
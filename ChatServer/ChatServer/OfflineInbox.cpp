@@ -0,0 +1,531 @@
+#include "OfflineInbox.h"
+#include "RedisMgr.h"
+#include "ConfigMgr.h"
+#include <map>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    // 各脚本共用：热层代数 = 全局代数 .. '.' .. 用户代数。
+    // 单机模式下调用方把 inbox_epoch 作为最后一个 KEY 传入，脚本每次现读；
+    // 集群模式下它与用户的键不在同一个槽，不传（g 为 nil），全局部分固定为 '-'，只用水位哈希里的用户代数
+    const char* EPOCH_LUA = R"lua(
+local function inbox_epoch(state, g)
+  local ge = '-'
+  if g then ge = redis.call('GET', g) or '0' end
+  return ge .. '.' .. (redis.call('HGET', state, 'epoch') or '0')
+end
+)lua";
+
+    // KEYS = 需置为未知的水位 * m, 然后本次写入的每个收件人两个键：水位、进行中的写入；ARGV = m, ticket, TtlSec
+    // 进行中的写入记为 ticket，score 为此刻的 hwm：这次写入的消息 id 在此之后才分配，一定大于它
+    const char* BEGIN_SCRIPT = R"lua(
+local m = tonumber(ARGV[1])
+for i = 1, m do
+  redis.call('HDEL', KEYS[i], 'hwm')
+end
+for i = m + 1, #KEYS, 2 do
+  redis.call('ZADD', KEYS[i + 1], redis.call('HGET', KEYS[i], 'hwm') or '0', ARGV[2])
+  redis.call('EXPIRE', KEYS[i + 1], ARGV[3])
+end
+return 1
+)lua";
+
+    // KEYS = 每个收件人三个键：热层、水位、进行中的写入，单机模式下最后再加 inbox_epoch
+    // ARGV = HotMax, TtlSec, ticket, 然后每个收件人: 条数, (id, member) * 条数
+    const char* COMMIT_SCRIPT = R"lua(
+local max = tonumber(ARGV[1])
+local ttl = tonumber(ARGV[2])
+local nkeys = #KEYS - #KEYS % 3
+local g = nil
+if nkeys < #KEYS then g = KEYS[#KEYS] end
+local pos = 4
+for k = 1, nkeys, 3 do
+  local key = KEYS[k]
+  local state = KEYS[k + 1]
+  local n = tonumber(ARGV[pos])
+  pos = pos + 1
+  local minid, maxid
+  for i = 0, n - 1 do
+    local id = tonumber(ARGV[pos + i * 2])
+    if not minid or id < minid then minid = id end
+    if not maxid or id > maxid then maxid = id end
+  end
+
+  -- 水位：hwm 只增不减，结束本次写入
+  local hwm = redis.call('HGET', state, 'hwm')
+  if not hwm or tonumber(hwm) < maxid then redis.call('HSET', state, 'hwm', string.format('%d', maxid)) end
+  redis.call('ZREM', KEYS[k + 2], ARGV[3])
+  redis.call('EXPIRE', state, ttl)
+
+  -- 热层
+  local epoch = inbox_epoch(state, g)
+  local head = redis.call('ZRANGE', key, 0, 0, 'WITHSCORES')
+  local floor, read
+  if head[1] then
+    local e, r = string.match(head[1], '^~([^:]*):(%d+)$')
+    if e == epoch then
+      floor = tonumber(head[2])
+      read = r
+    end
+  end
+  if not floor then
+    -- 未建立或已失效：以本批最小 id - 1 为 floor 重建，保留其上已有的消息
+    floor = minid - 1
+    read = '0'
+    if head[1] and string.sub(head[1], 1, 1) == '~' then redis.call('ZREM', key, head[1]) end
+    redis.call('ZREMRANGEBYSCORE', key, '-inf', string.format('%d', floor))
+    redis.call('ZADD', key, string.format('%d', floor), '~' .. epoch .. ':0')
+  end
+  for i = 1, n do
+    if tonumber(ARGV[pos]) > floor then redis.call('ZADD', key, ARGV[pos], ARGV[pos + 1]) end
+    pos = pos + 2
+  end
+  -- 超出 HotMax 时裁掉最旧的消息，floor 上调到被裁掉的最大 id
+  local extra = redis.call('ZCARD', key) - 1 - max
+  if extra > 0 then
+    local cut = redis.call('ZRANGE', key, extra, extra, 'WITHSCORES')
+    redis.call('ZREMRANGEBYRANK', key, 0, extra)
+    redis.call('ZADD', key, cut[2], '~' .. epoch .. ':' .. read)
+  end
+  redis.call('EXPIRE', key, ttl)
+end
+return 1
+)lua";
+
+    // KEYS = 每个收件人两个键：水位、进行中的写入；ARGV = ticket（为空表示没有标记）
+    // 写库失败时部分分片可能已写入，hwm 置为未知，等 MySQL 查询后重建
+    const char* ABORT_SCRIPT = R"lua(
+for i = 1, #KEYS, 2 do
+  redis.call('HDEL', KEYS[i], 'hwm')
+  if ARGV[1] ~= '' then redis.call('ZREM', KEYS[i + 1], ARGV[1]) end
+end
+return 1
+)lua";
+
+    // KEYS = 各收件人水位；ARGV = TtlSec
+    // 递增这批收件人的用户代数，让他们的热层失效，下次写入时重建
+    const char* BUMP_SCRIPT = R"lua(
+for i = 1, #KEYS do
+  redis.call('HINCRBY', KEYS[i], 'epoch', 1)
+  redis.call('EXPIRE', KEYS[i], ARGV[1])
+end
+return 1
+)lua";
+
+    // KEYS = 热层, 水位, 进行中的写入, 单机模式下再加 inbox_epoch；ARGV = cursor, limit
+    // 返回 {0} 未命中，{1, member...} 热层命中（最多 limit + 1 条，用于判断 has_more），{2} 没有新消息，
+    // {3, member...} 有进行中的写入，只出到它们最小的 score（水位）为止，之后可能还有
+    //
+    // 进行中的写入还没进热层，它们的 id 都大于各自开始时的 hwm；热层只在这个水位以下是完整的。
+    // 不设上限的话，先完成的写入（id 大）会先出页、被确认，之后完成的小 id 落在 floor 以下被丢掉
+    const char* READ_SCRIPT = R"lua(
+local w = redis.call('ZRANGE', KEYS[3], 0, 0, 'WITHSCORES')
+local function hot()
+  local head = redis.call('ZRANGE', KEYS[1], 0, 0, 'WITHSCORES')
+  if not head[1] then return nil end
+  local e, r = string.match(head[1], '^~([^:]*):(%d+)$')
+  if e ~= inbox_epoch(KEYS[2], KEYS[4]) then return nil end
+  local from = math.max(tonumber(ARGV[1]), tonumber(r))
+  if from < tonumber(head[2]) then return nil end
+  local to = '+inf'
+  if w[1] then to = w[2] end
+  return redis.call('ZRANGEBYSCORE', KEYS[1], string.format('(%d', from), to, 'LIMIT', 0, tonumber(ARGV[2]) + 1)
+end
+local items = hot()
+if items then
+  if not w[1] then return {1, items} end
+  if #items > 0 then return {3, items} end
+  return {0}
+end
+local st = redis.call('HMGET', KEYS[2], 'hwm', 'read')
+if st[1] and not w[1] then
+  if tonumber(st[1]) <= math.max(tonumber(ARGV[1]), tonumber(st[2] or '0')) then return {2} end
+end
+return {0}
+)lua";
+
+    // KEYS = 水位, 进行中的写入；ARGV = seen, now_ms, WIP_STALE_MS, TtlSec
+    // 有新近的写入时不重建：查询期间可能有写入正在提交。
+    // ticket 以开始时间开头，过期说明写入方在「已入库、未写热层」之间崩溃或失联，删除时递增用户代数，让热层失效
+    const char* OBSERVE_SCRIPT = R"lua(
+local live = false
+local stale = false
+for _, t in ipairs(redis.call('ZRANGE', KEYS[2], 0, -1)) do
+  local ts = tonumber(string.match(t, '^(%d+):') or '0')
+  if tonumber(ARGV[2]) - ts >= tonumber(ARGV[3]) then
+    redis.call('ZREM', KEYS[2], t)
+    stale = true
+  else
+    live = true
+  end
+end
+if stale then redis.call('HINCRBY', KEYS[1], 'epoch', 1) end
+if live then return 0 end
+local hwm = redis.call('HGET', KEYS[1], 'hwm')
+if not hwm or tonumber(hwm) < tonumber(ARGV[1]) then redis.call('HSET', KEYS[1], 'hwm', ARGV[1]) end
+redis.call('EXPIRE', KEYS[1], ARGV[4])
+return 1
+)lua";
+
+    // KEYS = 热层, 水位, 单机模式下再加 inbox_epoch；ARGV = cursor, TtlSec
+    // 游标超过 hwm（已入库的最大 id）或 hwm 未知时拒绝，返回 -1：
+    // 否则热层的 floor 被抬到还没写入的 id 之上，之后写入的消息不在覆盖范围内也会被当成已读
+    const char* ACK_SCRIPT = R"lua(
+local c = tonumber(ARGV[1])
+local hwm = redis.call('HGET', KEYS[2], 'hwm')
+if not hwm or c > tonumber(hwm) then return -1 end
+local sr = redis.call('HGET', KEYS[2], 'read')
+if not sr or tonumber(sr) < c then
+  redis.call('HSET', KEYS[2], 'read', ARGV[1])
+  redis.call('EXPIRE', KEYS[2], ARGV[2])
+end
+local epoch = inbox_epoch(KEYS[2], KEYS[3])
+local head = redis.call('ZRANGE', KEYS[1], 0, 0, 'WITHSCORES')
+if not head[1] then return 0 end
+local e, r = string.match(head[1], '^~([^:]*):(%d+)$')
+if e ~= epoch then return 0 end
+if c <= tonumber(r) then return 1 end
+local floor = math.max(tonumber(head[2]), c)
+redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', string.format('%d', floor))
+redis.call('ZADD', KEYS[1], string.format('%d', floor), '~' .. epoch .. ':' .. string.format('%d', c))
+return 1
+)lua";
+
+    // 同一用户的热层、水位和进行中的写入用 {uid} 作 hash tag，集群模式下落在同一个槽，可以在一个脚本里访问
+    std::string InboxKey(int uid) {
+        return INBOX_PREFIX "{" + std::to_string(uid) + "}";
+    }
+
+    std::string StateKey(int uid) {
+        return INBOX_STATE_PREFIX "{" + std::to_string(uid) + "}";
+    }
+
+    std::string WipKey(int uid) {
+        return INBOX_WIP_PREFIX "{" + std::to_string(uid) + "}";
+    }
+
+    // 单机模式下把全局代数键追加到 KEYS 末尾，脚本现读；集群模式下不传
+    void AppendEpochKey(std::vector<std::string>& keys) {
+        if (!RedisMgr::GetInstance()->Clustered()) {
+            keys.push_back(INBOX_EPOCH);
+        }
+    }
+
+    // 脚本调用按槽分组：集群模式下一次调用的 KEYS 必须在同一个槽；单机模式下只有一组，仍是一次调用
+    template <class Range>
+    std::map<int, std::vector<int>> GroupBySlot(const Range& uids) {
+        bool clustered = RedisMgr::GetInstance()->Clustered();
+        std::map<int, std::vector<int>> groups;
+        for (int uid : uids) {
+            groups[clustered ? RedisKeySlot(InboxKey(uid)) : 0].push_back(uid);
+        }
+        return groups;
+    }
+}
+
+OfflineInbox::OfflineInbox()
+    : b_enabled_(false), b_epoch_pending_(false), hot_max_(200), ttl_sec_(7 * 24 * 3600), seq_(0) {
+    // ticket 在各服务进程间不能重复
+    std::random_device rd;
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+    nonce_ = buf;
+}
+
+void OfflineInbox::Init() {
+    auto& cfg = ConfigMgr::Inst();
+    if (cfg["OfflineInbox"]["Enable"] == "0") {
+        std::cout << "[OfflineInbox] disabled, offline sync reads MySQL only" << std::endl;
+        return;
+    }
+    try { hot_max_ = std::stoi(cfg["OfflineInbox"]["HotMax"]); }
+    catch (...) {}
+    try { ttl_sec_ = std::stoi(cfg["OfflineInbox"]["TtlSec"]); }
+    catch (...) {}
+    if (hot_max_ <= 0) hot_max_ = 200;
+    if (ttl_sec_ <= 0) ttl_sec_ = 7 * 24 * 3600;
+
+    // 脚本按名字注册并预加载，之后每次调用只发送 sha1
+    auto redis = RedisMgr::GetInstance();
+    redis->RegisterScript("inbox_begin", BEGIN_SCRIPT);
+    redis->RegisterScript("inbox_commit", std::string(EPOCH_LUA) + COMMIT_SCRIPT);
+    redis->RegisterScript("inbox_abort", ABORT_SCRIPT);
+    redis->RegisterScript("inbox_bump", BUMP_SCRIPT);
+    redis->RegisterScript("inbox_read", std::string(EPOCH_LUA) + READ_SCRIPT);
+    redis->RegisterScript("inbox_observe", OBSERVE_SCRIPT);
+    redis->RegisterScript("inbox_ack", std::string(EPOCH_LUA) + ACK_SCRIPT);
+
+    // 上次退出时可能有已入库、未写热层的消息，单机模式下递增全局代数让所有热层失效。
+    // 一直失败时本进程不读热层，每次写入前再试；写入时热层照常失效（见 Invalidate）。
+    // 集群模式没有全局代数：崩溃时登记了进行中写入的用户由 Observe 在 ticket 过期时递增用户代数
+    bool bumped = true;
+    if (!redis->Clustered()) {
+        bumped = false;
+        for (int i = 0; i < INVALIDATE_RETRIES && !bumped; ++i) {
+            if (i) std::this_thread::sleep_for(std::chrono::milliseconds(INVALIDATE_RETRY_MS << (i - 1)));
+            bumped = BumpEpoch();
+        }
+    }
+    b_epoch_pending_ = !bumped;
+    b_enabled_ = true;
+    std::cout << "[OfflineInbox] enabled, hot_max=" << hot_max_ << " ttl=" << ttl_sec_ << "s epoch="
+        << (redis->Clustered() ? "per-user" : (bumped ? "bumped" : "pending")) << std::endl;
+}
+
+bool OfflineInbox::BumpEpoch() {
+    std::vector<std::string> result;
+    return RedisMgr::GetInstance()->Eval("return redis.call('INCR', KEYS[1])", { INBOX_EPOCH }, {}, result)
+        && !result.empty();
+}
+
+void OfflineInbox::Invalidate(const std::vector<int>& uids) {
+    bool clustered = RedisMgr::GetInstance()->Clustered();
+    for (int i = 0; i < INVALIDATE_RETRIES && !clustered; ++i) {
+        if (i) std::this_thread::sleep_for(std::chrono::milliseconds(INVALIDATE_RETRY_MS << (i - 1)));
+        if (BumpEpoch()) {
+            b_epoch_pending_ = false;
+            return;
+        }
+    }
+
+    std::vector<RedisScriptCall> calls;
+    for (const auto& group : GroupBySlot(uids)) {
+        RedisScriptCall call;
+        for (int uid : group.second) {
+            call.keys.push_back(StateKey(uid));
+        }
+        call.args = { std::to_string(ttl_sec_) };
+        calls.push_back(std::move(call));
+    }
+    if (EvalRetry("inbox_bump", calls)) {
+        if (!clustered) {
+            std::cerr << "[OfflineInbox] bump global epoch failed, bumped epoch of " << uids.size() << " recipients" << std::endl;
+        }
+        return;
+    }
+
+    // Redis 整体不可用：单机模式下本进程停用热层读取，下次写入前继续递增全局代数
+    b_epoch_pending_ = !clustered;
+    std::cerr << "[OfflineInbox] failed to invalidate hot tier for " << uids.size()
+        << " recipients, other servers may serve pages missing these messages" << std::endl;
+}
+
+void OfflineInbox::ClearHwm(const std::vector<int>& uids, const std::string& ticket) {
+    std::vector<RedisScriptCall> calls;
+    for (const auto& group : GroupBySlot(uids)) {
+        RedisScriptCall call;
+        for (int uid : group.second) {
+            call.keys.push_back(StateKey(uid));
+            call.keys.push_back(WipKey(uid));
+        }
+        call.args = { ticket };
+        calls.push_back(std::move(call));
+    }
+    if (EvalRetry("inbox_abort", calls)) return;
+
+    // Redis 整体不可用：留到下一次 BeginWrite 再清，没删掉的 ticket 超过 WIP_STALE_MS 后由 Observe 删除
+    std::cerr << "[OfflineInbox] failed to clear hwm for " << uids.size() << " recipients, retry on next write" << std::endl;
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    dirty_uids_.insert(uids.begin(), uids.end());
+}
+
+bool OfflineInbox::EvalRetry(const std::string& name, const std::vector<RedisScriptCall>& calls) {
+    std::vector<RedisResult> results;
+    for (int i = 0; i < INVALIDATE_RETRIES; ++i) {
+        if (i) std::this_thread::sleep_for(std::chrono::milliseconds(INVALIDATE_RETRY_MS << (i - 1)));
+        if (RedisMgr::GetInstance()->EvalScripts(name, calls, results)) return true;
+    }
+    return false;
+}
+
+long long OfflineInbox::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string OfflineInbox::BeginWrite(const std::vector<ChatMsgRecord>& msgs) {
+    if (!b_enabled_ || msgs.empty()) return "";
+
+    std::set<int> dirty;
+    {
+        std::lock_guard<std::mutex> lock(dirty_mutex_);
+        dirty.swap(dirty_uids_);
+    }
+    std::set<int> uids;
+    for (const auto& msg : msgs) {
+        uids.insert(msg._to_uid);
+    }
+
+    // 每个槽一次调用：KEYS 先放该槽内需置为未知的水位，再放本次写入的收件人（水位、进行中的写入）
+    auto dirty_groups = GroupBySlot(dirty);
+    auto uid_groups = GroupBySlot(uids);
+    std::map<int, RedisScriptCall> by_slot;
+    for (const auto& group : dirty_groups) {
+        auto& call = by_slot[group.first];
+        for (int uid : group.second) {
+            call.keys.push_back(StateKey(uid));
+        }
+    }
+    // ticket 以开始时间开头，Observe 据此判断写入方是否已崩溃
+    std::string ticket = std::to_string(NowMs()) + ":" + nonce_ + "-" + std::to_string(++seq_);
+    std::string ttl = std::to_string(ttl_sec_);
+    std::vector<RedisScriptCall> calls;
+    calls.reserve(by_slot.size() + uid_groups.size());
+    for (const auto& group : uid_groups) {
+        auto& call = by_slot[group.first];
+        for (int uid : group.second) {
+            call.keys.push_back(StateKey(uid));
+            call.keys.push_back(WipKey(uid));
+        }
+    }
+    for (auto& item : by_slot) {
+        auto iter = dirty_groups.find(item.first);
+        size_t m = iter == dirty_groups.end() ? 0 : iter->second.size();
+        item.second.args = { std::to_string(m), ticket, ttl };
+        calls.push_back(std::move(item.second));
+    }
+
+    std::vector<RedisResult> results;
+    if (!RedisMgr::GetInstance()->EvalScripts("inbox_begin", calls, results)) {
+        // 没登记上：其它写入读不到这批消息的水位，EndWrite 不写热层，直接让热层失效
+        std::lock_guard<std::mutex> lock(dirty_mutex_);
+        dirty_uids_.insert(dirty.begin(), dirty.end());
+        return "";
+    }
+    return ticket;
+}
+
+void OfflineInbox::EndWrite(const std::vector<ChatMsgRecord>& msgs, const std::string& ticket) {
+    if (!b_enabled_ || msgs.empty()) return;
+
+    // 没入库（_id 为 0）的消息所在收件人按失败处理，水位置为未知
+    std::map<int, std::vector<const ChatMsgRecord*>> by_uid;
+    std::set<int> failed;
+    for (const auto& msg : msgs) {
+        if (msg._id <= 0) failed.insert(msg._to_uid);
+        by_uid[msg._to_uid].push_back(&msg);
+    }
+
+    std::vector<int> uids;
+    uids.reserve(by_uid.size());
+    for (auto iter = by_uid.begin(); iter != by_uid.end();) {
+        if (failed.count(iter->first)) {
+            iter = by_uid.erase(iter);
+        }
+        else {
+            uids.push_back(iter->first);
+            ++iter;
+        }
+    }
+    if (!failed.empty()) {
+        ClearHwm(std::vector<int>(failed.begin(), failed.end()), ticket);
+    }
+    if (uids.empty()) return;
+
+    // 没登记为进行中的写入（BeginWrite 失败）：写库期间别的写入可能已把更大的 id 写进热层并被读走，
+    // 这批再写进去也会落在已出页的范围里，只能让热层失效。
+    // 没能递增全局代数（启动时或上次失效时）：先补上，成功后才写入
+    bool ok = !ticket.empty() && (!b_epoch_pending_ || BumpEpoch());
+    if (ok) b_epoch_pending_ = false;
+    std::vector<RedisScriptCall> calls;
+    std::vector<RedisResult> results;
+    if (ok) {
+        for (const auto& group : GroupBySlot(uids)) {
+            RedisScriptCall call;
+            call.keys.reserve(group.second.size() * 3 + 1);
+            call.args = { std::to_string(hot_max_), std::to_string(ttl_sec_), ticket };
+            for (int uid : group.second) {
+                const auto& items = by_uid[uid];
+                call.keys.push_back(InboxKey(uid));
+                call.keys.push_back(StateKey(uid));
+                call.keys.push_back(WipKey(uid));
+                call.args.push_back(std::to_string(items.size()));
+                for (const auto* msg : items) {
+                    std::string id = std::to_string(msg->_id);
+                    call.args.push_back(id);
+                    call.args.push_back(id + ":" + msg->_payload);
+                }
+            }
+            AppendEpochKey(call.keys);
+            calls.push_back(std::move(call));
+        }
+        ok = RedisMgr::GetInstance()->EvalScripts("inbox_commit", calls, results);
+    }
+
+    if (!ok) {
+        // 漏写的消息只在 MySQL 里：立即在 Redis 里让热层失效，别的服务不能再从热层出跳过它的页；
+        // 同时清掉 hwm，否则旧的 hwm 会让所有服务回「没有新消息」。
+        // commit 可能已执行只是回复丢失，ZREM 重复执行无妨；删不掉的 ticket 超过 WIP_STALE_MS 后由 Observe 删除
+        if (!ticket.empty()) {
+            std::cerr << "[OfflineInbox] commit for " << uids.size() << " recipients failed, invalidate hot tier" << std::endl;
+        }
+        Invalidate(uids);
+        ClearHwm(uids, ticket);
+    }
+}
+
+bool OfflineInbox::ReadPage(int uid, long long cursor, int limit, ChatMsgPage& page) {
+    if (!b_enabled_ || b_epoch_pending_) return false;
+
+    std::vector<std::string> keys = { InboxKey(uid), StateKey(uid), WipKey(uid) };
+    AppendEpochKey(keys);
+    std::vector<std::string> result;
+    if (!RedisMgr::GetInstance()->EvalScript("inbox_read", keys,
+        { std::to_string(cursor), std::to_string(limit) }, result)) {
+        return false;
+    }
+    if (result.empty() || (result[0] != "1" && result[0] != "2" && result[0] != "3")) {
+        return false;
+    }
+
+    page.ids.clear();
+    page.payloads.clear();
+    if (result[0] == "2") {
+        // 水位表明没有新消息
+        page.ok = true;
+        page.has_more = false;
+        return true;
+    }
+    // "3"：只出到进行中写入的水位为止，之后的消息可能还在写，让客户端接着拉
+    size_t count = result.size() - 1;
+    page.has_more = result[0] == "3" || count > static_cast<size_t>(limit);
+    if (page.has_more) count = static_cast<size_t>(limit);
+    page.ids.reserve(count);
+    page.payloads.reserve(count);
+    for (size_t i = 1; i <= count; ++i) {
+        const std::string& member = result[i];
+        size_t sep = member.find(':');
+        if (sep == std::string::npos) {
+            return false;
+        }
+        try { page.ids.push_back(std::stoll(member.substr(0, sep))); }
+        catch (...) { return false; }
+        page.payloads.push_back(member.substr(sep + 1));
+    }
+    page.ok = true;
+    return true;
+}
+
+void OfflineInbox::Observe(int uid, long long seen) {
+    if (!b_enabled_ || seen < 0) return;
+
+    std::vector<std::string> result;
+    RedisMgr::GetInstance()->EvalScript("inbox_observe", { StateKey(uid), WipKey(uid) },
+        { std::to_string(seen), std::to_string(NowMs()), std::to_string(WIP_STALE_MS), std::to_string(ttl_sec_) }, result);
+}
+
+void OfflineInbox::Ack(int uid, long long cursor) {
+    if (!b_enabled_ || cursor <= 0) return;
+
+    std::vector<std::string> keys = { InboxKey(uid), StateKey(uid) };
+    AppendEpochKey(keys);
+    std::vector<std::string> result;
+    if (RedisMgr::GetInstance()->EvalScript("inbox_ack", keys, { std::to_string(cursor), std::to_string(ttl_sec_) }, result)
+        && !result.empty() && result[0] == "-1") {
+        std::cout << "[OfflineInbox] ack beyond hwm rejected, uid=" << uid << " cursor=" << cursor << std::endl;
+    }
+}
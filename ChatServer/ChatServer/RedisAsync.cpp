@@ -0,0 +1,473 @@
+#include "RedisAsync.h"
+#include "AsioIOServicePool.h"
+#include "ConfigMgr.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <boost/asio.hpp>
+
+#include <hiredis/hiredis.h>
+
+namespace {
+    // 未能执行的命令的结果：type 为 0，str 为原因
+    RedisResult Failure(const std::string& reason) {
+        RedisResult result;
+        result.str = reason;
+        return result;
+    }
+
+    // 回调中的异常不能漏到 io_context::run，否则 IO 线程会退出
+    void Invoke(const RedisAsync::Callback& callback, const RedisResult& result) {
+        if (!callback) return;
+        try {
+            callback(result);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[RedisAsync] callback threw: " << e.what() << std::endl;
+        }
+        catch (...) {
+            std::cerr << "[RedisAsync] callback threw unknown exception" << std::endl;
+        }
+    }
+
+    constexpr size_t MAX_WRITE_BYTES = 1024 * 1024;        // 单次写出上限，超出的命令留给下一次
+    constexpr int MAX_REDIRECTS = 5;
+    const char* const ASKING_CMD = "*1\r\n$6\r\nASKING\r\n";
+    constexpr std::chrono::milliseconds MIN_BACKOFF(200);
+    constexpr std::chrono::milliseconds MAX_BACKOFF(5000);
+} // namespace
+
+// 一条到 Redis 的长连接，除 Send / Stop 外的成员只在 strand_ 上访问
+class RedisAsync::Connection : public std::enable_shared_from_this<RedisAsync::Connection> {
+public:
+    Connection(boost::asio::io_context& ioc, size_t index, std::string host, std::string port, std::string pwd,
+        std::chrono::milliseconds timeout, size_t maxPending)
+        : strand_(boost::asio::make_strand(ioc)), socket_(strand_), resolver_(strand_),
+          reconnect_timer_(strand_), tick_timer_(strand_),
+          index_(index), host_(std::move(host)), port_(std::move(port)), pwd_(std::move(pwd)),
+          timeout_(timeout), max_pending_(maxPending), backoff_(MIN_BACKOFF) {
+    }
+
+    ~Connection() {
+        if (reader_) redisReaderFree(reader_);
+    }
+
+    void Start() {
+        boost::asio::post(strand_, [self = shared_from_this()]() {
+            self->DoConnect();
+            self->Tick();
+        });
+    }
+
+    void Stop() {
+        b_stop_ = true;
+        boost::asio::post(strand_, [self = shared_from_this()]() {
+            self->reconnect_timer_.cancel();
+            self->tick_timer_.cancel();
+            self->Fail("stopped");
+        });
+    }
+
+    // 任意线程调用，cmd 为已编码的 RESP。asking 为 true 时紧挨着先发一条 ASKING（集群迁移中的槽）
+    void Send(std::string cmd, Callback callback, bool asking = false) {
+        if (b_stop_) {
+            Invoke(callback, Failure("stopped"));
+            return;
+        }
+        boost::asio::post(strand_, [self = shared_from_this(), cmd = std::move(cmd), callback = std::move(callback), asking]() mutable {
+            if (asking) {
+                self->Enqueue(ASKING_CMD, nullptr);
+            }
+            self->Enqueue(std::move(cmd), std::move(callback));
+        });
+    }
+
+private:
+    enum class State { Connecting, Ready, Down };
+
+    struct Pending {
+        std::string cmd;
+        Callback callback;
+    };
+
+    void Enqueue(std::string cmd, Callback callback) {
+        if (b_stop_ || state_ == State::Down) {
+            Invoke(callback, Failure("redis connection down"));
+            return;
+        }
+        if (pending_.size() + inflight_.size() >= max_pending_) {
+            Invoke(callback, Failure("too many pending commands"));
+            return;
+        }
+        pending_.push_back({ std::move(cmd), std::move(callback) });
+        Flush();
+    }
+
+    void DoConnect() {
+        if (b_stop_) return;
+        state_ = State::Connecting;
+        progress_ = std::chrono::steady_clock::now();
+        auto gen = ++gen_;
+        resolver_.async_resolve(host_, port_,
+            [self = shared_from_this(), gen](const boost::system::error_code& ec,
+                boost::asio::ip::tcp::resolver::results_type results) {
+                if (gen != self->gen_) return;
+                if (ec) {
+                    self->Fail("resolve " + self->host_ + ": " + ec.message());
+                    return;
+                }
+                boost::asio::async_connect(self->socket_, results,
+                    [self, gen](const boost::system::error_code& ec, const boost::asio::ip::tcp::endpoint&) {
+                        if (gen != self->gen_) return;
+                        if (ec) {
+                            self->Fail("connect " + self->host_ + ":" + self->port_ + ": " + ec.message());
+                            return;
+                        }
+                        self->OnConnected(gen);
+                    });
+            });
+    }
+
+    void OnConnected(uint64_t gen) {
+        boost::system::error_code ignored;
+        socket_.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+        reader_ = redisReaderCreate();
+
+        // AUTH 排在最前面，后面的命令跟着一起写出
+        if (!pwd_.empty()) {
+            const char* argv[2] = { "AUTH", pwd_.c_str() };
+            size_t argvlen[2] = { 4, pwd_.size() };
+            char* cmd = nullptr;
+            auto len = redisFormatCommandArgv(&cmd, 2, argv, argvlen);
+            if (len > 0 && cmd) {
+                size_t index = index_;
+                pending_.push_front({ std::string(cmd, len), [index](const RedisResult& result) {
+                    if (!result.Ok()) {
+                        std::cerr << "[RedisAsync] conn#" << index << " AUTH failed: " << result.str << std::endl;
+                    }
+                } });
+            }
+            redisFreeCommand(cmd);
+        }
+
+        state_ = State::Ready;
+        backoff_ = MIN_BACKOFF;
+        std::cout << "[RedisAsync] conn#" << index_ << " connected to " << host_ << ":" << port_
+            << ", queued=" << pending_.size() << std::endl;
+        DoRead(gen);
+        Flush();
+    }
+
+    // 把排队的命令拼成一次写出；上一次写完之前不发起新的写
+    void Flush() {
+        if (state_ != State::Ready || writing_ || pending_.empty()) return;
+        if (inflight_.empty()) {
+            progress_ = std::chrono::steady_clock::now();
+        }
+        write_buf_.clear();
+        while (!pending_.empty() && write_buf_.size() < MAX_WRITE_BYTES) {
+            write_buf_ += pending_.front().cmd;
+            inflight_.push_back(std::move(pending_.front().callback));
+            pending_.pop_front();
+        }
+        writing_ = true;
+        auto gen = gen_;
+        boost::asio::async_write(socket_, boost::asio::buffer(write_buf_),
+            [self = shared_from_this(), gen](const boost::system::error_code& ec, std::size_t) {
+                if (gen != self->gen_) return;
+                self->writing_ = false;
+                if (ec) {
+                    self->Fail("write: " + ec.message());
+                    return;
+                }
+                self->Flush();
+            });
+    }
+
+    void DoRead(uint64_t gen) {
+        socket_.async_read_some(boost::asio::buffer(read_buf_),
+            [self = shared_from_this(), gen](const boost::system::error_code& ec, std::size_t n) {
+                if (gen != self->gen_) return;
+                if (ec) {
+                    self->Fail("read: " + ec.message());
+                    return;
+                }
+                if (!self->OnData(n)) return;
+                self->DoRead(gen);
+            });
+    }
+
+    // 解析读到的数据，按 FIFO 回调在途命令；协议出错时关闭连接并返回 false
+    bool OnData(size_t n) {
+        if (redisReaderFeed(reader_, read_buf_.data(), n) != REDIS_OK) {
+            Fail("reader feed failed");
+            return false;
+        }
+        for (;;) {
+            void* reply = nullptr;
+            if (redisReaderGetReply(reader_, &reply) != REDIS_OK) {
+                Fail(std::string("protocol error: ") + reader_->errstr);
+                return false;
+            }
+            if (reply == nullptr) {
+                return true;
+            }
+            if (inflight_.empty()) {
+                freeReplyObject(reply);
+                Fail("unexpected reply");
+                return false;
+            }
+            RedisResult result;
+            CopyRedisReply(static_cast<redisReply*>(reply), result);
+            freeReplyObject(reply);
+            Callback callback = std::move(inflight_.front());
+            inflight_.pop_front();
+            progress_ = std::chrono::steady_clock::now();
+            Invoke(callback, result);
+        }
+    }
+
+    // 关闭当前连接，在途和排队的命令全部失败，未停止时安排重连
+    void Fail(const std::string& reason) {
+        ++gen_;
+        boost::system::error_code ignored;
+        resolver_.cancel();
+        socket_.close(ignored);
+        if (reader_) {
+            redisReaderFree(reader_);
+            reader_ = nullptr;
+        }
+        writing_ = false;
+        state_ = State::Down;
+
+        std::deque<Callback> inflight;
+        std::deque<Pending> pending;
+        inflight.swap(inflight_);
+        pending.swap(pending_);
+        if (!b_stop_ || !inflight.empty() || !pending.empty()) {
+            std::cerr << "[RedisAsync] conn#" << index_ << " " << reason << ", failing "
+                << inflight.size() << " in-flight and " << pending.size() << " queued commands" << std::endl;
+        }
+        RedisResult failure = Failure(reason);
+        for (auto& callback : inflight) Invoke(callback, failure);
+        for (auto& item : pending) Invoke(item.callback, failure);
+
+        if (b_stop_) return;
+        reconnect_timer_.expires_after(backoff_);
+        reconnect_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->b_stop_) return;
+            self->DoConnect();
+        });
+        backoff_ = std::min(backoff_ * 2, MAX_BACKOFF);
+    }
+
+    // 建连或等待回复超过 timeout_ 没有进展时判定连接故障
+    void Tick() {
+        tick_timer_.expires_after(std::min(timeout_ / 2, std::chrono::milliseconds(1000)));
+        tick_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->b_stop_) return;
+            bool waiting = self->state_ == State::Connecting
+                || (self->state_ == State::Ready && !self->inflight_.empty());
+            if (waiting && std::chrono::steady_clock::now() - self->progress_ > self->timeout_) {
+                self->Fail(self->state_ == State::Connecting ? "connect timeout" : "reply timeout");
+            }
+            self->Tick();
+        });
+    }
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::steady_timer reconnect_timer_;
+    boost::asio::steady_timer tick_timer_;
+
+    const size_t index_;
+    const std::string host_;
+    const std::string port_;
+    const std::string pwd_;
+    const std::chrono::milliseconds timeout_;
+    const size_t max_pending_;
+
+    redisReader* reader_ = nullptr;
+    State state_ = State::Down;
+    uint64_t gen_ = 0;              // 每次建连、断开加 1，旧连接上迟到的完成回调据此丢弃
+    bool writing_ = false;
+    std::deque<Pending> pending_;   // 等待写出
+    std::deque<Callback> inflight_; // 已写出（或正在写出）等待回复，与回复顺序一致
+    std::string write_buf_;
+    std::array<char, 16 * 1024> read_buf_;
+    std::chrono::steady_clock::time_point progress_;
+    std::chrono::milliseconds backoff_;
+    std::atomic<bool> b_stop_{ false };
+};
+
+RedisAsync::~RedisAsync()
+{
+    Stop();
+}
+
+void RedisAsync::Init()
+{
+    if (!conns_.empty()) return; // 避免重复初始化
+
+    auto& cfg = ConfigMgr::Inst();
+    int connections = 2;
+    int timeout_ms = 3000;
+    long long max_pending = 100000;
+    try { connections = std::stoi(cfg["RedisAsync"]["Connections"]); }
+    catch (...) {}
+    try { timeout_ms = std::stoi(cfg["RedisAsync"]["TimeoutMs"]); }
+    catch (...) {}
+    try { max_pending = std::stoll(cfg["RedisAsync"]["MaxPending"]); }
+    catch (...) {}
+    if (connections <= 0) {
+        std::cout << "[RedisAsync] disabled" << std::endl;
+        return;
+    }
+    if (timeout_ms <= 0) timeout_ms = 3000;
+    if (max_pending <= 0) max_pending = 100000;
+
+    auto host = cfg["Redis"]["Host"];
+    auto port = cfg["Redis"]["Port"];
+    pwd_ = cfg["Redis"]["Passwd"];
+    connections_ = static_cast<size_t>(connections);
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+    max_pending_ = static_cast<size_t>(max_pending);
+    pool_ = AsioIOServicePool::GetInstance();
+    if (RedisMgr::GetInstance()->Clustered()) {
+        // 集群模式：每个主节点一组连接，槽表由 RedisMgr 维护，之后出现的节点首次发往时再建
+        clustered_ = true;
+        for (const auto& addr : RedisMgr::GetInstance()->NodeAddrs()) {
+            NodeConns(addr);
+        }
+    }
+    else {
+        conns_ = MakeConns(host, port);
+    }
+    enabled_ = true;
+    std::cout << "[RedisAsync] started, connections=" << connections << (clustered_ ? " per node" : "")
+        << " timeout_ms=" << timeout_ms << " max_pending=" << max_pending << std::endl;
+}
+
+std::vector<std::shared_ptr<RedisAsync::Connection>> RedisAsync::MakeConns(const std::string& host, const std::string& port)
+{
+    std::vector<std::shared_ptr<Connection>> conns;
+    for (size_t i = 0; i < connections_; ++i) {
+        auto conn = std::make_shared<Connection>(pool_->GetIOService(), i, host, port, pwd_, timeout_, max_pending_);
+        conn->Start();
+        conns.push_back(conn);
+    }
+    return conns;
+}
+
+const std::vector<std::shared_ptr<RedisAsync::Connection>>* RedisAsync::NodeConns(const std::string& addr)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(nodes_mutex_);
+        auto iter = nodes_.find(addr);
+        if (iter != nodes_.end()) return &iter->second;
+    }
+    std::string host;
+    int port = 0;
+    if (!RedisSplitAddr(addr, host, port)) return nullptr;
+    std::unique_lock<std::shared_mutex> lock(nodes_mutex_);
+    if (b_stop_) return nullptr;
+    auto iter = nodes_.find(addr);
+    if (iter == nodes_.end()) {
+        // 建连是异步的，不会阻塞调用线程（可能是 IO 线程）
+        iter = nodes_.emplace(addr, MakeConns(host, std::to_string(port))).first;
+        std::cout << "[RedisAsync] node " << addr << " connections=" << connections_ << std::endl;
+    }
+    return &iter->second;
+}
+
+void RedisAsync::Stop()
+{
+    for (auto& conn : conns_) {
+        conn->Stop();
+    }
+    std::unique_lock<std::shared_mutex> lock(nodes_mutex_);
+    b_stop_ = true;
+    for (auto& node : nodes_) {
+        for (auto& conn : node.second) {
+            conn->Stop();
+        }
+    }
+}
+
+void RedisAsync::Command(std::vector<std::string> argv, Callback callback)
+{
+    Dispatch(next_++, argv, std::move(callback));
+}
+
+void RedisAsync::Command(long long key, std::vector<std::string> argv, Callback callback)
+{
+    Dispatch(static_cast<size_t>(static_cast<unsigned long long>(key)), argv, std::move(callback));
+}
+
+std::future<RedisResult> RedisAsync::CommandFuture(std::vector<std::string> argv)
+{
+    auto promise = std::make_shared<std::promise<RedisResult>>();
+    auto future = promise->get_future();
+    Command(std::move(argv), [promise](const RedisResult& result) {
+        promise->set_value(result);
+    });
+    return future;
+}
+
+// 在调用线程编码，IO 线程只做拼接和收发
+void RedisAsync::Dispatch(size_t index, const std::vector<std::string>& argv, Callback callback)
+{
+    if (!enabled_) {
+        Invoke(callback, Failure("async redis disabled"));
+        return;
+    }
+    std::vector<const char*> args;
+    std::vector<size_t> lens;
+    args.reserve(argv.size());
+    lens.reserve(argv.size());
+    for (const auto& arg : argv) {
+        args.push_back(arg.data());
+        lens.push_back(arg.size());
+    }
+    char* cmd = nullptr;
+    auto len = redisFormatCommandArgv(&cmd, static_cast<int>(args.size()), args.data(), lens.data());
+    if (len <= 0 || cmd == nullptr) {
+        redisFreeCommand(cmd);
+        Invoke(callback, Failure("format command failed"));
+        return;
+    }
+    std::string packed(cmd, static_cast<size_t>(len));
+    redisFreeCommand(cmd);
+    if (clustered_) {
+        SendTo(RedisMgr::GetInstance()->NodeAddr(argv), index, std::move(packed), false, 0, std::move(callback));
+        return;
+    }
+    conns_[index % conns_.size()]->Send(std::move(packed), std::move(callback));
+}
+
+// 集群模式：发往 addr 节点的第 index 条连接（同一个 key 仍落在同一条连接上）；
+// 回复为 MOVED / ASK 时改发到目标节点，MOVED 同时通知 RedisMgr 更新槽位
+void RedisAsync::SendTo(const std::string& addr, size_t index, std::string packed, bool asking, int hops, Callback callback)
+{
+    const auto* conns = addr.empty() ? nullptr : NodeConns(addr);
+    if (conns == nullptr || conns->empty()) {
+        Invoke(callback, Failure(addr.empty() ? "no redis node available" : "bad redis node " + addr));
+        return;
+    }
+    auto& conn = (*conns)[index % conns->size()];
+    conn->Send(packed, [this, index, packed, hops, callback = std::move(callback)](const RedisResult& result) {
+        bool ask = false;
+        int slot = 0;
+        std::string target;
+        if (hops < MAX_REDIRECTS && result.type == REDIS_REPLY_ERROR && RedisParseRedirect(result.str, ask, slot, target)) {
+            if (!ask) {
+                RedisMgr::GetInstance()->Redirected(slot, target);
+            }
+            SendTo(target, index, packed, ask, hops + 1, callback);
+            return;
+        }
+        Invoke(callback, result);
+    }, asking);
+}
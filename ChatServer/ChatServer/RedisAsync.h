@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "Singleton.h"
+#include "RedisMgr.h"
+
+class AsioIOServicePool;
+
+// 异步 Redis 客户端
+//
+// 作用：
+//   RedisMgr 的每次调用都要占住调用线程（逻辑线程、DB 线程、gRPC 线程）等一个完整的往返。
+//   这里在 AsioIOServicePool 的 io_context 上维护少量长连接，命令写出后立即返回，
+//   回复到达时在 IO 线程上回调，一条连接上可以同时有成千上万条命令在途。
+//
+// 实现：
+//   命令在调用线程用 redisFormatCommandArgv 编码成 RESP，post 到连接的 strand 排队；
+//   连接空闲时把排队的命令拼成一次 async_write 写出（流水线），
+//   读到的数据交给 hiredis 的 redisReader 解析，回复按 FIFO 与在途命令一一对应。
+//
+// 顺序：
+//   Command(key, ...) 中相同 key 总落在同一条连接上，回调按发送顺序执行；
+//   不带 key 的命令在各连接间轮转，彼此之间不保证顺序。
+//
+// 集群：
+//   [Redis] Nodes 非空时每个主节点一组连接，命令按 RedisMgr 的槽表发往键所在的节点；
+//   回复 MOVED 时通知 RedisMgr 更新槽位并改发到目标节点，ASK 时在目标节点上先发 ASKING 再重发。
+//
+// 失败：
+//   连接断开、读写出错或在途命令超过 TimeoutMs 没有任何回复时，关闭连接，
+//   在途和排队的命令都以 type 为 0 的 RedisResult 回调（str 为原因），随后按退避间隔重连。
+//   断线期间的新命令立即失败，调用方按 Redis 不可用处理，不会堆积。
+//
+// 回调在 IO 线程上执行，不能做阻塞操作（MySQL、同步 gRPC、同步 RedisMgr），需要时转交 AsyncDBPool。
+//
+// 配置（config.ini）：
+//   [RedisAsync]
+//   Connections = 2         // 连接数（集群模式下为每个节点的连接数），0 表示不启用，调用方继续走 RedisMgr 同步接口
+//   TimeoutMs = 3000        // 在途命令无回复、建连超过这个时间视为连接故障
+//   MaxPending = 100000     // 每条连接排队 + 在途命令上限，超出的命令直接失败
+//   地址和密码沿用 [Redis]
+class RedisAsync : public Singleton<RedisAsync> {
+    friend class Singleton<RedisAsync>;
+public:
+    using Callback = std::function<void(const RedisResult&)>;
+
+    ~RedisAsync();
+
+    // 读取配置并在 AsioIOServicePool 上建立连接，须在 IO 线程池启动之后调用
+    void Init();
+
+    // 关闭所有连接，之后的命令立即失败；须在 AsioIOServicePool::Stop 之前调用
+    void Stop();
+
+    bool Enabled() const { return enabled_; }
+
+    // 发送一条命令，argv 为命令及参数（如 { "GET", key }）
+    void Command(std::vector<std::string> argv, Callback callback);
+    // 同上，key 相同的命令走同一条连接，回调保持发送顺序
+    void Command(long long key, std::vector<std::string> argv, Callback callback);
+    // 供非 IO 线程使用，调用方在 future 上等待
+    std::future<RedisResult> CommandFuture(std::vector<std::string> argv);
+
+private:
+    class Connection;
+
+    RedisAsync() = default;
+
+    void Dispatch(size_t index, const std::vector<std::string>& argv, Callback callback);
+    void SendTo(const std::string& addr, size_t index, std::string packed, bool asking, int hops, Callback callback);
+    std::vector<std::shared_ptr<Connection>> MakeConns(const std::string& host, const std::string& port);
+    // 集群模式下节点的连接组，首次用到时建立；停止后返回 nullptr
+    const std::vector<std::shared_ptr<Connection>>* NodeConns(const std::string& addr);
+
+    // 连接的 socket、定时器属于 IO 线程池的 io_context，持有线程池保证它晚于连接析构
+    std::shared_ptr<AsioIOServicePool> pool_;
+    std::vector<std::shared_ptr<Connection>> conns_;    // 单机模式
+    std::atomic<size_t> next_{ 0 };
+    bool enabled_ = false;
+    bool clustered_ = false;
+
+    std::shared_mutex nodes_mutex_;
+    std::map<std::string, std::vector<std::shared_ptr<Connection>>> nodes_;   // 集群模式：节点地址 -> 连接组，只增不删
+    bool b_stop_ = false;
+
+    std::string pwd_;
+    size_t connections_ = 0;
+    std::chrono::milliseconds timeout_{ 3000 };
+    size_t max_pending_ = 0;
+};
@@ -1,6 +1,7 @@
 #include "RedisMgr.h"
 #include"const.h"
 #include"ConfigMgr.h"
+#include "crypto_utils.h"
 #include <iostream>
 #include <cstring>
 #include <stdexcept>
@@ -9,31 +10,107 @@
 #include <hiredis/hiredis.h>
 
 namespace {
+    // 从列表头部原子地弹出至多 ARGV[1] 条（LRANGE + LTRIM），不依赖 Redis 6.2 的 LPOP count / 7.0 的 LMPOP；
+    // 弹空后 LTRIM 会删除这个键
+    const char* LIST_POP_SCRIPT_NAME = "list_pop";
+    const char* LIST_POP_SCRIPT = R"lua(
+local v = redis.call('LRANGE', KEYS[1], 0, tonumber(ARGV[1]) - 1)
+if #v > 0 then redis.call('LTRIM', KEYS[1], #v, -1) end
+return v
+)lua";
+
+    constexpr size_t LIST_PAGE_SIZE = 512;
+
     // 小的辅助函数：安全地把 reply->str 拷贝到 std::string（防止 reply==nullptr）
     static std::string replyToString(redisReply* reply) {
         if (!reply || reply->type != REDIS_REPLY_STRING) return {};
         return std::string(reply->str, reply->len);
     }
+
+    // 把脚本返回值展开成字符串列表
+    static void flattenReply(redisReply* reply, std::vector<std::string>& out) {
+        if (!reply) return;
+        switch (reply->type) {
+        case REDIS_REPLY_ARRAY:
+            for (size_t i = 0; i < reply->elements; ++i) {
+                flattenReply(reply->element[i], out);
+            }
+            break;
+        case REDIS_REPLY_INTEGER:
+            out.push_back(std::to_string(reply->integer));
+            break;
+        case REDIS_REPLY_STRING:
+        case REDIS_REPLY_STATUS:
+            out.emplace_back(reply->str, reply->len);
+            break;
+        default:
+            out.emplace_back();
+            break;
+        }
+    }
+
+    // 同 flattenReply，作用于已拷贝的 RedisResult
+    static void flattenResult(const RedisResult& result, std::vector<std::string>& out) {
+        switch (result.type) {
+        case REDIS_REPLY_ARRAY:
+            for (const auto& element : result.elements) {
+                flattenResult(element, out);
+            }
+            break;
+        case REDIS_REPLY_INTEGER:
+            out.push_back(std::to_string(result.integer));
+            break;
+        case REDIS_REPLY_STRING:
+        case REDIS_REPLY_STATUS:
+            out.push_back(result.str);
+            break;
+        default:
+            out.emplace_back();
+            break;
+        }
+    }
+
+    // 数组回复转成 optional 列表，nil 为 std::nullopt
+    static bool arrayToOptionals(const RedisResult& result, size_t expect,
+        std::vector<std::optional<std::string>>& values) {
+        if (result.type != REDIS_REPLY_ARRAY || result.elements.size() != expect) return false;
+        values.reserve(expect);
+        for (const auto& element : result.elements) {
+            if (element.type == REDIS_REPLY_STRING) {
+                values.emplace_back(element.str);
+            }
+            else {
+                values.emplace_back(std::nullopt);
+            }
+        }
+        return true;
+    }
 } // namespace
 
-// RAII guard：确保取到的连接会在析构时归还到池里
-class RedisConnectionGuard {
-public:
-    RedisConnectionGuard(RedisConPool* pool, redisContext* ctx) : pool_(pool), ctx_(ctx) {}
-    ~RedisConnectionGuard() {
-        if (pool_ && ctx_) {
-            pool_->returnConnection(ctx_);
-            // 不置 ctx_ 为 nullptr，因为析构后不会再用
+void CopyRedisReply(redisReply* reply, RedisResult& out)
+{
+    out = RedisResult();
+    if (!reply) return;
+    out.type = reply->type;
+    switch (reply->type) {
+    case REDIS_REPLY_INTEGER:
+        out.integer = reply->integer;
+        break;
+    case REDIS_REPLY_STRING:
+    case REDIS_REPLY_STATUS:
+    case REDIS_REPLY_ERROR:
+        out.str.assign(reply->str, reply->len);
+        break;
+    case REDIS_REPLY_ARRAY:
+        out.elements.resize(reply->elements);
+        for (size_t i = 0; i < reply->elements; ++i) {
+            CopyRedisReply(reply->element[i], out.elements[i]);
         }
+        break;
+    default:
+        break;
     }
-    redisContext* get() const { return ctx_; }
-    // 禁止复制
-    RedisConnectionGuard(const RedisConnectionGuard&) = delete;
-    RedisConnectionGuard& operator=(const RedisConnectionGuard&) = delete;
-private:
-    RedisConPool* pool_;
-    redisContext* ctx_;
-};
+}
 
 // RedisMgr 构造与析构
 RedisMgr::RedisMgr()
@@ -42,11 +119,14 @@ RedisMgr::RedisMgr()
     auto host = gCfgMgr["Redis"]["Host"];
     auto port = gCfgMgr["Redis"]["Port"];
     auto pwd = gCfgMgr["Redis"]["Passwd"];
-    // 根据CPU核心数动态设置连接池大小
+    // Nodes 非空时按 Redis Cluster 路由，Host / Port 不再用于命令
+    auto nodes = gCfgMgr["Redis"]["Nodes"];
+    // 根据CPU核心数动态设置连接池大小（集群模式下每个主节点一个池）
     size_t pool_size = std::max(16u, std::thread::hardware_concurrency() * 2);
     std::cout << "[RedisMgr] CPU cores: " << std::thread::hardware_concurrency() 
               << ", Redis pool size: " << pool_size << std::endl;
-    con_pool_.reset(new RedisConPool(pool_size, host.c_str(), atoi(port.c_str()), pwd.c_str()));
+    router_.reset(new RedisRouter<RedisConPool>(nodes, host, atoi(port.c_str()), pwd, pool_size));
+    RegisterScript(LIST_POP_SCRIPT_NAME, LIST_POP_SCRIPT);
 }
 
 RedisMgr::~RedisMgr()
@@ -54,17 +134,35 @@ RedisMgr::~RedisMgr()
     Close();
 }
 
+redisReply* RedisMgr::Command(const std::vector<std::string>& argv)
+{
+    return router_->Command(argv).release();
+}
+
+bool RedisMgr::Clustered() const
+{
+    return router_->Clustered();
+}
+
+std::string RedisMgr::NodeAddr(const std::vector<std::string>& argv)
+{
+    return router_->NodeAddr(argv);
+}
+
+std::vector<std::string> RedisMgr::NodeAddrs()
+{
+    return router_->NodeAddrs();
+}
+
+void RedisMgr::Redirected(int slot, const std::string& addr)
+{
+    router_->Moved(slot, addr, false);
+}
+
 // Get
 bool RedisMgr::Get(const std::string& key, std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Get] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "GET %s", key.c_str());
+    redisReply* reply = Command({ "GET", key });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Get] redisCommand returned NULL for key=" << key << std::endl;
         return false;
@@ -89,59 +187,66 @@ bool RedisMgr::Get(const std::string& key, std::string& value)
     return true;
 }
 
-// 原子地获取并清空list
+// 按页取空 list：失败时 values 保留已经弹出的元素
 bool RedisMgr::GetAllList(const std::string& key, std::vector<std::string>& values)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::GetAllList] getConnection nullptr for key=" << key << std::endl;
-        return false;
+    bool ok = DrainList(key, LIST_PAGE_SIZE, [&values](std::vector<std::string>& page) {
+        values.insert(values.end(), std::make_move_iterator(page.begin()), std::make_move_iterator(page.end()));
+        return true;
+    });
+    if (!ok) {
+        std::cout << "[RedisMgr::GetAllList] pop failed for key=" << key << ", returning " << values.size()
+            << " elements already popped" << std::endl;
     }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
+    return ok;
+}
 
-    // 使用 MULTI/EXEC 保证原子性
-    redisReply* multi_reply = (redisReply*)redisCommand(connect, "MULTI");
-    if (multi_reply == nullptr || multi_reply->type == REDIS_REPLY_ERROR) {
-        std::cout << "[RedisMgr::GetAllList] MULTI failed" << std::endl;
-        if (multi_reply) freeReplyObject(multi_reply);
-        return false;
+// PopList：脚本保证 LRANGE 与 LTRIM 之间不会插入别的命令，集群模式下也与列表在同一个节点上执行
+bool RedisMgr::PopList(const std::string& key, size_t count, std::vector<std::string>& values)
+{
+    if (count == 0) {
+        return true;
     }
-    freeReplyObject(multi_reply);
-
-    redisReply* lrange_reply = (redisReply*)redisCommand(connect, "LRANGE %s 0 -1", key.c_str());
-    redisReply* del_reply = (redisReply*)redisCommand(connect, "DEL %s", key.c_str());
-
-    redisReply* exec_reply = (redisReply*)redisCommand(connect, "EXEC");
-    if (exec_reply == nullptr || exec_reply->type != REDIS_REPLY_ARRAY || exec_reply->elements < 2) {
-        std::cout << "[RedisMgr::GetAllList] EXEC failed" << std::endl;
-        if (lrange_reply) freeReplyObject(lrange_reply);
-        if (del_reply) freeReplyObject(del_reply);
-        if (exec_reply) freeReplyObject(exec_reply);
+    RedisResult result;
+    if (!EvalScript(LIST_POP_SCRIPT_NAME, { key }, { std::to_string(count) }, result)
+        || result.type != REDIS_REPLY_ARRAY) {
+        std::cout << "[RedisMgr::PopList] pop failed for key=" << key << " type=" << result.type
+            << " " << result.str << std::endl;
         return false;
     }
+    values.reserve(values.size() + result.elements.size());
+    for (auto& element : result.elements) {
+        values.push_back(std::move(element.str));
+    }
+    return true;
+}
 
-    // 解析LRANGE的结果
-    redisReply* lrange_result = exec_reply->element[0];
-    if (lrange_result->type == REDIS_REPLY_ARRAY) {
-        for (size_t i = 0; i < lrange_result->elements; ++i) {
-            values.push_back(std::string(lrange_result->element[i]->str, lrange_result->element[i]->len));
+bool RedisMgr::DrainList(const std::string& key, size_t pageSize,
+    const std::function<bool(std::vector<std::string>& page)>& consumer)
+{
+    if (pageSize == 0) {
+        pageSize = LIST_PAGE_SIZE;
+    }
+    std::vector<std::string> page;
+    for (;;) {
+        page.clear();
+        // 弹出失败时 page 为空：脚本没有执行，或执行了但回复丢失（连接断开），前者元素仍在列表里
+        if (!PopList(key, pageSize, page)) {
+            return false;
+        }
+        if (page.empty()) {
+            return true;
+        }
+        bool drained = page.size() < pageSize;
+        if (!consumer(page) || drained) {
+            return true;
         }
     }
-
-    freeReplyObject(exec_reply); // lrange_reply 和 del_reply 会被 exec_reply 一起释放
-    return true;
 }
 
 // Set
 bool RedisMgr::Set(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Set] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "SET %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "SET", key, value });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Set] Execut command [ SET " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -167,14 +272,7 @@ bool RedisMgr::Set(const std::string& key, const std::string& value) {
 // Auth
 bool RedisMgr::Auth(const std::string& password)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Auth] getConnection returned nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "AUTH %s", password.c_str());
+    redisReply* reply = Command({ "AUTH", password });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Auth] AUTH returned NULL\n";
         return false;
@@ -194,14 +292,7 @@ bool RedisMgr::Auth(const std::string& password)
 // LPush
 bool RedisMgr::LPush(const std::string& key, const std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "LPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -220,14 +311,7 @@ bool RedisMgr::LPush(const std::string& key, const std::string& value)
 
 // LPop
 bool RedisMgr::LPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPOP %s", key.c_str());
+    redisReply* reply = Command({ "LPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -252,14 +336,7 @@ bool RedisMgr::LPop(const std::string& key, std::string& value) {
 
 // RPush
 bool RedisMgr::RPush(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "RPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -278,14 +355,7 @@ bool RedisMgr::RPush(const std::string& key, const std::string& value) {
 
 // RPop
 bool RedisMgr::RPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPOP %s", key.c_str());
+    redisReply* reply = Command({ "RPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -310,14 +380,7 @@ bool RedisMgr::RPop(const std::string& key, std::string& value) {
 
 // HSet (string overload)
 bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "HSET %s %s %s", key.c_str(), hkey.c_str(), value.c_str());
+    redisReply* reply = Command({ "HSET", key, hkey, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet " << key << "  " << hkey << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -337,25 +400,7 @@ bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::
 // HSet (binary overload using redisCommandArgv)
 bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet(binary)] getConnection nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    const char* argv[4];
-    size_t argvlen[4];
-    argv[0] = "HSET";
-    argvlen[0] = 4;
-    argv[1] = key;
-    argvlen[1] = strlen(key);
-    argv[2] = hkey;
-    argvlen[2] = strlen(hkey);
-    argv[3] = hvalue;
-    argvlen[3] = hvaluelen;
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 4, argv, argvlen);
+    redisReply* reply = Command({ "HSET", key, hkey, std::string(hvalue, hvaluelen) });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet(binary) ] failure (reply==NULL)!\n";
         return false;
@@ -374,16 +419,8 @@ bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_
 
 bool RedisMgr::HDel(const std::string& key, const std::string& field)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HDel] getConnection returned nullptr for key=" << key << " field=" << field << std::endl;
-        return false;
-    }
-    // RAII: 确保连接会被归还到连接池
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
     // 执行 HDEL 命令
-    redisReply* reply = (redisReply*)redisCommand(connect, "HDEL %s %s", key.c_str(), field.c_str());
+    redisReply* reply = Command({ "HDEL", key, field });
     if (reply == nullptr) {
         std::cout << "Execut command [ HDEL " << key << " " << field << " ] failure (reply==NULL)!\n";
         return false;
@@ -419,23 +456,7 @@ bool RedisMgr::HDel(const std::string& key, const std::string& field)
 // HGet
 std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HGet] getConnection nullptr for key=" << key << std::endl;
-        return "";
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    const char* argv[3];
-    size_t argvlen[3];
-    argv[0] = "HGET";
-    argvlen[0] = 4;
-    argv[1] = key.c_str();
-    argvlen[1] = key.length();
-    argv[2] = hkey.c_str();
-    argvlen[2] = hkey.length();
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 3, argv, argvlen);
+    redisReply* reply = Command({ "HGET", key, hkey });
     if (reply == nullptr) {
         std::cout << "Execut command [ HGet " << key << " " << hkey << " ] failure (reply==NULL)!\n";
         return "";
@@ -462,14 +483,7 @@ std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
 // Del
 bool RedisMgr::Del(const std::string& key)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Del] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "DEL %s", key.c_str());
+    redisReply* reply = Command({ "DEL", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ Del " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -489,14 +503,7 @@ bool RedisMgr::Del(const std::string& key)
 // ExistsKey
 bool RedisMgr::ExistsKey(const std::string& key)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::ExistsKey] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "EXISTS %s", key.c_str());
+    redisReply* reply = Command({ "EXISTS", key });
     if (reply == nullptr) {
         std::cout << "Not Found [ Key " << key << " ]  ! (reply==NULL)\n";
         return false;
@@ -513,13 +520,325 @@ bool RedisMgr::ExistsKey(const std::string& key)
     return false;
 }
 
-void RedisMgr::Close()
+// Eval
+bool RedisMgr::Eval(const std::string& script, const std::vector<std::string>& keys,
+    const std::vector<std::string>& args, std::vector<std::string>& result)
+{
+    result.clear();
+    std::vector<std::string> cmd;
+    cmd.reserve(3 + keys.size() + args.size());
+    cmd.push_back("EVAL");
+    cmd.push_back(script);
+    cmd.push_back(std::to_string(keys.size()));
+    cmd.insert(cmd.end(), keys.begin(), keys.end());
+    cmd.insert(cmd.end(), args.begin(), args.end());
+
+    redisReply* reply = Command(cmd);
+    if (reply == nullptr) {
+        std::cout << "[RedisMgr::Eval] command returned NULL" << std::endl;
+        return false;
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        std::cout << "[RedisMgr::Eval] script error: " << std::string(reply->str, reply->len) << std::endl;
+        freeReplyObject(reply);
+        return false;
+    }
+
+    flattenReply(reply, result);
+    freeReplyObject(reply);
+    return true;
+}
+
+// Exec：按节点分组流水线发送（见 RedisRouter::Exec），回复拷贝成 RedisResult
+bool RedisMgr::Exec(const RedisBatch& batch, std::vector<RedisResult>& results)
 {
-    if (con_pool_) {
-        con_pool_->Close();
-        // 注意：RedisConPool::Close() 应该释放所有 redisContext（redisFree）
-        // 如果你还没在 RedisConPool 中实现释放，请在 RedisConPool::Close/析构里释放 ctx
-        con_pool_.reset();
+    results.clear();
+    if (batch.Empty()) {
+        return true;
+    }
+    std::vector<RedisReplyPtr> replies;
+    bool ok = router_->Exec(batch.cmds_, replies);
+    results.resize(replies.size());
+    for (size_t i = 0; i < replies.size(); ++i) {
+        CopyRedisReply(replies[i].get(), results[i]);
     }
+    return ok;
 }
 
+// MGet
+bool RedisMgr::MGet(const std::vector<std::string>& keys, std::vector<std::optional<std::string>>& values)
+{
+    values.clear();
+    if (keys.empty()) {
+        return true;
+    }
+    RedisBatch batch;
+    std::vector<RedisResult> results;
+    if (router_->Clustered()) {
+        // 键分散在不同的槽，拆成逐个 GET，按节点流水线发送
+        for (const auto& key : keys) {
+            batch.Add({ "GET", key });
+        }
+        if (!Exec(batch, results)) {
+            return false;
+        }
+        values.reserve(keys.size());
+        for (const auto& result : results) {
+            if (!result.Ok()) {
+                std::cout << "[RedisMgr::MGet] GET failed type=" << result.type << " " << result.str << std::endl;
+                values.clear();
+                return false;
+            }
+            if (result.type == REDIS_REPLY_STRING) {
+                values.emplace_back(result.str);
+            }
+            else {
+                values.emplace_back(std::nullopt);
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::string> cmd;
+    cmd.reserve(keys.size() + 1);
+    cmd.push_back("MGET");
+    cmd.insert(cmd.end(), keys.begin(), keys.end());
+    batch.Add(std::move(cmd));
+    if (!Exec(batch, results)) {
+        return false;
+    }
+    if (!arrayToOptionals(results[0], keys.size(), values)) {
+        std::cout << "[RedisMgr::MGet] unexpected reply type=" << results[0].type << " " << results[0].str << std::endl;
+        values.clear();
+        return false;
+    }
+    return true;
+}
+
+// MSet
+bool RedisMgr::MSet(const std::vector<std::pair<std::string, std::string>>& kvs)
+{
+    if (kvs.empty()) {
+        return true;
+    }
+    RedisBatch batch;
+    if (router_->Clustered()) {
+        // 键分散在不同的槽，拆成逐个 SET（不再是一次原子写入）
+        for (const auto& kv : kvs) {
+            batch.Add({ "SET", kv.first, kv.second });
+        }
+    }
+    else {
+        std::vector<std::string> cmd;
+        cmd.reserve(kvs.size() * 2 + 1);
+        cmd.push_back("MSET");
+        for (const auto& kv : kvs) {
+            cmd.push_back(kv.first);
+            cmd.push_back(kv.second);
+        }
+        batch.Add(std::move(cmd));
+    }
+
+    std::vector<RedisResult> results;
+    if (!Exec(batch, results)) {
+        return false;
+    }
+    for (const auto& result : results) {
+        if (result.type != REDIS_REPLY_STATUS) {
+            std::cout << "[RedisMgr::MSet] failure type=" << result.type << " " << result.str << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// HMGet
+bool RedisMgr::HMGet(const std::string& key, const std::vector<std::string>& fields,
+    std::vector<std::optional<std::string>>& values)
+{
+    values.clear();
+    if (fields.empty()) {
+        return true;
+    }
+    std::vector<std::string> cmd;
+    cmd.reserve(fields.size() + 2);
+    cmd.push_back("HMGET");
+    cmd.push_back(key);
+    cmd.insert(cmd.end(), fields.begin(), fields.end());
+
+    RedisBatch batch;
+    batch.Add(std::move(cmd));
+    std::vector<RedisResult> results;
+    if (!Exec(batch, results)) {
+        return false;
+    }
+    if (!arrayToOptionals(results[0], fields.size(), values)) {
+        std::cout << "[RedisMgr::HMGet] unexpected reply for key=" << key << " type=" << results[0].type << std::endl;
+        values.clear();
+        return false;
+    }
+    return true;
+}
+
+void RedisMgr::RegisterScript(const std::string& name, const std::string& body)
+{
+    auto script = std::make_shared<Script>();
+    script->body = body;
+    script->sha = sha1_hex(body);
+    {
+        std::lock_guard<std::mutex> lock(scripts_mutex_);
+        scripts_[name] = script;
+    }
+
+    // 脚本缓存是每个节点各自的，集群模式下每个主节点都预加载一次。
+    // 预加载失败不影响使用，首次 EVALSHA 收到 NOSCRIPT 时会改用 EVAL
+    for (const auto& item : router_->Broadcast({ "SCRIPT", "LOAD", body })) {
+        const redisReply* reply = item.second.get();
+        if (reply == nullptr || reply->type != REDIS_REPLY_STRING) {
+            std::cout << "[RedisMgr::RegisterScript] " << name << " preload failed on " << item.first
+                << ", will load on first use" << std::endl;
+            continue;
+        }
+        std::string sha(reply->str, reply->len);
+        if (sha != script->sha) {
+            std::cout << "[RedisMgr::RegisterScript] " << name << " sha mismatch local=" << script->sha
+                << " redis=" << sha << " on " << item.first << std::endl;
+            continue;
+        }
+        std::cout << "[RedisMgr::RegisterScript] " << name << " loaded sha=" << script->sha << " on " << item.first << std::endl;
+    }
+}
+
+bool RedisMgr::EvalScripts(const std::string& name, const std::vector<RedisScriptCall>& calls,
+    std::vector<RedisResult>& results)
+{
+    std::vector<RedisResult> extra_results;
+    return EvalScripts(name, calls, RedisBatch(), results, extra_results);
+}
+
+bool RedisMgr::EvalScripts(const std::string& name, const std::vector<RedisScriptCall>& calls,
+    const RedisBatch& extra, std::vector<RedisResult>& results, std::vector<RedisResult>& extra_results)
+{
+    results.clear();
+    extra_results.clear();
+    if (calls.empty()) {
+        return true;
+    }
+    std::shared_ptr<const Script> script;
+    {
+        std::lock_guard<std::mutex> lock(scripts_mutex_);
+        auto iter = scripts_.find(name);
+        if (iter != scripts_.end()) {
+            script = iter->second;
+        }
+    }
+    if (!script) {
+        std::cout << "[RedisMgr::EvalScripts] script not registered: " << name << std::endl;
+        results.resize(calls.size());
+        extra_results.resize(extra.Size());
+        return false;
+    }
+
+    auto make_cmd = [&script](const char* cmd, const std::string& body_or_sha, const RedisScriptCall& call) {
+        std::vector<std::string> argv;
+        argv.reserve(3 + call.keys.size() + call.args.size());
+        argv.push_back(cmd);
+        argv.push_back(body_or_sha);
+        argv.push_back(std::to_string(call.keys.size()));
+        argv.insert(argv.end(), call.keys.begin(), call.keys.end());
+        argv.insert(argv.end(), call.args.begin(), call.args.end());
+        return argv;
+    };
+
+    RedisBatch batch;
+    for (const auto& call : calls) {
+        batch.Add(make_cmd("EVALSHA", script->sha, call));
+    }
+    for (const auto& cmd : extra.cmds_) {
+        batch.Add(cmd);
+    }
+    bool ok = Exec(batch, results);
+    results.resize(calls.size() + extra.Size());
+    extra_results.assign(std::make_move_iterator(results.begin() + calls.size()), std::make_move_iterator(results.end()));
+    results.resize(calls.size());
+
+    // 脚本缓存已清空（Redis 重启、SCRIPT FLUSH、主从切换、新加入的节点）：
+    // 只对收到 NOSCRIPT 的调用用 EVAL 重发，脚本随之在那个节点上重新缓存
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].type == REDIS_REPLY_ERROR && results[i].str.compare(0, 8, "NOSCRIPT") == 0) {
+            missing.push_back(i);
+        }
+    }
+    if (!missing.empty()) {
+        std::cout << "[RedisMgr::EvalScripts] " << name << " not cached on server, resend " << missing.size()
+            << " call(s) with EVAL" << std::endl;
+        batch.Clear();
+        for (size_t i : missing) {
+            batch.Add(make_cmd("EVAL", script->body, calls[i]));
+        }
+        std::vector<RedisResult> retried;
+        if (!Exec(batch, retried)) {
+            ok = false;
+        }
+        for (size_t k = 0; k < missing.size(); ++k) {
+            results[missing[k]] = std::move(retried[k]);
+        }
+    }
+
+    for (const auto& result : results) {
+        if (result.type == REDIS_REPLY_ERROR) {
+            std::cout << "[RedisMgr::EvalScripts] " << name << " error: " << result.str << std::endl;
+        }
+        if (!result.Ok()) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool RedisMgr::EvalScript(const std::string& name, const std::vector<std::string>& keys,
+    const std::vector<std::string>& args, RedisResult& result)
+{
+    result = RedisResult();
+    std::vector<RedisResult> results;
+    bool ok = EvalScripts(name, { RedisScriptCall{ keys, args } }, results);
+    if (!results.empty()) {
+        result = std::move(results[0]);
+    }
+    return ok;
+}
+
+bool RedisMgr::EvalScript(const std::string& name, const std::vector<std::string>& keys,
+    const std::vector<std::string>& args, RedisResult& result,
+    const RedisBatch& extra, std::vector<RedisResult>& extra_results)
+{
+    result = RedisResult();
+    std::vector<RedisResult> results;
+    bool ok = EvalScripts(name, { RedisScriptCall{ keys, args } }, extra, results, extra_results);
+    if (!results.empty()) {
+        result = std::move(results[0]);
+    }
+    return ok;
+}
+
+bool RedisMgr::EvalScript(const std::string& name, const std::vector<std::string>& keys,
+    const std::vector<std::string>& args, std::vector<std::string>& result)
+{
+    result.clear();
+    RedisResult reply;
+    if (!EvalScript(name, keys, args, reply)) {
+        return false;
+    }
+    flattenResult(reply, result);
+    return true;
+}
+
+void RedisMgr::Close()
+{
+    // 只停止连接池（之后取连接返回 nullptr），路由表和池对象留到析构时释放，
+    // 关闭后仍在调用的线程拿到的是失败而不是悬空指针
+    if (router_) {
+        router_->Close();
+    }
+}
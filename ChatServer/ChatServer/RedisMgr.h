@@ -1,6 +1,26 @@
 #pragma once
 #include"const.h"
+#include "ConnAffinity.h"
+#include "RedisRouter.h"
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+struct RedisContextDeleter {
+    void operator()(redisContext* ctx) const { redisFree(ctx); }
+};
+
+// Redis 连接池（固定大小）
+//
+// 线程亲和（见 ConnAffinity）：
+//   归还的连接先放进当前线程的槽，同一线程下次取连接直接拿回，取还都不加 mutex_；
+//   共享队列为空时等待者从其它线程的槽里偷，有人等待时归还方直接还给共享队列。
+//   没有维护线程：慢路径上至多每 RECLAIM_INTERVAL_MS 做一次 Reclaim，
+//   把已退出线程槽里的连接收回共享队列并删掉它们的空槽（新线程首次取连接必走慢路径）。
 class RedisConPool {
 public:
     RedisConPool(size_t poolSize, const char* host, int port, const char* pwd)
@@ -39,13 +59,32 @@ public:
     }
 
     redisContext* getConnection() {
+        if (b_stop_) {
+            return nullptr;
+        }
+        if (auto* local = affinity_.TakeLocal()) {
+            return local;
+        }
+
         std::unique_lock<std::mutex> lock(mutex_);
-        cond_.wait(lock, [this] {
+        ReclaimLocked();
+        for (;;) {
             if (b_stop_) {
-                return true;
+                return nullptr;
             }
-            return !connections_.empty();
-            });
+            if (!connections_.empty()) {
+                break;
+            }
+            // 先登记再偷，与 returnConnection 中「先放槽再看 waiting_」配对
+            ++waiting_;
+            auto* stolen = affinity_.Steal();
+            if (stolen) {
+                --waiting_;
+                return stolen;
+            }
+            cond_.wait(lock, [this] { return b_stop_ || !connections_.empty(); });
+            --waiting_;
+        }
         //?????????????????
         if (b_stop_) {
             return  nullptr;
@@ -56,6 +95,16 @@ public:
     }
 
     void returnConnection(redisContext* context) {
+        if (!b_stop_ && waiting_ == 0 && affinity_.ParkLocal(context)) {
+            // 放槽之后才有人开始等：取回来交给共享队列
+            if (waiting_ == 0) {
+                return;
+            }
+            context = affinity_.TakeLocal();
+            if (context == nullptr) {
+                return;
+            }
+        }
         std::lock_guard<std::mutex> lock(mutex_);
         if (b_stop_) {
             return;
@@ -70,6 +119,21 @@ public:
     }
 
 private:
+    static constexpr int RECLAIM_INTERVAL_MS = 1000;
+
+    // 在持有 mutex_ 时调用：收回已退出线程槽里的连接，清理空槽。存活线程的连接留在原槽
+    void ReclaimLocked() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_reclaim_ < std::chrono::milliseconds(RECLAIM_INTERVAL_MS)) {
+            return;
+        }
+        last_reclaim_ = now;
+        affinity_.Reclaim([](redisContext*) { return false; }, [this](redisContext* context) {
+            connections_.push(context);
+            cond_.notify_one();
+            });
+    }
+
     std::atomic<bool> b_stop_;
     size_t poolSize_;
     const char* host_;
@@ -77,6 +141,56 @@ private:
     std::queue<redisContext*> connections_;
     std::mutex mutex_;
     std::condition_variable cond_;
+    std::atomic<size_t> waiting_{ 0 };     // 在 mutex_ 内修改，归还快路径在锁外读取
+    std::chrono::steady_clock::time_point last_reclaim_;
+    ConnAffinity<redisContext, RedisContextDeleter> affinity_;
+};
+
+// 一条 Redis 回复的拷贝（批量执行 / MGET 等使用，调用方不需要 freeReplyObject）
+struct RedisResult {
+    int type = 0;                       // REDIS_REPLY_*；连接出错、没有读到回复时为 0
+    long long integer = 0;              // INTEGER
+    std::string str;                    // STRING / STATUS / ERROR 的内容
+    std::vector<RedisResult> elements;  // ARRAY
+
+    bool Ok() const { return type != 0 && type != REDIS_REPLY_ERROR; }
+    bool IsNil() const { return type == REDIS_REPLY_NIL; }
+};
+
+// 把 hiredis 的回复拷贝成 RedisResult（reply 为 nullptr 时得到 type 为 0 的结果）
+void CopyRedisReply(redisReply* reply, RedisResult& out);
+
+// 批量命令构造器
+//
+// 作用：
+//   多条互不依赖的命令在同一条连接上用 redisAppendCommandArgv 一次写出，再依次读回全部回复，
+//   N 条命令只花一次往返，取还连接也只有一次。命令之间没有原子性，需要原子请用 Eval。
+//   集群模式下按键所在节点拆成几组，各组并行往返（见 RedisRouter）。
+//
+// 用法：
+//   RedisBatch batch;
+//   batch.Add({ "HINCRBY", LOGIN_COUNT, server_name, "1" }).Add({ "SET", ipkey, server_name });
+//   std::vector<RedisResult> results;
+//   RedisMgr::GetInstance()->Exec(batch, results);   // results[i] 对应第 i 条命令
+class RedisBatch {
+public:
+    RedisBatch& Add(std::vector<std::string> argv) {
+        cmds_.push_back(std::move(argv));
+        return *this;
+    }
+    size_t Size() const { return cmds_.size(); }
+    bool Empty() const { return cmds_.empty(); }
+    void Clear() { cmds_.clear(); }
+
+private:
+    friend class RedisMgr;
+    std::vector<std::vector<std::string>> cmds_;
+};
+
+// 一次脚本调用的 KEYS / ARGV（EvalScripts 使用）
+struct RedisScriptCall {
+    std::vector<std::string> keys;
+    std::vector<std::string> args;
 };
 
 class RedisMgr : public Singleton<RedisMgr>,
@@ -87,7 +201,19 @@ public:
     ~RedisMgr();
 
     bool Get(const std::string& key, std::string& value);
+    // 取出并删除整个列表：按页弹出（见 DrainList），单次回复不超过 LIST_PAGE_SIZE 条。
+    // 不是一次原子操作，取的过程中新推入的元素也会一并取到。
+    // 中途某一页弹出失败时返回 false，但之前各页已经从 Redis 删除，仍按顺序留在 values 里，
+    // 调用方须照常处理 values，不能当作什么都没取到
     bool GetAllList(const std::string& key, std::vector<std::string>& values);
+    // 从列表头部原子地弹出至多 count 条，按顺序追加到 values；列表为空或不存在时返回 true、values 不变
+    bool PopList(const std::string& key, size_t count, std::vector<std::string>& values);
+    // 按页取空列表：每页一次 EVALSHA 往返，交给 consumer 处理完再弹下一页，内存里只有一页。
+    // 弹出的每一页都会先交给 consumer，再弹下一页：返回 false（某次弹出失败）时，之前的页都已经交给过 consumer，
+    // 失败的那一页没有交给 consumer（脚本未执行时仍留在列表里，只有回复在途中丢失时才会丢掉）。consumer 返回 false 时停止，剩下的元素留在列表里；
+    // 已经交给 consumer 的页不会放回，由 consumer 负责
+    bool DrainList(const std::string& key, size_t pageSize,
+        const std::function<bool(std::vector<std::string>& page)>& consumer);
     bool Set(const std::string& key, const std::string& value);
     bool Auth(const std::string& password);
     bool LPush(const std::string& key, const std::string& value);
@@ -100,14 +226,76 @@ public:
     std::string HGet(const std::string& key, const std::string& hkey);
     bool Del(const std::string& key);
     bool ExistsKey(const std::string& key);
+    // 执行 Lua 脚本（EVAL），返回值按顺序展开到 result：
+    // 字符串原样、整数转成十进制字符串、嵌套数组逐个展开，nil 为空串
+    bool Eval(const std::string& script, const std::vector<std::string>& keys,
+        const std::vector<std::string>& args, std::vector<std::string>& result);
+
+    // 批量执行：所有命令在一条连接上流水线发送（集群模式下每个节点一条），一次往返读回，results 与命令一一对应。
+    // 连接不可用或读回复失败返回 false（此时已读到的回复保留，其余 type 为 0）；
+    // 单条命令出错只体现在对应的 RedisResult 上，不影响返回值
+    bool Exec(const RedisBatch& batch, std::vector<RedisResult>& results);
+    // MGET：values 与 keys 一一对应，不存在的键为 std::nullopt（集群模式下拆成逐个 GET）
+    bool MGet(const std::vector<std::string>& keys, std::vector<std::optional<std::string>>& values);
+    // MSET：一次写入多个键（集群模式下拆成逐个 SET，不再原子）
+    bool MSet(const std::vector<std::pair<std::string, std::string>>& kvs);
+    // HMGET：values 与 fields 一一对应，不存在的字段为 std::nullopt
+    bool HMGet(const std::string& key, const std::vector<std::string>& fields,
+        std::vector<std::optional<std::string>>& values);
+
+    // 脚本注册表
+    //
+    // 多步操作写成 Lua 脚本按名字注册，之后用 EvalScript 以 EVALSHA 调用：
+    // 一次往返、服务端原子执行，每次只发送 40 字节的 sha1 而不是整段脚本。
+    // 注册时本地算出 sha1 并尽力在每个节点上 SCRIPT LOAD 预加载；Redis 重启、SCRIPT FLUSH 或主从切换后
+    // 返回 NOSCRIPT 时自动改用 EVAL 重发一次，脚本随之重新进入缓存。
+    // 同名重复注册以最后一次为准。线程安全
+    void RegisterScript(const std::string& name, const std::string& body);
+    // 执行已注册的脚本，result 为脚本返回值；未注册、连接失败或脚本报错返回 false
+    bool EvalScript(const std::string& name, const std::vector<std::string>& keys,
+        const std::vector<std::string>& args, RedisResult& result);
+    // 同上，返回值按 Eval 的规则展开成字符串列表
+    bool EvalScript(const std::string& name, const std::vector<std::string>& keys,
+        const std::vector<std::string>& args, std::vector<std::string>& result);
+    // 同上，extra 中的命令与脚本放在同一批流水线发送（集群模式下按节点并行），不再单独一次往返；
+    // extra 不受脚本原子性保护，回复写入 extra_results，不影响返回值
+    bool EvalScript(const std::string& name, const std::vector<std::string>& keys,
+        const std::vector<std::string>& args, RedisResult& result,
+        const RedisBatch& extra, std::vector<RedisResult>& extra_results);
+    // 同一脚本的多次调用一起流水线发送，results 与 calls 一一对应；任一调用失败返回 false。
+    // 集群模式下每次调用的 KEYS 必须在同一个槽，跨槽的键由调用方拆成多次调用
+    bool EvalScripts(const std::string& name, const std::vector<RedisScriptCall>& calls,
+        std::vector<RedisResult>& results);
+
+    // 集群模式（[Redis] Nodes 非空）
+    bool Clustered() const;
+    // 命令应发往的节点地址 host:port（RedisAsync 按它选连接）
+    std::string NodeAddr(const std::vector<std::string>& argv);
+    std::vector<std::string> NodeAddrs();
+    // 异步连接收到 MOVED 时调用：只更新这个槽，不阻塞调用线程，整张槽表由下一条同步命令刷新
+    void Redirected(int slot, const std::string& addr);
     void Close();
 private:
     RedisMgr();
 
+    // 路由执行一条命令，调用方 freeReplyObject；连接不可用时返回 nullptr
+    redisReply* Command(const std::vector<std::string>& argv);
+    // EvalScripts 的实现，extra 追加在脚本调用之后一起发送
+    bool EvalScripts(const std::string& name, const std::vector<RedisScriptCall>& calls,
+        const RedisBatch& extra, std::vector<RedisResult>& results, std::vector<RedisResult>& extra_results);
+
+    struct Script {
+        std::string body;
+        std::string sha;
+    };
+
     //redisContext* _connect;
     //redisReply* _reply;
 
-    std::unique_ptr<RedisConPool> con_pool_;
+    std::unique_ptr<RedisRouter<RedisConPool>> router_;
+
+    std::mutex scripts_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const Script>> scripts_;
 };
 
 
@@ -0,0 +1,251 @@
+#include "RedisSubscriber.h"
+#include <iostream>
+
+namespace {
+    constexpr std::chrono::milliseconds MIN_BACKOFF(200);
+    constexpr std::chrono::milliseconds MAX_BACKOFF(5000);
+
+    std::string ElementString(const redisReply* reply, size_t i) {
+        if (i >= reply->elements || reply->element[i]->type != REDIS_REPLY_STRING) return {};
+        return std::string(reply->element[i]->str, reply->element[i]->len);
+    }
+} // namespace
+
+RedisSubscriber::RedisSubscriber(boost::asio::io_context& ioc, std::string host, std::string port, std::string pwd,
+    std::string clientName, std::vector<std::string> channels, Handler handler)
+    : strand_(boost::asio::make_strand(ioc)), socket_(strand_), resolver_(strand_),
+      reconnect_timer_(strand_), ping_timer_(strand_),
+      host_(std::move(host)), port_(std::move(port)), pwd_(std::move(pwd)),
+      client_name_(std::move(clientName)), channels_(std::move(channels)), handler_(std::move(handler)),
+      backoff_(MIN_BACKOFF) {
+}
+
+RedisSubscriber::~RedisSubscriber()
+{
+    if (reader_) redisReaderFree(reader_);
+}
+
+void RedisSubscriber::Start()
+{
+    boost::asio::post(strand_, [self = shared_from_this()]() {
+        self->DoConnect();
+        self->Ping();
+    });
+}
+
+void RedisSubscriber::Stop()
+{
+    b_stop_ = true;
+    boost::asio::post(strand_, [self = shared_from_this()]() {
+        self->reconnect_timer_.cancel();
+        self->ping_timer_.cancel();
+        self->Fail("stopped");
+    });
+}
+
+void RedisSubscriber::DoConnect()
+{
+    if (b_stop_) return;
+    auto gen = ++gen_;
+    resolver_.async_resolve(host_, port_,
+        [self = shared_from_this(), gen](const boost::system::error_code& ec,
+            boost::asio::ip::tcp::resolver::results_type results) {
+            if (gen != self->gen_) return;
+            if (ec) {
+                self->Fail("resolve " + self->host_ + ": " + ec.message());
+                return;
+            }
+            boost::asio::async_connect(self->socket_, results,
+                [self, gen](const boost::system::error_code& ec, const boost::asio::ip::tcp::endpoint&) {
+                    if (gen != self->gen_) return;
+                    if (ec) {
+                        self->Fail("connect " + self->host_ + ":" + self->port_ + ": " + ec.message());
+                        return;
+                    }
+                    self->OnConnected(gen);
+                });
+        });
+}
+
+// AUTH、SETNAME、SUBSCRIBE 一次写出，回复在 OnReply 中按类型处理
+void RedisSubscriber::OnConnected(uint64_t gen)
+{
+    boost::system::error_code ignored;
+    socket_.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+    socket_.set_option(boost::asio::socket_base::keep_alive(true), ignored);
+    reader_ = redisReaderCreate();
+    connected_ = true;
+    last_rx_ = std::chrono::steady_clock::now();
+
+    if (!pwd_.empty()) {
+        Write(Format({ "AUTH", pwd_ }));
+    }
+    if (!client_name_.empty()) {
+        Write(Format({ "CLIENT", "SETNAME", client_name_ }));
+    }
+    std::vector<std::string> sub = { "SUBSCRIBE" };
+    sub.insert(sub.end(), channels_.begin(), channels_.end());
+    Write(Format(sub));
+
+    DoRead(gen);
+}
+
+void RedisSubscriber::DoRead(uint64_t gen)
+{
+    socket_.async_read_some(boost::asio::buffer(read_buf_),
+        [self = shared_from_this(), gen](const boost::system::error_code& ec, std::size_t n) {
+            if (gen != self->gen_) return;
+            if (ec) {
+                self->Fail("read: " + ec.message());
+                return;
+            }
+            if (!self->OnData(n)) return;
+            self->DoRead(gen);
+        });
+}
+
+bool RedisSubscriber::OnData(size_t n)
+{
+    last_rx_ = std::chrono::steady_clock::now();
+    if (redisReaderFeed(reader_, read_buf_.data(), n) != REDIS_OK) {
+        Fail("reader feed failed");
+        return false;
+    }
+    for (;;) {
+        void* reply = nullptr;
+        if (redisReaderGetReply(reader_, &reply) != REDIS_OK) {
+            Fail(std::string("protocol error: ") + reader_->errstr);
+            return false;
+        }
+        if (reply == nullptr) {
+            return true;
+        }
+        std::unique_ptr<redisReply, void(*)(void*)> guard(static_cast<redisReply*>(reply), freeReplyObject);
+        if (guard->type == REDIS_REPLY_ERROR) {
+            // AUTH 或 SUBSCRIBE 失败，重连重试
+            Fail("server error: " + std::string(guard->str, guard->len));
+            return false;
+        }
+        OnReply(guard.get());
+    }
+}
+
+void RedisSubscriber::OnReply(redisReply* reply)
+{
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements == 0) {
+        return; // AUTH / SETNAME 的 +OK
+    }
+    std::string kind = ElementString(reply, 0);
+    if (kind == "message" && reply->elements >= 3) {
+        std::string channel = ElementString(reply, 1);
+        std::string payload = ElementString(reply, 2);
+        try {
+            handler_(channel, payload);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[RedisSubscriber] handler threw on channel=" << channel << ": " << e.what() << std::endl;
+        }
+        return;
+    }
+    if (kind == "subscribe" && reply->elements >= 3) {
+        std::cout << "[RedisSubscriber] subscribed channel=" << ElementString(reply, 1)
+            << " count=" << reply->element[2]->integer << std::endl;
+        backoff_ = MIN_BACKOFF;
+        if (on_subscribed_ && reply->element[2]->integer == static_cast<long long>(channels_.size())) {
+            try {
+                on_subscribed_();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "[RedisSubscriber] subscribed handler threw: " << e.what() << std::endl;
+            }
+        }
+    }
+    // pong 只用于刷新 last_rx_
+}
+
+void RedisSubscriber::Write(std::string cmd)
+{
+    write_queue_.push_back(std::move(cmd));
+    DoWrite(gen_);
+}
+
+void RedisSubscriber::DoWrite(uint64_t gen)
+{
+    if (!connected_ || writing_ || write_queue_.empty()) return;
+    write_buf_.clear();
+    for (auto& cmd : write_queue_) {
+        write_buf_ += cmd;
+    }
+    write_queue_.clear();
+    writing_ = true;
+    boost::asio::async_write(socket_, boost::asio::buffer(write_buf_),
+        [self = shared_from_this(), gen](const boost::system::error_code& ec, std::size_t) {
+            if (gen != self->gen_) return;
+            self->writing_ = false;
+            if (ec) {
+                self->Fail("write: " + ec.message());
+                return;
+            }
+            self->DoWrite(gen);
+        });
+}
+
+void RedisSubscriber::Fail(const std::string& reason)
+{
+    ++gen_;
+    boost::system::error_code ignored;
+    resolver_.cancel();
+    socket_.close(ignored);
+    if (reader_) {
+        redisReaderFree(reader_);
+        reader_ = nullptr;
+    }
+    connected_ = false;
+    writing_ = false;
+    write_queue_.clear();
+    if (b_stop_) return;
+
+    std::cerr << "[RedisSubscriber] " << reason << ", reconnect in " << backoff_.count() << "ms" << std::endl;
+    reconnect_timer_.expires_after(backoff_);
+    reconnect_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec || self->b_stop_) return;
+        self->DoConnect();
+    });
+    backoff_ = std::min(backoff_ * 2, MAX_BACKOFF);
+}
+
+// 定时 PING，长时间收不到任何数据（包括 pong）时判定连接已断
+void RedisSubscriber::Ping()
+{
+    ping_timer_.expires_after(PING_INTERVAL);
+    ping_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec || self->b_stop_) return;
+        if (self->connected_) {
+            if (std::chrono::steady_clock::now() - self->last_rx_ > 2 * PING_INTERVAL) {
+                self->Fail("no data for " + std::to_string(2 * PING_INTERVAL.count()) + "s");
+            }
+            else {
+                self->Write(Format({ "PING" }));
+            }
+        }
+        self->Ping();
+    });
+}
+
+std::string RedisSubscriber::Format(const std::vector<std::string>& argv)
+{
+    std::vector<const char*> args;
+    std::vector<size_t> lens;
+    for (const auto& arg : argv) {
+        args.push_back(arg.data());
+        lens.push_back(arg.size());
+    }
+    char* cmd = nullptr;
+    auto len = redisFormatCommandArgv(&cmd, static_cast<int>(args.size()), args.data(), lens.data());
+    std::string packed;
+    if (len > 0 && cmd) {
+        packed.assign(cmd, static_cast<size_t>(len));
+    }
+    redisFreeCommand(cmd);
+    return packed;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <hiredis/hiredis.h>
+
+// Redis 订阅连接（事件驱动）
+//
+// 作用：
+//   原来的订阅线程用 1 秒读超时轮询 redisGetReply，空闲时每次再睡 50ms，消息最多多等 50ms，
+//   还要单独占一个线程。这里把订阅连接放到 Asio 的 io_context 上：socket 可读时才解析，
+//   收到 message 立即回调，不轮询、不占线程。
+//
+// 连接保活：
+//   每 PING_INTERVAL 发一次 PING（订阅模式下允许），超过两个间隔没有收到任何数据视为连接已断；
+//   断开后按退避间隔重连并重新 SUBSCRIBE，断线期间发布的消息会丢失（pub/sub 本身不保存消息）。
+//   需要知道这段空窗的调用方用 SetOnSubscribed，每次全部频道订阅成功时回调一次。
+//
+// 回调在 IO 线程上执行，不能阻塞。
+class RedisSubscriber : public std::enable_shared_from_this<RedisSubscriber> {
+public:
+    using Handler = std::function<void(const std::string& channel, const std::string& payload)>;
+    using SubscribedHandler = std::function<void()>;
+
+    RedisSubscriber(boost::asio::io_context& ioc, std::string host, std::string port, std::string pwd,
+        std::string clientName, std::vector<std::string> channels, Handler handler);
+    ~RedisSubscriber();
+
+    // Start 之前设置
+    void SetOnSubscribed(SubscribedHandler handler) { on_subscribed_ = std::move(handler); }
+
+    void Start();
+    void Stop();
+
+private:
+    void DoConnect();
+    void OnConnected(uint64_t gen);
+    void DoRead(uint64_t gen);
+    bool OnData(size_t n);
+    void OnReply(redisReply* reply);
+    void Write(std::string cmd);
+    void DoWrite(uint64_t gen);
+    void Fail(const std::string& reason);
+    void Ping();
+
+    static std::string Format(const std::vector<std::string>& argv);
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::steady_timer reconnect_timer_;
+    boost::asio::steady_timer ping_timer_;
+
+    const std::string host_;
+    const std::string port_;
+    const std::string pwd_;
+    const std::string client_name_;
+    const std::vector<std::string> channels_;
+    Handler handler_;
+    SubscribedHandler on_subscribed_;
+
+    redisReader* reader_ = nullptr;
+    bool connected_ = false;
+    uint64_t gen_ = 0;                      // 每次建连、断开加 1，旧连接上迟到的完成回调据此丢弃
+    std::vector<std::string> write_queue_;
+    std::string write_buf_;
+    bool writing_ = false;
+    std::array<char, 16 * 1024> read_buf_;
+    std::chrono::steady_clock::time_point last_rx_;
+    std::chrono::milliseconds backoff_;
+    std::atomic<bool> b_stop_{ false };
+
+    static constexpr std::chrono::seconds PING_INTERVAL{ 30 };
+};
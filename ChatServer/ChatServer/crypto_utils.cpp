@@ -12,4 +12,15 @@ std::string sha256_hex(const std::string& input) {
         oss << std::setw(2) << static_cast<int>(hash[i]);
     }
     return oss.str();
-}
\ No newline at end of file
+}
+
+std::string sha1_hex(const std::string& input) {
+    unsigned char hash[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char*>(input.data()), input.size(), hash);
+    std::ostringstream oss;
+    oss << std::hex << std::setfill('0');
+    for (int i = 0; i < SHA_DIGEST_LENGTH; ++i) {
+        oss << std::setw(2) << static_cast<int>(hash[i]);
+    }
+    return oss.str();
+}
@@ -2,4 +2,5 @@
 #include <string>
 
 std::string sha256_hex(const std::string& input);
+std::string sha1_hex(const std::string& input);
 
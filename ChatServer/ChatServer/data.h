@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 struct UserInfo {
 	UserInfo() : name(""), pwd(""), uid(0), email(""), sex(0), nick(""), desc(""), back(""), icon("") {}
@@ -27,4 +28,33 @@ struct ApplyInfo {
     std::string _nick;
     int _sex;
     int _status;
-};
\ No newline at end of file
+};
+
+// 待持久化的单条聊天消息（批量写入 messages 表使用）
+struct ChatMsgRecord {
+    ChatMsgRecord(int from_uid, int to_uid, std::string payload)
+        : _from_uid(from_uid), _to_uid(to_uid), _payload(std::move(payload)), _id(0) { }
+
+    int _from_uid;
+    int _to_uid;
+    std::string _payload;
+    std::string _client_msg_id; // 去重键，首次写库时取消息体里发送方的 msgid，重试沿用
+    long long _id;      // 写库成功后回填的 messages.id
+};
+
+// 一页离线消息（键集分页查询结果）
+struct ChatMsgPage {
+    bool ok = false;
+    bool has_more = false;  // 本页之后还有未读消息
+    std::vector<long long> ids;
+    std::vector<std::string> payloads;
+};
+
+// messages 表一行的存储格式（归档搬运用，payload 不解码）
+struct StoredChatMsg {
+    long long _id = 0;
+    int _from_uid = 0;
+    long long _create_time = 0;     // unix 秒
+    int _codec = 0;
+    std::string _blob;
+};
@@ -2667,6 +2667,7 @@ class TextChatMsgReq final :
     kTextmsgsFieldNumber = 3,
     kFromuidFieldNumber = 1,
     kTouidFieldNumber = 2,
+    kIdFieldNumber = 4,
   };
   // repeated .message.TextChatData textmsgs = 3;
   int textmsgs_size() const;
@@ -2704,6 +2705,15 @@ class TextChatMsgReq final :
   void _internal_set_touid(int32_t value);
   public:
 
+  // int64 id = 4;
+  void clear_id();
+  int64_t id() const;
+  void set_id(int64_t value);
+  private:
+  int64_t _internal_id() const;
+  void _internal_set_id(int64_t value);
+  public:
+
   // @@protoc_insertion_point(class_scope:message.TextChatMsgReq)
  private:
   class _Internal;
@@ -2715,6 +2725,7 @@ class TextChatMsgReq final :
     ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::message::TextChatData > textmsgs_;
     int32_t fromuid_;
     int32_t touid_;
+    int64_t id_;
     mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
   };
   union { Impl_ _impl_; };
@@ -5753,6 +5764,26 @@ TextChatMsgReq::textmsgs() const {
   return _impl_.textmsgs_;
 }
 
+// int64 id = 4;
+inline void TextChatMsgReq::clear_id() {
+  _impl_.id_ = int64_t{0};
+}
+inline int64_t TextChatMsgReq::_internal_id() const {
+  return _impl_.id_;
+}
+inline int64_t TextChatMsgReq::id() const {
+  // @@protoc_insertion_point(field_get:message.TextChatMsgReq.id)
+  return _internal_id();
+}
+inline void TextChatMsgReq::_internal_set_id(int64_t value) {
+  
+  _impl_.id_ = value;
+}
+inline void TextChatMsgReq::set_id(int64_t value) {
+  _internal_set_id(value);
+  // @@protoc_insertion_point(field_set:message.TextChatMsgReq.id)
+}
+
 // -------------------------------------------------------------------
 
 // TextChatData
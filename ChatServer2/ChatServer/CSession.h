@@ -42,6 +42,9 @@ public:
 
 	std::shared_ptr<CSession> SharedSelf();
 
+	// 会话的 strand，异步任务（如 DB 查询）完成后可 post 回这里继续处理
+	boost::asio::strand<boost::asio::io_context::executor_type> GetStrand();
+
 private:
 	void HandleWrite(const boost::system::error_code& error, std::shared_ptr<CSession> shared_self);
 
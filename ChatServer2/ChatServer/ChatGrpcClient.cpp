@@ -18,8 +18,15 @@
 //   2. 解析server列表
 //   3. 为每个server创建连接池
 //   4. 使用server的Name作为key，存储在unordered_map中
+//   5. 读取异步调用的截止时间和排队上限，启动完成队列线程
 ChatGrpcClient::ChatGrpcClient() {
     auto& cfg = ConfigMgr::Inst();
+    try { deadline_ = std::chrono::milliseconds(std::stoi(cfg["PeerServer"]["DeadlineMs"])); }
+    catch (...) {}
+    try { max_pending_ = static_cast<size_t>(std::stoi(cfg["PeerServer"]["MaxPending"])); }
+    catch (...) {}
+    if (deadline_.count() <= 0) deadline_ = std::chrono::milliseconds(1000);
+    if (max_pending_ == 0) max_pending_ = 10000;
     auto server_list = cfg["PeerServer"]["Servers"];
 
     std::vector<std::string> words;
@@ -71,6 +78,8 @@ ChatGrpcClient::ChatGrpcClient() {
                   << " host=" << host
                   << " rpc_port=" << rpc_port << std::endl;
     }
+
+    cq_thread_ = std::thread([this]() { PollCompletions(); });
 }
 
 
@@ -93,7 +102,12 @@ AddFriendRsp ChatGrpcClient::NotifyAddFriend(std::string server_ip, const AddFri
 
     auto& pool = find_iter->second;
     ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + deadline_);
     auto stub = pool->getConnection();
+    if (!stub) {
+        rsp.set_error(ErrorCodes::RPCFailed);
+        return rsp;
+    }
     Status status = stub->NotifyAddFriend(&context, req, &rsp);
     Defer defercon([&stub, this, &pool]() {
         pool->returnConnection(std::move(stub));
@@ -119,55 +133,126 @@ bool ChatGrpcClient::GetBaseInfo(std::string base_key, int uid, std::shared_ptr<
     return false;
 }
 
-// 通知文本聊天消息（当前未实现）
-TextChatMsgRsp ChatGrpcClient::NotifyTextChatMsg(std::string server_ip, const TextChatMsgReq& req)
+// 通知文本聊天消息（异步）
+//
+// 对端找不到、已停止或排队已满时在当前线程立即回调失败；
+// 否则挂到收件人的队列上，队列原本为空时立即发起，不然等前一条完成后由完成队列线程发起
+void ChatGrpcClient::NotifyTextChatMsg(const std::string& server_name, const TextChatMsgReq& req, TextChatCallback callback)
 {
-    TextChatMsgRsp rsp;
-    // 预置返回值，默认 Success，并把请求内容回填
-    Defer defer([&rsp, &req]() {
-        rsp.set_error(ErrorCodes::Success);
-        rsp.set_fromuid(req.fromuid());
-        rsp.set_touid(req.touid());
-        for (const auto& text_data : req.textmsgs()) {
-            TextChatData* new_msg = rsp.add_textmsgs();
-            new_msg->set_msgid(text_data.msgid());
-            new_msg->set_msgcontent(text_data.msgcontent());
-        }
-        });
-
     // 查找连接池时统一使用小写键
-    std::string key = server_ip;
+    std::string key = server_name;
     std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-    std::cout << "[TextChat][gRPC][Client] call target=" << server_ip
-              << " normalized=" << key << std::endl;
     auto find_iter = _pools.find(key);
     if (find_iter == _pools.end()) {
         std::cout << "[TextChat][gRPC][Client] pool not found for key=" << key << " pools=";
         for (auto &kv : _pools) std::cout << kv.first << ' ';
         std::cout << std::endl;
-        rsp.set_error(ErrorCodes::RPCFailed);
-        return rsp;
+        callback(Status(grpc::StatusCode::UNAVAILABLE, "unknown server " + server_name), TextChatMsgRsp());
+        return;
     }
 
-    auto& pool = find_iter->second;
-    ClientContext context;
-    auto stub = pool->getConnection();
-    if (!stub) {
-        rsp.set_error(ErrorCodes::RPCFailed);
-        return rsp;
+    auto call = std::make_unique<TextChatCall>();
+    call->stub = find_iter->second->asyncStub();
+    call->req = req;
+    call->callback = std::move(callback);
+
+    std::unique_lock<std::mutex> lock(call_mutex_);
+    if (b_stop_ || pending_ >= max_pending_) {
+        lock.unlock();
+        std::cout << "[TextChat][gRPC][Client] " << (b_stop_ ? "stopped" : "too many pending calls")
+                  << ", drop touid=" << req.touid() << std::endl;
+        call->callback(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, b_stop_ ? "client stopped" : "too many pending calls"),
+            TextChatMsgRsp());
+        return;
     }
-    Status status = stub->NotifyTextChatMsg(&context, req, &rsp);
-    Defer defercon([&stub, this, &pool]() {
-        pool->returnConnection(std::move(stub));
-        });
+    auto& queue = calls_[req.touid()];
+    queue.push_back(std::move(call));
+    ++pending_;
+    if (queue.size() == 1) {
+        StartCall(*queue.front());
+    }
+}
 
-    if (!status.ok()) {
-        std::cout << "[TextChat][gRPC][Client] rpc failed ok=false error_code=" << status.error_code()
-                  << " error_message=" << status.error_message() << std::endl;
-        rsp.set_error(ErrorCodes::RPCFailed);
-        return rsp;
+void ChatGrpcClient::StartCall(TextChatCall& call)
+{
+    call.context = std::make_unique<ClientContext>();
+    call.context->set_deadline(std::chrono::system_clock::now() + deadline_);
+    call.reader = call.stub->PrepareAsyncNotifyTextChatMsg(call.context.get(), call.req, &cq_);
+    call.reader->StartCall();
+    call.reader->Finish(&call.rsp, &call.status, &call);
+}
+
+void ChatGrpcClient::Complete(TextChatCall& call)
+{
+    try {
+        call.callback(call.status, call.rsp);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[TextChat][gRPC][Client] callback threw: " << e.what() << std::endl;
     }
-    std::cout << "[TextChat][gRPC][Client] rpc ok" << std::endl;
+}
 
-    return rsp;
+void ChatGrpcClient::PollCompletions()
+{
+    void* tag = nullptr;
+    bool ok = false;
+    while (cq_.Next(&tag, &ok)) {
+        // 一元调用的 Finish 总会以 ok == true 完成，失败和超时体现在 status 里
+        auto* finished = static_cast<TextChatCall*>(tag);
+        Complete(*finished);
+
+        std::unique_ptr<TextChatCall> done;
+        std::deque<std::unique_ptr<TextChatCall>> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(call_mutex_);
+            auto iter = calls_.find(finished->req.touid());
+            done = std::move(iter->second.front());
+            iter->second.pop_front();
+            --pending_;
+            if (b_stop_) {
+                // 已停止：完成队列不再接受新调用，排队的直接按失败回调
+                cancelled.swap(iter->second);
+                pending_ -= cancelled.size();
+            }
+            else if (!iter->second.empty()) {
+                StartCall(*iter->second.front());
+            }
+            if (iter->second.empty()) {
+                calls_.erase(iter);
+            }
+        }
+        for (auto& call : cancelled) {
+            call->status = Status(grpc::StatusCode::CANCELLED, "client stopped");
+            Complete(*call);
+        }
+    }
+}
+
+void ChatGrpcClient::Stop()
+{
+    std::deque<std::unique_ptr<TextChatCall>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(call_mutex_);
+        if (b_stop_) {
+            return;
+        }
+        b_stop_ = true;
+        // 进行中的调用（队首）留给完成队列线程回调，其余的在这里取消
+        for (auto& kv : calls_) {
+            for (size_t i = 1; i < kv.second.size(); ++i) {
+                cancelled.push_back(std::move(kv.second[i]));
+            }
+            pending_ -= kv.second.size() - 1;
+            kv.second.resize(1);
+        }
+    }
+    for (auto& call : cancelled) {
+        call->status = Status(grpc::StatusCode::CANCELLED, "client stopped");
+        Complete(*call);
+    }
+    // Shutdown 之后 Next 仍会返回进行中调用的完成事件（至多 DeadlineMs），取完后返回 false
+    cq_.Shutdown();
+    if (cq_thread_.joinable()) {
+        cq_thread_.join();
+    }
 }
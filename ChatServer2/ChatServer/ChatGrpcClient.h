@@ -9,6 +9,12 @@
 #include"message.grpc.pb.h"
 #include"message.pb.h"
 #include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<deque>
+#include<functional>
+#include<mutex>
+#include<thread>
 #include<unordered_map>
 #include"data.h"
 
@@ -57,6 +63,7 @@ public:
             auto stub = ChatService::NewStub(channel);
             connections_.emplace(std::move(stub));
         }
+        async_stub_ = ChatService::NewStub(grpc::CreateChannel(host_ + ":" + port_, grpc::InsecureChannelCredentials()));
     }
 
     // 析构函数：清理所有连接
@@ -87,6 +94,11 @@ public:
         return context;
     }
 
+    // 异步调用使用的Stub：异步调用不占用Stub，也不会阻塞，所有异步调用共用这一个
+    ChatService::Stub* asyncStub() {
+        return async_stub_.get();
+    }
+
     // 归还Stub到连接池
     void returnConnection(std::unique_ptr<ChatService::Stub> context) {
         std::lock_guard<std::mutex> lock(mutex_);
@@ -109,6 +121,7 @@ private:
     std::string host_;                                      // ChatServer主机地址
     std::string port_;                                      // ChatServer端口
     std::queue<std::unique_ptr<ChatService::Stub>> connections_;  // Stub队列
+    std::unique_ptr<ChatService::Stub> async_stub_;         // 异步调用专用Stub（独立通道）
     std::mutex mutex_;                                      // 互斥锁（保证线程安全）
     std::condition_variable cond_;                         // 条件变量（用于等待连接）
 };
@@ -124,11 +137,18 @@ private:
 // 主要功能：
 //   - NotifyAddFriend: 通知添加好友（跨服务器）
 //   - NotifyAuthFriend: 通知认证好友（跨服务器）
-//   - NotifyTextChatMsg: 通知文本聊天消息（跨服务器）
+//   - NotifyTextChatMsg: 通知文本聊天消息（跨服务器，异步）
 //   - GetBaseInfo: 获取用户基础信息
 // 
 // 使用场景：
 //   当需要向其他ChatServer发送消息时（如用户在不同ChatServer上时）
+//
+// 异步调用：
+//   NotifyTextChatMsg 由 CompletionQueue 发起，立即返回，结果在完成队列线程上回调，
+//   逻辑线程和 Redis IO 线程不会因为对端慢或宕机而阻塞。
+//   每次调用带 [PeerServer] DeadlineMs 的截止时间，超时按失败回调。
+//   同一收件人的消息串行发出：上一条完成（成功、失败或超时）后才发下一条，投递顺序与发送顺序一致。
+//   排队和进行中的调用总数超过 [PeerServer] MaxPending 时直接按失败回调，不再排队。
 class ChatGrpcClient : public Singleton<ChatGrpcClient>
 {
     friend class Singleton<ChatGrpcClient>;  // 允许Singleton访问私有构造函数
@@ -136,7 +156,7 @@ class ChatGrpcClient : public Singleton<ChatGrpcClient>
 public:
     // 析构函数：清理资源
     ~ChatGrpcClient() {
-
+        Stop();
     }
 
     // 通知添加好友（当前未实现）
@@ -148,16 +168,51 @@ public:
     // 获取用户基础信息（当前未实现）
     bool GetBaseInfo(std::string base_key, int uid, std::shared_ptr<UserInfo>& userinfo);
 
-    // 通知文本聊天消息（当前未实现）
-    TextChatMsgRsp NotifyTextChatMsg(std::string server_ip, const TextChatMsgReq& req);
+    // 异步调用的完成回调，在完成队列线程上执行，不能阻塞。
+    // status 非 OK（对端不可达、超时、排队已满、已停止）时 rsp 无意义
+    using TextChatCallback = std::function<void(const Status& status, const TextChatMsgRsp& rsp)>;
+
+    // 通知文本聊天消息：异步发往 server_name 所在的 ChatServer，完成后调用 callback，线程安全
+    void NotifyTextChatMsg(const std::string& server_name, const TextChatMsgReq& req, TextChatCallback callback);
+
+    // 停止完成队列线程：不再发起新调用，排队中的调用按失败回调，等待进行中的调用完成（至多 DeadlineMs）
+    void Stop();
 
 private:
     // 私有构造函数：单例模式
     // 从配置文件中读取多个ChatServer的连接信息，为每个ChatServer创建连接池
     ChatGrpcClient();
 
+    // 一次异步调用，地址作为完成队列的 tag
+    struct TextChatCall {
+        ChatService::Stub* stub = nullptr;
+        TextChatMsgReq req;
+        TextChatMsgRsp rsp;
+        Status status;
+        TextChatCallback callback;
+        std::unique_ptr<ClientContext> context;
+        std::unique_ptr<grpc::ClientAsyncResponseReader<TextChatMsgRsp>> reader;
+    };
+
+    // 设置截止时间并发起调用，调用前持有 call_mutex_
+    void StartCall(TextChatCall& call);
+    // 完成队列线程：回调结果，再发起同一收件人的下一条
+    void PollCompletions();
+    static void Complete(TextChatCall& call);
+
     // 存储多个ChatServer的连接池（server_name -> connection_pool）
     std::unordered_map<std::string, std::unique_ptr<ChatConPool> > _pools;
+
+    std::chrono::milliseconds deadline_{ 1000 };
+    size_t max_pending_ = 10000;
+
+    grpc::CompletionQueue cq_;
+    std::thread cq_thread_;
+    std::mutex call_mutex_;
+    // 按收件人排队的调用，队首为进行中的调用
+    std::unordered_map<int, std::deque<std::unique_ptr<TextChatCall>>> calls_;
+    size_t pending_ = 0;                    // calls_ 中的调用总数
+    bool b_stop_ = false;
 };
 
 
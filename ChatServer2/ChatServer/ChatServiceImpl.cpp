@@ -105,6 +105,10 @@ Status ChatServiceImpl::NotifyTextChatMsg(ServerContext* context, const TextChat
         text_array.append(element);
     }
     rtvalue["text_array"] = text_array;
+    // 已入库的 messages.id，客户端按它确认
+    if (request->id() > 0) {
+        rtvalue["id"] = (Json::Int64)request->id();
+    }
 
     std::string return_str = rtvalue.toStyledString();
     std::cout << "[TextChat][gRPC] send TCP 1019 to uid=" << touid
@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// 线程亲和的连接缓存（MySqlPool / RedisConPool 共用）
+//
+// 作用：
+//   连接池的空闲队列由一把 mutex 保护，AsyncDBPool、逻辑线程、gRPC 线程每次取、还连接都要抢两次锁。
+//   这里给每个线程一个单连接的槽：线程归还连接时先放进自己的槽，下次取连接直接拿回，
+//   取还都只是一次原子交换，不碰池子的锁。槽里没有连接时才走池子原来的慢路径。
+//
+// 不会饿死别的线程：
+//   槽里的连接对其它线程也是可取的。池子空了的时候，等待者先登记 waiting，再 Steal 其它线程的槽；
+//   归还方放入槽后再检查 waiting，有人在等就把连接取回来放进共享队列并唤醒等待者。
+//   两边都是 seq_cst，至少有一方能看到对方，等待者不会在有空闲连接时白等到超时。
+//
+// 线程退出后它的槽还留在这里，连接由 Reclaim（池子的维护线程调用）收回。
+//
+// 所有权：槽里的 T* 由缓存持有，Take / Steal / Reclaim / Drain 取出后交给调用方；
+// 析构时仍留在槽里的连接用 Deleter 释放。
+template<typename T, typename Deleter = std::default_delete<T>>
+class ConnAffinity {
+public:
+    ConnAffinity() : id_(NextId()) {}
+
+    ~ConnAffinity() {
+        Drain(Deleter());
+    }
+
+    ConnAffinity(const ConnAffinity&) = delete;
+    ConnAffinity& operator=(const ConnAffinity&) = delete;
+
+    // 取本线程槽中的连接，没有返回 nullptr
+    T* TakeLocal() {
+        T* item = LocalSlot()->item.exchange(nullptr);
+        if (item) --parked_;
+        return item;
+    }
+
+    // 放入本线程槽，槽已被占用返回 false（调用方改还给共享队列）
+    bool ParkLocal(T* item) {
+        // 先计数再放入，其它线程取走后的 -- 不会让计数短暂下溢
+        ++parked_;
+        T* expected = nullptr;
+        if (!LocalSlot()->item.compare_exchange_strong(expected, item)) {
+            --parked_;
+            return false;
+        }
+        return true;
+    }
+
+    // 从任意线程的槽里取一个连接，没有返回 nullptr
+    T* Steal() {
+        if (parked_.load() == 0) return nullptr;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& slot : slots_) {
+            T* item = slot->item.exchange(nullptr);
+            if (item) {
+                --parked_;
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
+    // 收回槽中的连接：所属线程已退出，或 pred(item) 为 true（如闲置过久）时交给 out 处理，
+    // 其余尽量放回原槽。同时清理已退出线程的空槽
+    template<typename Pred, typename Out>
+    void Reclaim(Pred pred, Out out) {
+        std::vector<T*> taken;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto iter = slots_.begin(); iter != slots_.end();) {
+                auto& slot = *iter;
+                bool dead = slot.use_count() == 1;
+                T* item = slot->item.exchange(nullptr);
+                if (item) {
+                    T* expected = nullptr;
+                    if (dead || pred(item) || !slot->item.compare_exchange_strong(expected, item)) {
+                        --parked_;
+                        taken.push_back(item);
+                    }
+                }
+                if (dead && !slot->item.load()) {
+                    iter = slots_.erase(iter);
+                }
+                else {
+                    ++iter;
+                }
+            }
+        }
+        for (T* item : taken) out(item);
+    }
+
+    // 取出所有槽中的连接（关闭连接池时使用）
+    template<typename Out>
+    void Drain(Out out) {
+        std::vector<T*> taken;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& slot : slots_) {
+                T* item = slot->item.exchange(nullptr);
+                if (item) {
+                    --parked_;
+                    taken.push_back(item);
+                }
+            }
+        }
+        for (T* item : taken) out(item);
+    }
+
+    // 槽中的连接数（近似值）
+    size_t Parked() const { return parked_.load(); }
+
+private:
+    struct Slot {
+        std::atomic<T*> item{ nullptr };
+    };
+
+    // 本线程在这个缓存上的槽，首次使用时登记
+    Slot* LocalSlot() {
+        thread_local std::vector<std::pair<uint64_t, std::shared_ptr<Slot>>> local;
+        for (auto& entry : local) {
+            if (entry.first == id_) return entry.second.get();
+        }
+        auto slot = std::make_shared<Slot>();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_.push_back(slot);
+        }
+        local.emplace_back(id_, slot);
+        return slot.get();
+    }
+
+    static uint64_t NextId() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next++;
+    }
+
+    const uint64_t id_;             // 区分不同的池（线程本地表按它查找，不用可能被复用的地址）
+    std::mutex mutex_;              // 保护 slots_ 的登记和遍历，快路径不使用
+    std::vector<std::shared_ptr<Slot>> slots_;
+    std::atomic<size_t> parked_{ 0 };
+};
@@ -0,0 +1,406 @@
+#include "MsgArchive.h"
+#include "MysqlMgr.h"
+#include "MsgCodec.h"
+#include "ConfigMgr.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+#include <boost/crc.hpp>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 读取 [MsgArchive] 下的整数配置，缺省或非法时返回默认值
+long long ReadArchiveCfg(const std::string& key, long long def) {
+    try { return std::stoll(ConfigMgr::Inst()["MsgArchive"][key]); }
+    catch (...) { return def; }
+}
+
+bool SyncFile(std::FILE* fp) {
+    if (std::fflush(fp) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+template<typename T>
+void Put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+bool Get(const std::string& in, size_t& pos, T& value) {
+    if (in.size() - pos < sizeof(value)) return false;
+    std::memcpy(&value, in.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+uint32_t Checksum(const std::string& data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+// 每个数据块解压后的目标大小：读一页历史只需解压一块
+constexpr size_t BLOCK_TARGET_BYTES = 256 * 1024;
+
+}
+
+MsgArchive::MsgArchive()
+    : b_job_(false), days_(30), interval_(600), batch_rows_(2000), users_per_query_(500),
+      b_stop_(false), b_started_(false) {
+}
+
+MsgArchive::~MsgArchive() {
+    Stop();
+}
+
+void MsgArchive::Init() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (b_started_) return;
+
+    dir_ = ConfigMgr::Inst()["MsgArchive"]["Dir"];
+    b_job_ = ReadArchiveCfg("Job", 0) == 1;
+    days_ = static_cast<int>(std::max(1LL, ReadArchiveCfg("Days", 30)));
+    interval_ = std::chrono::seconds(std::max(1LL, ReadArchiveCfg("IntervalSec", 600)));
+    batch_rows_ = static_cast<int>(std::max(1LL, ReadArchiveCfg("BatchRows", 2000)));
+    users_per_query_ = static_cast<int>(std::max(1LL, ReadArchiveCfg("UsersPerQuery", 500)));
+
+    if (dir_.empty()) {
+        std::cout << "[MsgArchive] disabled" << std::endl;
+        return;
+    }
+    std::cout << "[MsgArchive] dir=" << dir_ << " job=" << std::boolalpha << b_job_ << " days=" << days_
+        << " interval_sec=" << interval_.count() << " batch_rows=" << batch_rows_ << std::endl;
+    if (!b_job_) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (ec) {
+        std::cerr << "[MsgArchive] cannot create " << dir_ << ": " << ec.message() << ", job not started" << std::endl;
+        return;
+    }
+    b_stop_ = false;
+    b_started_ = true;
+    worker_ = std::thread(&MsgArchive::Run, this);
+}
+
+void MsgArchive::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!b_started_) return;
+        b_stop_ = true;
+        b_started_ = false;
+    }
+    cond_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    std::cout << "[MsgArchive] stopped" << std::endl;
+}
+
+void MsgArchive::Run() {
+    while (!b_stop_) {
+        auto start = std::chrono::steady_clock::now();
+        size_t archived = RunRound();
+        auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "[MsgArchive] round done, archived=" << archived << " cost_ms=" << cost.count() << std::endl;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait_for(lock, interval_, [this] { return b_stop_.load(); });
+    }
+}
+
+size_t MsgArchive::RunRound() {
+    auto mysql = MysqlMgr::GetInstance();
+    long long cutoff = static_cast<long long>(std::time(nullptr)) - static_cast<long long>(days_) * 86400;
+    size_t archived = 0;
+
+    for (size_t shard = 0; shard < mysql->MsgShardCount() && !b_stop_; ++shard) {
+        int after_uid = 0;
+        std::vector<std::pair<int, long long>> cursors;
+        while (!b_stop_) {
+            if (!mysql->GetReadCursors(shard, after_uid, users_per_query_, cursors)) {
+                std::cerr << "[MsgArchive] failed to list read cursors, shard=" << shard << std::endl;
+                break;
+            }
+            for (const auto& cursor : cursors) {
+                if (b_stop_) break;
+                archived += ArchiveUser(cursor.first, cursor.second, cutoff);
+            }
+            if ((int)cursors.size() < users_per_query_) break;
+            after_uid = cursors.back().first;
+        }
+    }
+    return archived;
+}
+
+// 归档一个用户
+//
+// 实现逻辑：
+//   1. 按 id 升序取已读消息，只保留早于 cutoff 的前缀（同一用户的 id 随时间递增，遇到新消息即停）
+//   2. 按月份、按 BLOCK_TARGET_BYTES 切块写入归档
+//   3. 全部写入成功后删除表中 id <= 最后一条的行
+//   4. 整批都满足条件时继续下一批
+size_t MsgArchive::ArchiveUser(int uid, long long readCursor, long long cutoff) {
+    auto mysql = MysqlMgr::GetInstance();
+    size_t archived = 0;
+    std::vector<StoredChatMsg> rows;
+
+    while (!b_stop_ && readCursor > 0) {
+        if (!mysql->GetStoredChatMessages(uid, readCursor, batch_rows_, rows)) {
+            break;
+        }
+        size_t keep = 0;
+        while (keep < rows.size() && rows[keep]._create_time < cutoff) ++keep;
+        if (keep == 0) break;
+
+        bool ok = true;
+        size_t begin = 0;
+        while (ok && begin < keep) {
+            int month = MonthOf(rows[begin]._create_time);
+            size_t end = begin;
+            size_t bytes = 0;
+            while (end < keep && MonthOf(rows[end]._create_time) == month
+                && (end == begin || bytes + rows[end]._blob.size() <= BLOCK_TARGET_BYTES)) {
+                bytes += rows[end]._blob.size();
+                ++end;
+            }
+            std::vector<StoredChatMsg> block(std::make_move_iterator(rows.begin() + begin),
+                std::make_move_iterator(rows.begin() + end));
+            ok = AppendBlock(uid, month, block);
+            begin = end;
+        }
+        if (!ok) {
+            std::cerr << "[MsgArchive] failed to write archive, uid=" << uid << std::endl;
+            break;
+        }
+
+        long long last_id = rows[keep - 1]._id;
+        if (mysql->DeleteChatMessagesUpTo(uid, last_id) < 0) {
+            // 下一轮会重新归档这批消息，读取时按 id 去重
+            break;
+        }
+        archived += keep;
+        if (keep < rows.size() || (int)rows.size() < batch_rows_) break;
+    }
+    return archived;
+}
+
+bool MsgArchive::AppendBlock(int uid, int month, const std::vector<StoredChatMsg>& rows) {
+    if (rows.empty()) return true;
+
+    std::string raw;
+    for (const auto& row : rows) {
+        Put<int64_t>(raw, row._id);
+        Put<int32_t>(raw, row._from_uid);
+        Put<int64_t>(raw, row._create_time);
+        Put<uint8_t>(raw, static_cast<uint8_t>(row._codec));
+        Put<uint32_t>(raw, static_cast<uint32_t>(row._blob.size()));
+        raw.append(row._blob);
+    }
+    if (raw.size() > MAX_BLOCK_BYTES) {
+        std::cerr << "[MsgArchive] block too large, uid=" << uid << " bytes=" << raw.size() << std::endl;
+        return false;
+    }
+
+    std::string zipped(compressBound(static_cast<uLong>(raw.size())), '\0');
+    uLongf zipped_len = static_cast<uLongf>(zipped.size());
+    if (compress2(reinterpret_cast<Bytef*>(&zipped[0]), &zipped_len,
+        reinterpret_cast<const Bytef*>(raw.data()), static_cast<uLong>(raw.size()), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    zipped.resize(zipped_len);
+
+    namespace fs = std::filesystem;
+    std::lock_guard<std::mutex> lock(UserLock(uid));
+    std::string dir = UserDir(uid);
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) return false;
+    std::string base = dir + "/" + std::to_string(month);
+    std::string seg_path = base + ".seg";
+    std::string idx_path = base + ".idx";
+
+    // 上次崩溃留下的半条索引记录
+    auto idx_size = fs::exists(idx_path, ec) ? fs::file_size(idx_path, ec) : 0;
+    if (ec) return false;
+    if (idx_size % sizeof(IndexEntry) != 0) {
+        fs::resize_file(idx_path, idx_size - idx_size % sizeof(IndexEntry), ec);
+        if (ec) return false;
+    }
+
+    IndexEntry entry{};
+    entry.first_id = rows.front()._id;
+    entry.last_id = rows.back()._id;
+    entry.length = static_cast<uint32_t>(zipped.size());
+    entry.raw_length = static_cast<uint32_t>(raw.size());
+    entry.count = static_cast<uint32_t>(rows.size());
+    entry.crc = Checksum(zipped);
+
+    std::FILE* seg = std::fopen(seg_path.c_str(), "ab");
+    if (!seg) return false;
+    std::fseek(seg, 0, SEEK_END);
+    long offset = std::ftell(seg);
+    bool ok = offset >= 0
+        && std::fwrite(zipped.data(), 1, zipped.size(), seg) == zipped.size()
+        && SyncFile(seg);
+    std::fclose(seg);
+    if (!ok) return false;
+    entry.offset = static_cast<uint64_t>(offset);
+
+    std::FILE* idx = std::fopen(idx_path.c_str(), "ab");
+    if (!idx) return false;
+    ok = std::fwrite(&entry, sizeof(entry), 1, idx) == 1 && SyncFile(idx);
+    std::fclose(idx);
+    return ok;
+}
+
+bool MsgArchive::ReadHistory(int uid, long long before_id, int limit, ChatMsgPage& page) {
+    if (limit <= 0 || dir_.empty()) return true;
+    if (before_id <= 0) before_id = std::numeric_limits<long long>::max();
+
+    namespace fs = std::filesystem;
+    std::lock_guard<std::mutex> lock(UserLock(uid));
+    std::string dir = UserDir(uid);
+    std::error_code ec;
+    if (!fs::exists(dir, ec)) return true;
+
+    // 月份从新到旧；同一用户的 id 随时间递增，新月份的 id 都更大
+    std::vector<int> months;
+    for (const auto& item : fs::directory_iterator(dir, ec)) {
+        if (item.path().extension() != ".idx") continue;
+        try { months.push_back(std::stoi(item.path().stem().string())); }
+        catch (...) {}
+    }
+    if (ec) {
+        std::cerr << "[MsgArchive] cannot list " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    std::sort(months.rbegin(), months.rend());
+
+    // id -> 消息，降序；重复归档的消息在这里去重
+    std::map<long long, StoredChatMsg, std::greater<long long>> found;
+    for (int month : months) {
+        std::string base = dir + "/" + std::to_string(month);
+        std::vector<IndexEntry> entries;
+        if (!LoadIndex(base + ".idx", entries)) return false;
+
+        for (auto it = entries.rbegin(); it != entries.rend() && (int)found.size() < limit; ++it) {
+            if (it->first_id >= before_id) continue;
+            std::vector<StoredChatMsg> rows;
+            if (!ReadBlock(base + ".seg", *it, rows)) {
+                std::cerr << "[MsgArchive] corrupt block uid=" << uid << " month=" << month
+                    << " offset=" << it->offset << std::endl;
+                return false;
+            }
+            for (auto& row : rows) {
+                if (row._id < before_id) found.emplace(row._id, std::move(row));
+            }
+        }
+        if ((int)found.size() >= limit) break;
+    }
+
+    auto codec = MsgCodec::GetInstance();
+    int count = 0;
+    for (const auto& item : found) {
+        if (count++ >= limit) break;
+        std::string payload;
+        if (!codec->Decode(item.second._codec, item.second._blob, item.second._from_uid, uid, payload)) {
+            std::cerr << "[MsgArchive] failed to decode message id=" << item.first
+                << " codec=" << item.second._codec << std::endl;
+        }
+        page.ids.push_back(item.first);
+        page.payloads.push_back(std::move(payload));
+    }
+    return true;
+}
+
+bool MsgArchive::LoadIndex(const std::string& path, std::vector<IndexEntry>& entries) const {
+    entries.clear();
+    std::FILE* fp = std::fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    IndexEntry entry;
+    // 尾部不完整的记录（写入中或崩溃残留）不读
+    while (std::fread(&entry, sizeof(entry), 1, fp) == 1) {
+        entries.push_back(entry);
+    }
+    bool ok = std::ferror(fp) == 0;
+    std::fclose(fp);
+    return ok;
+}
+
+bool MsgArchive::ReadBlock(const std::string& path, const IndexEntry& entry, std::vector<StoredChatMsg>& rows) const {
+    rows.clear();
+    if (entry.length == 0 || entry.raw_length > MAX_BLOCK_BYTES) return false;
+
+    std::FILE* fp = std::fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    std::string zipped(entry.length, '\0');
+    bool ok = std::fseek(fp, static_cast<long>(entry.offset), SEEK_SET) == 0
+        && std::fread(&zipped[0], 1, zipped.size(), fp) == zipped.size();
+    std::fclose(fp);
+    if (!ok || Checksum(zipped) != entry.crc) return false;
+
+    std::string raw(entry.raw_length, '\0');
+    uLongf raw_len = static_cast<uLongf>(raw.size());
+    if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &raw_len,
+        reinterpret_cast<const Bytef*>(zipped.data()), static_cast<uLong>(zipped.size())) != Z_OK
+        || raw_len != raw.size()) {
+        return false;
+    }
+
+    size_t pos = 0;
+    rows.reserve(entry.count);
+    while (pos < raw.size()) {
+        StoredChatMsg row;
+        int64_t id = 0;
+        int32_t from_uid = 0;
+        int64_t ts = 0;
+        uint8_t codec = 0;
+        uint32_t len = 0;
+        if (!Get(raw, pos, id) || !Get(raw, pos, from_uid) || !Get(raw, pos, ts)
+            || !Get(raw, pos, codec) || !Get(raw, pos, len) || raw.size() - pos < len) {
+            return false;
+        }
+        row._id = id;
+        row._from_uid = from_uid;
+        row._create_time = ts;
+        row._codec = codec;
+        row._blob.assign(raw, pos, len);
+        pos += len;
+        rows.push_back(std::move(row));
+    }
+    return rows.size() == entry.count;
+}
+
+std::string MsgArchive::UserDir(int uid) const {
+    return dir_ + "/" + std::to_string(static_cast<unsigned int>(uid) % 1000) + "/" + std::to_string(uid);
+}
+
+std::mutex& MsgArchive::UserLock(int uid) {
+    return user_locks_[static_cast<unsigned int>(uid) % (sizeof(user_locks_) / sizeof(user_locks_[0]))];
+}
+
+// unix 秒 -> yyyymm（UTC）
+int MsgArchive::MonthOf(long long unixSec) {
+    std::time_t t = static_cast<std::time_t>(unixSec);
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    return (tm.tm_year + 1900) * 100 + tm.tm_mon + 1;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include "Singleton.h"
+#include "data.h"
+
+// 已读消息冷归档
+//
+// 作用：
+//   已确认的消息原先一直留在 messages 表里做历史，表和 (to_uid, id) 索引只增不减，
+//   未读查询用到的热数据被越挤越少。归档任务把每个用户已读（id <= 已读游标）且早于 Days 天的消息
+//   按用户、按月写入压缩分段文件，再从 messages 表删除，表里只剩未读和近期消息。
+//   历史分页（MysqlMgr::GetChatHistoryPage）先查表，不足一页再从归档补齐。
+//
+// 文件布局（Dir 目录下）：
+//   <uid % 1000>/<uid>/<yyyymm>.seg   数据块依次追加，每块是一批消息的 zlib 压缩结果
+//   <uid % 1000>/<uid>/<yyyymm>.idx   稀疏索引，每块一条定长记录：首尾 id、偏移、长度、crc
+//   消息保持 messages 表中的存储格式（codec + payload），读出时由 MsgCodec 还原。
+//
+// 崩溃安全：
+//   先写数据块并 fsync，再追加索引并 fsync，最后删表中的行。
+//   段尾没有索引指向的半块数据会被忽略；索引尾部的半条记录在下次追加前截掉。
+//   写完归档、删行之前崩溃，下一轮会把同一批消息再归档一次，读取时按 id 去重。
+//
+// 部署：
+//   Dir 需是各 ChatServer 都能读到的共享目录；Job 只在其中一台上开启。
+//   归档中的 id 保持入库时的值，重新分片（tools/reshard_messages.py 会改写 id）前应先把归档跑空或停掉。
+//
+// 配置（config.ini）：
+//   [MsgArchive]
+//   Dir = archive           // 为空表示没有归档，历史只查 messages 表
+//   Job = 0                 // 1 表示本服务运行归档任务
+//   Days = 30               // 只归档早于这么多天的已读消息
+//   IntervalSec = 600       // 两轮归档的间隔
+//   BatchRows = 2000        // 每个用户每次最多搬运的条数
+//   UsersPerQuery = 500     // 每次从游标表取的用户数
+class MsgArchive : public Singleton<MsgArchive> {
+    friend class Singleton<MsgArchive>;
+public:
+    ~MsgArchive();
+
+    // 读取 [MsgArchive] 配置；Job = 1 时启动归档线程
+    void Init();
+
+    // 停止归档线程，当前用户搬完后退出
+    void Stop();
+
+    bool Enabled() const { return !dir_.empty(); }
+
+    // 从归档读取 uid 的 id < before_id 的最多 limit 条消息，按 id 降序追加到 page；
+    // before_id <= 0 表示从最新开始。线程安全
+    bool ReadHistory(int uid, long long before_id, int limit, ChatMsgPage& page);
+
+private:
+    MsgArchive();
+
+    // 索引记录，定长，按追加顺序排列
+    struct IndexEntry {
+        int64_t first_id;
+        int64_t last_id;
+        uint64_t offset;        // 数据块在 .seg 中的偏移
+        uint32_t length;        // 压缩后长度
+        uint32_t raw_length;    // 解压后长度
+        uint32_t count;
+        uint32_t crc;           // 压缩数据的 crc32
+    };
+
+    void Run();
+    // 遍历所有分片的已读游标，返回本轮归档条数
+    size_t RunRound();
+    // 归档一个用户，返回归档条数
+    size_t ArchiveUser(int uid, long long readCursor, long long cutoff);
+
+    bool AppendBlock(int uid, int month, const std::vector<StoredChatMsg>& rows);
+    bool LoadIndex(const std::string& path, std::vector<IndexEntry>& entries) const;
+    bool ReadBlock(const std::string& path, const IndexEntry& entry, std::vector<StoredChatMsg>& rows) const;
+
+    std::string UserDir(int uid) const;
+    std::mutex& UserLock(int uid);
+    static int MonthOf(long long unixSec);
+
+    std::string dir_;
+    bool b_job_;
+    int days_;
+    std::chrono::seconds interval_;
+    int batch_rows_;
+    int users_per_query_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<bool> b_stop_;
+    bool b_started_;
+
+    // 同一用户的归档写入与读取互斥
+    std::mutex user_locks_[64];
+
+    static constexpr uint32_t MAX_BLOCK_BYTES = 64 * 1024 * 1024;
+};
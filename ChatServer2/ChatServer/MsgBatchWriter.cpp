@@ -0,0 +1,166 @@
+#include "MsgBatchWriter.h"
+#include "MysqlMgr.h"
+#include "OfflineInbox.h"
+#include "ConfigMgr.h"
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+
+MsgBatchWriter::MsgBatchWriter()
+    : b_stop_(false), b_started_(false),
+      max_rows_(DEFAULT_MAX_ROWS), max_delay_(DEFAULT_MAX_DELAY_MS) {
+}
+
+MsgBatchWriter::~MsgBatchWriter() {
+    Stop();
+}
+
+// 启动刷盘线程
+//
+// 配置示例（config.ini）：
+//   [MsgBatch]
+//   MaxRows = 200
+//   MaxDelayMs = 5
+void MsgBatchWriter::Init(int maxRows, int maxDelayMs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (b_started_) return; // 避免重复初始化
+
+    auto& cfg = ConfigMgr::Inst();
+    if (maxRows <= 0) {
+        try { maxRows = std::stoi(cfg["MsgBatch"]["MaxRows"]); }
+        catch (...) { maxRows = DEFAULT_MAX_ROWS; }
+    }
+    if (maxDelayMs < 0) {
+        try { maxDelayMs = std::stoi(cfg["MsgBatch"]["MaxDelayMs"]); }
+        catch (...) { maxDelayMs = DEFAULT_MAX_DELAY_MS; }
+    }
+    max_rows_ = maxRows > 0 ? static_cast<size_t>(maxRows) : DEFAULT_MAX_ROWS;
+    max_delay_ = std::chrono::milliseconds(maxDelayMs >= 0 ? maxDelayMs : DEFAULT_MAX_DELAY_MS);
+    pending_.reserve(max_rows_);
+
+    b_stop_ = false;
+    b_started_ = true;
+    worker_ = std::thread(&MsgBatchWriter::Run, this);
+
+    std::cout << "[MsgBatchWriter] started, max_rows=" << max_rows_
+        << " max_delay_ms=" << max_delay_.count() << std::endl;
+}
+
+void MsgBatchWriter::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!b_started_) return;
+        b_stop_ = true;
+        b_started_ = false;
+    }
+    cond_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    std::cout << "[MsgBatchWriter] stopped" << std::endl;
+}
+
+std::future<bool> MsgBatchWriter::Submit(int fromUid, int toUid, std::string payload, Callback cb) {
+    PendingMsg msg{ ChatMsgRecord(fromUid, toUid, std::move(payload)), std::promise<bool>(), std::move(cb) };
+    auto fut = msg.done.get_future();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (b_started_) {
+            if (pending_.empty()) {
+                first_enqueue_ = std::chrono::steady_clock::now();
+            }
+            pending_.push_back(std::move(msg));
+            // 第一条消息唤醒攒批计时；攒满一批时提前唤醒
+            if (pending_.size() == 1 || pending_.size() >= max_rows_) {
+                cond_.notify_one();
+            }
+            return fut;
+        }
+    }
+
+    // 未启动或已停止：直接按失败通知，不在调用方（逻辑线程）上同步写库；发送方收到失败回包后重发
+    std::cerr << "[MsgBatchWriter] not running, reject message from_uid=" << fromUid << " to_uid=" << toUid << std::endl;
+    msg.done.set_value(false);
+    if (msg.cb) {
+        try {
+            msg.cb(false, 0);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MsgBatchWriter] callback exception: " << e.what() << std::endl;
+        }
+    }
+    return fut;
+}
+
+// 刷盘线程
+//
+// 实现逻辑：
+//   1. 队列为空时等待第一条消息
+//   2. 从第一条消息入队开始计时，等到 满 max_rows_ / 超过 max_delay_ / 停止 三者之一
+//   3. 取出最多 max_rows_ 条，释放锁后写库
+//   4. 停止时把剩余消息全部写完再退出
+void MsgBatchWriter::Run() {
+    for (;;) {
+        std::vector<PendingMsg> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return b_stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return; // b_stop_ 且已写完
+            }
+
+            cond_.wait_until(lock, first_enqueue_ + max_delay_,
+                [this] { return b_stop_ || pending_.size() >= max_rows_; });
+
+            if (pending_.size() <= max_rows_) {
+                batch.swap(pending_);
+                pending_.reserve(max_rows_);
+            }
+            else {
+                batch.reserve(max_rows_);
+                std::move(pending_.begin(), pending_.begin() + max_rows_, std::back_inserter(batch));
+                pending_.erase(pending_.begin(), pending_.begin() + max_rows_);
+                // 剩余部分已经等过一轮，不再额外延迟
+                first_enqueue_ = std::chrono::steady_clock::now() - max_delay_;
+            }
+        }
+        Flush(batch);
+    }
+}
+
+void MsgBatchWriter::Flush(std::vector<PendingMsg>& batch) {
+    if (batch.empty()) return;
+
+    std::vector<ChatMsgRecord> records;
+    records.reserve(batch.size());
+    for (auto& msg : batch) {
+        records.push_back(msg.record);
+    }
+
+    // 写库前后通知离线收件箱：标记进行中的写入，成功后写热层并推进未读水位
+    std::string ticket = OfflineInbox::GetInstance()->BeginWrite(records);
+    bool ok = MysqlMgr::GetInstance()->SaveChatMessages(records);
+    if (!ok) {
+        // 失败时连接已被标记为坏连接并替换，重试一次，只重写 _id 仍为 0 的记录（失败的分片）。
+        // 首次写入时 records 已分配去重键，上一次实际已提交时重试只会查回已有的 id，不会重复入库
+        std::cerr << "[MsgBatchWriter] batch insert failed, retry once, size=" << records.size() << std::endl;
+        MysqlMgr::GetInstance()->SaveChatMessages(records);
+    }
+    OfflineInbox::GetInstance()->EndWrite(records, ticket);
+
+    // 按条回调：分片部分失败时，已入库的消息照常回 ACK
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto& msg = batch[i];
+        bool saved = records[i]._id > 0;
+        msg.done.set_value(saved);
+        if (!msg.cb) continue;
+        try {
+            msg.cb(saved, records[i]._id);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MsgBatchWriter] callback exception: " << e.what() << std::endl;
+        }
+        catch (...) {
+            std::cerr << "[MsgBatchWriter] callback unknown exception" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,574 @@
+#include "MsgJournal.h"
+#include "MysqlMgr.h"
+#include "OfflineInbox.h"
+#include "MsgCodec.h"
+#include "ConfigMgr.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <limits>
+#include <cctype>
+#include <random>
+#include <boost/crc.hpp>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 读取 [MsgJournal] 下的整数配置，缺省或非法时返回默认值
+long long ReadJournalCfg(const std::string& key, long long def) {
+    try { return std::stoll(ConfigMgr::Inst()["MsgJournal"][key]); }
+    catch (...) { return def; }
+}
+
+// 把用户态缓冲和内核页缓存都刷到磁盘
+bool SyncFile(std::FILE* fp) {
+    if (std::fflush(fp) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+// seg_00000000000000000001.log -> 1
+bool ParseSegmentName(const std::string& name, uint64_t& seg) {
+    const std::string prefix = "seg_";
+    const std::string suffix = ".log";
+    if (name.size() <= prefix.size() + suffix.size()) return false;
+    if (name.compare(0, prefix.size(), prefix) != 0) return false;
+    if (name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) return false;
+    std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    if (!std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c) != 0; })) return false;
+    try { seg = std::stoull(digits); }
+    catch (...) { return false; }
+    return true;
+}
+
+}
+
+MsgJournal::MsgJournal()
+    : b_stop_(false), b_started_(false),
+      active_file_(nullptr), active_segment_(0), active_size_(0),
+      durable_segment_(0), durable_offset_(0), b_ship_stop_(false),
+      index_(nullptr),
+      segment_bytes_(64ull * 1024 * 1024), fsync_interval_(2),
+      max_batch_(512), ship_batch_(500), retry_interval_(1000) {
+}
+
+MsgJournal::~MsgJournal() {
+    Stop();
+}
+
+// 启动日志
+//
+// 实现逻辑：
+//   1. 打开（或创建）mmap 映射的投递进度
+//   2. 删除早于投递进度的分段，其余分段留给投递线程从进度处重放
+//   3. 新消息总是写到一个新段，不接在可能残缺的旧段尾部
+//   4. 启动写入线程和投递线程
+void MsgJournal::Init() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (b_started_) return; // 避免重复初始化
+
+    if (ReadJournalCfg("Enable", 0) != 1) {
+        std::cout << "[MsgJournal] disabled" << std::endl;
+        return;
+    }
+
+    // 同一台机器上的多个 ChatServer 必须使用不同目录，未配置时按服务名区分
+    dir_ = ConfigMgr::Inst()["MsgJournal"]["Dir"];
+    if (dir_.empty()) dir_ = "journal_" + ConfigMgr::Inst()["SelfServer"]["Name"];
+    segment_bytes_ = static_cast<uint64_t>(std::max(1LL, ReadJournalCfg("SegmentMB", 64))) * 1024 * 1024;
+    fsync_interval_ = std::chrono::milliseconds(std::max(0LL, ReadJournalCfg("FsyncIntervalMs", 2)));
+    max_batch_ = static_cast<size_t>(std::max(1LL, ReadJournalCfg("MaxBatch", 512)));
+    ship_batch_ = static_cast<size_t>(std::max(1LL, ReadJournalCfg("ShipBatch", 500)));
+    retry_interval_ = std::chrono::milliseconds(std::max(10LL, ReadJournalCfg("RetryMs", 1000)));
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) {
+        std::cerr << "[MsgJournal] create dir " << dir_ << " failed: " << ec.message() << std::endl;
+        return;
+    }
+    if (!OpenIndex() || !LoadJournalId()) {
+        return;
+    }
+
+    uint64_t last_seg = index_->shipped_segment;
+    size_t replay_segments = 0;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        uint64_t seg = 0;
+        if (!ParseSegmentName(entry.path().filename().string(), seg)) continue;
+        if (seg < index_->shipped_segment) {
+            fs::remove(entry.path(), ec);
+            continue;
+        }
+        last_seg = std::max(last_seg, seg);
+        ++replay_segments;
+    }
+
+    if (!OpenSegment(last_seg + 1)) {
+        return;
+    }
+    durable_segment_ = active_segment_;
+    durable_offset_ = active_size_;
+    b_ship_stop_ = false;
+
+    b_stop_ = false;
+    b_started_ = true;
+    writer_ = std::thread(&MsgJournal::Run, this);
+    shipper_ = std::thread(&MsgJournal::ShipRun, this);
+
+    std::cout << "[MsgJournal] started, dir=" << dir_ << " segment=" << active_segment_
+        << " replay_segments=" << replay_segments
+        << " shipped=" << index_->shipped_segment << ":" << index_->shipped_offset
+        << " fsync_interval_ms=" << fsync_interval_.count() << std::endl;
+}
+
+void MsgJournal::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!b_started_ || b_stop_) return;
+        b_stop_ = true;
+    }
+    cond_.notify_all();
+    if (writer_.joinable()) writer_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(ship_mutex_);
+        b_ship_stop_ = true;
+    }
+    ship_cond_.notify_all();
+    if (shipper_.joinable()) shipper_.join();
+
+    CloseSegment();
+    if (index_) {
+        index_region_.flush(0, sizeof(IndexData), false);
+    }
+    b_started_ = false;
+    std::cout << "[MsgJournal] stopped, appended=" << appended_ << " shipped=" << shipped_ << std::endl;
+}
+
+void MsgJournal::Append(int fromUid, int toUid, std::string payload, Callback cb, StoredCallback stored) {
+    PendingRecord rec{ ChatMsgRecord(fromUid, toUid, std::move(payload)), std::move(cb), std::move(stored) };
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (b_started_ && !b_stop_) {
+            if (pending_.empty()) {
+                first_enqueue_ = std::chrono::steady_clock::now();
+            }
+            pending_.push_back(std::move(rec));
+            if (pending_.size() == 1 || pending_.size() >= max_batch_) {
+                cond_.notify_one();
+            }
+            return;
+        }
+    }
+
+    // 未启动或正在停止：直接按失败通知，不在调用方（逻辑线程）上同步写库；发送方收到失败回包后重发
+    std::cerr << "[MsgJournal] not running, reject message from_uid=" << fromUid << " to_uid=" << toUid << std::endl;
+    if (rec.cb) {
+        try {
+            rec.cb(false);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MsgJournal] callback exception: " << e.what() << std::endl;
+        }
+    }
+}
+
+// 写入线程：攒满 MaxBatch 条或等待 FsyncIntervalMs 后写入一批，一次 fsync 后统一回调
+void MsgJournal::Run() {
+    for (;;) {
+        std::vector<PendingRecord> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return b_stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return; // b_stop_ 且已写完
+            }
+            cond_.wait_until(lock, first_enqueue_ + fsync_interval_,
+                [this] { return b_stop_ || pending_.size() >= max_batch_; });
+            batch.swap(pending_);
+        }
+
+        // 写入失败时整批按失败通知，不再直接写库：fwrite 成功、只有 fsync 失败时段里可能已有这批记录，
+        // 直接写库之后投递线程会再投一次。失败的段尾由 WriteBatch 截掉，投递线程不会读到
+        std::vector<uint64_t> offsets;
+        bool ok = WriteBatch(batch, offsets);
+        if (ok) {
+            appended_ += batch.size();
+            {
+                // 回调先于推进 fsync 位置登记，投递线程读到这些记录时一定能找到
+                std::lock_guard<std::mutex> lock(ship_mutex_);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    if (batch[i].stored) {
+                        stored_waiters_[std::make_pair(active_segment_, offsets[i])] = std::move(batch[i].stored);
+                    }
+                }
+                durable_segment_ = active_segment_;
+                durable_offset_ = active_size_;
+            }
+            ship_cond_.notify_one();
+        }
+
+        for (auto& rec : batch) {
+            if (!rec.cb) continue;
+            try {
+                rec.cb(ok);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "[MsgJournal] callback exception: " << e.what() << std::endl;
+            }
+            catch (...) {
+                std::cerr << "[MsgJournal] callback unknown exception" << std::endl;
+            }
+        }
+    }
+}
+
+bool MsgJournal::WriteBatch(const std::vector<PendingRecord>& batch, std::vector<uint64_t>& offsets) {
+    if (!active_file_ && !OpenSegment(active_segment_ + 1)) {
+        return false;
+    }
+    if (active_size_ >= segment_bytes_) {
+        uint64_t next = active_segment_ + 1;
+        CloseSegment();
+        if (!OpenSegment(next)) return false;
+    }
+
+    std::string buf;
+    offsets.clear();
+    offsets.reserve(batch.size());
+    for (const auto& rec : batch) {
+        offsets.push_back(active_size_ + buf.size());
+        RecordHeader hdr;
+        hdr.magic = RECORD_MAGIC;
+        hdr.from_uid = rec.record._from_uid;
+        hdr.to_uid = rec.record._to_uid;
+        hdr.payload_len = static_cast<uint32_t>(rec.record._payload.size());
+        hdr.crc = Checksum(hdr, rec.record._payload);
+        buf.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        buf.append(rec.record._payload);
+    }
+
+    if (std::fwrite(buf.data(), 1, buf.size(), active_file_) != buf.size() || !SyncFile(active_file_)) {
+        std::cerr << "[MsgJournal] write segment " << active_segment_ << " failed, batch=" << batch.size() << std::endl;
+        // 这批已按失败通知发送方，段里可能留下整批或半条记录：
+        // 投递线程只读到失败前的长度，同时截掉段尾，重启重放时也不会投递；后续写入换到新段
+        uint64_t seg = active_segment_;
+        uint64_t good = active_size_;
+        CloseSegment();
+        {
+            std::lock_guard<std::mutex> lock(ship_mutex_);
+            segment_ends_[seg] = good;
+        }
+        std::error_code ec;
+        std::filesystem::resize_file(SegmentPath(seg), good, ec);
+        if (ec) {
+            std::cerr << "[MsgJournal] truncate segment " << seg << " failed: " << ec.message()
+                << ", failed batch may be replayed after restart" << std::endl;
+        }
+        OpenSegment(seg + 1);
+        return false;
+    }
+    active_size_ += buf.size();
+    return true;
+}
+
+bool MsgJournal::OpenSegment(uint64_t seg) {
+    std::string path = SegmentPath(seg);
+    std::FILE* fp = std::fopen(path.c_str(), "ab");
+    if (!fp) {
+        std::cerr << "[MsgJournal] open segment " << path << " failed" << std::endl;
+        return false;
+    }
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    active_file_ = fp;
+    active_segment_ = seg;
+    active_size_ = ec ? 0 : static_cast<uint64_t>(size);
+    return true;
+}
+
+void MsgJournal::CloseSegment() {
+    if (active_file_) {
+        std::fclose(active_file_);
+        active_file_ = nullptr;
+    }
+}
+
+// 投递线程
+//
+// 实现逻辑：
+//   1. 从 journal.idx 记录的位置开始，读到已 fsync 的位置为止
+//   2. 每次最多 ShipBatch 条，用一条多行 INSERT 写入 MySQL，成功后推进进度
+//   3. 早于当前写入段的旧段读完后删除，进入下一段
+//   4. 写库失败时等待 RetryMs 后重试，只重写没入库的记录（失败的分片）；停止时追平即退出，追不平的留给下次启动重放
+//   5. 没有发送方 msgid 的记录以 "~<日志 id>-<段号>-<偏移>" 作去重键，重试、重放都得到同一个键
+void MsgJournal::ShipRun() {
+    uint64_t seg = index_->shipped_segment;
+    uint64_t offset = index_->shipped_offset;
+    unsigned long long total = index_->shipped_total;
+    std::vector<ChatMsgRecord> records;
+    std::vector<uint64_t> offsets;      // 与 records 一一对应的段内偏移
+    records.reserve(ship_batch_);
+    offsets.reserve(ship_batch_);
+    uint64_t end = offset;
+    size_t batch_size = 0;
+    bool retrying = false;  // 上一批部分写入失败，records 里留着还没入库的记录
+
+    for (;;) {
+        uint64_t durable_seg = 0;
+        uint64_t durable_off = 0;
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(ship_mutex_);
+            ship_cond_.wait(lock, [&] {
+                return b_ship_stop_ || seg < durable_segment_ || offset < durable_offset_;
+            });
+            durable_seg = durable_segment_;
+            durable_off = durable_offset_;
+            stopping = b_ship_stop_;
+        }
+
+        if (seg >= durable_seg && offset >= durable_off) {
+            if (stopping) return;
+            continue;
+        }
+
+        if (!retrying) {
+            uint64_t limit = durable_off;
+            if (seg < durable_seg) {
+                std::lock_guard<std::mutex> lock(ship_mutex_);
+                auto iter = segment_ends_.find(seg);
+                limit = iter == segment_ends_.end() ? std::numeric_limits<uint64_t>::max() : iter->second;
+            }
+            records.clear();
+            offsets.clear();
+            end = ReadRecords(seg, offset, limit, ship_batch_, records, &offsets);
+            batch_size = records.size();
+            for (size_t i = 0; i < records.size(); ++i) {
+                AssignClientMsgId(records[i], seg, offsets[i]);
+            }
+        }
+
+        if (records.empty()) {
+            if (seg < durable_seg) {
+                // 旧段已读完（段尾可能有崩溃留下的半条记录），进入下一段
+                DropWaiters(seg + 1, 0);
+                RemoveSegment(seg);
+                {
+                    std::lock_guard<std::mutex> lock(ship_mutex_);
+                    segment_ends_.erase(seg);
+                }
+                ++seg;
+                offset = 0;
+                SaveIndex(seg, offset, total);
+            }
+            else {
+                std::cerr << "[MsgJournal] corrupted record in segment " << seg << " at offset " << offset
+                    << ", skip to " << durable_off << std::endl;
+                offset = durable_off;
+                DropWaiters(seg, offset);
+                SaveIndex(seg, offset, total);
+            }
+            continue;
+        }
+
+        std::string ticket = OfflineInbox::GetInstance()->BeginWrite(records);
+        bool shipped = MysqlMgr::GetInstance()->SaveChatMessages(records);
+        OfflineInbox::GetInstance()->EndWrite(records, ticket);
+        NotifyStored(seg, offsets, records);
+        if (!shipped) {
+            // 只留下没入库的记录（失败的分片），重试时不重读日志，沿用已分配的去重键
+            size_t kept = 0;
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (records[i]._id > 0) continue;
+                records[kept] = std::move(records[i]);
+                offsets[kept] = offsets[i];
+                ++kept;
+            }
+            records.erase(records.begin() + kept, records.end());
+            offsets.resize(kept);
+            retrying = true;
+            std::cerr << "[MsgJournal] ship " << records.size() << " records failed, retry in "
+                << retry_interval_.count() << "ms" << std::endl;
+            std::unique_lock<std::mutex> lock(ship_mutex_);
+            if (ship_cond_.wait_for(lock, retry_interval_, [this] { return b_ship_stop_; })) {
+                std::cerr << "[MsgJournal] stopping with unshipped records, will replay on next start" << std::endl;
+                return;
+            }
+            continue;
+        }
+
+        retrying = false;
+        offset = end;
+        total += batch_size;
+        shipped_ += batch_size;
+        SaveIndex(seg, offset, total);
+    }
+}
+
+void MsgJournal::AssignClientMsgId(ChatMsgRecord& record, uint64_t seg, uint64_t offset) const {
+    record._client_msg_id = MsgCodec::ClientMsgId(record._payload);
+    if (!record._client_msg_id.empty()) return;
+    char key[64];
+    std::snprintf(key, sizeof(key), "~%s-%llu-%llu", journal_id_.c_str(),
+        static_cast<unsigned long long>(seg), static_cast<unsigned long long>(offset));
+    record._client_msg_id = key;
+}
+
+void MsgJournal::NotifyStored(uint64_t seg, const std::vector<uint64_t>& offsets, const std::vector<ChatMsgRecord>& records) {
+    std::vector<std::pair<StoredCallback, long long>> ready;
+    {
+        std::lock_guard<std::mutex> lock(ship_mutex_);
+        if (stored_waiters_.empty()) return;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records[i]._id <= 0) continue;
+            auto iter = stored_waiters_.find(std::make_pair(seg, offsets[i]));
+            if (iter == stored_waiters_.end()) continue;
+            ready.emplace_back(std::move(iter->second), records[i]._id);
+            stored_waiters_.erase(iter);
+        }
+    }
+    for (auto& item : ready) {
+        try {
+            item.first(item.second);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MsgJournal] stored callback exception: " << e.what() << std::endl;
+        }
+        catch (...) {
+            std::cerr << "[MsgJournal] stored callback unknown exception" << std::endl;
+        }
+    }
+}
+
+void MsgJournal::DropWaiters(uint64_t seg, uint64_t offset) {
+    std::lock_guard<std::mutex> lock(ship_mutex_);
+    stored_waiters_.erase(stored_waiters_.begin(), stored_waiters_.lower_bound(std::make_pair(seg, offset)));
+}
+
+uint64_t MsgJournal::ReadRecords(uint64_t seg, uint64_t offset, uint64_t limit, size_t max_rows,
+    std::vector<ChatMsgRecord>& out, std::vector<uint64_t>* offsets) {
+    std::ifstream in(SegmentPath(seg), std::ios::binary);
+    if (!in) return offset;
+    in.seekg(static_cast<std::streamoff>(offset));
+
+    uint64_t pos = offset;
+    std::string payload;
+    while (out.size() < max_rows && pos + sizeof(RecordHeader) <= limit) {
+        RecordHeader hdr;
+        if (!in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr))) break;
+        if (hdr.magic != RECORD_MAGIC || hdr.payload_len > MAX_PAYLOAD) break;
+        if (pos + sizeof(hdr) + hdr.payload_len > limit) break;
+        payload.resize(hdr.payload_len);
+        if (hdr.payload_len > 0 && !in.read(&payload[0], hdr.payload_len)) break;
+        if (Checksum(hdr, payload) != hdr.crc) break;
+        out.emplace_back(hdr.from_uid, hdr.to_uid, payload);
+        if (offsets) offsets->push_back(pos);
+        pos += sizeof(hdr) + hdr.payload_len;
+    }
+    return pos;
+}
+
+// 日志 id 在目录创建时生成一次，之后重启沿用，重放得到的去重键和崩溃前一致
+bool MsgJournal::LoadJournalId() {
+    std::string path = dir_ + "/journal.id";
+    {
+        std::ifstream in(path);
+        if (in >> journal_id_ && journal_id_.size() == 16
+            && std::all_of(journal_id_.begin(), journal_id_.end(), [](unsigned char c) { return std::isxdigit(c) != 0; })) {
+            return true;
+        }
+    }
+
+    // 先写临时文件再改名，崩溃时不会留下半个 id
+    std::random_device rd;
+    char id[17];
+    std::snprintf(id, sizeof(id), "%08x%08x", rd(), rd());
+    journal_id_ = id;
+    std::string tmp = path + ".tmp";
+    std::FILE* fp = std::fopen(tmp.c_str(), "wb");
+    bool ok = fp && std::fputs(id, fp) >= 0 && SyncFile(fp);
+    if (fp) std::fclose(fp);
+    std::error_code ec;
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec) {
+        std::cerr << "[MsgJournal] create " << path << " failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MsgJournal::OpenIndex() {
+    namespace bip = boost::interprocess;
+    namespace fs = std::filesystem;
+    std::string path = dir_ + "/journal.idx";
+
+    std::error_code ec;
+    if (!fs::exists(path, ec) || fs::file_size(path, ec) < sizeof(IndexData)) {
+        IndexData init{ INDEX_MAGIC, INDEX_VERSION, 0, 0, 0 };
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&init), sizeof(init));
+        if (!out) {
+            std::cerr << "[MsgJournal] create index " << path << " failed" << std::endl;
+            return false;
+        }
+    }
+
+    try {
+        index_mapping_ = bip::file_mapping(path.c_str(), bip::read_write);
+        index_region_ = bip::mapped_region(index_mapping_, bip::read_write, 0, sizeof(IndexData));
+    }
+    catch (const bip::interprocess_exception& e) {
+        std::cerr << "[MsgJournal] map index " << path << " failed: " << e.what() << std::endl;
+        return false;
+    }
+
+    index_ = static_cast<IndexData*>(index_region_.get_address());
+    if (index_->magic != INDEX_MAGIC || index_->version != INDEX_VERSION) {
+        // 进度损坏时从头重放现存的所有分段，宁可重复也不丢
+        std::cerr << "[MsgJournal] invalid index, replay all segments" << std::endl;
+        *index_ = IndexData{ INDEX_MAGIC, INDEX_VERSION, 0, 0, 0 };
+    }
+    return true;
+}
+
+// 更新投递进度
+// 换段时先把偏移清零再写段号：中途崩溃最多重放旧段，不会用旧偏移跳过新段的记录
+void MsgJournal::SaveIndex(uint64_t seg, uint64_t offset, uint64_t shipped) {
+    if (seg != index_->shipped_segment) {
+        index_->shipped_offset = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        index_->shipped_segment = seg;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    index_->shipped_offset = offset;
+    index_->shipped_total = shipped;
+    index_region_.flush(0, sizeof(IndexData), true);
+}
+
+void MsgJournal::RemoveSegment(uint64_t seg) {
+    std::error_code ec;
+    std::filesystem::remove(SegmentPath(seg), ec);
+}
+
+std::string MsgJournal::SegmentPath(uint64_t seg) const {
+    char name[48];
+    std::snprintf(name, sizeof(name), "seg_%020llu.log", static_cast<unsigned long long>(seg));
+    return dir_ + "/" + name;
+}
+
+uint32_t MsgJournal::Checksum(const RecordHeader& hdr, const std::string& payload) {
+    boost::crc_32_type crc;
+    crc.process_bytes(&hdr.from_uid, sizeof(hdr.from_uid) + sizeof(hdr.to_uid) + sizeof(hdr.payload_len));
+    crc.process_bytes(payload.data(), payload.size());
+    return crc.checksum();
+}
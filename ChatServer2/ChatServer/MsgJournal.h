@@ -0,0 +1,177 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <map>
+#include <utility>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "Singleton.h"
+#include "data.h"
+
+// 本地追加写消息日志（Write-Ahead Journal）
+//
+// 作用：
+//   开启后聊天消息先追加到本机日志文件并 fsync，随即给发送方回 ACK，
+//   再由后台投递线程按批写入 MySQL。ACK 延迟取决于本地 fsync 批次，而不是一次 DB 往返；
+//   进程在收到消息到入库之间崩溃，重启时从日志重放未投递的部分，消息不丢。
+//
+// 文件布局（Dir 目录下）：
+//   seg_00000000000000000001.log ...  分段日志，写满 SegmentMB 后切换到下一段
+//   journal.idx                       mmap 映射的投递进度（段号 + 段内偏移），投递线程每批更新一次
+//   journal.id                        本目录日志的随机 id，创建后不变，用于生成去重键
+//
+// 记录格式：
+//   RecordHeader（magic / crc32 / from_uid / to_uid / payload_len）+ payload
+//   崩溃时段尾可能留下半条记录，读取时 magic 或 crc 不符即视为该段结束。
+//
+// 语义：
+//   至少一次。一批写入 MySQL 成功后、进度落盘前崩溃，重放时这批会再写一次，
+//   入库按 (from_uid, to_uid, msgid) 去重键跳过已有的行，不会重复；老客户端没带 msgid 的记录以日志 id + 段号 + 偏移作键，
+//   重放时同样去重。消息投递到 MySQL 之前，离线拉取看不到它（通常为毫秒级）。
+//   未启动、正在停止或写日志失败时按失败回调，不退化为直接写库，发送方重发；失败的段尾被截掉，不会再投递。
+//   收件人按 messages.id 确认，所以在线投递要等投递线程写库拿到 id 之后（Append 的 stored 回调）；
+//   重启后重放的记录没有回调，收件人从收件箱拉取。
+//
+// 配置（config.ini）：
+//   [MsgJournal]
+//   Enable = 0
+//   Dir = journal_chatserver1      // 每个服务独立目录
+//   SegmentMB = 64
+//   FsyncIntervalMs = 2
+//   MaxBatch = 512
+//   ShipBatch = 500
+//   RetryMs = 1000
+class MsgJournal : public Singleton<MsgJournal> {
+    friend class Singleton<MsgJournal>;
+public:
+    using Callback = std::function<void(bool)>;
+    // 入库后以 messages.id 回调
+    using StoredCallback = std::function<void(long long)>;
+
+    ~MsgJournal();
+
+    // 读取 [MsgJournal] 配置；Enable = 1 时恢复未投递的日志并启动写入、投递线程
+    void Init();
+
+    // 停止：写完排队中的消息，尽量把日志投递完，剩余部分留给下次启动重放
+    void Stop();
+
+    bool Enabled() const { return b_started_; }
+
+    // 追加一条消息，线程安全
+    // cb 在该消息所在批次 fsync 之后于写入线程上调用，true 表示已持久化到本地日志；
+    // 未启动或正在停止时在调用线程上以 false 调用；
+    // stored 在该消息写入 MySQL 之后于投递线程上调用（本进程内没能入库时不调用），不要在里面做阻塞操作
+    void Append(int fromUid, int toUid, std::string payload, Callback cb, StoredCallback stored = nullptr);
+
+private:
+    MsgJournal();
+
+#pragma pack(push, 1)
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t crc;           // 覆盖 from_uid / to_uid / payload_len / payload
+        int32_t from_uid;
+        int32_t to_uid;
+        uint32_t payload_len;
+    };
+
+    struct IndexData {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t shipped_segment;   // 已投递到的段号
+        uint64_t shipped_offset;    // 该段内已投递到的偏移
+        uint64_t shipped_total;     // 累计投递条数（仅用于观察）
+    };
+#pragma pack(pop)
+
+    struct PendingRecord {
+        ChatMsgRecord record;
+        Callback cb;
+        StoredCallback stored;
+    };
+
+    void Run();
+    void ShipRun();
+
+    // 写入一批并 fsync，offsets 为每条记录在当前段内的起始偏移；
+    // 失败时截掉这批写入的内容并切到新段，避免后续记录接在半条记录后面
+    bool WriteBatch(const std::vector<PendingRecord>& batch, std::vector<uint64_t>& offsets);
+    bool OpenSegment(uint64_t seg);
+    void CloseSegment();
+
+    // 从 seg 的 offset 处最多读 max_rows 条、不超过 limit 字节的完整记录，返回读到的末尾偏移；
+    // offsets 不为空时追加每条记录的起始偏移
+    uint64_t ReadRecords(uint64_t seg, uint64_t offset, uint64_t limit, size_t max_rows,
+        std::vector<ChatMsgRecord>& out, std::vector<uint64_t>* offsets = nullptr);
+
+    // 投递线程：没有发送方 msgid 的记录以 "~<日志 id>-<段号>-<偏移>" 作去重键
+    void AssignClientMsgId(ChatMsgRecord& record, uint64_t seg, uint64_t offset) const;
+    // 投递线程：已入库的记录按 (段号, 偏移) 取出 stored 回调执行
+    void NotifyStored(uint64_t seg, const std::vector<uint64_t>& offsets, const std::vector<ChatMsgRecord>& records);
+    // 丢弃 (seg, offset) 之前已不会再投递的记录的回调（段尾损坏被跳过时）
+    void DropWaiters(uint64_t seg, uint64_t offset);
+
+    bool OpenIndex();
+    // 读取 journal.id，不存在时生成
+    bool LoadJournalId();
+    void SaveIndex(uint64_t seg, uint64_t offset, uint64_t shipped);
+    void RemoveSegment(uint64_t seg);
+
+    std::string SegmentPath(uint64_t seg) const;
+    static uint32_t Checksum(const RecordHeader& hdr, const std::string& payload);
+
+    // 写入线程
+    std::vector<PendingRecord> pending_;
+    std::chrono::steady_clock::time_point first_enqueue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread writer_;
+    std::atomic<bool> b_stop_;
+    std::atomic<bool> b_started_;
+
+    std::FILE* active_file_;
+    uint64_t active_segment_;
+    uint64_t active_size_;
+
+    // 已 fsync 的位置，投递线程读到这里为止
+    std::mutex ship_mutex_;
+    std::condition_variable ship_cond_;
+    std::thread shipper_;
+    uint64_t durable_segment_;
+    uint64_t durable_offset_;
+    bool b_ship_stop_;          // 写入线程退出后置位，投递线程追平后退出
+    std::map<std::pair<uint64_t, uint64_t>, StoredCallback> stored_waiters_;   // (段号, 偏移) -> 入库回调
+    std::map<uint64_t, uint64_t> segment_ends_;     // 写入失败后换掉的段 -> 失败前的长度，投递线程读到这里为止
+
+    // 投递进度
+    boost::interprocess::file_mapping index_mapping_;
+    boost::interprocess::mapped_region index_region_;
+    IndexData* index_;
+
+    std::string dir_;
+    std::string journal_id_;
+    uint64_t segment_bytes_;
+    std::chrono::milliseconds fsync_interval_;
+    size_t max_batch_;
+    size_t ship_batch_;
+    std::chrono::milliseconds retry_interval_;
+
+    std::atomic<unsigned long long> appended_{ 0 };
+    std::atomic<unsigned long long> shipped_{ 0 };
+
+    static constexpr uint32_t RECORD_MAGIC = 0x4D534A52;   // "MSJR"
+    static constexpr uint32_t INDEX_MAGIC = 0x4D534A49;    // "MSJI"
+    static constexpr uint32_t INDEX_VERSION = 1;
+    static constexpr uint32_t MAX_PAYLOAD = 1024 * 1024;
+};
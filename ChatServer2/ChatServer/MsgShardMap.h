@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include "Singleton.h"
+#include "MysqlDao.h"
+
+// messages 表按收件人 uid 水平分片
+//
+// 作用：
+//   消息写入、未读扫描、已读游标都只涉及收件人自己的数据，按 to_uid 取模路由到 N 个 MySQL 实例，
+//   写入吞吐随实例数线性扩展。每个分片各有一张 messages、user_read_cursor、user_inbox_lock 表，id 各自自增，
+//   同一用户的消息和游标总在同一分片，键集分页与游标语义不变。
+//
+// 配置（config.ini）：
+//   [MsgShard]
+//   Count = 2               // <= 1 表示不分片，消息表留在 [Mysql] 主库
+//   [MsgShard0]
+//   Host =                  // 为空表示复用 [Mysql] 主库连接池
+//   [MsgShard1]
+//   Host = 127.0.0.1
+//   Port = 3308
+//   User / Passwd / Schema / PoolMin / PoolMax 未配置时沿用 [Mysql]
+//
+// 分片数变化时需先停服，用 tools/reshard_messages.py 把用户数据搬到新分片。
+class MsgShardMap : public Singleton<MsgShardMap> {
+    friend class Singleton<MsgShardMap>;
+public:
+    // 读取 [MsgShard] 配置并初始化各分片连接池，任一分片连接失败时抛出异常
+    void Init(std::shared_ptr<MySqlPool> primary, int defaultMin, int defaultMax);
+
+    bool Enabled() const { return !shards_.empty(); }
+    size_t Count() const { return shards_.size(); }
+
+    size_t ShardOf(int uid) const {
+        return static_cast<size_t>(static_cast<unsigned int>(uid) % shards_.size());
+    }
+
+    // 收件人 uid 所在分片的连接池，调用前须确认 Enabled()
+    std::shared_ptr<MySqlPool> PoolFor(int uid) const {
+        return shards_[ShardOf(uid)];
+    }
+
+    // 第 shard 个分片的连接池，调用前须确认 Enabled() 且 shard < Count()
+    std::shared_ptr<MySqlPool> Pool(size_t shard) const {
+        return shards_[shard];
+    }
+
+private:
+    MsgShardMap() = default;
+
+    std::vector<std::shared_ptr<MySqlPool>> shards_;
+};
@@ -0,0 +1,545 @@
+#include "MysqlAsync.h"
+#include "AsioIOServicePool.h"
+#include "ConfigMgr.h"
+#include <deque>
+#include <iostream>
+#include <boost/asio.hpp>
+
+#include <mysql.h>
+#include <errmsg.h>
+
+namespace {
+    // 未能执行的查询的结果
+    MysqlResult Failure(const std::string& reason) {
+        MysqlResult result;
+        result.error = reason;
+        return result;
+    }
+
+    // 回调中的异常不能漏到 io_context::run，否则 IO 线程会退出
+    void Invoke(const MysqlAsync::Callback& callback, MysqlResult result) {
+        if (!callback) return;
+        try {
+            callback(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MysqlAsync] callback threw: " << e.what() << std::endl;
+        }
+        catch (...) {
+            std::cerr << "[MysqlAsync] callback threw unknown exception" << std::endl;
+        }
+    }
+
+    // libmysqlclient 要求调用它的每个线程先执行 mysql_thread_init，线程退出时 mysql_thread_end；
+    // strand 上的处理可能落在 IO 线程池的任意线程上
+    void EnsureThreadInit() {
+        struct ThreadInit {
+            ThreadInit() { mysql_thread_init(); }
+            ~ThreadInit() { mysql_thread_end(); }
+        };
+        thread_local ThreadInit init;
+        (void)init;
+    }
+
+    // 客户端错误（CR_*）说明连接已不可用；服务端错误（SQL 错误、锁等待超时等）只影响这一条查询
+    bool IsConnectionError(unsigned int err) {
+        return err >= CR_MIN_ERROR && err <= CR_MAX_ERROR;
+    }
+
+    constexpr std::chrono::milliseconds MIN_BACKOFF(200);
+    constexpr std::chrono::milliseconds MAX_BACKOFF(5000);
+    constexpr std::chrono::milliseconds CONNECT_POLL(5);    // 建连期间的轮询间隔
+
+#ifdef _WIN32
+    const my_socket NO_SOCKET = INVALID_SOCKET;
+#else
+    const my_socket NO_SOCKET = -1;
+#endif
+} // namespace
+
+// 一条到 MySQL 的长连接，除 Send / Stop 外的成员只在 strand_ 上访问
+class MysqlAsync::Connection : public std::enable_shared_from_this<MysqlAsync::Connection> {
+public:
+    Connection(boost::asio::io_context& ioc, std::string name, std::string host, unsigned int port,
+        std::string user, std::string pwd, std::string schema, std::chrono::milliseconds timeout, size_t maxPending)
+        : strand_(boost::asio::make_strand(ioc)), socket_(strand_), wait_timer_(strand_),
+          reconnect_timer_(strand_), tick_timer_(strand_),
+          name_(std::move(name)), host_(std::move(host)), port_(port), user_(std::move(user)),
+          pwd_(std::move(pwd)), schema_(std::move(schema)),
+          timeout_(timeout), max_pending_(maxPending), backoff_(MIN_BACKOFF) {
+    }
+
+    ~Connection() {
+        EnsureThreadInit();
+        Close();
+    }
+
+    void Start() {
+        boost::asio::post(strand_, [self = shared_from_this()]() {
+            EnsureThreadInit();
+            self->DoConnect();
+            self->Tick();
+        });
+    }
+
+    void Stop() {
+        b_stop_ = true;
+        boost::asio::post(strand_, [self = shared_from_this()]() {
+            EnsureThreadInit();
+            self->reconnect_timer_.cancel();
+            self->tick_timer_.cancel();
+            self->Fail("stopped");
+        });
+    }
+
+    // 任意线程调用
+    void Send(std::string sql, std::vector<MysqlParam> params, Callback callback) {
+        if (b_stop_) {
+            Invoke(callback, Failure("stopped"));
+            return;
+        }
+        boost::asio::post(strand_, [self = shared_from_this(), sql = std::move(sql), params = std::move(params),
+            callback = std::move(callback)]() mutable {
+            EnsureThreadInit();
+            self->Enqueue({ std::move(sql), std::move(params), std::move(callback) });
+        });
+    }
+
+private:
+    enum class State { Connecting, Ready, Busy, Down };
+    enum class Phase { Connect, Query, Store };
+
+    struct Pending {
+        std::string sql;
+        std::vector<MysqlParam> params;
+        Callback callback;
+    };
+
+    void Enqueue(Pending item) {
+        if (b_stop_ || state_ == State::Down) {
+            Invoke(item.callback, Failure("mysql connection down"));
+            return;
+        }
+        if (pending_.size() >= max_pending_) {
+            Invoke(item.callback, Failure("too many pending queries"));
+            return;
+        }
+        pending_.push_back(std::move(item));
+        StartNext();
+    }
+
+    void DoConnect() {
+        if (b_stop_) return;
+        ++gen_;
+        mysql_ = mysql_init(nullptr);
+        if (!mysql_) {
+            Fail("mysql_init failed");
+            return;
+        }
+        // 只走 TCP（Host 为 localhost 时默认会走 unix socket），客户端与服务端统一用 utf8mb4
+        unsigned int protocol = MYSQL_PROTOCOL_TCP;
+        mysql_options(mysql_, MYSQL_OPT_PROTOCOL, &protocol);
+        mysql_options(mysql_, MYSQL_SET_CHARSET_NAME, "utf8mb4");
+        state_ = State::Connecting;
+        phase_ = Phase::Connect;
+        progress_ = std::chrono::steady_clock::now();
+        Step(gen_);
+    }
+
+    void OnConnected() {
+        state_ = State::Ready;
+        backoff_ = MIN_BACKOFF;
+        std::cout << "[MysqlAsync] " << name_ << " connected to " << host_ << ":" << port_
+            << ", queued=" << pending_.size() << std::endl;
+        StartNext();
+    }
+
+    // 空闲时取出下一条查询：在本连接上转义参数、拼出 SQL 后开始执行
+    void StartNext() {
+        if (state_ != State::Ready || pending_.empty()) return;
+        current_ = std::move(pending_.front());
+        pending_.pop_front();
+        std::string error;
+        if (!Format(current_.sql, current_.params, sql_, error)) {
+            Callback callback = std::move(current_.callback);
+            Invoke(callback, Failure(error));
+            StartNext();
+            return;
+        }
+        state_ = State::Busy;
+        phase_ = Phase::Query;
+        progress_ = std::chrono::steady_clock::now();
+        Step(gen_);
+    }
+
+    // 把 '?' 依次替换成参数；SQL 文本里不能有字面量 '?'
+    bool Format(const std::string& sql, const std::vector<MysqlParam>& params, std::string& out, std::string& error) {
+        out.clear();
+        out.reserve(sql.size() + params.size() * 16);
+        size_t next = 0;
+        for (char c : sql) {
+            if (c != '?') {
+                out.push_back(c);
+                continue;
+            }
+            if (next >= params.size()) {
+                error = "too few parameters";
+                return false;
+            }
+            const auto& param = params[next++];
+            if (const long long* v = std::get_if<long long>(&param)) {
+                out += std::to_string(*v);
+                continue;
+            }
+            const std::string& s = std::get<std::string>(param);
+            std::string escaped(s.size() * 2 + 1, '\0');
+            unsigned long len = mysql_real_escape_string(mysql_, &escaped[0], s.data(), static_cast<unsigned long>(s.size()));
+            out.push_back('\'');
+            out.append(escaped.data(), len);
+            out.push_back('\'');
+        }
+        if (next != params.size()) {
+            error = "too many parameters";
+            return false;
+        }
+        return true;
+    }
+
+    // 推进当前的非阻塞操作，直到完成、出错或需要等待 socket 可读
+    void Step(uint64_t gen) {
+        for (;;) {
+            if (gen != gen_) return;
+            net_async_status status = NET_ASYNC_ERROR;
+            MYSQL_RES* res = nullptr;
+            switch (phase_) {
+            case Phase::Connect:
+                status = mysql_real_connect_nonblocking(mysql_, host_.c_str(), user_.c_str(), pwd_.c_str(),
+                    schema_.c_str(), port_, nullptr, 0);
+                break;
+            case Phase::Query:
+                status = mysql_real_query_nonblocking(mysql_, sql_.data(), static_cast<unsigned long>(sql_.size()));
+                break;
+            case Phase::Store:
+                status = mysql_store_result_nonblocking(mysql_, &res);
+                break;
+            }
+
+            if (status == NET_ASYNC_NOT_READY) {
+                WaitReadable(gen);
+                return;
+            }
+            if (status == NET_ASYNC_ERROR) {
+                OnError();
+                return;
+            }
+            progress_ = std::chrono::steady_clock::now();
+            if (phase_ == Phase::Connect) {
+                OnConnected();
+                return;
+            }
+            if (phase_ == Phase::Query) {
+                phase_ = Phase::Store;
+                continue;
+            }
+            Complete(res);
+            return;
+        }
+    }
+
+    // 库函数返回 NOT_READY 说明它已读到 EAGAIN，等 socket 可读再调用
+    void WaitReadable(uint64_t gen) {
+        auto wait_id = ++wait_id_;
+        if (phase_ == Phase::Connect) {
+            // 建连期间 socket 可能还没建立（net.fd 尚未赋值），又要等的是可写，短间隔轮询；建连很少发生
+            wait_timer_.expires_after(CONNECT_POLL);
+            wait_timer_.async_wait([self = shared_from_this(), gen, wait_id](const boost::system::error_code& ec) {
+                if (ec || gen != self->gen_ || wait_id != self->wait_id_) return;
+                EnsureThreadInit();
+                self->Step(gen);
+            });
+            return;
+        }
+        my_socket fd = mysql_->net.fd;
+        if (!socket_.is_open() || fd_ != fd) {
+            ReleaseSocket();
+            // 协议族只影响 local_endpoint 之类的调用，这里只用来等待可读
+            boost::system::error_code ec;
+            socket_.assign(boost::asio::ip::tcp::v4(), fd, ec);
+            if (ec) {
+                Fail("assign socket: " + ec.message());
+                return;
+            }
+            fd_ = fd;
+        }
+        socket_.async_wait(boost::asio::ip::tcp::socket::wait_read,
+            [self = shared_from_this(), gen, wait_id](const boost::system::error_code& ec) {
+                if (gen != self->gen_ || wait_id != self->wait_id_) return;
+                if (ec) {
+                    self->Fail("wait: " + ec.message());
+                    return;
+                }
+                EnsureThreadInit();
+                self->Step(gen);
+            });
+    }
+
+    void OnError() {
+        unsigned int err = mysql_errno(mysql_);
+        std::string reason = std::to_string(err) + " " + mysql_error(mysql_);
+        if (phase_ == Phase::Connect || IsConnectionError(err)) {
+            Fail(phase_ == Phase::Connect ? "connect: " + reason : reason);
+            return;
+        }
+        // SQL 错误：连接仍可用，只让这一条失败
+        state_ = State::Ready;
+        Callback callback = std::move(current_.callback);
+        Invoke(callback, Failure(reason));
+        StartNext();
+    }
+
+    void Complete(MYSQL_RES* res) {
+        MysqlResult result;
+        result.ok = true;
+        if (res) {
+            unsigned int fields = mysql_num_fields(res);
+            result.rows.reserve(static_cast<size_t>(mysql_num_rows(res)));
+            while (MYSQL_ROW row = mysql_fetch_row(res)) {
+                unsigned long* lengths = mysql_fetch_lengths(res);
+                std::vector<std::optional<std::string>> values;
+                values.reserve(fields);
+                for (unsigned int i = 0; i < fields; ++i) {
+                    if (row[i]) values.emplace_back(std::string(row[i], lengths[i]));
+                    else values.emplace_back(std::nullopt);
+                }
+                result.rows.push_back(std::move(values));
+            }
+            // 结果已整体读入内存，释放不涉及网络
+            mysql_free_result(res);
+        }
+        else {
+            result.affected = mysql_affected_rows(mysql_);
+        }
+        state_ = State::Ready;
+        Callback callback = std::move(current_.callback);
+        Invoke(callback, std::move(result));
+        StartNext();
+    }
+
+    // 交还 socket 给 libmysqlclient，只取消在其上的等待，不关闭
+    void ReleaseSocket() {
+        if (!socket_.is_open()) return;
+        boost::system::error_code ignored;
+        socket_.release(ignored);
+        fd_ = NO_SOCKET;
+    }
+
+    void Close() {
+        ReleaseSocket();
+        if (mysql_) {
+            mysql_close(mysql_);
+            mysql_ = nullptr;
+        }
+    }
+
+    // 关闭当前连接，执行中和排队的查询全部失败，未停止时安排重连
+    void Fail(const std::string& reason) {
+        ++gen_;
+        wait_timer_.cancel();
+        Close();
+        bool busy = state_ == State::Busy;
+        state_ = State::Down;
+
+        std::deque<Pending> pending;
+        pending.swap(pending_);
+        if (!b_stop_ || busy || !pending.empty()) {
+            std::cerr << "[MysqlAsync] " << name_ << " " << reason << ", failing " << (busy ? 1 : 0)
+                << " running and " << pending.size() << " queued queries" << std::endl;
+        }
+        MysqlResult failure = Failure(reason);
+        if (busy) {
+            Callback callback = std::move(current_.callback);
+            Invoke(callback, failure);
+        }
+        for (auto& item : pending) Invoke(item.callback, failure);
+
+        if (b_stop_) return;
+        reconnect_timer_.expires_after(backoff_);
+        reconnect_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->b_stop_) return;
+            EnsureThreadInit();
+            self->DoConnect();
+        });
+        backoff_ = std::min(backoff_ * 2, MAX_BACKOFF);
+    }
+
+    // 建连或执行查询超过 timeout_ 没有完成时判定连接故障。
+    // 每次都不等 socket 直接推进一次：库偶尔会在写出时返回 NOT_READY（发送缓冲区满），此时等可读不会被唤醒
+    void Tick() {
+        tick_timer_.expires_after(std::min(timeout_ / 2, std::chrono::milliseconds(1000)));
+        tick_timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->b_stop_) return;
+            EnsureThreadInit();
+            bool waiting = self->state_ == State::Connecting || self->state_ == State::Busy;
+            if (waiting && std::chrono::steady_clock::now() - self->progress_ > self->timeout_) {
+                self->Fail(self->state_ == State::Connecting ? "connect timeout" : "query timeout");
+            }
+            else if (waiting) {
+                ++self->wait_id_;
+                self->Step(self->gen_);
+            }
+            self->Tick();
+        });
+    }
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::ip::tcp::socket socket_;   // 只借用 libmysqlclient 的 fd 等待可读，不读写、不关闭
+    boost::asio::steady_timer wait_timer_;
+    boost::asio::steady_timer reconnect_timer_;
+    boost::asio::steady_timer tick_timer_;
+
+    const std::string name_;
+    const std::string host_;
+    const unsigned int port_;
+    const std::string user_;
+    const std::string pwd_;
+    const std::string schema_;
+    const std::chrono::milliseconds timeout_;
+    const size_t max_pending_;
+
+    MYSQL* mysql_ = nullptr;
+    my_socket fd_ = NO_SOCKET;
+    State state_ = State::Down;
+    Phase phase_ = Phase::Connect;
+    uint64_t gen_ = 0;              // 每次建连、断开加 1，旧连接上迟到的完成回调据此丢弃
+    uint64_t wait_id_ = 0;          // 每次等待加 1，Tick 已推进过的等待醒来时丢弃
+    Pending current_;               // 执行中的查询
+    std::string sql_;               // 执行中的查询展开参数后的 SQL，完成前须保持不变
+    std::deque<Pending> pending_;
+    std::chrono::steady_clock::time_point progress_;
+    std::chrono::milliseconds backoff_;
+    std::atomic<bool> b_stop_{ false };
+};
+
+MysqlAsync::~MysqlAsync()
+{
+    Stop();
+}
+
+void MysqlAsync::Init()
+{
+    if (main_) return; // 避免重复初始化
+
+    auto& cfg = ConfigMgr::Inst();
+    int connections = 4;
+    int timeout_ms = 5000;
+    long long max_pending = 100000;
+    try { connections = std::stoi(cfg["MysqlAsync"]["Connections"]); }
+    catch (...) {}
+    try { timeout_ms = std::stoi(cfg["MysqlAsync"]["TimeoutMs"]); }
+    catch (...) {}
+    try { max_pending = std::stoll(cfg["MysqlAsync"]["MaxPending"]); }
+    catch (...) {}
+    if (connections <= 0) {
+        std::cout << "[MysqlAsync] disabled" << std::endl;
+        return;
+    }
+    if (timeout_ms <= 0) timeout_ms = 5000;
+    if (max_pending <= 0) max_pending = 100000;
+
+    // 多线程使用前须先初始化客户端库
+    if (mysql_library_init(0, nullptr, nullptr) != 0) {
+        std::cerr << "[MysqlAsync] mysql_library_init failed, disabled" << std::endl;
+        return;
+    }
+
+    connections_ = static_cast<size_t>(connections);
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+    max_pending_ = static_cast<size_t>(max_pending);
+    pool_ = AsioIOServicePool::GetInstance();
+
+    // 未配置的项沿用 [Mysql]
+    auto value = [&cfg](const std::string& section, const std::string& key) {
+        std::string v = cfg[section][key];
+        return v.empty() ? cfg["Mysql"][key] : v;
+    };
+    auto port = [&value](const std::string& section) {
+        try { return static_cast<unsigned int>(std::stoul(value(section, "Port"))); }
+        catch (...) { return 3306u; }
+    };
+    main_ = MakeConns("main", cfg["Mysql"]["Host"], port("Mysql"), cfg["Mysql"]["User"], cfg["Mysql"]["Passwd"],
+        cfg["Mysql"]["Schema"]);
+
+    // 消息分片：规则与 MsgShardMap 一致，Host 为空的分片复用主库连接
+    int shard_count = 0;
+    try { shard_count = std::stoi(cfg["MsgShard"]["Count"]); }
+    catch (...) {}
+    for (int i = 0; shard_count > 1 && i < shard_count; ++i) {
+        std::string section = "MsgShard" + std::to_string(i);
+        std::string host = cfg[section]["Host"];
+        shards_.push_back(host.empty() ? main_ : MakeConns("shard" + std::to_string(i), host, port(section),
+            value(section, "User"), value(section, "Passwd"), value(section, "Schema")));
+    }
+
+    enabled_ = true;
+    std::cout << "[MysqlAsync] started, connections=" << connections << " per database, shards=" << shards_.size()
+        << " timeout_ms=" << timeout_ms << " max_pending=" << max_pending << std::endl;
+}
+
+std::shared_ptr<MysqlAsync::ConnGroup> MysqlAsync::MakeConns(const std::string& name, const std::string& host,
+    unsigned int port, const std::string& user, const std::string& pwd, const std::string& schema)
+{
+    auto conns = std::make_shared<ConnGroup>();
+    for (size_t i = 0; i < connections_; ++i) {
+        auto conn = std::make_shared<Connection>(pool_->GetIOService(), name + "#" + std::to_string(i),
+            host, port, user, pwd, schema, timeout_, max_pending_);
+        conn->Start();
+        conns->push_back(conn);
+    }
+    return conns;
+}
+
+void MysqlAsync::Stop()
+{
+    if (!main_) return;
+    for (auto& conn : *main_) {
+        conn->Stop();
+    }
+    for (auto& shard : shards_) {
+        if (shard == main_) continue;
+        for (auto& conn : *shard) {
+            conn->Stop();
+        }
+    }
+}
+
+void MysqlAsync::Query(long long key, std::string sql, std::vector<MysqlParam> params, Callback callback)
+{
+    if (!enabled_) {
+        Invoke(callback, Failure("async mysql disabled"));
+        return;
+    }
+    Dispatch(*main_, static_cast<size_t>(static_cast<unsigned long long>(key)), std::move(sql), std::move(params),
+        std::move(callback));
+}
+
+void MysqlAsync::QueryMsg(int uid, std::string sql, std::vector<MysqlParam> params, Callback callback)
+{
+    if (!enabled_) {
+        Invoke(callback, Failure("async mysql disabled"));
+        return;
+    }
+    unsigned int key = static_cast<unsigned int>(uid);
+    if (shards_.empty()) {
+        Dispatch(*main_, key, std::move(sql), std::move(params), std::move(callback));
+        return;
+    }
+    // 分片内再按 uid / 分片数 选连接，避免同一分片的用户都落到同一条连接上
+    size_t count = shards_.size();
+    Dispatch(*shards_[key % count], key / count, std::move(sql), std::move(params), std::move(callback));
+}
+
+void MysqlAsync::Dispatch(const ConnGroup& conns, size_t index, std::string sql, std::vector<MysqlParam> params,
+    Callback callback)
+{
+    conns[index % conns.size()]->Send(std::move(sql), std::move(params), std::move(callback));
+}
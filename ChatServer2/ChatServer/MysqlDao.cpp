@@ -1,18 +1,207 @@
 #include "MysqlDao.h"
 #include"ConfigMgr.h"
 #include"crypto_utils.h"
+#include "MsgShardMap.h"
+#include "MsgCodec.h"
+#include "MysqlAsync.h"
 #include <sstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+
+namespace {
+    // 读出当前行 payload 列的原始字节
+    std::string ReadBlob(sql::ResultSet* res)
+    {
+        std::unique_ptr<std::istream> in(res->getBlob("payload"));
+        std::string blob;
+        if (in) {
+            blob.assign(std::istreambuf_iterator<char>(*in), std::istreambuf_iterator<char>());
+        }
+        return blob;
+    }
+
+    // 读出当前行的消息体，按 codec 还原成下发给客户端的 JSON
+    std::string LoadPayload(sql::ResultSet* res, int toUid)
+    {
+        std::string blob = ReadBlob(res);
+        std::string payload;
+        if (!MsgCodec::GetInstance()->Decode(res->getInt("codec"), blob, res->getInt("from_uid"), toUid, payload)) {
+            std::cerr << "[MysqlDao] failed to decode message id=" << res->getInt64("id")
+                << " codec=" << res->getInt("codec") << std::endl;
+        }
+        return payload;
+    }
+
+    // MysqlAsync 返回的一页 (id, from_uid, payload, codec)，按 codec 还原成下发给客户端的 JSON
+    ChatMsgPage LoadPage(const MysqlResult& result, int toUid)
+    {
+        ChatMsgPage page;
+        page.ok = result.ok;
+        if (!result.ok) {
+            return page;
+        }
+        auto number = [](const std::optional<std::string>& v) { return v ? std::strtoll(v->c_str(), nullptr, 10) : 0LL; };
+        page.ids.reserve(result.rows.size());
+        page.payloads.reserve(result.rows.size());
+        for (const auto& row : result.rows) {
+            long long id = number(row[0]);
+            int codec = static_cast<int>(number(row[3]));
+            std::string payload;
+            if (!MsgCodec::GetInstance()->Decode(codec, row[2].value_or(""), static_cast<int>(number(row[1])), toUid, payload)) {
+                std::cerr << "[MysqlDao] failed to decode message id=" << id << " codec=" << codec << std::endl;
+            }
+            page.ids.push_back(id);
+            page.payloads.push_back(std::move(payload));
+        }
+        return page;
+    }
+
+    // 同步和异步版本共用的 SQL
+    const char* const UNREAD_PAGE_SQL =
+        "SELECT id, from_uid, payload, codec FROM messages "
+        "WHERE to_uid = ? AND id > GREATEST(?, IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = ?), 0)) "
+        "ORDER BY id ASC LIMIT ?";
+    // 已读状态是每个用户一行的游标：无论积压多少条未读，确认都只写一行
+    // GREATEST 保证游标只前进，乱序或重复的 ACK 不会把游标往回拨。
+    // 只接受该用户已入库消息的 id：超出已入库范围的值（例如老客户端拿本地时间戳确认）
+    // 会把还没投递的消息一并标成已读，SELECT 查不到行时什么也不写
+    const char* const RANGE_ACK_SQL =
+        "INSERT INTO user_read_cursor (uid, read_msg_id) "
+        "SELECT to_uid, id FROM messages WHERE to_uid = ? AND id = ? "
+        "ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id))";
+    // 在线下发的消息逐条确认，不能越过还没投递的消息：
+    // 登录后离线分页还在进行时收到的新消息 id 比积压的都大，直接推进会把积压的跳过。
+    // 游标与 msg_id 之间没有别的消息（连续）才推进，否则留给分页确认
+    const char* const SINGLE_ACK_SQL =
+        "INSERT INTO user_read_cursor (uid, read_msg_id) "
+        "SELECT m.to_uid, m.id FROM messages m WHERE m.to_uid = ? AND m.id = ? "
+        "AND NOT EXISTS (SELECT 1 FROM messages g WHERE g.to_uid = m.to_uid AND g.id < m.id "
+        "AND g.id > IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = ?), 0)) "
+        "ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id))";
+    // (to_uid, id) 索引倒序扫描
+    const char* const HISTORY_PAGE_SQL =
+        "SELECT id, from_uid, payload, codec FROM messages "
+        "WHERE to_uid = ? AND id < ? ORDER BY id DESC LIMIT ?";
+
+    // messages.client_msg_id 的列宽
+    constexpr size_t MAX_CLIENT_MSG_ID = 64;
+
+    // 给还没有去重键的消息分配去重键：优先用发送方 msgid 加内容摘要（MsgCodec::ClientMsgId）；
+    // 老客户端没带 msgid 时生成一个本进程唯一的键（"~" 开头，不会和客户端的数字 msgid 冲突），
+    // 只保证本次写入的重试幂等
+    void AssignClientMsgIds(std::vector<ChatMsgRecord>& msgs)
+    {
+        static const unsigned long long nonce = std::random_device{}() * 4294967296ULL + std::random_device{}();
+        static std::atomic<unsigned long long> seq{ 0 };
+        for (auto& msg : msgs) {
+            if (!msg._client_msg_id.empty()) continue;
+            msg._client_msg_id = MsgCodec::ClientMsgId(msg._payload);
+            if (msg._client_msg_id.empty() || msg._client_msg_id.size() > MAX_CLIENT_MSG_ID) {
+                std::ostringstream oss;
+                oss << "~" << std::hex << nonce << "-" << ++seq;
+                msg._client_msg_id = oss.str();
+            }
+        }
+    }
+}
 
 using MySqlPoolSingleton = Singleton<MySqlPool>;
+using MySqlReplicaPoolSingleton = Singleton<MySqlReplicaPool>;
 
-MysqlDao::MysqlDao() {
+MysqlDao::MysqlDao() : sticky_(DEFAULT_STICKY_MS) {
     pool_ = MySqlPoolSingleton::GetInstance();
+    replica_ = MySqlReplicaPoolSingleton::GetInstance();
+    try { sticky_ = std::chrono::milliseconds(std::stoi(ConfigMgr::Inst()["MysqlReplica"]["StickyMs"])); }
+    catch (...) {}
 }
 
 MysqlDao::~MysqlDao() {
     //pool_->Close();
 }
 
+ConnectionGuard MysqlDao::ReadGuard(std::initializer_list<int> uids)
+{
+    if (replica_ && replica_->Ready() && !RecentlyWritten(uids)) {
+        // 从库池取不到连接时不等待（getConnection 最多会阻塞 WAIT_TIMEOUT_SECONDS），直接走主库
+        ConnectionGuard guard = ConnectionGuard::TryAcquire(replica_);
+        if (guard) {
+            return guard;
+        }
+    }
+    return ConnectionGuard(pool_);
+}
+
+std::shared_ptr<MySqlPool> MysqlDao::MsgPool(int to_uid)
+{
+    auto shards = MsgShardMap::GetInstance();
+    return shards->Enabled() ? shards->PoolFor(to_uid) : pool_;
+}
+
+ConnectionGuard MysqlDao::MsgReadGuard(int uid)
+{
+    // 分片后消息读写都在收件人所在分片的主库上，不走从库
+    auto shards = MsgShardMap::GetInstance();
+    if (shards->Enabled()) {
+        return ConnectionGuard(shards->PoolFor(uid));
+    }
+    return ReadGuard({ uid });
+}
+
+void MysqlDao::MarkWrite(std::initializer_list<int> uids)
+{
+    if (!replica_ || !replica_->Ready()) return;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(recent_mutex_);
+    for (int uid : uids) {
+        recent_writes_[uid] = now;
+    }
+    PruneRecentWrites(now);
+}
+
+void MysqlDao::MarkWrite(const std::vector<ChatMsgRecord>& msgs)
+{
+    if (!replica_ || !replica_->Ready()) return;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(recent_mutex_);
+    for (const auto& msg : msgs) {
+        recent_writes_[msg._from_uid] = now;
+        recent_writes_[msg._to_uid] = now;
+    }
+    PruneRecentWrites(now);
+}
+
+bool MysqlDao::RecentlyWritten(std::initializer_list<int> uids)
+{
+    if (uids.size() == 0) return false;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(recent_mutex_);
+    for (int uid : uids) {
+        auto iter = recent_writes_.find(uid);
+        if (iter != recent_writes_.end() && now - iter->second < sticky_) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 持有 recent_mutex_ 时调用：每写入 PRUNE_EVERY 次清理一遍过期记录
+void MysqlDao::PruneRecentWrites(std::chrono::steady_clock::time_point now)
+{
+    if (++mark_count_ % PRUNE_EVERY != 0) return;
+    for (auto iter = recent_writes_.begin(); iter != recent_writes_.end();) {
+        if (now - iter->second >= sticky_) {
+            iter = recent_writes_.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
 int MysqlDao::RegUser(const std::string& name,
     const std::string& email,
     const std::string& pwd)
@@ -27,6 +216,7 @@ int MysqlDao::RegUser(const std::string& name,
     try {
         sql::Connection* con = guard.get();
         
+        // 存储过程调用会附带额外结果集，不走连接上的语句缓存
         std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("CALL reg_user(?,?,?,@result)"));
 
         pstmt->setString(1, name);
@@ -64,8 +254,7 @@ bool MysqlDao::CheckEmail(const std::string& name, const std::string& email) {
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("SELECT email FROM user WHERE name = ?"));
+        sql::PreparedStatement* pstmt = guard.prepare("SELECT email FROM user WHERE name = ?");
 
         pstmt->setString(1, name);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -95,12 +284,9 @@ bool MysqlDao::UpdatePwdByEmail(const std::string& email, const std::string& new
         return false;
     }
     try {
-        sql::Connection* con = guard.get();
         std::string hashedPwd = sha256_hex(newpwdPlain);
 
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("UPDATE user SET pwd = ? WHERE email = ?")
-        );
+        sql::PreparedStatement* pstmt = guard.prepare("UPDATE user SET pwd = ? WHERE email = ?");
         pstmt->setString(1, hashedPwd);
         pstmt->setString(2, email);
 
@@ -125,15 +311,14 @@ bool MysqlDao::CheckPwd(const std::string& identifier, const std::string& pwdPla
     }
     
     try {
-        sql::Connection* con = guard.get();
         bool isEmail = (identifier.find('@') != std::string::npos);
-        std::unique_ptr<sql::PreparedStatement> pstmt;
+        sql::PreparedStatement* pstmt = nullptr;
         if (isEmail) {
-            pstmt.reset(con->prepareStatement("SELECT * FROM user WHERE email = ?"));
+            pstmt = guard.prepare("SELECT * FROM user WHERE email = ?");
             pstmt->setString(1, identifier);
         }
         else {
-            pstmt.reset(con->prepareStatement("SELECT * FROM user WHERE name = ?"));
+            pstmt = guard.prepare("SELECT * FROM user WHERE name = ?");
             pstmt->setString(1, identifier);
         }
 
@@ -185,17 +370,15 @@ bool MysqlDao::CheckPwd(const std::string& identifier, const std::string& pwdPla
 
 bool MysqlDao::GetUser(int uid, UserInfo& userInfo)
 {
-    ConnectionGuard guard(pool_);
+    // 只读查询，优先走从库
+    ConnectionGuard guard = ReadGuard({ uid });
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("SELECT uid, name, email, pwd FROM user WHERE uid = ?")
-        );
+        sql::PreparedStatement* pstmt = guard.prepare("SELECT uid, name, email, pwd FROM user WHERE uid = ?");
         pstmt->setInt(1, uid);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
 
@@ -220,15 +403,15 @@ bool MysqlDao::GetUser(int uid, UserInfo& userInfo)
 
 std::shared_ptr<UserInfo> MysqlDao::GetUserByName(const std::string& name)
 {
-    ConnectionGuard guard(pool_);
+    // 只读查询，优先走从库
+    ConnectionGuard guard = ReadGuard({});
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return nullptr;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement("SELECT * from user where name = ?"));
+        sql::PreparedStatement* pstmt = guard.prepare("SELECT * from user where name = ?");
         pstmt->setString(1, name);
 
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -259,22 +442,20 @@ std::shared_ptr<UserInfo> MysqlDao::GetUserByName(const std::string& name)
 // 获取好友申请列表
 std::vector<ApplyInfo> MysqlDao::GetFriendRequests(int uid) {
     std::vector<ApplyInfo> requests;
-    ConnectionGuard guard(pool_);
+    // 只读查询，优先走从库
+    ConnectionGuard guard = ReadGuard({ uid });
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return requests;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement(
-                "SELECT fr.from_uid, u.name, fr.desc, u.icon, u.nick, u.sex, fr.status "
-                "FROM friend_requests fr "
-                "JOIN user u ON fr.from_uid = u.uid "
-                "WHERE fr.to_uid = ? AND fr.status = 0 "
-                "ORDER BY fr.create_time DESC"
-            )
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT fr.from_uid, u.name, fr.desc, u.icon, u.nick, u.sex, fr.status "
+            "FROM friend_requests fr "
+            "JOIN user u ON fr.from_uid = u.uid "
+            "WHERE fr.to_uid = ? AND fr.status = 0 "
+            "ORDER BY fr.create_time DESC"
         );
         pstmt->setInt(1, uid);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -302,6 +483,7 @@ std::vector<ApplyInfo> MysqlDao::GetFriendRequests(int uid) {
 
 // 回复好友申请
 bool MysqlDao::ReplyFriendRequest(int fromUid, int toUid, bool agree) {
+    MarkWrite({ fromUid, toUid });
     ConnectionGuard guard(pool_);
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
@@ -309,11 +491,8 @@ bool MysqlDao::ReplyFriendRequest(int fromUid, int toUid, bool agree) {
     }
 
     try {
-        sql::Connection* con = guard.get();
         // 更新申请状态
-        std::unique_ptr<sql::PreparedStatement> updateStmt(
-            con->prepareStatement("UPDATE friend_requests SET status = ? WHERE from_uid = ? AND to_uid = ? AND status = 0")
-        );
+        sql::PreparedStatement* updateStmt = guard.prepare("UPDATE friend_requests SET status = ? WHERE from_uid = ? AND to_uid = ? AND status = 0");
         updateStmt->setInt(1, agree ? 1 : 2);
         updateStmt->setInt(2, fromUid);
         updateStmt->setInt(3, toUid);
@@ -321,9 +500,7 @@ bool MysqlDao::ReplyFriendRequest(int fromUid, int toUid, bool agree) {
 
         if (updateCount > 0 && agree) {
             // 如果同意，添加好友关系
-            std::unique_ptr<sql::PreparedStatement> insertFriendStmt(
-                con->prepareStatement("INSERT INTO friends (uid1, uid2, create_time) VALUES (?, ?, NOW()), (?, ?, NOW())")
-            );
+            sql::PreparedStatement* insertFriendStmt = guard.prepare("INSERT INTO friends (uid1, uid2, create_time) VALUES (?, ?, NOW()), (?, ?, NOW())");
             insertFriendStmt->setInt(1, fromUid);
             insertFriendStmt->setInt(2, toUid);
             insertFriendStmt->setInt(3, toUid);
@@ -343,22 +520,20 @@ bool MysqlDao::ReplyFriendRequest(int fromUid, int toUid, bool agree) {
 // 获取我的好友列表
 std::vector<UserInfo> MysqlDao::GetMyFriends(int uid) {
     std::vector<UserInfo> friends;
-    ConnectionGuard guard(pool_);
+    // 只读查询，优先走从库
+    ConnectionGuard guard = ReadGuard({ uid });
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return friends;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement(
-                "SELECT u.uid, u.name, u.email, u.nick, u.icon, u.sex, u.desc "
-                "FROM friends f "
-                "JOIN user u ON (f.uid2 = u.uid) "
-                "WHERE f.uid1 = ? "
-                "ORDER BY u.nick ASC"
-            )
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT u.uid, u.name, u.email, u.nick, u.icon, u.sex, u.desc "
+            "FROM friends f "
+            "JOIN user u ON (f.uid2 = u.uid) "
+            "WHERE f.uid1 = ? "
+            "ORDER BY u.nick ASC"
         );
         pstmt->setInt(1, uid);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -385,17 +560,15 @@ std::vector<UserInfo> MysqlDao::GetMyFriends(int uid) {
 
 // 检查是否为好友
 bool MysqlDao::IsFriend(int uid1, int uid2) {
-    ConnectionGuard guard(pool_);
+    // 只读查询，优先走从库
+    ConnectionGuard guard = ReadGuard({ uid1, uid2 });
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("SELECT COUNT(*) as count FROM friends WHERE (uid1 = ? AND uid2 = ?) OR (uid1 = ? AND uid2 = ?)")
-        );
+        sql::PreparedStatement* pstmt = guard.prepare("SELECT COUNT(*) as count FROM friends WHERE (uid1 = ? AND uid2 = ?) OR (uid1 = ? AND uid2 = ?)");
         pstmt->setInt(1, uid1);
         pstmt->setInt(2, uid2);
         pstmt->setInt(3, uid2);
@@ -418,55 +591,227 @@ bool MysqlDao::IsFriend(int uid1, int uid2) {
 
 bool MysqlDao::SaveChatMessage(int fromUid, int toUid, const std::string& payload)
 {
-    ConnectionGuard guard(pool_);
+    // 与批量写入走同一条路径：同样加收件人写入锁、按去重键幂等
+    std::vector<ChatMsgRecord> msgs{ ChatMsgRecord(fromUid, toUid, payload) };
+    return SaveChatMessages(msgs);
+}
+
+bool MysqlDao::SaveChatMessages(std::vector<ChatMsgRecord>& msgs)
+{
+    // 只写还没有 _id 的记录：调用方拿同一批重试时，上次已成功的分片不再重写
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        if (msgs[i]._id <= 0) pending.push_back(i);
+    }
+    if (pending.empty()) return true;
+
+    MarkWrite(msgs);
+    AssignClientMsgIds(msgs);
+    auto shards = MsgShardMap::GetInstance();
+    if (!shards->Enabled() && pending.size() == msgs.size()) {
+        return SaveChatMessagesOn(pool_, msgs);
+    }
+
+    // 按收件人分片拆成若干批，每个分片一条多行 INSERT；
+    // 各分片独立提交，失败的分片其记录 _id 保持为 0，返回 false 由调用方只重试这些记录
+    size_t count = shards->Enabled() ? shards->Count() : 1;
+    std::vector<std::vector<ChatMsgRecord>> groups(count);
+    std::vector<std::vector<size_t>> positions(count);
+    for (size_t i : pending) {
+        size_t shard = shards->Enabled() ? shards->ShardOf(msgs[i]._to_uid) : 0;
+        groups[shard].push_back(msgs[i]);
+        positions[shard].push_back(i);
+    }
+    bool ok = true;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        if (groups[i].empty()) continue;
+        if (!SaveChatMessagesOn(MsgPool(groups[i].front()._to_uid), groups[i])) {
+            std::cerr << "[MysqlDao] SaveChatMessages failed on shard " << i << std::endl;
+            ok = false;
+            continue;
+        }
+        for (size_t j = 0; j < groups[i].size(); ++j) {
+            msgs[positions[i][j]]._id = groups[i][j]._id;
+        }
+    }
+    return ok;
+}
+
+bool MysqlDao::SaveChatMessagesOn(std::shared_ptr<MySqlPool> pool, std::vector<ChatMsgRecord>& msgs)
+{
+    ConnectionGuard guard(pool);
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
+    sql::Connection* con = guard.get();
     try {
-        sql::Connection* con = guard.get();
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("INSERT INTO messages (from_uid, to_uid, payload, status, create_time) VALUES (?, ?, ?, 0, NOW())")
-        );
-        pstmt->setInt(1, fromUid);
-        pstmt->setInt(2, toUid);
-        pstmt->setString(3, payload);
-        pstmt->execute();
+        // (from_uid, to_uid, client_msg_id) 唯一，已写入的行被 IGNORE 跳过：
+        // 上一次事务已提交但回复丢失时整批重试，或客户端重发同一条消息，都不会重复入库
+        std::ostringstream oss;
+        oss << "INSERT IGNORE INTO messages (from_uid, to_uid, payload, codec, client_msg_id, create_time) VALUES ";
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            if (i) oss << ",";
+            oss << "(?, ?, ?, ?, ?, NOW())";
+        }
+
+        // 消息体按存储编码压缩，setBlob 只保存流指针，流要活到 executeUpdate 之后
+        std::vector<std::unique_ptr<std::istringstream>> blobs;
+        std::vector<int> codecs;
+        blobs.reserve(msgs.size());
+        codecs.reserve(msgs.size());
+        for (const auto& msg : msgs) {
+            std::string blob;
+            codecs.push_back(MsgCodec::GetInstance()->Encode(msg._payload, blob));
+            blobs.emplace_back(new std::istringstream(std::move(blob)));
+        }
+
+        // 整批放在一个事务里：一次网络往返 + 一次 redo 刷盘
+        con->setAutoCommit(false);
+
+        // 先按 uid 升序锁住本批收件人（user_inbox_lock 每人一行，不存在时插入），持有到提交：
+        // 同一收件人的写入事务串行分配 id、串行提交，id 大的消息不会先于 id 小的可见。
+        // 离线分页按 id > 游标取、确认按 id 推进游标，都依赖这一点，否则后提交的小 id 会被跳过。
+        // 各事务按同一顺序加锁，不会互相死锁
+        std::set<int> recipients;
+        for (const auto& msg : msgs) {
+            recipients.insert(msg._to_uid);
+        }
+        std::ostringstream lock_sql;
+        lock_sql << "INSERT INTO user_inbox_lock (uid) VALUES ";
+        for (size_t i = 0; i < recipients.size(); ++i) {
+            if (i) lock_sql << ",";
+            lock_sql << "(?)";
+        }
+        lock_sql << " ON DUPLICATE KEY UPDATE uid = uid";
+        std::unique_ptr<sql::PreparedStatement> lock_stmt(con->prepareStatement(lock_sql.str()));
+        unsigned int lock_idx = 1;
+        for (int to_uid : recipients) {
+            lock_stmt->setInt(lock_idx++, to_uid);
+        }
+        lock_stmt->executeUpdate();
+
+        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(oss.str()));
+        unsigned int idx = 1;
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            pstmt->setInt(idx++, msgs[i]._from_uid);
+            pstmt->setInt(idx++, msgs[i]._to_uid);
+            pstmt->setBlob(idx++, blobs[i].get());
+            pstmt->setInt(idx++, codecs[i]);
+            pstmt->setString(idx++, msgs[i]._client_msg_id);
+        }
+        int inserted = pstmt->executeUpdate();
+
+        if (inserted == static_cast<int>(msgs.size())) {
+            // 单条多行 INSERT 属于 simple insert，InnoDB 为其一次性分配连续的自增 id，
+            // 按 LAST_INSERT_ID() 和步长即可回填每条消息的 id（离线收件箱按 id 排序、去重）
+            sql::PreparedStatement* id_stmt = guard.prepare("SELECT LAST_INSERT_ID(), @@auto_increment_increment");
+            std::unique_ptr<sql::ResultSet> res(id_stmt->executeQuery());
+            if (res->next()) {
+                long long first_id = res->getInt64(1);
+                long long step = res->getInt64(2);
+                for (size_t i = 0; i < msgs.size(); ++i) {
+                    msgs[i]._id = first_id + static_cast<long long>(i) * step;
+                }
+            }
+        }
+        else {
+            // 有行已经存在：跳过的行让 id 不再与位置一一对应，按去重键查回每条消息的 id
+            ResolveChatMessageIds(con, msgs);
+        }
+        con->commit();
+        con->setAutoCommit(true);
 
         return true;
     }
     catch (sql::SQLException& e) {
+        // 回滚失败说明连接已不可用，直接标记为坏连接由连接池替换
+        try {
+            con->rollback();
+            con->setAutoCommit(true);
+        }
+        catch (...) {}
         guard.markBad();
-        std::cerr << "[MysqlDao] SQLException in SaveChatMessage: " << e.what() << std::endl;
+        // 事务已回滚，提交前回填的 id 作废
+        for (auto& msg : msgs) {
+            msg._id = 0;
+        }
+        std::cerr << "[MysqlDao] SQLException in SaveChatMessages (batch=" << msgs.size() << "): " << e.what()
+            << " (MySQL error code: " << e.getErrorCode()
+            << ", SQLState: " << e.getSQLState() << ")" << std::endl;
         return false;
     }
 }
 
+void MysqlDao::ResolveChatMessageIds(sql::Connection* con, std::vector<ChatMsgRecord>& msgs)
+{
+    std::ostringstream oss;
+    oss << "SELECT id, from_uid, to_uid, client_msg_id, payload, codec FROM messages "
+        "WHERE (from_uid, to_uid, client_msg_id) IN (";
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        if (i) oss << ",";
+        oss << "(?, ?, ?)";
+    }
+    oss << ")";
+
+    std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(oss.str()));
+    unsigned int idx = 1;
+    for (const auto& msg : msgs) {
+        pstmt->setInt(idx++, msg._from_uid);
+        pstmt->setInt(idx++, msg._to_uid);
+        pstmt->setString(idx++, msg._client_msg_id);
+    }
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    // 去重键 -> (id, 已入库的消息体)
+    std::map<std::tuple<int, int, std::string>, std::pair<long long, std::string>> rows;
+    while (res->next()) {
+        int to_uid = res->getInt("to_uid");
+        rows[std::make_tuple(res->getInt("from_uid"), to_uid, std::string(res->getString("client_msg_id")))]
+            = std::make_pair(res->getInt64("id"), LoadPayload(res.get(), to_uid));
+    }
+    for (auto& msg : msgs) {
+        auto iter = rows.find(std::make_tuple(msg._from_uid, msg._to_uid, msg._client_msg_id));
+        if (iter == rows.end()) {
+            // 被 IGNORE 的不是重复键（例如数据错误），不能当作已入库
+            throw sql::SQLException("message not stored, client_msg_id=" + msg._client_msg_id);
+        }
+        // 键相同但内容不同是撞键而不是重发，不能把发送方的消息当成已送达丢掉；
+        // "~" 键由服务端按写入位置生成（本进程内的重试，或消息日志的段号 + 偏移），消息体一定相同，不必比较
+        if (msg._client_msg_id[0] != '~' && !MsgCodec::SameText(iter->second.second, msg._payload)) {
+            throw sql::SQLException("client_msg_id collision with different payload, client_msg_id="
+                + msg._client_msg_id);
+        }
+        msg._id = iter->second.first;
+    }
+}
+
 bool MysqlDao::GetUnreadChatMessagesWithIds(int uid, std::vector<long long>& ids, std::vector<std::string>& payloads)
 {
     ids.clear();
     payloads.clear();
     
     // 使用 RAII ConnectionGuard，自动归还连接
-    ConnectionGuard guard(pool_);
+    ConnectionGuard guard = MsgReadGuard(uid);
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("SELECT id, payload FROM messages WHERE to_uid = ? AND status = 0 ORDER BY id ASC")
+        // 未读 = id 大于该用户的已读游标
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT id, from_uid, payload, codec FROM messages "
+            "WHERE to_uid = ? AND id > IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = ?), 0) "
+            "ORDER BY id ASC"
         );
         pstmt->setInt(1, uid);
+        pstmt->setInt(2, uid);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
 
         while (res->next()) {
             ids.push_back(res->getInt64("id"));
-            payloads.push_back(res->getString("payload"));
+            payloads.push_back(LoadPayload(res.get(), uid));
         }
 
         // 不需要手动 returnConnection，Guard 析构时自动执行
@@ -479,56 +824,56 @@ bool MysqlDao::GetUnreadChatMessagesWithIds(int uid, std::vector<long long>& ids
     }
 }
 
-bool MysqlDao::DeleteChatMessagesByIds(const std::vector<long long>& ids)
+bool MysqlDao::GetUnreadChatMessagesPage(int uid, long long after_id, int limit,
+    std::vector<long long>& ids, std::vector<std::string>& payloads)
 {
-    // 历史保留：将消息标记为已读（status=1），而不是物理删除
-    if (ids.empty()) return true;
-    
-    ConnectionGuard guard(pool_);
+    ids.clear();
+    payloads.clear();
+    if (limit <= 0) return true;
+
+    // 收件人在 sticky 窗口内收到过消息或确认过游标时走主库，否则可以读从库
+    ConnectionGuard guard = MsgReadGuard(uid);
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        std::ostringstream oss;
-        oss << "UPDATE messages SET status=1 WHERE id IN (";
-        for (size_t i = 0; i < ids.size(); ++i) {
-            if (i) oss << ",";
-            oss << "?";
-        }
-        oss << ")";
+        sql::PreparedStatement* pstmt = guard.prepare(UNREAD_PAGE_SQL);
+        pstmt->setInt(1, uid);
+        pstmt->setInt64(2, after_id);
+        pstmt->setInt(3, uid);
+        pstmt->setInt(4, limit);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
 
-        std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(oss.str()));
-        for (size_t i = 0; i < ids.size(); ++i) {
-            pstmt->setInt64(static_cast<unsigned int>(i + 1), ids[i]);
+        ids.reserve(limit);
+        payloads.reserve(limit);
+        while (res->next()) {
+            ids.push_back(res->getInt64("id"));
+            payloads.push_back(LoadPayload(res.get(), uid));
         }
-        pstmt->executeUpdate();
 
         return true;
     }
     catch (sql::SQLException& e) {
         guard.markBad();
-        std::cerr << "[MysqlDao] SQLException in DeleteChatMessagesByIds: " << e.what() << std::endl;
+        std::cerr << "[MysqlDao] SQLException in GetUnreadChatMessagesPage: " << e.what() << std::endl;
         return false;
     }
 }
 
 bool MysqlDao::AckOfflineMessages(int uid, long long max_msg_id)
 {
-    ConnectionGuard guard(pool_);
+    MarkWrite({ uid });
+    // 游标和该用户的消息在同一分片
+    ConnectionGuard guard(MsgPool(uid));
     if (!guard) {
         std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
         return false;
     }
 
     try {
-        sql::Connection* con = guard.get();
-        // 只更新status=0的消息
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            con->prepareStatement("UPDATE messages SET status=1 WHERE to_uid = ? AND id <= ? AND status = 0")
-        );
+        sql::PreparedStatement* pstmt = guard.prepare(RANGE_ACK_SQL);
         pstmt->setInt(1, uid);
         pstmt->setInt64(2, max_msg_id);
         int affected_rows = pstmt->executeUpdate();
@@ -537,11 +882,268 @@ bool MysqlDao::AckOfflineMessages(int uid, long long max_msg_id)
                   << " max_msg_id=" << max_msg_id 
                   << " affected_rows=" << affected_rows << std::endl;
 
-        return true;
+        return affected_rows > 0;
     }
     catch (sql::SQLException& e) {
         guard.markBad();
         std::cerr << "[MysqlDao] SQLException in AckOfflineMessages: " << e.what() << std::endl;
         return false;
     }
-}
\ No newline at end of file
+}
+
+bool MysqlDao::AckOfflineMessage(int uid, long long msg_id)
+{
+    MarkWrite({ uid });
+    ConnectionGuard guard(MsgPool(uid));
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return false;
+    }
+
+    try {
+        sql::PreparedStatement* pstmt = guard.prepare(SINGLE_ACK_SQL);
+        pstmt->setInt(1, uid);
+        pstmt->setInt64(2, msg_id);
+        pstmt->setInt(3, uid);
+        int affected_rows = pstmt->executeUpdate();
+
+        std::cout << "[AckOfflineMessage] uid=" << uid
+                  << " msg_id=" << msg_id
+                  << " affected_rows=" << affected_rows << std::endl;
+
+        return affected_rows > 0;
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in AckOfflineMessage: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+long long MysqlDao::GetUnreadCount(int uid)
+{
+    ConnectionGuard guard = MsgReadGuard(uid);
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return -1;
+    }
+
+    try {
+        // 游标之后的 (to_uid, id) 索引区间计数
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT COUNT(*) AS cnt FROM messages "
+            "WHERE to_uid = ? AND id > IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = ?), 0)"
+        );
+        pstmt->setInt(1, uid);
+        pstmt->setInt(2, uid);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (res->next()) {
+            return res->getInt64("cnt");
+        }
+        return 0;
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in GetUnreadCount: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+bool MysqlDao::GetChatHistoryPage(int uid, long long before_id, int limit,
+    std::vector<long long>& ids, std::vector<std::string>& payloads)
+{
+    ids.clear();
+    payloads.clear();
+    if (limit <= 0) return true;
+    if (before_id <= 0) before_id = std::numeric_limits<long long>::max();
+
+    ConnectionGuard guard = MsgReadGuard(uid);
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return false;
+    }
+
+    try {
+        sql::PreparedStatement* pstmt = guard.prepare(HISTORY_PAGE_SQL);
+        pstmt->setInt(1, uid);
+        pstmt->setInt64(2, before_id);
+        pstmt->setInt(3, limit);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+
+        while (res->next()) {
+            ids.push_back(res->getInt64("id"));
+            payloads.push_back(LoadPayload(res.get(), uid));
+        }
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in GetChatHistoryPage: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void MysqlDao::GetUnreadChatMessagesPageAsync(int uid, long long after_id, int limit,
+    std::function<void(ChatMsgPage)> callback)
+{
+    if (limit <= 0) {
+        ChatMsgPage page;
+        page.ok = true;
+        callback(std::move(page));
+        return;
+    }
+    MysqlAsync::GetInstance()->QueryMsg(uid, UNREAD_PAGE_SQL, { uid, after_id, uid, limit },
+        [uid, callback](MysqlResult result) {
+            if (!result.ok) {
+                std::cerr << "[MysqlDao] GetUnreadChatMessagesPageAsync failed: " << result.error << std::endl;
+            }
+            callback(LoadPage(result, uid));
+        });
+}
+
+void MysqlDao::AckOfflineMessagesAsync(int uid, long long max_msg_id, std::function<void(bool)> callback)
+{
+    MarkWrite({ uid });
+    MysqlAsync::GetInstance()->QueryMsg(uid, RANGE_ACK_SQL, { uid, max_msg_id },
+        [uid, max_msg_id, callback](MysqlResult result) {
+            if (!result.ok) {
+                std::cerr << "[MysqlDao] AckOfflineMessagesAsync failed: " << result.error << std::endl;
+                callback(false);
+                return;
+            }
+            std::cout << "[AckOfflineMessages] uid=" << uid
+                      << " max_msg_id=" << max_msg_id
+                      << " affected_rows=" << result.affected << std::endl;
+            callback(result.affected > 0);
+        });
+}
+
+void MysqlDao::AckOfflineMessageAsync(int uid, long long msg_id, std::function<void(bool)> callback)
+{
+    MarkWrite({ uid });
+    MysqlAsync::GetInstance()->QueryMsg(uid, SINGLE_ACK_SQL, { uid, msg_id, uid },
+        [uid, msg_id, callback](MysqlResult result) {
+            if (!result.ok) {
+                std::cerr << "[MysqlDao] AckOfflineMessageAsync failed: " << result.error << std::endl;
+                callback(false);
+                return;
+            }
+            std::cout << "[AckOfflineMessage] uid=" << uid
+                      << " msg_id=" << msg_id
+                      << " affected_rows=" << result.affected << std::endl;
+            callback(result.affected > 0);
+        });
+}
+
+void MysqlDao::GetChatHistoryPageAsync(int uid, long long before_id, int limit, std::function<void(ChatMsgPage)> callback)
+{
+    if (limit <= 0) {
+        ChatMsgPage page;
+        page.ok = true;
+        callback(std::move(page));
+        return;
+    }
+    if (before_id <= 0) before_id = std::numeric_limits<long long>::max();
+    MysqlAsync::GetInstance()->QueryMsg(uid, HISTORY_PAGE_SQL, { uid, before_id, limit },
+        [uid, callback](MysqlResult result) {
+            if (!result.ok) {
+                std::cerr << "[MysqlDao] GetChatHistoryPageAsync failed: " << result.error << std::endl;
+            }
+            callback(LoadPage(result, uid));
+        });
+}
+
+size_t MysqlDao::MsgShardCount()
+{
+    auto shards = MsgShardMap::GetInstance();
+    return shards->Enabled() ? shards->Count() : 1;
+}
+
+bool MysqlDao::GetReadCursors(size_t shard, int after_uid, int limit, std::vector<std::pair<int, long long>>& cursors)
+{
+    cursors.clear();
+    auto shards = MsgShardMap::GetInstance();
+    ConnectionGuard guard(shards->Enabled() ? shards->Pool(shard) : pool_);
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return false;
+    }
+
+    try {
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT uid, read_msg_id FROM user_read_cursor WHERE uid > ? ORDER BY uid ASC LIMIT ?"
+        );
+        pstmt->setInt(1, after_uid);
+        pstmt->setInt(2, limit);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) {
+            cursors.emplace_back(res->getInt("uid"), res->getInt64("read_msg_id"));
+        }
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in GetReadCursors: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MysqlDao::GetStoredChatMessages(int uid, long long max_id, int limit, std::vector<StoredChatMsg>& rows)
+{
+    rows.clear();
+    ConnectionGuard guard(MsgPool(uid));
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return false;
+    }
+
+    try {
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "SELECT id, from_uid, payload, codec, UNIX_TIMESTAMP(create_time) AS ts FROM messages "
+            "WHERE to_uid = ? AND id <= ? ORDER BY id ASC LIMIT ?"
+        );
+        pstmt->setInt(1, uid);
+        pstmt->setInt64(2, max_id);
+        pstmt->setInt(3, limit);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) {
+            StoredChatMsg row;
+            row._id = res->getInt64("id");
+            row._from_uid = res->getInt("from_uid");
+            row._create_time = res->getInt64("ts");
+            row._codec = res->getInt("codec");
+            row._blob = ReadBlob(res.get());
+            rows.push_back(std::move(row));
+        }
+        return true;
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in GetStoredChatMessages: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+long long MysqlDao::DeleteChatMessagesUpTo(int uid, long long max_id)
+{
+    ConnectionGuard guard(MsgPool(uid));
+    if (!guard) {
+        std::cerr << "[MysqlDao] Failed to get connection from pool." << std::endl;
+        return -1;
+    }
+
+    try {
+        // (to_uid, id) 索引范围删除
+        sql::PreparedStatement* pstmt = guard.prepare(
+            "DELETE FROM messages WHERE to_uid = ? AND id <= ?"
+        );
+        pstmt->setInt(1, uid);
+        pstmt->setInt64(2, max_id);
+        return pstmt->executeUpdate();
+    }
+    catch (sql::SQLException& e) {
+        guard.markBad();
+        std::cerr << "[MysqlDao] SQLException in DeleteChatMessagesUpTo: " << e.what() << std::endl;
+        return -1;
+    }
+}
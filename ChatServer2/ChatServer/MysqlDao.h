@@ -4,6 +4,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <iostream>
@@ -14,58 +16,152 @@
 #include <cppconn/statement.h>
 #include <cppconn/exception.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include <initializer_list>
+#include <functional>
 #include "data.h"
+#include "ConnAffinity.h"
 /*数据库访问层（DAO  data access object）*/
 
 // ------------------ PooledConnection ------------------
-// 池化连接：包含连接对象 + 最后使用时间戳
+// 池化连接：包含连接对象 + 最后使用时间戳 + 预编译语句缓存
+//
+// 预编译语句缓存：
+//   同一条 SQL 文本在每个连接上只 prepare 一次，之后直接复用，
+//   省掉每次调用的服务端 prepare/deallocate 往返。
+//   缓存跟随连接：连接被判定失效并重建时，新连接从空缓存开始懒加载。
+//   声明顺序保证 stmt_cache 先于 conn 析构（语句必须在连接关闭前释放）。
 struct PooledConnection {
     std::unique_ptr<sql::Connection> conn;
     std::chrono::steady_clock::time_point last_used;
-    
+    std::chrono::steady_clock::time_point checkout_at;     // 借出时间，用于统计借出时长
+    std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>> stmt_cache;
+    // 缓存已满时临时 prepare 的语句，归还连接时释放
+    std::vector<std::unique_ptr<sql::PreparedStatement>> stmt_scratch;
+
+    // 单个连接最多缓存的语句数，防止动态拼接的 SQL（如 IN (?,?,...)）撑爆缓存
+    static constexpr size_t MAX_CACHED_STATEMENTS = 64;
+
     PooledConnection(std::unique_ptr<sql::Connection> c) 
         : conn(std::move(c)), 
-          last_used(std::chrono::steady_clock::now()) {}
+          last_used(std::chrono::steady_clock::now()), checkout_at(last_used) {}
     
     // 允许移动
     PooledConnection(PooledConnection&& other) noexcept
-        : conn(std::move(other.conn)), last_used(other.last_used) {}
+        : conn(std::move(other.conn)), last_used(other.last_used), checkout_at(other.checkout_at),
+          stmt_cache(std::move(other.stmt_cache)), stmt_scratch(std::move(other.stmt_scratch)) {}
     
     PooledConnection& operator=(PooledConnection&& other) noexcept {
         if (this != &other) {
+            stmt_scratch.clear();
+            stmt_cache.clear();
             conn = std::move(other.conn);
             last_used = other.last_used;
+            checkout_at = other.checkout_at;
+            stmt_cache = std::move(other.stmt_cache);
+            stmt_scratch = std::move(other.stmt_scratch);
         }
         return *this;
     }
+
+    ~PooledConnection() {
+        stmt_scratch.clear();
+        stmt_cache.clear();
+    }
     
     // 禁止拷贝
     PooledConnection(const PooledConnection&) = delete;
     PooledConnection& operator=(const PooledConnection&) = delete;
+
+    // 按 SQL 文本借出预编译语句（所有权仍归连接），prepare 失败时抛 sql::SQLException
+    sql::PreparedStatement* GetStatement(const std::string& sql) {
+        auto iter = stmt_cache.find(sql);
+        if (iter != stmt_cache.end()) {
+            iter->second->clearParameters();
+            return iter->second.get();
+        }
+
+        std::unique_ptr<sql::PreparedStatement> pstmt(conn->prepareStatement(sql));
+        sql::PreparedStatement* raw = pstmt.get();
+        if (stmt_cache.size() < MAX_CACHED_STATEMENTS) {
+            stmt_cache.emplace(sql, std::move(pstmt));
+        }
+        else {
+            stmt_scratch.push_back(std::move(pstmt));
+        }
+        return raw;
+    }
 };
 
 // ------------------ MySqlPool ------------------
+// 弹性连接池
+//
+// 容量：
+//   池内连接数在 [minSize, maxSize] 之间伸缩。取连接时没有空闲连接且未到上限，
+//   由维护线程补建；空闲超过 IDLE_TIMEOUT_SECONDS 的多余连接被回收，最少保留 minSize 个。
+//
+// 锁外建连：
+//   driver_->connect() 和 Ping 都不在 mutex_ 内执行，一个慢重连不会卡住其它取连接的线程。
+//   坏连接归还时只做计数，由维护线程在锁外补建；启动时按 MAX_PARALLEL_CONNECT 并行预热。
+//
+// 维护线程（每 MAINTAIN_INTERVAL_MS 一轮，或被取连接/坏连接唤醒）：
+//   1. 按 max(minSize, 使用中 + 等待中) 补建连接
+//   2. 回收闲置过久的多余连接
+//   3. 每 HEALTH_CHECK_SECONDS 对闲置超过 IDLE_THRESHOLD_SECONDS 的连接做一次 Ping（每轮至多 HEALTH_CHECK_BATCH 个）
+//   4. 每 STATS_LOG_SECONDS 输出一次统计
+//
+// 线程亲和（见 ConnAffinity）：
+//   归还的好连接先放进当前线程的槽，同一线程下次取连接直接拿回，取还都不加 mutex_；
+//   池子空了时等待者从其它线程的槽里偷，有人等待时归还方直接还给共享队列。
+//   维护线程把槽里闲置过久、或所属线程已退出的连接收回共享队列，照常做健康检查和回收。
+//
+// 统计（GetStats）：等待时长、借出时长、等待超时（池耗尽）次数、建连/回收次数等。
 class MySqlPool {
 public:
-    MySqlPool() : poolSize_(0), b_stop_(false) {}
+    struct Stats {
+        size_t idle = 0;                        // 空闲连接数
+        size_t total = 0;                       // 存活连接数（空闲 + 借出 + 检查中）
+        size_t creating = 0;                    // 正在建立的连接数
+        size_t waiting = 0;                     // 正在等待连接的线程数
+        size_t parked = 0;                      // 停在线程槽里的空闲连接数
+        size_t min_size = 0;
+        size_t max_size = 0;
+        unsigned long long checkouts = 0;       // 成功借出次数
+        unsigned long long affinity_hits = 0;   // 其中直接从本线程槽取得的次数
+        unsigned long long exhausted = 0;       // 等待超时（池耗尽）次数
+        unsigned long long created = 0;         // 新建连接数
+        unsigned long long create_failed = 0;   // 建连失败次数
+        unsigned long long reaped = 0;          // 因闲置被回收的连接数
+        unsigned long long broken = 0;          // 被判定失效并丢弃的连接数
+        double avg_wait_ms = 0;
+        double max_wait_ms = 0;
+        double avg_checkout_ms = 0;             // 借出到归还的平均时长
+        double max_checkout_ms = 0;
+    };
+
+    MySqlPool() : b_stop_(false) {}
 
     // Init 接受 url，例如 "tcp://127.0.0.1:3306"
+    // minSize: 常驻连接数，启动时并行预热；maxSize: 上限，<= minSize 时为固定大小的池
     void Init(const std::string& url,
         const std::string& user,
         const std::string& pass,
         const std::string& schema,
-        int poolSize)
+        int minSize,
+        int maxSize = 0)
     {
         url_ = url;
         user_ = user;
         pass_ = pass;
         schema_ = schema;
-        poolSize_ = poolSize;
+        min_size_ = static_cast<size_t>(std::max(minSize, MIN_POOL_SIZE));
+        max_size_ = std::max(min_size_, static_cast<size_t>(std::max(maxSize, 0)));
         b_stop_ = false;
 
         std::cout << "[MySqlPool] Init called. url=" << url_
             << " user=" << user_ << " schema=" << schema_
-            << " poolSize=" << poolSize_ << std::endl;
+            << " minSize=" << min_size_ << " maxSize=" << max_size_ << std::endl;
 
         sql::mysql::MySQL_Driver* driver = nullptr;
         try {
@@ -109,155 +205,235 @@ public:
             throw;
         }
 
-        // 保存驱动指针，供后续 getConnection() 动态创建新连接
+        // 保存驱动指针，供后续维护线程动态创建新连接
         driver_ = driver;
-        
-        // 如果 test 通过，逐个建池（每次都有 try/catch）
-        for (int i = 0; i < poolSize_; ++i) {
-            try {
-                std::unique_ptr<sql::Connection> con(driver->connect(url_, user_, pass_));
-                con->setSchema(schema_);
-                pool_.push(PooledConnection(std::move(con)));
-                std::cout << "[MySqlPool] push connection " << i << std::endl;
-            }
-            catch (sql::SQLException& e) {
-                std::cerr << "[MySqlPool] connect #" << i << " failed: " << e.what()
-                    << " (err:" << e.getErrorCode() << ", state:" << e.getSQLState() << ")" << std::endl;
-                // 这里选择：继续尝试剩下的，或直接抛出。为了稳健，这里继续但打印错误。
-            }
-            catch (const std::exception& e) {
-                std::cerr << "[MySqlPool] connect #" << i << " std::exception: " << e.what() << std::endl;
-            }
-            catch (...) {
-                std::cerr << "[MySqlPool] connect #" << i << " unknown exception" << std::endl;
-            }
+
+        // 并行预热 minSize 个连接
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            creating_ += min_size_;
         }
+        size_t warmed = CreateConnections(min_size_);
 
         // 检查池子是否为空（防止死锁）
-        if (pool_.empty()) {
+        if (warmed == 0) {
             std::cerr << "[MySqlPool] CRITICAL: Pool is empty after Init! All connection attempts failed." << std::endl;
             throw std::runtime_error("[MySqlPool] Failed to initialize any database connections");
         }
 
-        std::cout << "[MySqlPool] Init done, actual pool size = " << pool_.size() 
-                  << " (min required: " << MIN_POOL_SIZE << "), driver saved for lazy loading" << std::endl;
+        maintainer_ = std::thread(&MySqlPool::MaintainLoop, this);
+        ready_ = true;
+
+        std::cout << "[MySqlPool] Init done, warmed " << warmed << "/" << min_size_
+                  << " connections, maintainer started" << std::endl;
     }
 
-    // 从池子里取一个连接，支持自动重建
-    // 实现懒加载 + 自动重建机制：
-    //   - 超时机制：最多等待 3 秒，超时返回 nullptr（防止死锁）
-    //   - 惰性检查：闲置 > 60s 的连接才执行 Ping 检查
-    //   - 自动补充：坏连接销毁后尝试同步创建新连接
+    // 从池子里取一个连接
+    //   - 本线程槽里有连接直接借出，不加锁
+    //   - 有空闲连接直接借出（后进先出，常用的连接保持热）
+    //   - 共享队列为空时先从其它线程的槽里取
+    //   - 没有空闲连接时唤醒维护线程补建，最多等待 WAIT_TIMEOUT_SECONDS 秒，超时返回 nullptr
+    //   - 闲置 > IDLE_THRESHOLD_SECONDS 的连接借出前在锁外 Ping，失效则丢弃并继续等待
     // 调用者必须检查返回值是否为 nullptr
-    std::unique_ptr<sql::Connection> getConnection() {
+    // 返回的 PooledConnection 携带该连接的预编译语句缓存，用完通过 returnConnection 归还
+    std::unique_ptr<PooledConnection> getConnection() {
+        auto start = std::chrono::steady_clock::now();
+        if (b_stop_) return nullptr;
+
+        // 快路径：本线程上次归还的连接
+        std::unique_ptr<PooledConnection> local(affinity_.TakeLocal());
+        if (local) {
+            if (start - local->last_used <= std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+                ++affinity_hits_;
+                RecordWait(std::chrono::steady_clock::duration::zero());
+                local->checkout_at = start;
+                return local;
+            }
+            // 闲置较久，放回共享队列走下面的 Ping 流程
+            std::unique_lock<std::mutex> lock(mutex_);
+            idle_.push_back(std::move(*local));
+        }
+
+        auto deadline = start + std::chrono::seconds(WAIT_TIMEOUT_SECONDS);
         std::unique_lock<std::mutex> lock(mutex_);
-        
-        // 设置超时时间为 3 秒，防止死锁
-        if (cond_.wait_for(lock, std::chrono::seconds(3), 
-            [this] { return b_stop_ || !pool_.empty(); })) {
-            
+        for (;;) {
             if (b_stop_) return nullptr;
-            
-            // 虚假唤醒检查：即使 wait_for 返回 true，pool 也可能为空
-            if (pool_.empty()) {
-                std::cerr << "[MySqlPool] Spurious wakeup detected, pool is empty" << std::endl;
-                return nullptr;
-            }
-            
-            // 成功获取连接
-            auto pooledItem = std::move(pool_.front());
-            pool_.pop();
-            
-            // 第二层：惰性检查（防失效）
-            auto now = std::chrono::steady_clock::now();
-            auto idle_duration = std::chrono::duration_cast<std::chrono::seconds>(
-                now - pooledItem.last_used
-            );
-            
-            bool isValid = true;
-            if (idle_duration.count() > IDLE_THRESHOLD_SECONDS) {
-                // 闲置超过 60 秒，执行 Ping 检查
-                isValid = isConnectionValid(pooledItem.conn.get());
-            }
-            
-            // 第三层：自动补充（防失效）
-            if (!isValid) {
-                std::cout << "[MySqlPool] Connection stale (idle " << idle_duration.count() 
-                          << "s), attempting to reconnect..." << std::endl;
-                
-                // 销毁坏连接
-                pooledItem.conn.reset();
-                
-                // 尝试创建新连接替换
-                if (driver_) {
-                    try {
-                        std::unique_ptr<sql::Connection> new_con(
-                            driver_->connect(url_, user_, pass_)
-                        );
-                        new_con->setSchema(schema_);
-                        std::cout << "[MySqlPool] Reconnected successfully" << std::endl;
-                        return new_con;
+
+            std::unique_ptr<PooledConnection> item;
+            if (idle_.empty()) {
+                // 先登记再偷，与 returnConnection 中「先放槽再看 waiting_」配对
+                ++waiting_;
+                item.reset(affinity_.Steal());
+                if (!item) {
+                    maint_cond_.notify_one();
+                    bool ready = cond_.wait_until(lock, deadline, [this] { return b_stop_ || !idle_.empty(); });
+                    if (!ready && !b_stop_) {
+                        item.reset(affinity_.Steal());
                     }
-                    catch (sql::SQLException& e) {
-                        std::cerr << "[MySqlPool] Failed to reconnect: " << e.what() << std::endl;
-                        // 重连失败，返回 nullptr，让上层处理
+                    --waiting_;
+                    if (b_stop_) return nullptr;
+                    if (!ready && !item) {
+                        ++exhausted_;
+                        std::cerr << "[MySqlPool] getConnection timeout after " << WAIT_TIMEOUT_SECONDS
+                            << "s, total=" << total_ << " max=" << max_size_ << std::endl;
                         return nullptr;
                     }
                 }
-                
-                std::cerr << "[MySqlPool] Driver not available for reconnection" << std::endl;
-                return nullptr;
+                else {
+                    --waiting_;
+                }
+            }
+            if (!item) {
+                item = std::make_unique<PooledConnection>(std::move(idle_.front()));
+                idle_.pop_front();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - item->last_used > std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+                // 锁外 Ping，避免阻塞其它线程
+                lock.unlock();
+                bool valid = isConnectionValid(item->conn.get());
+                if (!valid) {
+                    std::cout << "[MySqlPool] Connection stale, drop it and wait for another" << std::endl;
+                    item.reset();
+                }
+                lock.lock();
+                if (!valid) {
+                    --total_;
+                    ++broken_;
+                    maint_cond_.notify_one();
+                    continue;
+                }
+                now = std::chrono::steady_clock::now();
             }
-            
-            // 连接有效，返回
-            return std::move(pooledItem.conn);
-        } else {
-            // 超时：池子在 3 秒内仍未有可用连接
-            std::cerr << "[MySqlPool] getConnection timeout after 3s, pool is empty" << std::endl;
+
+            RecordWait(now - start);
+            item->checkout_at = now;
+            return item;
+        }
+    }
+
+    // 不等待地取一个连接：只取本线程槽、共享队列和其它线程槽里无需 Ping 的连接，取不到立即返回 nullptr
+    // 供有退路的调用方使用（如从库取不到连接时改走主库）；取不到时提示维护线程多建一个连接
+    std::unique_ptr<PooledConnection> tryGetConnection() {
+        auto start = std::chrono::steady_clock::now();
+        if (b_stop_) return nullptr;
+
+        std::unique_ptr<PooledConnection> item(affinity_.TakeLocal());
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (item && start - item->last_used > std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+            idle_.push_back(std::move(*item));
+            item.reset();
+        }
+        if (!item && !idle_.empty() && start - idle_.front().last_used <= std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+            item = std::make_unique<PooledConnection>(std::move(idle_.front()));
+            idle_.pop_front();
+        }
+        if (!item) {
+            item.reset(affinity_.Steal());
+            if (item && start - item->last_used > std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+                idle_.push_back(std::move(*item));
+                item.reset();
+            }
+        }
+        if (!item) {
+            try_missed_ = true;
+            maint_cond_.notify_one();
             return nullptr;
         }
+        lock.unlock();
+
+        RecordWait(std::chrono::steady_clock::duration::zero());
+        item->checkout_at = start;
+        return item;
     }
 
     // 用完把连接放回池子
-    // isHealthy=true：连接正常，放回池子
-    // isHealthy=false：连接坏了，销毁并尝试补充新连接
-    void returnConnection(std::unique_ptr<sql::Connection> con, bool isHealthy = true) {
-        if (!con) return;
-        
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (b_stop_) return;
-        
-        if (isHealthy) {
-            // 好连接：放回池子，更新时间戳为当前时间
-            pool_.push(PooledConnection(std::move(con)));
-            cond_.notify_one();
-        } else {
-            // 坏连接：销毁并尝试补充新连接
+    // isHealthy=true：连接正常，没有线程在等时放进本线程的槽（不加锁），否则放回共享队列
+    // isHealthy=false：连接坏了，在锁外销毁，由维护线程补建
+    void returnConnection(std::unique_ptr<PooledConnection> con, bool isHealthy = true) {
+        if (!con || !con->conn) return;
+
+        auto now = std::chrono::steady_clock::now();
+        RecordCheckout(now - con->checkout_at);
+        if (!isHealthy || b_stop_) {
             con.reset();
-            
-            if (driver_) {
-                try {
-                    std::unique_ptr<sql::Connection> newCon(
-                        driver_->connect(url_, user_, pass_)
-                    );
-                    newCon->setSchema(schema_);
-                    pool_.push(PooledConnection(std::move(newCon)));
-                    std::cout << "[MySqlPool] Replaced bad connection with new one" << std::endl;
-                    cond_.notify_one();
-                }
-                catch (sql::SQLException& e) {
-                    std::cerr << "[MySqlPool] Failed to create replacement connection: " << e.what() << std::endl;
-                    // 补充失败，池子暂时缩容，依靠 getConnection 的重连逻辑恢复
-                }
+        }
+
+        if (con) {
+            con->stmt_scratch.clear();
+            con->last_used = now;
+            if (waiting_ == 0 && affinity_.ParkLocal(con.get())) {
+                con.release();
+                // 放槽之后才有人开始等：取回来交给共享队列，避免等待者等到超时
+                if (waiting_ == 0) return;
+                con.reset(affinity_.TakeLocal());
+                if (!con) return;   // 已被等待者偷走
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!con) {
+            --total_;
+            if (!b_stop_) {
+                ++broken_;
+                maint_cond_.notify_one();
             }
+            return;
         }
+
+        // 好连接：放回池子，保留语句缓存
+        idle_.push_front(std::move(*con));
+        cond_.notify_one();
     }
 
-    void Close() {
+    // Init 成功且未关闭
+    bool Ready() const { return ready_ && !b_stop_; }
+
+    Stats GetStats() {
         std::unique_lock<std::mutex> lock(mutex_);
-        b_stop_ = true;
-        while (!pool_.empty()) pool_.pop();
-        cond_.notify_all();
+        Stats stats;
+        stats.idle = idle_.size();
+        stats.total = total_;
+        stats.creating = creating_;
+        stats.waiting = waiting_;
+        stats.parked = affinity_.Parked();
+        stats.min_size = min_size_;
+        stats.max_size = max_size_;
+        stats.checkouts = checkouts_;
+        stats.affinity_hits = affinity_hits_;
+        stats.exhausted = exhausted_;
+        stats.created = created_;
+        stats.create_failed = create_failed_;
+        stats.reaped = reaped_;
+        stats.broken = broken_;
+        stats.avg_wait_ms = stats.checkouts ? wait_us_total_ / 1000.0 / stats.checkouts : 0;
+        stats.max_wait_ms = wait_us_max_ / 1000.0;
+        unsigned long long returns = returns_;
+        stats.avg_checkout_ms = returns ? hold_us_total_ / 1000.0 / returns : 0;
+        stats.max_checkout_ms = hold_us_max_ / 1000.0;
+        return stats;
+    }
+
+    void Close() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (b_stop_) return;
+            b_stop_ = true;
+            cond_.notify_all();
+            maint_cond_.notify_all();
+        }
+        if (maintainer_.joinable()) maintainer_.join();
+
+        std::deque<PooledConnection> idle;
+        size_t parked = 0;
+        affinity_.Drain([&parked](PooledConnection* item) { delete item; ++parked; });
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            idle.swap(idle_);
+            total_ -= idle.size() + parked;
+        }
+        idle.clear();
         std::cout << "[MySqlPool] Closed pool" << std::endl;
     }
 
@@ -269,22 +445,235 @@ private:
     // 配置参数
     static constexpr int IDLE_THRESHOLD_SECONDS = 60;      // 闲置多久才需要 Ping
     static constexpr int MIN_POOL_SIZE = 2;                 // 最小池子大小
-    
-    std::string host_;
+    static constexpr int WAIT_TIMEOUT_SECONDS = 3;          // 取连接最长等待时间
+    static constexpr int IDLE_TIMEOUT_SECONDS = 300;        // 多余连接闲置多久被回收
+    static constexpr int MAINTAIN_INTERVAL_MS = 1000;       // 维护线程轮询间隔
+    static constexpr int HEALTH_CHECK_SECONDS = 30;         // 后台 Ping 间隔
+    static constexpr size_t HEALTH_CHECK_BATCH = 4;         // 每轮最多取出 Ping 的连接数
+    static constexpr int STATS_LOG_SECONDS = 60;            // 统计输出间隔
+    static constexpr size_t MAX_PARALLEL_CONNECT = 8;       // 并行建连上限
+
+    // 建立一个新连接（不持有锁调用），失败返回 nullptr
+    std::unique_ptr<sql::Connection> Connect() {
+        try {
+            std::unique_ptr<sql::Connection> con(driver_->connect(url_, user_, pass_));
+            con->setSchema(schema_);
+            return con;
+        }
+        catch (sql::SQLException& e) {
+            std::cerr << "[MySqlPool] connect failed: " << e.what()
+                << " (err:" << e.getErrorCode() << ", state:" << e.getSQLState() << ")" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[MySqlPool] connect std::exception: " << e.what() << std::endl;
+        }
+        catch (...) {
+            std::cerr << "[MySqlPool] connect unknown exception" << std::endl;
+        }
+        return nullptr;
+    }
+
+    // 锁外并行建立 count 个连接并放入池子，调用前须已把 count 计入 creating_
+    size_t CreateConnections(size_t count) {
+        size_t ok = 0;
+        while (count > 0) {
+            size_t wave = std::min(count, MAX_PARALLEL_CONNECT);
+            std::vector<std::unique_ptr<sql::Connection>> conns(wave);
+            std::vector<std::thread> workers;
+            workers.reserve(wave);
+            for (size_t i = 0; i < wave; ++i) {
+                workers.emplace_back([this, &conns, i] { conns[i] = Connect(); });
+            }
+            for (auto& t : workers) t.join();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (auto& con : conns) {
+                --creating_;
+                if (!con) {
+                    ++create_failed_;
+                    continue;
+                }
+                ++created_;
+                ++ok;
+                if (b_stop_) continue;
+                ++total_;
+                idle_.emplace_front(std::move(con));
+                cond_.notify_one();
+            }
+            count -= wave;
+        }
+        return ok;
+    }
+
+    void MaintainLoop() {
+        auto last_check = std::chrono::steady_clock::now();
+        auto last_log = last_check;
+        bool backoff = false;   // 上一轮建连失败时本轮不被唤醒提前，避免数据库不可用时空转
+        for (;;) {
+            size_t need = 0;
+            std::vector<PooledConnection> reaped;
+            std::vector<PooledConnection> to_check;
+            auto now = std::chrono::steady_clock::now();
+
+            // 0. 线程槽里闲置过久或所属线程已退出的连接收回共享队列，参与下面的回收和健康检查
+            std::vector<std::unique_ptr<PooledConnection>> reclaimed;
+            affinity_.Reclaim(
+                [now](PooledConnection* item) { return now - item->last_used > std::chrono::seconds(IDLE_THRESHOLD_SECONDS); },
+                [&reclaimed](PooledConnection* item) { reclaimed.emplace_back(item); });
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                for (auto& item : reclaimed) {
+                    idle_.push_back(std::move(*item));
+                }
+                reclaimed.clear();
+                maint_cond_.wait_for(lock, std::chrono::milliseconds(MAINTAIN_INTERVAL_MS), [this, backoff] {
+                    return b_stop_ || (!backoff &&
+                        total_ + creating_ < std::min(max_size_, std::max(min_size_, InUse() + waiting_ + (try_missed_ ? 1 : 0))));
+                });
+                if (b_stop_) return;
+                now = std::chrono::steady_clock::now();
+
+                // 1. 补建：常驻数不足，或有线程在等（含 tryGetConnection 落空）且未到上限
+                size_t demand = InUse() + waiting_ + (try_missed_ ? 1 : 0);
+                try_missed_ = false;
+                size_t target = std::min(max_size_, std::max(min_size_, demand));
+                if (total_ + creating_ < target) {
+                    need = target - total_ - creating_;
+                    creating_ += need;
+                }
+
+                // 2. 回收：队尾是最久未用的连接
+                while (total_ > min_size_ && !idle_.empty() &&
+                    now - idle_.back().last_used > std::chrono::seconds(IDLE_TIMEOUT_SECONDS)) {
+                    reaped.push_back(std::move(idle_.back()));
+                    idle_.pop_back();
+                    --total_;
+                    ++reaped_;
+                }
+
+                // 3. 健康检查：每轮从队尾取出至多 HEALTH_CHECK_BATCH 个闲置较久的连接，锁外 Ping；
+                //    一轮取不完时不更新 last_check，下一轮（MAINTAIN_INTERVAL_MS 后）继续
+                if (now - last_check > std::chrono::seconds(HEALTH_CHECK_SECONDS)) {
+                    for (auto iter = idle_.end(); iter != idle_.begin() && to_check.size() < HEALTH_CHECK_BATCH;) {
+                        --iter;
+                        if (now - iter->last_used > std::chrono::seconds(IDLE_THRESHOLD_SECONDS)) {
+                            to_check.push_back(std::move(*iter));
+                            iter = idle_.erase(iter);
+                        }
+                    }
+                    checking_ = to_check.size();
+                    if (to_check.size() < HEALTH_CHECK_BATCH) {
+                        last_check = now;
+                    }
+                }
+            }
+
+            // 以下均在锁外执行
+            reaped.clear();
+            backoff = need > 0 && CreateConnections(need) < need;
+            if (!to_check.empty()) {
+                // 逐个 Ping、逐个归还，健康的连接不必等整批检查完才能被取走
+                size_t dead = 0;
+                for (auto& item : to_check) {
+                    bool valid = isConnectionValid(item.conn.get());
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    --checking_;
+                    if (valid) {
+                        item.last_used = std::chrono::steady_clock::now();
+                        idle_.push_front(std::move(item));
+                        cond_.notify_one();
+                    }
+                    else {
+                        --total_;
+                        ++broken_;
+                        ++dead;
+                    }
+                }
+                to_check.clear();
+                if (dead > 0) {
+                    std::cout << "[MySqlPool] health check dropped " << dead << " dead connections" << std::endl;
+                }
+            }
+
+            if (now - last_log > std::chrono::seconds(STATS_LOG_SECONDS)) {
+                last_log = now;
+                Stats s = GetStats();
+                std::cout << "[MySqlPool] stats: total=" << s.total << " idle=" << s.idle
+                    << " parked=" << s.parked << " waiting=" << s.waiting << " checkouts=" << s.checkouts
+                    << " affinity_hits=" << s.affinity_hits
+                    << " exhausted=" << s.exhausted << " avg_wait_ms=" << s.avg_wait_ms
+                    << " max_wait_ms=" << s.max_wait_ms << " avg_checkout_ms=" << s.avg_checkout_ms
+                    << " max_checkout_ms=" << s.max_checkout_ms << " created=" << s.created
+                    << " reaped=" << s.reaped << " broken=" << s.broken << std::endl;
+            }
+        }
+    }
+
+    // 在持有 mutex_ 时调用；正在健康检查的连接不算占用，否则会被误判为需要扩容
+    size_t InUse() const {
+        size_t free = idle_.size() + affinity_.Parked() + checking_;
+        return total_ > free ? total_ - free : 0;
+    }
+
+    // 以下统计可在锁外调用（快路径不持有 mutex_）
+    void RecordWait(std::chrono::steady_clock::duration d) {
+        auto us = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        ++checkouts_;
+        wait_us_total_ += us;
+        UpdateMax(wait_us_max_, us);
+    }
+
+    void RecordCheckout(std::chrono::steady_clock::duration d) {
+        auto us = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        ++returns_;
+        hold_us_total_ += us;
+        UpdateMax(hold_us_max_, us);
+    }
+
+    static void UpdateMax(std::atomic<unsigned long long>& target, unsigned long long value) {
+        unsigned long long cur = target.load(std::memory_order_relaxed);
+        while (value > cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+        }
+    }
+
     std::string url_;
     std::string user_;
     std::string pass_;
     std::string schema_;
-    int poolSize_ = 0;
+    size_t min_size_ = MIN_POOL_SIZE;
+    size_t max_size_ = MIN_POOL_SIZE;
 
     // 保存 MySQL 驱动指针，用于动态创建新连接（懒加载）
     sql::mysql::MySQL_Driver* driver_ = nullptr;
 
-    std::queue<PooledConnection> pool_;
+    std::deque<PooledConnection> idle_;     // 队头最近使用，队尾最久未用
+    size_t total_ = 0;
+    size_t creating_ = 0;
+    size_t checking_ = 0;                   // 维护线程取出做健康检查、尚未归还的连接数
+    bool try_missed_ = false;               // tryGetConnection 上次落空，维护线程据此多建一个
+    std::atomic<size_t> waiting_{ 0 };    // 在 mutex_ 内修改，归还快路径在锁外读取
     std::mutex mutex_;
-    std::condition_variable cond_;
+    std::condition_variable cond_;          // 通知等待连接的线程
+    std::condition_variable maint_cond_;    // 唤醒维护线程
+    std::thread maintainer_;
     std::atomic<bool> b_stop_;
-    
+    std::atomic<bool> ready_{ false };
+
+    ConnAffinity<PooledConnection> affinity_;
+
+    std::atomic<unsigned long long> checkouts_{ 0 };
+    std::atomic<unsigned long long> affinity_hits_{ 0 };
+    unsigned long long exhausted_ = 0;
+    unsigned long long created_ = 0;
+    unsigned long long create_failed_ = 0;
+    unsigned long long reaped_ = 0;
+    unsigned long long broken_ = 0;
+    std::atomic<unsigned long long> returns_{ 0 };
+    std::atomic<unsigned long long> wait_us_total_{ 0 };
+    std::atomic<unsigned long long> wait_us_max_{ 0 };
+    std::atomic<unsigned long long> hold_us_total_{ 0 };
+    std::atomic<unsigned long long> hold_us_max_{ 0 };
+
     // 辅助方法：检查连接是否有效（不持有锁调用）
     bool isConnectionValid(sql::Connection* con) {
         if (!con) return false;
@@ -304,13 +693,18 @@ private:
     }
 };
 
+// 只读从库连接池：与主库池同实现，单独一个单例，配置 [MysqlReplica] 时初始化
+class MySqlReplicaPool : public MySqlPool {
+};
+
 // RAII 连接守卫：自动归还连接，彻底杜绝泄漏
 // 使用方式：
 //   ConnectionGuard guard(pool_);
 //   if (!guard) return false;
-//   sql::Connection* con = guard.get();
 //   try {
-//       // 使用 con 执行 SQL
+//       // 固定 SQL 通过 guard.prepare() 借用连接上缓存的预编译语句（不要 delete）
+//       sql::PreparedStatement* pstmt = guard.prepare("SELECT ... WHERE uid = ?");
+//       // 其它操作（事务、Statement 等）使用 guard.get() 拿到原始连接
 //   } catch (...) {
 //       guard.markBad();  // 标记连接为坏的
 //       throw;
@@ -324,6 +718,16 @@ public:
         }
     }
 
+    // 不等待地取连接，见 MySqlPool::tryGetConnection
+    static ConnectionGuard TryAcquire(std::shared_ptr<MySqlPool> pool) {
+        ConnectionGuard guard(nullptr);
+        if (pool) {
+            guard.con_ = pool->tryGetConnection();
+            guard.pool_ = std::move(pool);
+        }
+        return guard;
+    }
+
     ~ConnectionGuard() {
         if (pool_ && con_) {
             pool_->returnConnection(std::move(con_), is_healthy_);
@@ -348,7 +752,10 @@ public:
     }
     
     // 获取原始指针用于操作
-    sql::Connection* get() { return con_.get(); }
+    sql::Connection* get() { return con_ ? con_->conn.get() : nullptr; }
+
+    // 从连接的语句缓存中借用预编译语句，所有权归连接，调用方不得释放
+    sql::PreparedStatement* prepare(const std::string& sql) { return con_->GetStatement(sql); }
     
     // 判断是否获取成功
     operator bool() const { return con_ != nullptr; }
@@ -358,7 +765,7 @@ public:
 
 private:
     std::shared_ptr<MySqlPool> pool_;
-    std::unique_ptr<sql::Connection> con_;
+    std::unique_ptr<PooledConnection> con_;
     bool is_healthy_;  // 连接是否健康
 };
 
@@ -383,10 +790,71 @@ public:
     std::vector<UserInfo> GetMyFriends(int uid);
     bool IsFriend(int uid1, int uid2);
     bool SaveChatMessage(int fromUid, int toUid, const std::string& payload);
+    // 批量写入：每个分片一条多行 INSERT + 一个事务，分片内全部成功或全部回滚；成功的记录回填 _id。
+    // 只写 _id 为 0 的记录，全部写入时返回 true；部分分片失败时返回 false，调用方拿同一批重试即只重写失败的分片。
+    // 按去重键幂等，重放不会重复入库
+    bool SaveChatMessages(std::vector<ChatMsgRecord>& msgs);
     bool GetUnreadChatMessagesWithIds(int uid, std::vector<long long>& ids, std::vector<std::string>& payloads);
-    bool DeleteChatMessagesByIds(const std::vector<long long>& ids);
+    // 键集分页：取 id > max(after_id, 已读游标) 的前 limit 条消息，走 (to_uid, id) 索引
+    bool GetUnreadChatMessagesPage(int uid, long long after_id, int limit,
+        std::vector<long long>& ids, std::vector<std::string>& payloads);
+    // 把用户的已读游标推进到 max_msg_id（单行 upsert，只前进不后退），用于离线分页的游标确认。
+    // max_msg_id 必须是发给该用户的一条已入库消息的 id，否则拒绝；返回是否接受（游标已更新或本来就不小于它）
     bool AckOfflineMessages(int uid, long long max_msg_id);
+    // 在线消息逐条确认：msg_id 是发给该用户的消息，且已读游标与它之间没有别的消息时才推进到 msg_id。
+    // 中间还有没确认的消息（例如离线分页还没拉到）时拒绝，游标留给分页确认推进。返回是否接受
+    bool AckOfflineMessage(int uid, long long msg_id);
+    // 未读条数，失败返回 -1
+    long long GetUnreadCount(int uid);
+    // 收件历史：id < before_id 的最多 limit 条消息，按 id 降序；before_id <= 0 表示从最新开始
+    bool GetChatHistoryPage(int uid, long long before_id, int limit,
+        std::vector<long long>& ids, std::vector<std::string>& payloads);
+
+    // 非阻塞版本（见 MysqlAsync）：语义和 SQL 同上面的同名方法，不占线程等待，
+    // callback 在 IO 线程上执行，须先确认 MysqlAsync::Enabled()。
+    // 同一 uid 的调用落在同一条连接上，按调用顺序执行（确认一定先于随后的分页查询）。
+    // 页结果只填 ok / ids / payloads，has_more 由调用方按 limit 判断
+    void GetUnreadChatMessagesPageAsync(int uid, long long after_id, int limit, std::function<void(ChatMsgPage)> callback);
+    void AckOfflineMessagesAsync(int uid, long long max_msg_id, std::function<void(bool)> callback);
+    void AckOfflineMessageAsync(int uid, long long msg_id, std::function<void(bool)> callback);
+    void GetChatHistoryPageAsync(int uid, long long before_id, int limit, std::function<void(ChatMsgPage)> callback);
+
+    // 归档（见 MsgArchive）
+    // 分片数，未分片时为 1
+    size_t MsgShardCount();
+    // 分片 shard 上 uid > after_uid 的前 limit 个已读游标，按 uid 升序
+    bool GetReadCursors(size_t shard, int after_uid, int limit, std::vector<std::pair<int, long long>>& cursors);
+    // uid 已读（id <= max_id）的最早 limit 条消息，按 id 升序，payload 保持存储格式
+    bool GetStoredChatMessages(int uid, long long max_id, int limit, std::vector<StoredChatMsg>& rows);
+    // 删除 uid 的 id <= max_id 的消息，返回删除行数，失败返回 -1
+    long long DeleteChatMessagesUpTo(int uid, long long max_id);
 private:
+    // 读写分离
+    //   只读查询通过 ReadGuard 取连接：从库可用时走从库，从库池没有现成的空闲连接时不等待，立即回退主库。
+    //   读你所写：写操作前 MarkWrite 记下涉及的 uid，这些 uid 在 sticky_ 窗口内的读仍走主库，
+    //   窗口应大于从库复制延迟（[MysqlReplica] StickyMs）。
+    //   recent_writes_ 只在本进程内：用户在 sticky_ 窗口内换到另一台 ChatServer（重连、负载均衡），
+    //   那台服务器不知道这次写入，读可能落到尚未追上的从库，读你所写只在用户留在同一台服务器时成立。
+    ConnectionGuard ReadGuard(std::initializer_list<int> uids);
+    // 消息表按收件人分片（见 MsgShardMap），未分片时为主库 / ReadGuard
+    std::shared_ptr<MySqlPool> MsgPool(int to_uid);
+    ConnectionGuard MsgReadGuard(int uid);
+    bool SaveChatMessagesOn(std::shared_ptr<MySqlPool> pool, std::vector<ChatMsgRecord>& msgs);
+    // 在同一事务内按 (from_uid, to_uid, client_msg_id) 查回每条消息的 id，找不到时抛出 SQLException
+    static void ResolveChatMessageIds(sql::Connection* con, std::vector<ChatMsgRecord>& msgs);
+    void MarkWrite(std::initializer_list<int> uids);
+    void MarkWrite(const std::vector<ChatMsgRecord>& msgs);
+    bool RecentlyWritten(std::initializer_list<int> uids);
+    void PruneRecentWrites(std::chrono::steady_clock::time_point now);
+
     std::shared_ptr<MySqlPool> pool_;
+    std::shared_ptr<MySqlPool> replica_;
+    std::chrono::milliseconds sticky_;
+    std::mutex recent_mutex_;
+    std::unordered_map<int, std::chrono::steady_clock::time_point> recent_writes_;  // uid -> 最近一次写入时间
+    size_t mark_count_ = 0;
+
+    static constexpr int DEFAULT_STICKY_MS = 1000;
+    static constexpr size_t PRUNE_EVERY = 4096;
 };
 
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include "Singleton.h"
+#include "data.h"
+
+struct RedisScriptCall;
+
+// 离线收件箱：Redis 热层 + MySQL 冷层
+//
+// 作用：
+//   messages 表是唯一的持久化来源（冷层）。每条消息写库成功、拿到 messages.id 之后，
+//   再按收件人写入 Redis 有序集合 inbox_{uid}（热层，score = messages.id），只保留最新 HotMax 条。
+//   离线拉取时先查热层：游标落在热层覆盖范围内就直接从 Redis 出页（一次往返），否则回落到 MySQL 键集分页。
+//   两层使用同一个 id 和同一个游标，按 id > cursor 取下一页，天然不会重复或跳过。
+//
+// 热层结构（单个 ZSET，避免元数据和数据被分别淘汰）：
+//   "~<epoch>:<read>"   哨兵，score = floor：热层保证包含所有 id > floor 的消息；read 为已确认到的游标
+//   "<id>:<payload>"    消息，score = id
+//   游标 max(cursor, read) >= floor 时命中；裁剪旧消息或确认时上调 floor
+//
+// 失效：
+//   哨兵代数 = 全局代数 inbox_epoch + "." + 用户代数（水位哈希的 epoch 字段），由脚本每次现读，不在进程里缓存。
+//   代数不一致的热层视为失效，下一次写入时以新消息 id - 1 为 floor 重建。
+//   - 单机模式：服务启动时、写热层失败后立即递增全局代数（失败时重试），一直递增不上时改为递增这批收件人的用户代数。
+//     进程在「已入库、未写热层」之间崩溃，或者 Redis 短暂不可用导致漏写，都不会让热层在覆盖范围内缺消息。
+//   - 集群模式：inbox_epoch 与用户的键不在同一个槽，脚本不读它（全局部分固定为 "-"），
+//     写热层失败时递增这批收件人的用户代数；写入方崩溃时，其登记的 ticket 过期后由 Observe 递增用户代数。
+//     没登记上（BeginWrite 失败）又在写库后崩溃的那一批不在覆盖范围内。
+//   水位哈希与热层一起续期，且续期更频繁，用户代数不会先于热层过期而回到旧值。
+//
+// 未读水位（inbox_state_{uid} 哈希，不随代数失效）：
+//   hwm     该用户已入库消息的最大 id
+//   read    已确认到的游标
+//   epoch   用户代数，见上
+//   热层未命中时，没有进行中的写入且 hwm <= max(cursor, read) 即可直接回「没有新消息」，不查 MySQL。
+//   重连风暴时绝大多数用户没有未读，登录后的离线拉取基本不再落到数据库。
+//   hwm 缺失（首次、过期、写库失败后置为未知）或有进行中的写入时回落 MySQL；
+//   MySQL 确认没有更多未读后用查到的位置重建 hwm，超过 WIP_STALE_MS 的 ticket 视为写入方已崩溃并删除。
+//
+// 进行中的写入（inbox_wip_{uid} 有序集合）：
+//   "<开始时间>:<进程 nonce>-<序号>"  ticket，score = 写库前的 hwm（未知时为 0）
+//   id 在写库时才分配，多个写入并发时后分配的 id 可能先写进热层。进行中写入的 id 都大于各自的 score，
+//   热层只保证最小 score（W）以下是完整的：有进行中的写入时只出 (cursor, W] 的消息并让客户端接着拉，
+//   游标已到 W 时回落 MySQL。否则大 id 先出页、被确认，后写进来的小 id 就落在 floor 以下再也拉不到。
+//   确认的游标由 MySQL 校验（user_inbox_lock 让同一收件人的 id 按提交顺序分配），热层只出已提交的 id，
+//   两边都不会越过还没提交的消息。
+//
+// 集群：
+//   同一用户的热层和水位以 {uid} 为 hash tag 落在同一个槽；一批消息涉及多个收件人时，脚本按槽拆成多次调用，
+//   一起流水线发送（RedisMgr::EvalScripts）。单机模式下仍是一次调用。
+//
+// 配置（config.ini）：
+//   [OfflineInbox]
+//   Enable = 1
+//   HotMax = 200           // 每个用户热层最多保留条数
+//   TtlSec = 604800        // 热层过期时间，每次写入续期
+class OfflineInbox : public Singleton<OfflineInbox> {
+    friend class Singleton<OfflineInbox>;
+public:
+    // 读取 [OfflineInbox] 配置；单机模式下递增全局代数使旧热层失效
+    void Init();
+
+    bool Enabled() const { return b_enabled_; }
+
+    // 写库前调用：为这些收件人登记进行中的写入，返回 ticket（未启用或登记失败时为空），原样交给 EndWrite，线程安全
+    std::string BeginWrite(const std::vector<ChatMsgRecord>& msgs);
+
+    // 写库结束后调用。按收件人处理：消息都已入库（_id 已回填）的写入热层并推进 hwm；
+    // 有消息没入库的把 hwm 置为未知；ticket 为空（没登记上）时不写热层，直接让热层失效。
+    // 同一收件人的消息在同一分片，要么都成功要么都失败。线程安全
+    void EndWrite(const std::vector<ChatMsgRecord>& msgs, const std::string& ticket);
+
+    // 从热层取 id > cursor 的最多 limit 条未读消息，有进行中的写入时只取到它们的水位并置 has_more
+    // 热层命中，或水位表明没有新消息（返回空页）时返回 true；
+    // 否则返回 false，调用方改查 MySQL
+    bool ReadPage(int uid, long long cursor, int limit, ChatMsgPage& page);
+
+    // MySQL 确认 seen 之后没有更多未读时调用，重建 hwm
+    void Observe(int uid, long long seen);
+
+    // 确认 <= cursor 的消息已读，从热层删除并记录游标。
+    // 调用方先经 MySQL 确认 cursor 合法；脚本另外拒绝超过 hwm（或 hwm 未知）的游标
+    void Ack(int uid, long long cursor);
+
+private:
+    OfflineInbox();
+
+    static long long NowMs();
+    // 递增全局代数（单机模式）
+    bool BumpEpoch();
+    // 写热层失败后立即调用：单机模式下递增全局代数，失败时重试；
+    // 仍失败或集群模式下递增这些收件人的用户代数（同样重试）
+    void Invalidate(const std::vector<int>& uids);
+    // 在 Redis 里把这些收件人的 hwm 置为未知（ticket 非空时同时删除这次写入的登记），失败时重试；
+    // 仍失败则记入 dirty_uids_，下次 BeginWrite 时再清
+    void ClearHwm(const std::vector<int>& uids, const std::string& ticket);
+    // EvalScripts，失败时按 INVALIDATE_RETRY_MS 退避重试，共 INVALIDATE_RETRIES 次
+    bool EvalRetry(const std::string& name, const std::vector<RedisScriptCall>& calls);
+
+    std::atomic<bool> b_enabled_;
+    std::atomic<bool> b_epoch_pending_; // 单机模式下启动时或失效时没能递增全局代数：本进程不读热层，下次写入前再递增
+    int hot_max_;
+    int ttl_sec_;
+
+    // ClearHwm 重试后仍没能清掉 hwm 的收件人（Redis 整体不可用），下次 BeginWrite 时再清
+    std::mutex dirty_mutex_;
+    std::set<int> dirty_uids_;
+
+    std::string nonce_;                 // 本进程的随机标识，ticket 的一部分
+    std::atomic<unsigned long long> seq_;
+
+    static constexpr long long WIP_STALE_MS = 30000;
+    static constexpr int INVALIDATE_RETRIES = 3;        // 递增全局代数 / 用户代数 / 清 hwm 各自的尝试次数
+    static constexpr int INVALIDATE_RETRY_MS = 50;      // 重试间隔，逐次翻倍
+};
@@ -0,0 +1,175 @@
+#include "ProfileCache.h"
+#include "ConfigMgr.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+void ProfileCache::Init()
+{
+    auto& cfg = ConfigMgr::Inst();
+    if (cfg["ProfileCache"]["Enable"] == "0") {
+        std::cout << "[ProfileCache] disabled" << std::endl;
+        return;
+    }
+    int capacity = 100000;
+    int shards = 16;
+    int ttl_sec = 600;
+    try { capacity = std::stoi(cfg["ProfileCache"]["Capacity"]); }
+    catch (...) {}
+    try { shards = std::stoi(cfg["ProfileCache"]["Shards"]); }
+    catch (...) {}
+    try { ttl_sec = std::stoi(cfg["ProfileCache"]["TtlSec"]); }
+    catch (...) {}
+    if (capacity <= 0) capacity = 100000;
+    if (shards <= 0) shards = 16;
+    if (ttl_sec <= 0) ttl_sec = 600;
+
+    capacity_ = static_cast<size_t>(capacity);
+    shard_capacity_ = std::max<size_t>(1, capacity_ / static_cast<size_t>(shards));
+    ttl_ = std::chrono::seconds(ttl_sec);
+    for (int i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+    last_log_sec_ = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    b_enabled_ = true;
+    std::cout << "[ProfileCache] enabled, capacity=" << capacity_ << " shards=" << shards
+        << " ttl=" << ttl_sec << "s" << std::endl;
+}
+
+std::shared_ptr<const UserInfo> ProfileCache::Get(int uid, Ticket& ticket)
+{
+    ticket = 0;
+    if (!b_enabled_) {
+        return nullptr;
+    }
+    MaybeLogStats();
+    auto& shard = ShardOf(uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ticket = shard.generation;
+    auto iter = shard.entries.find(uid);
+    if (iter == shard.entries.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    if (std::chrono::steady_clock::now() >= iter->second.expire_at) {
+        shard.lru.erase(iter->second.lru);
+        shard.entries.erase(iter);
+        ++expired_;
+        ++misses_;
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.lru);
+    ++hits_;
+    return iter->second.info;
+}
+
+void ProfileCache::Put(const UserInfo& info, Ticket ticket)
+{
+    if (!b_enabled_) {
+        return;
+    }
+    auto copy = std::make_shared<UserInfo>(info);
+    copy->pwd.clear();
+    auto& shard = ShardOf(info.uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.generation != ticket) {
+        ++stale_puts_;
+        return;
+    }
+    auto expire_at = std::chrono::steady_clock::now() + ttl_;
+    auto iter = shard.entries.find(info.uid);
+    if (iter != shard.entries.end()) {
+        iter->second.info = std::move(copy);
+        iter->second.expire_at = expire_at;
+        shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.lru);
+        return;
+    }
+    shard.lru.push_front(info.uid);
+    shard.entries.emplace(info.uid, Entry{ std::move(copy), expire_at, shard.lru.begin() });
+    while (shard.entries.size() > shard_capacity_) {
+        shard.entries.erase(shard.lru.back());
+        shard.lru.pop_back();
+        ++evictions_;
+    }
+}
+
+void ProfileCache::Invalidate(int uid)
+{
+    if (!b_enabled_) {
+        return;
+    }
+    auto& shard = ShardOf(uid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+    auto iter = shard.entries.find(uid);
+    if (iter != shard.entries.end()) {
+        shard.lru.erase(iter->second.lru);
+        shard.entries.erase(iter);
+        ++invalidations_;
+    }
+}
+
+void ProfileCache::OnInvalidate(const std::string& payload)
+{
+    std::stringstream in(payload);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        try {
+            Invalidate(std::stoi(item));
+        }
+        catch (...) {
+            std::cerr << "[ProfileCache] bad invalidation payload: " << payload << std::endl;
+            return;
+        }
+    }
+}
+
+void ProfileCache::Clear()
+{
+    size_t dropped = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        ++shard->generation;
+        dropped += shard->entries.size();
+        shard->entries.clear();
+        shard->lru.clear();
+    }
+    if (b_enabled_) {
+        std::cout << "[ProfileCache] cleared " << dropped << " entries" << std::endl;
+    }
+}
+
+ProfileCache::Stats ProfileCache::GetStats()
+{
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.expired = expired_;
+    stats.invalidations = invalidations_;
+    stats.evictions = evictions_;
+    stats.stale_puts = stale_puts_;
+    stats.capacity = capacity_;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.size += shard->entries.size();
+    }
+    auto lookups = stats.hits + stats.misses;
+    stats.hit_rate = lookups ? stats.hits * 100.0 / lookups : 0;
+    return stats;
+}
+
+void ProfileCache::MaybeLogStats()
+{
+    long long now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    long long last = last_log_sec_;
+    if (now - last < STATS_LOG_SECONDS || !last_log_sec_.compare_exchange_strong(last, now)) {
+        return;
+    }
+    auto stats = GetStats();
+    std::cout << "[ProfileCache] size=" << stats.size << "/" << stats.capacity
+        << " hits=" << stats.hits << " misses=" << stats.misses << " hit_rate=" << stats.hit_rate << "%"
+        << " expired=" << stats.expired << " invalidations=" << stats.invalidations
+        << " evictions=" << stats.evictions << " stale_puts=" << stats.stale_puts << std::endl;
+}
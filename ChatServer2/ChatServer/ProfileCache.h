@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Singleton.h"
+#include "data.h"
+
+// 用户资料进程内缓存（近端缓存）
+//
+// 作用：
+//   登录时资料随登录脚本从 Redis 用户哈希取回，未命中再查 MySQL 并回填。
+//   这里在进程内按 uid 缓存解码好的 UserInfo（不含密码），命中时登录脚本只校验 token、登记路由，
+//   不再取回资料字段；用户哈希里缺资料时也不必再查 MySQL、再跑一次脚本。
+//
+// 结构：
+//   按 uid 分成 Shards 个分片，每个分片一把锁、一条 LRU 链表，超过 Capacity / Shards 条时淘汰最久未用的。
+//   缓存的是 shared_ptr<const UserInfo>，读出后在锁外使用，不会被并发修改。
+//
+// 一致性：
+//   修改资料的一方写完 MySQL 和用户哈希后 PUBLISH PROFILE_CHANNEL <uid>，各 ChatServer 订阅后删除对应条目。
+//   目前还没有修改昵称、签名、性别、头像的接口（改密码不涉及缓存字段），也就没有发布方，
+//   资料的陈旧时间只由 TtlSec 限定；以后加资料修改接口时须在写完后发布。
+//   订阅连接断开期间的消息会丢失，每次（重新）订阅成功时清空整个缓存；
+//   每条记录另有 TtlSec 的存活上限，兜底其它漏掉的失效。
+//   查 Redis / MySQL 期间若收到该用户的失效，回填会被丢弃（见 Ticket），避免把旧资料放回缓存。
+//
+// 统计：
+//   命中、未命中、失效、淘汰、过期次数，每 STATS_LOG_SECONDS 随查询输出一次命中率。
+//
+// 配置（config.ini）：
+//   [ProfileCache]
+//   Enable = 1
+//   Capacity = 100000      // 总条数上限
+//   Shards = 16
+//   TtlSec = 600           // 单条记录最长存活时间
+class ProfileCache : public Singleton<ProfileCache> {
+    friend class Singleton<ProfileCache>;
+public:
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;          // 含过期
+        unsigned long long expired = 0;         // 因超过 TtlSec 丢弃的条数
+        unsigned long long invalidations = 0;   // 收到失效时实际删除的条数
+        unsigned long long evictions = 0;       // LRU 淘汰条数
+        unsigned long long stale_puts = 0;      // 因期间收到失效而放弃的回填
+        size_t size = 0;
+        size_t capacity = 0;
+        double hit_rate = 0;                    // 百分比
+    };
+
+    // 回填凭证：查询前取得，回填时检查期间是否收到过失效
+    using Ticket = unsigned long long;
+
+    // 读取 [ProfileCache] 配置，Enable = 0 时 Get 总是未命中、Put 不缓存
+    void Init();
+
+    bool Enabled() const { return b_enabled_; }
+
+    // 命中返回资料；未命中返回空指针，ticket 用于之后的 Put
+    std::shared_ptr<const UserInfo> Get(int uid, Ticket& ticket);
+
+    // 回填（不保存密码）。ticket 之后该用户收到过失效或缓存被清空时放弃
+    void Put(const UserInfo& info, Ticket ticket);
+
+    // 删除一个用户的缓存（失效消息、本服修改资料后调用）
+    void Invalidate(int uid);
+
+    // 处理失效频道的消息，payload 为逗号分隔的 uid
+    void OnInvalidate(const std::string& payload);
+
+    // 清空全部缓存（订阅连接重新建立时调用）
+    void Clear();
+
+    Stats GetStats();
+
+private:
+    ProfileCache() = default;
+
+    struct Entry {
+        std::shared_ptr<const UserInfo> info;
+        std::chrono::steady_clock::time_point expire_at;
+        std::list<int>::iterator lru;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<int> lru;                         // 头部最近使用
+        std::unordered_map<int, Entry> entries;
+        Ticket generation = 0;                      // 本分片每次失效 / 清空加 1
+    };
+
+    Shard& ShardOf(int uid) { return *shards_[static_cast<unsigned int>(uid) % shards_.size()]; }
+    void MaybeLogStats();
+
+    bool b_enabled_ = false;
+    size_t capacity_ = 100000;
+    size_t shard_capacity_ = 0;
+    std::chrono::seconds ttl_{ 600 };
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<unsigned long long> hits_{ 0 };
+    std::atomic<unsigned long long> misses_{ 0 };
+    std::atomic<unsigned long long> expired_{ 0 };
+    std::atomic<unsigned long long> invalidations_{ 0 };
+    std::atomic<unsigned long long> evictions_{ 0 };
+    std::atomic<unsigned long long> stale_puts_{ 0 };
+    std::atomic<long long> last_log_sec_{ 0 };
+
+    static constexpr long long STATS_LOG_SECONDS = 60;
+};
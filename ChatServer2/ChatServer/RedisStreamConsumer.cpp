@@ -0,0 +1,252 @@
+#include "RedisStreamConsumer.h"
+#include "RedisRouter.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+namespace {
+    constexpr std::chrono::milliseconds MIN_BACKOFF(200);
+    constexpr std::chrono::milliseconds MAX_BACKOFF(5000);
+
+    using ReplyPtr = std::unique_ptr<redisReply, void(*)(void*)>;
+
+    ReplyPtr Command(redisContext* ctx, const std::vector<std::string>& cmd)
+    {
+        std::vector<const char*> argv;
+        std::vector<size_t> argvlen;
+        for (const auto& arg : cmd) {
+            argv.push_back(arg.data());
+            argvlen.push_back(arg.size());
+        }
+        auto* reply = static_cast<redisReply*>(
+            redisCommandArgv(ctx, static_cast<int>(argv.size()), argv.data(), argvlen.data()));
+        return ReplyPtr(reply, freeReplyObject);
+    }
+
+    std::string ReplyString(const redisReply* reply)
+    {
+        if (reply == nullptr || reply->str == nullptr) return {};
+        return std::string(reply->str, reply->len);
+    }
+} // namespace
+
+std::string RedisStreamConsumer::Entry::Field(const std::string& name) const
+{
+    for (const auto& field : fields) {
+        if (field.first == name) return field.second;
+    }
+    return {};
+}
+
+RedisStreamConsumer::RedisStreamConsumer(std::string host, int port, std::string pwd, std::string stream,
+    std::string group, std::string consumer, int batchSize, int blockMs, Handler handler)
+    : host_(std::move(host)), port_(port), pwd_(std::move(pwd)), stream_(std::move(stream)),
+      group_(std::move(group)), consumer_(std::move(consumer)),
+      batch_size_(std::max(batchSize, 1)), block_ms_(std::max(blockMs, 100)), handler_(std::move(handler)) {
+}
+
+RedisStreamConsumer::~RedisStreamConsumer()
+{
+    Stop();
+}
+
+void RedisStreamConsumer::Start()
+{
+    thread_ = std::thread([this]() { Run(); });
+}
+
+void RedisStreamConsumer::Stop()
+{
+    b_stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void RedisStreamConsumer::Run()
+{
+    auto backoff = MIN_BACKOFF;
+    // 每次（重新）建连后先从 "0" 读本消费者已领取未确认的记录，读空后再读新记录
+    bool recovering = true;
+    int redirects = 0;
+    while (!b_stop_) {
+        if (ctx_ == nullptr) {
+            if (!Connect() || !EnsureGroup()) {
+                Disconnect();
+                if (redirected_ && ++redirects <= MAX_REDIRECTS) {
+                    redirected_ = false;
+                    continue; // 跟随 MOVED 立即连接新节点
+                }
+                redirected_ = false;
+                std::cerr << "[RedisStream] " << stream_ << " unavailable, retry in " << backoff.count() << "ms" << std::endl;
+                for (auto waited = std::chrono::milliseconds(0); waited < backoff && !b_stop_; waited += std::chrono::milliseconds(100)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                backoff = std::min(backoff * 2, MAX_BACKOFF);
+                continue;
+            }
+            backoff = MIN_BACKOFF;
+            redirects = 0;
+            redirected_ = false;
+            recovering = true;
+        }
+
+        size_t count = 0;
+        if (!ReadBatch(recovering ? "0" : ">", count)) {
+            Disconnect();
+            continue;
+        }
+        if (recovering && count == 0) {
+            recovering = false;
+        }
+    }
+    Disconnect();
+}
+
+bool RedisStreamConsumer::Connect()
+{
+    struct timeval tv = { 2, 0 };
+    ctx_ = redisConnectWithTimeout(host_.c_str(), port_, tv);
+    if (ctx_ == nullptr || ctx_->err != 0) {
+        std::cerr << "[RedisStream] connect " << host_ << ":" << port_ << " failed: "
+            << (ctx_ ? ctx_->errstr : "alloc") << std::endl;
+        return false;
+    }
+    if (!pwd_.empty()) {
+        auto reply = Command(ctx_, { "AUTH", pwd_ });
+        if (!reply || reply->type == REDIS_REPLY_ERROR) {
+            std::cerr << "[RedisStream] AUTH failed: " << ReplyString(reply.get()) << std::endl;
+            return false;
+        }
+    }
+    // 读超时要留出 BLOCK 的时间，否则空闲时每次阻塞读都会被当成连接故障
+    long long timeout_ms = block_ms_ + 3000;
+    struct timeval rtv = { static_cast<long>(timeout_ms / 1000), static_cast<long>((timeout_ms % 1000) * 1000) };
+    redisSetTimeout(ctx_, rtv);
+    redisEnableKeepAlive(ctx_);
+    return true;
+}
+
+// 消费组从 "0" 开始：消费组建立之前写入的记录也会投递
+bool RedisStreamConsumer::EnsureGroup()
+{
+    auto reply = Command(ctx_, { "XGROUP", "CREATE", stream_, group_, "0", "MKSTREAM" });
+    if (!reply) {
+        std::cerr << "[RedisStream] XGROUP CREATE " << stream_ << " failed: " << ctx_->errstr << std::endl;
+        return false;
+    }
+    if (Redirect(reply.get())) {
+        return false;
+    }
+    if (reply->type == REDIS_REPLY_ERROR && ReplyString(reply.get()).rfind("BUSYGROUP", 0) != 0) {
+        std::cerr << "[RedisStream] XGROUP CREATE " << stream_ << " failed: " << ReplyString(reply.get()) << std::endl;
+        return false;
+    }
+    std::cout << "[RedisStream] consuming stream=" << stream_ << " group=" << group_ << " consumer=" << consumer_ << std::endl;
+    return true;
+}
+
+bool RedisStreamConsumer::ReadBatch(const std::string& from, size_t& count)
+{
+    count = 0;
+    std::vector<std::string> cmd = { "XREADGROUP", "GROUP", group_, consumer_, "COUNT", std::to_string(batch_size_) };
+    if (from == ">") {
+        cmd.push_back("BLOCK");
+        cmd.push_back(std::to_string(block_ms_));
+    }
+    cmd.push_back("STREAMS");
+    cmd.push_back(stream_);
+    cmd.push_back(from);
+
+    auto reply = Command(ctx_, cmd);
+    if (!reply) {
+        std::cerr << "[RedisStream] XREADGROUP " << stream_ << " failed: " << ctx_->errstr << std::endl;
+        return false;
+    }
+    if (reply->type == REDIS_REPLY_NIL) {
+        return true; // BLOCK 超时，没有新记录
+    }
+    if (Redirect(reply.get())) {
+        return false;
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        auto err = ReplyString(reply.get());
+        std::cerr << "[RedisStream] XREADGROUP " << stream_ << " error: " << err << std::endl;
+        // Stream 或消费组被删除（NOGROUP）时重建连接，重新 XGROUP CREATE
+        return false;
+    }
+    if (reply->type != REDIS_REPLY_ARRAY) {
+        return false;
+    }
+
+    std::vector<std::string> ack = { "XACK", stream_, group_ };
+    for (size_t s = 0; s < reply->elements; ++s) {
+        const redisReply* stream = reply->element[s];
+        if (stream->type != REDIS_REPLY_ARRAY || stream->elements < 2 || stream->element[1]->type != REDIS_REPLY_ARRAY) {
+            continue;
+        }
+        const redisReply* entries = stream->element[1];
+        for (size_t i = 0; i < entries->elements; ++i) {
+            const redisReply* item = entries->element[i];
+            if (item->type != REDIS_REPLY_ARRAY || item->elements < 2) {
+                continue;
+            }
+            Entry entry;
+            entry.id = ReplyString(item->element[0]);
+            const redisReply* fields = item->element[1];
+            if (fields->type == REDIS_REPLY_ARRAY) {
+                for (size_t f = 0; f + 1 < fields->elements; f += 2) {
+                    entry.fields.emplace_back(ReplyString(fields->element[f]), ReplyString(fields->element[f + 1]));
+                }
+            }
+            try {
+                handler_(entry);
+            }
+            catch (const std::exception& e) {
+                // 无法处理的记录也要确认，否则每次重连都会卡在它上面
+                std::cerr << "[RedisStream] handler threw on " << stream_ << " id=" << entry.id << ": " << e.what() << std::endl;
+            }
+            ack.push_back(std::move(entry.id));
+            ++count;
+        }
+    }
+
+    if (count == 0) {
+        return true;
+    }
+    auto ack_reply = Command(ctx_, ack);
+    if (!ack_reply || ack_reply->type == REDIS_REPLY_ERROR) {
+        // 未确认的记录留在 PEL 中，重连后从 "0" 重新投递
+        std::cerr << "[RedisStream] XACK " << stream_ << " failed: "
+            << (ack_reply ? ReplyString(ack_reply.get()) : std::string(ctx_->errstr)) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 集群模式下 Stream 所在的槽在别的节点（或已迁走）：换成 MOVED 指向的节点，由 Run 重新建连。
+// ASK（迁移进行中）不跟随，按普通错误退避重试，迁移完成后会收到 MOVED
+bool RedisStreamConsumer::Redirect(const redisReply* reply)
+{
+    bool ask = false;
+    int slot = 0;
+    std::string addr;
+    std::string host;
+    int port = 0;
+    if (!RedisParseRedirect(reply, ask, slot, addr) || ask || !RedisSplitAddr(addr, host, port)) {
+        return false;
+    }
+    std::cout << "[RedisStream] " << stream_ << " slot " << slot << " moved to " << addr << std::endl;
+    host_ = host;
+    port_ = port;
+    redirected_ = true;
+    return true;
+}
+
+void RedisStreamConsumer::Disconnect()
+{
+    if (ctx_ != nullptr) {
+        redisFree(ctx_);
+        ctx_ = nullptr;
+    }
+}
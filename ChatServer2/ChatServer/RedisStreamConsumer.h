@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <hiredis/hiredis.h>
+
+// Redis Stream 消费者（消费组，至少一次投递）
+//
+// 作用：
+//   PUBLISH 不保存消息，订阅方重启或断线期间发布的事件直接丢失。
+//   这里改为从 Stream 以消费组读取（XREADGROUP），处理完一批后再 XACK：
+//   进程在处理中途崩溃时，已读未确认的记录留在消费组的 PEL 里，重启后先从 "0" 重读这部分，再读新记录。
+//   同一条记录可能被处理两次，处理函数需要能容忍重复。
+//
+// 线程：
+//   独占一个线程和一条 Redis 连接，XREADGROUP BLOCK 在服务端阻塞等待，空闲时不轮询。
+//   回调在该线程上执行，不能长时间阻塞。
+//
+// 集群：
+//   Stream 是单个键，连接建在它所在的主节点上：先连配置的节点，收到 MOVED 后改连目标节点。
+//
+// 保留：
+//   写入方用 XADD MAXLEN ~ 限制长度，消费者下线太久时最旧的记录会被裁掉；
+//   PEL 中内容已被裁掉的记录回调时 fields 为空，照常确认。
+class RedisStreamConsumer {
+public:
+    struct Entry {
+        std::string id;
+        std::vector<std::pair<std::string, std::string>> fields;
+
+        // 取字段值，不存在时返回空串
+        std::string Field(const std::string& name) const;
+    };
+    using Handler = std::function<void(const Entry& entry)>;
+
+    RedisStreamConsumer(std::string host, int port, std::string pwd, std::string stream,
+        std::string group, std::string consumer, int batchSize, int blockMs, Handler handler);
+    ~RedisStreamConsumer();
+
+    void Start();
+    // 等待正在进行的 XREADGROUP 返回（最多 blockMs）后退出线程
+    void Stop();
+
+private:
+    void Run();
+    bool Connect();
+    bool EnsureGroup();
+    // 读一批并逐条回调、确认。返回 false 表示连接需要重建
+    bool ReadBatch(const std::string& from, size_t& count);
+    // 回复为 MOVED 时改用目标节点并返回 true
+    bool Redirect(const redisReply* reply);
+    void Disconnect();
+
+    std::string host_;                      // 只在消费线程上修改
+    int port_;
+    const std::string pwd_;
+    const std::string stream_;
+    const std::string group_;
+    const std::string consumer_;
+    const int batch_size_;
+    const int block_ms_;
+    Handler handler_;
+
+    redisContext* ctx_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> b_stop_{ false };
+    bool redirected_ = false;
+
+    static constexpr int MAX_REDIRECTS = 5;
+};
@@ -38,7 +38,8 @@ enum ErrorCodes {
     RPCGetFailed = 1010,
     UidInvalid = 1011,
     TokenInvalid = 1012,
-    RecipientOffline = 1020       // ��Ϣ���շ�����
+    RecipientOffline = 1020,      // ��Ϣ���շ�����
+    MsgPersistFailed = 1021       // 消息持久化失败
 };
 
 enum MSG_IDS {
@@ -57,6 +58,9 @@ enum MSG_IDS {
     ID_NOTIFY_TEXT_CHAT_MSG_REQ = 1019,
     ID_NOTIFY_TEXT_CHAT_MSG_RSP = 1024,
     ID_GET_OFFLINE_MSG_REQ = 1023,
+    ID_GET_OFFLINE_MSG_RSP = 1025,      // 离线消息分页回包
+    ID_GET_HISTORY_MSG_REQ = 1026,      // 收件历史分页（含归档）
+    ID_GET_HISTORY_MSG_RSP = 1027,
 
     ID_NOTIFY_ADD_FRIEND_REQ = 1021,
     ID_NOTIFY_FRIEND_REPLY = 1022
@@ -79,10 +83,29 @@ private:
 
 
 
-#define USERIPPREFIX "uip_"
-#define USERTOKENPREFIX "utoken_"
+// 每个在线用户一个哈希 user_<uid>（小哈希在 Redis 中以 listpack 紧凑存储，一个键代替原来的三个）：
+//   token   登录令牌（StatusServer 分配时写入）
+//   server  所在 ChatServer 名称（登录时写入，跨服投递按它路由）
+//   name / email / nick / desc / sex / icon   基础资料（不含密码），登录时一次 HMGET 取回
+// 整个哈希 USER_HASH_TTL 秒后过期，分配 token、登录时续期
+#define USER_HASH_PREFIX "user_"
+#define USER_HASH_TTL 604800
 #define IPCOUNTPREFIX "ipcount_"
-#define USER_BASE_INFO "ubaseinfo_"
 #define LOGIN_COUNT "logincount"
 #define NAME_INFO "nameinfo_"
-#define OFFLINE_MSG_PREFIX "offline_msg_"
\ No newline at end of file
+#define INBOX_PREFIX "inbox_"             // 离线收件箱热层 ZSET，键为 inbox_{uid}
+#define INBOX_EPOCH "inbox_epoch"          // 热层全局代数
+#define INBOX_STATE_PREFIX "inbox_state_"  // 未读水位哈希，键为 inbox_state_{uid}（与热层同槽）
+#define INBOX_WIP_PREFIX "inbox_wip_"      // 进行中的写入 ZSET，键为 inbox_wip_{uid}（与热层同槽）
+#define FRIEND_STREAM_PREFIX "friend_stream_"  // 好友事件按服务器分 Stream：前缀 + 用户所在服务器名（用户哈希的 server 字段）
+// 资料失效频道：修改资料（昵称、头像等）的一方写完 MySQL 和用户哈希后 PUBLISH 本频道，消息为 uid（可逗号分隔多个）
+#define PROFILE_CHANNEL "user.profile"
+
+// 离线消息分页同步
+#define OFFLINE_PAGE_DEFAULT_SIZE 100      // 客户端未指定 page_size 时的页大小
+#define OFFLINE_PAGE_MAX_SIZE 500          // 单页最多条数
+#define OFFLINE_PAGE_MAX_BYTES (16 * 1024) // 单页回包字节上限（包头长度字段为 16 位）
+// 不翻页的老客户端由服务端连续取页下发，一次拉取的预算（任一项用完即停，剩下的等下次登录）
+#define OFFLINE_LEGACY_MAX_BYTES (1024 * 1024)
+#define OFFLINE_LEGACY_MAX_MSGS 500        // 逐条下发，须小于会话发送队列上限 MAX_SENDQUE
+#define OFFLINE_LEGACY_MAX_MS 5000
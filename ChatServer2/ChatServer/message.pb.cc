@@ -232,6 +232,7 @@ PROTOBUF_CONSTEXPR TextChatMsgReq::TextChatMsgReq(
     /*decltype(_impl_.textmsgs_)*/{}
   , /*decltype(_impl_.fromuid_)*/0
   , /*decltype(_impl_.touid_)*/0
+  , /*decltype(_impl_.id_)*/int64_t{0}
   , /*decltype(_impl_._cached_size_)*/{}} {}
 struct TextChatMsgReqDefaultTypeInternal {
   PROTOBUF_CONSTEXPR TextChatMsgReqDefaultTypeInternal()
@@ -529,6 +530,7 @@ const uint32_t TableStruct_message_2eproto::offsets[] PROTOBUF_SECTION_VARIABLE(
   PROTOBUF_FIELD_OFFSET(::message::TextChatMsgReq, _impl_.fromuid_),
   PROTOBUF_FIELD_OFFSET(::message::TextChatMsgReq, _impl_.touid_),
   PROTOBUF_FIELD_OFFSET(::message::TextChatMsgReq, _impl_.textmsgs_),
+  PROTOBUF_FIELD_OFFSET(::message::TextChatMsgReq, _impl_.id_),
   ~0u,  // no _has_bits_
   PROTOBUF_FIELD_OFFSET(::message::TextChatData, _internal_metadata_),
   ~0u,  // no _extensions_
@@ -636,16 +638,16 @@ static const ::_pbi::MigrationSchema schemas[] PROTOBUF_SECTION_VARIABLE(protode
   { 105, -1, -1, sizeof(::message::AuthFriendReq)},
   { 113, -1, -1, sizeof(::message::AuthFriendRsp)},
   { 122, -1, -1, sizeof(::message::TextChatMsgReq)},
-  { 131, -1, -1, sizeof(::message::TextChatData)},
-  { 139, -1, -1, sizeof(::message::TextChatMsgRsp)},
-  { 149, -1, -1, sizeof(::message::SearchFriendReq)},
-  { 157, -1, -1, sizeof(::message::SearchFriendRsp)},
-  { 165, -1, -1, sizeof(::message::UserInfo)},
-  { 178, -1, -1, sizeof(::message::GetFriendRequestsReq)},
-  { 185, -1, -1, sizeof(::message::GetFriendRequestsRsp)},
-  { 193, -1, -1, sizeof(::message::ApplyInfo)},
-  { 206, -1, -1, sizeof(::message::GetMyFriendsReq)},
-  { 213, -1, -1, sizeof(::message::GetMyFriendsRsp)},
+  { 132, -1, -1, sizeof(::message::TextChatData)},
+  { 140, -1, -1, sizeof(::message::TextChatMsgRsp)},
+  { 150, -1, -1, sizeof(::message::SearchFriendReq)},
+  { 158, -1, -1, sizeof(::message::SearchFriendRsp)},
+  { 166, -1, -1, sizeof(::message::UserInfo)},
+  { 179, -1, -1, sizeof(::message::GetFriendRequestsReq)},
+  { 186, -1, -1, sizeof(::message::GetFriendRequestsRsp)},
+  { 194, -1, -1, sizeof(::message::ApplyInfo)},
+  { 207, -1, -1, sizeof(::message::GetMyFriendsReq)},
+  { 214, -1, -1, sizeof(::message::GetMyFriendsRsp)},
 };
 
 static const ::_pb::Message* const file_default_instances[] = {
@@ -698,51 +700,51 @@ const char descriptor_table_protodef_message_2eproto[] PROTOBUF_SECTION_VARIABLE
   "\030\003 \001(\005\"/\n\rAuthFriendReq\022\017\n\007fromuid\030\001 \001(\005"
   "\022\r\n\005touid\030\002 \001(\005\">\n\rAuthFriendRsp\022\r\n\005erro"
   "r\030\001 \001(\005\022\017\n\007fromuid\030\002 \001(\005\022\r\n\005touid\030\003 \001(\005\""
-  "Y\n\016TextChatMsgReq\022\017\n\007fromuid\030\001 \001(\005\022\r\n\005to"
+  "e\n\016TextChatMsgReq\022\017\n\007fromuid\030\001 \001(\005\022\r\n\005to"
   "uid\030\002 \001(\005\022\'\n\010textmsgs\030\003 \003(\0132\025.message.Te"
-  "xtChatData\"1\n\014TextChatData\022\r\n\005msgid\030\001 \001("
-  "\t\022\022\n\nmsgcontent\030\002 \001(\t\"h\n\016TextChatMsgRsp\022"
-  "\r\n\005error\030\001 \001(\005\022\017\n\007fromuid\030\002 \001(\005\022\r\n\005touid"
-  "\030\003 \001(\005\022\'\n\010textmsgs\030\004 \003(\0132\025.message.TextC"
-  "hatData\"/\n\017SearchFriendReq\022\013\n\003uid\030\001 \001(\005\022"
-  "\017\n\007keyword\030\002 \001(\t\"B\n\017SearchFriendRsp\022\r\n\005e"
-  "rror\030\001 \001(\005\022 \n\005users\030\002 \003(\0132\021.message.User"
-  "Info\"k\n\010UserInfo\022\013\n\003uid\030\001 \001(\005\022\014\n\004name\030\002 "
-  "\001(\t\022\r\n\005email\030\003 \001(\t\022\014\n\004nick\030\004 \001(\t\022\014\n\004icon"
-  "\030\005 \001(\t\022\013\n\003sex\030\006 \001(\005\022\014\n\004desc\030\007 \001(\t\"#\n\024Get"
-  "FriendRequestsReq\022\013\n\003uid\030\001 \001(\005\"K\n\024GetFri"
-  "endRequestsRsp\022\r\n\005error\030\001 \001(\005\022$\n\010request"
-  "s\030\002 \003(\0132\022.message.ApplyInfo\"m\n\tApplyInfo"
-  "\022\013\n\003uid\030\001 \001(\005\022\014\n\004name\030\002 \001(\t\022\014\n\004desc\030\003 \001("
-  "\t\022\014\n\004icon\030\004 \001(\t\022\014\n\004nick\030\005 \001(\t\022\013\n\003sex\030\006 \001"
-  "(\005\022\016\n\006status\030\007 \001(\005\"\036\n\017GetMyFriendsReq\022\013\n"
-  "\003uid\030\001 \001(\005\"D\n\017GetMyFriendsRsp\022\r\n\005error\030\001"
-  " \001(\005\022\"\n\007friends\030\002 \003(\0132\021.message.UserInfo"
-  "2P\n\rVerifyService\022\?\n\rGetVerifyCode\022\025.mes"
-  "sage.GetVerifyReq\032\025.message.GetVerifyRsp"
-  "\"\0002\207\001\n\rStatusService\022G\n\rGetChatServer\022\031."
-  "message.GetChatServerReq\032\031.message.GetCh"
-  "atServerRsp\"\000\022-\n\005Login\022\021.message.LoginRe"
-  "q\032\021.message.LoginRsp2\311\004\n\013ChatService\022A\n\017"
-  "NotifyAddFriend\022\025.message.AddFriendReq\032\025"
-  ".message.AddFriendRsp\"\000\022D\n\016ReplyAddFrien"
-  "d\022\027.message.ReplyFriendReq\032\027.message.Rep"
-  "lyFriendRsp\"\000\022A\n\013SendChatMsg\022\027.message.S"
-  "endChatMsgReq\032\027.message.SendChatMsgRsp\"\000"
-  "\022D\n\020NotifyAuthFriend\022\026.message.AuthFrien"
-  "dReq\032\026.message.AuthFriendRsp\"\000\022G\n\021Notify"
-  "TextChatMsg\022\027.message.TextChatMsgReq\032\027.m"
-  "essage.TextChatMsgRsp\"\000\022D\n\014SearchFriend\022"
-  "\030.message.SearchFriendReq\032\030.message.Sear"
-  "chFriendRsp\"\000\022S\n\021GetFriendRequests\022\035.mes"
-  "sage.GetFriendRequestsReq\032\035.message.GetF"
-  "riendRequestsRsp\"\000\022D\n\014GetMyFriends\022\030.mes"
-  "sage.GetMyFriendsReq\032\030.message.GetMyFrie"
-  "ndsRsp\"\000b\006proto3"
+  "xtChatData\022\n\n\002id\030\004 \001(\003\"1\n\014TextChatData\022\r"
+  "\n\005msgid\030\001 \001(\t\022\022\n\nmsgcontent\030\002 \001(\t\"h\n\016Tex"
+  "tChatMsgRsp\022\r\n\005error\030\001 \001(\005\022\017\n\007fromuid\030\002 "
+  "\001(\005\022\r\n\005touid\030\003 \001(\005\022\'\n\010textmsgs\030\004 \003(\0132\025.m"
+  "essage.TextChatData\"/\n\017SearchFriendReq\022\013"
+  "\n\003uid\030\001 \001(\005\022\017\n\007keyword\030\002 \001(\t\"B\n\017SearchFr"
+  "iendRsp\022\r\n\005error\030\001 \001(\005\022 \n\005users\030\002 \003(\0132\021."
+  "message.UserInfo\"k\n\010UserInfo\022\013\n\003uid\030\001 \001("
+  "\005\022\014\n\004name\030\002 \001(\t\022\r\n\005email\030\003 \001(\t\022\014\n\004nick\030\004"
+  " \001(\t\022\014\n\004icon\030\005 \001(\t\022\013\n\003sex\030\006 \001(\005\022\014\n\004desc\030"
+  "\007 \001(\t\"#\n\024GetFriendRequestsReq\022\013\n\003uid\030\001 \001"
+  "(\005\"K\n\024GetFriendRequestsRsp\022\r\n\005error\030\001 \001("
+  "\005\022$\n\010requests\030\002 \003(\0132\022.message.ApplyInfo\""
+  "m\n\tApplyInfo\022\013\n\003uid\030\001 \001(\005\022\014\n\004name\030\002 \001(\t\022"
+  "\014\n\004desc\030\003 \001(\t\022\014\n\004icon\030\004 \001(\t\022\014\n\004nick\030\005 \001("
+  "\t\022\013\n\003sex\030\006 \001(\005\022\016\n\006status\030\007 \001(\005\"\036\n\017GetMyF"
+  "riendsReq\022\013\n\003uid\030\001 \001(\005\"D\n\017GetMyFriendsRs"
+  "p\022\r\n\005error\030\001 \001(\005\022\"\n\007friends\030\002 \003(\0132\021.mess"
+  "age.UserInfo2P\n\rVerifyService\022\?\n\rGetVeri"
+  "fyCode\022\025.message.GetVerifyReq\032\025.message."
+  "GetVerifyRsp\"\0002\207\001\n\rStatusService\022G\n\rGetC"
+  "hatServer\022\031.message.GetChatServerReq\032\031.m"
+  "essage.GetChatServerRsp\"\000\022-\n\005Login\022\021.mes"
+  "sage.LoginReq\032\021.message.LoginRsp2\311\004\n\013Cha"
+  "tService\022A\n\017NotifyAddFriend\022\025.message.Ad"
+  "dFriendReq\032\025.message.AddFriendRsp\"\000\022D\n\016R"
+  "eplyAddFriend\022\027.message.ReplyFriendReq\032\027"
+  ".message.ReplyFriendRsp\"\000\022A\n\013SendChatMsg"
+  "\022\027.message.SendChatMsgReq\032\027.message.Send"
+  "ChatMsgRsp\"\000\022D\n\020NotifyAuthFriend\022\026.messa"
+  "ge.AuthFriendReq\032\026.message.AuthFriendRsp"
+  "\"\000\022G\n\021NotifyTextChatMsg\022\027.message.TextCh"
+  "atMsgReq\032\027.message.TextChatMsgRsp\"\000\022D\n\014S"
+  "earchFriend\022\030.message.SearchFriendReq\032\030."
+  "message.SearchFriendRsp\"\000\022S\n\021GetFriendRe"
+  "quests\022\035.message.GetFriendRequestsReq\032\035."
+  "message.GetFriendRequestsRsp\"\000\022D\n\014GetMyF"
+  "riends\022\030.message.GetMyFriendsReq\032\030.messa"
+  "ge.GetMyFriendsRsp\"\000b\006proto3"
   ;
 static ::_pbi::once_flag descriptor_table_message_2eproto_once;
 const ::_pbi::DescriptorTable descriptor_table_message_2eproto = {
-    false, false, 2456, descriptor_table_protodef_message_2eproto,
+    false, false, 2468, descriptor_table_protodef_message_2eproto,
     "message.proto",
     &descriptor_table_message_2eproto_once, nullptr, 0, 25,
     schemas, file_default_instances, TableStruct_message_2eproto::offsets,
@@ -4222,12 +4224,13 @@ TextChatMsgReq::TextChatMsgReq(const TextChatMsgReq& from)
       decltype(_impl_.textmsgs_){from._impl_.textmsgs_}
     , decltype(_impl_.fromuid_){}
     , decltype(_impl_.touid_){}
+    , decltype(_impl_.id_){}
     , /*decltype(_impl_._cached_size_)*/{}};
 
   _internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
   ::memcpy(&_impl_.fromuid_, &from._impl_.fromuid_,
-    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.touid_) -
-    reinterpret_cast<char*>(&_impl_.fromuid_)) + sizeof(_impl_.touid_));
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.id_) -
+    reinterpret_cast<char*>(&_impl_.fromuid_)) + sizeof(_impl_.id_));
   // @@protoc_insertion_point(copy_constructor:message.TextChatMsgReq)
 }
 
@@ -4239,6 +4242,7 @@ inline void TextChatMsgReq::SharedCtor(
       decltype(_impl_.textmsgs_){arena}
     , decltype(_impl_.fromuid_){0}
     , decltype(_impl_.touid_){0}
+    , decltype(_impl_.id_){int64_t{0}}
     , /*decltype(_impl_._cached_size_)*/{}
   };
 }
@@ -4269,8 +4273,8 @@ void TextChatMsgReq::Clear() {
 
   _impl_.textmsgs_.Clear();
   ::memset(&_impl_.fromuid_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&_impl_.touid_) -
-      reinterpret_cast<char*>(&_impl_.fromuid_)) + sizeof(_impl_.touid_));
+      reinterpret_cast<char*>(&_impl_.id_) -
+      reinterpret_cast<char*>(&_impl_.fromuid_)) + sizeof(_impl_.id_));
   _internal_metadata_.Clear<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>();
 }
 
@@ -4309,6 +4313,14 @@ const char* TextChatMsgReq::_InternalParse(const char* ptr, ::_pbi::ParseContext
         } else
           goto handle_unusual;
         continue;
+      // int64 id = 4;
+      case 4:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 32)) {
+          _impl_.id_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
       default:
         goto handle_unusual;
     }  // switch
@@ -4358,6 +4370,12 @@ uint8_t* TextChatMsgReq::_InternalSerialize(
         InternalWriteMessage(3, repfield, repfield.GetCachedSize(), target, stream);
   }
 
+  // int64 id = 4;
+  if (this->_internal_id() != 0) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt64ToArray(4, this->_internal_id(), target);
+  }
+
   if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
     target = ::_pbi::WireFormat::InternalSerializeUnknownFieldsToArray(
         _internal_metadata_.unknown_fields<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(::PROTOBUF_NAMESPACE_ID::UnknownFieldSet::default_instance), target, stream);
@@ -4391,6 +4409,11 @@ size_t TextChatMsgReq::ByteSizeLong() const {
     total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_touid());
   }
 
+  // int64 id = 4;
+  if (this->_internal_id() != 0) {
+    total_size += ::_pbi::WireFormatLite::Int64SizePlusOne(this->_internal_id());
+  }
+
   return MaybeComputeUnknownFieldsSize(total_size, &_impl_._cached_size_);
 }
 
@@ -4416,6 +4439,9 @@ void TextChatMsgReq::MergeImpl(::PROTOBUF_NAMESPACE_ID::Message& to_msg, const :
   if (from._internal_touid() != 0) {
     _this->_internal_set_touid(from._internal_touid());
   }
+  if (from._internal_id() != 0) {
+    _this->_internal_set_id(from._internal_id());
+  }
   _this->_internal_metadata_.MergeFrom<::PROTOBUF_NAMESPACE_ID::UnknownFieldSet>(from._internal_metadata_);
 }
 
@@ -4435,8 +4461,8 @@ void TextChatMsgReq::InternalSwap(TextChatMsgReq* other) {
   _internal_metadata_.InternalSwap(&other->_internal_metadata_);
   _impl_.textmsgs_.InternalSwap(&other->_impl_.textmsgs_);
   ::PROTOBUF_NAMESPACE_ID::internal::memswap<
-      PROTOBUF_FIELD_OFFSET(TextChatMsgReq, _impl_.touid_)
-      + sizeof(TextChatMsgReq::_impl_.touid_)
+      PROTOBUF_FIELD_OFFSET(TextChatMsgReq, _impl_.id_)
+      + sizeof(TextChatMsgReq::_impl_.id_)
       - PROTOBUF_FIELD_OFFSET(TextChatMsgReq, _impl_.fromuid_)>(
           reinterpret_cast<char*>(&_impl_.fromuid_),
           reinterpret_cast<char*>(&other->_impl_.fromuid_));
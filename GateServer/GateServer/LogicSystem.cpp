@@ -11,6 +11,26 @@
 #include <cctype>
 #include "const.h"
 
+// 投递好友事件，供 ChatServer 推送 TCP 通知
+//
+// 写入目标用户所在服务器的 Stream（FRIEND_STREAM_PREFIX + 用户哈希 server 字段记录的服务器名），
+// ChatServer 以消费组读取并在处理后 XACK，重启期间写入的事件在它恢复后仍会送达。
+// 目标不在线时不投递，上线后通过 HTTP 拉取申请列表。
+static void PublishFriendEvent(int target_uid, const std::string& type, const Json::Value& ev)
+{
+    std::string server = RedisMgr::GetInstance()->HGet(USER_HASH_PREFIX + std::to_string(target_uid), "server");
+    if (server.empty()) {
+        std::cout << "[FriendNotify][Gate] uid=" << target_uid << " offline, skip publish" << std::endl;
+        return;
+    }
+    auto stream = FRIEND_STREAM_PREFIX + server;
+    auto payload = ev.toStyledString();
+    std::string id;
+    bool ok = RedisMgr::GetInstance()->XAdd(stream, FRIEND_STREAM_MAXLEN, { { "type", type }, { "payload", payload } }, id);
+    std::cout << "[FriendNotify][Gate] xadd stream=" << stream << " type=" << type
+        << " result=" << std::boolalpha << ok << " id=" << id << std::endl;
+}
+
 // 注册POST请求处理器,,,,应该写成ReqPost的，写错了，以后再改
 // 参数：
 //   - url: 请求路径
@@ -332,20 +352,16 @@ LogicSystem::LogicSystem() {
         //   ? ?       ?
         std::cout << "succeed to load userinfo uid is " << userInfo.uid << std::endl;
 
-        // 写入用户基础信息到 Redis，供 ChatServer 读取
-        // key: USER_BASE_INFO + uid
+        // 写入用户基础信息到 Redis，供 ChatServer 登录时与 token 一起取回
+        // key: USER_HASH_PREFIX + uid（与 token、路由同一个哈希，不写密码）
+        // 只写本次从 MySQL 读到的 name / email：ChatServer 发现资料字段不全时整体从 MySQL 回填，
+        // 这里写空值会覆盖真实资料，每次登录都改动资料也会让各 ChatServer 的资料缓存失去意义
         try {
-            std::string base_key = std::string(USER_BASE_INFO) + std::to_string(userInfo.uid);
-            Json::Value redis_root;
-            redis_root["uid"] = userInfo.uid;
-            redis_root["name"] = userInfo.name.empty() ? identifier : userInfo.name;
-            redis_root["email"] = userInfo.email;
-            redis_root["pwd"] = userInfo.pwd;
-            redis_root["nick"] = "";
-            redis_root["desc"] = "";
-            redis_root["sex"] = 0;
-            redis_root["icon"] = "";
-            RedisMgr::GetInstance()->Set(base_key, redis_root.toStyledString());
+            std::string user_key = std::string(USER_HASH_PREFIX) + std::to_string(userInfo.uid);
+            RedisMgr::GetInstance()->HSetFields(user_key, {
+                { "name", userInfo.name.empty() ? identifier : userInfo.name },
+                { "email", userInfo.email },
+                }, USER_HASH_TTL);
         }
         catch (...) {
             // 忽略缓存失败，不影响登录主流程
@@ -556,19 +572,14 @@ LogicSystem::LogicSystem() {
 
         root["error"] = success ? 0 : ErrorCodes::UserExist; // 如果失败，可能是重复申请
 
-        // 发布 friend.apply 事件，供 ChatServer 推送TCP通知
+        // 发布 apply 事件，推给被申请人所在的 ChatServer
         Json::Value ev;
         ev["type"] = "apply";
         ev["from_uid"] = fromUid;
         ev["to_uid"] = toUid;
         ev["desc"] = desc;
         ev["error"] = root["error"].asInt();
-        {
-            auto payload = ev.toStyledString();
-            std::cout << "[FriendNotify][Gate] publish channel=friend.apply payload=" << payload << std::endl;
-            bool pubok = RedisMgr::GetInstance()->Publish("friend.apply", payload);
-            std::cout << "[FriendNotify][Gate] publish friend.apply result=" << std::boolalpha << pubok << std::endl;
-        }
+        PublishFriendEvent(toUid, "apply", ev);
 
         beast::ostream(connection->_response.body()) << root.toStyledString();
         connection->WriteResponse();
@@ -612,19 +623,14 @@ LogicSystem::LogicSystem() {
 
         root["error"] = success ? 0 : ErrorCodes::PasswdUpFailed;
 
-        // 发布 friend.reply 事件，供 ChatServer 推送TCP通知
+        // 发布 reply 事件，推给申请人所在的 ChatServer
         Json::Value ev;
         ev["type"] = "reply";
         ev["from_uid"] = fromUid;
         ev["to_uid"] = toUid;
         ev["agree"] = agree;
         ev["error"] = root["error"].asInt();
-        {
-            auto payload = ev.toStyledString();
-            std::cout << "[FriendNotify][Gate] publish channel=friend.reply payload=" << payload << std::endl;
-            bool pubok = RedisMgr::GetInstance()->Publish("friend.reply", payload);
-            std::cout << "[FriendNotify][Gate] publish friend.reply result=" << std::boolalpha << pubok << std::endl;
-        }
+        PublishFriendEvent(fromUid, "reply", ev);
 
         beast::ostream(connection->_response.body()) << root.toStyledString();
         connection->WriteResponse();
@@ -17,37 +17,6 @@ namespace {
     }
 } // namespace
 
-// RedisConnectionGuard��RAII����ȷ����ȡ�������ӻ������������ʱ�黹
-// 
-// ���ã�
-//   �Զ�����Redis���ӵ��������ڣ�ȷ��������ʹ�����黹�����ӳ�
-// 
-// ʹ�÷�ʽ��
-//   auto guard = RedisConnectionGuard(pool, connection);
-//   redisContext* ctx = guard.get();
-class RedisConnectionGuard {
-public:
-    RedisConnectionGuard(RedisConPool* pool, redisContext* ctx) : pool_(pool), ctx_(ctx) {}
-
-    // �����������Զ��黹���ӵ����ӳ�
-    ~RedisConnectionGuard() {
-        if (pool_ && ctx_) {
-            pool_->returnConnection(ctx_);
-            // ��ctx_����Ϊnullptr����Ϊ�����ѹ黹
-        }
-    }
-
-    // ��ȡ���ӵ�ԭʼָ��
-    redisContext* get() const { return ctx_; }
-
-    // ��ֹ�������ƶ����壩
-    RedisConnectionGuard(const RedisConnectionGuard&) = delete;
-    RedisConnectionGuard& operator=(const RedisConnectionGuard&) = delete;
-private:
-    RedisConPool* pool_;      // ���ӳ�ָ��
-    redisContext* ctx_;       // Redis����ָ��
-};
-
 // ���캯������ʼ��Redis������
 // 
 // ���ã�
@@ -62,11 +31,13 @@ RedisMgr::RedisMgr()
     auto host = gCfgMgr["Redis"]["Host"];
     auto port = gCfgMgr["Redis"]["Port"];
     auto pwd = gCfgMgr["Redis"]["Passwd"];
-    // 根据CPU核心数动态设置连接池大小
+    // Nodes 非空时按 Redis Cluster 路由，Host / Port 不再用于命令
+    auto nodes = gCfgMgr["Redis"]["Nodes"];
+    // 根据CPU核心数动态设置连接池大小（集群模式下每个主节点一个池）
     size_t pool_size = std::max(16u, std::thread::hardware_concurrency() * 2);
     std::cout << "[RedisMgr] CPU cores: " << std::thread::hardware_concurrency() 
               << ", Redis pool size: " << pool_size << std::endl;
-    con_pool_.reset(new RedisConPool(pool_size, host.c_str(), atoi(port.c_str()), pwd.c_str()));
+    router_.reset(new RedisRouter<RedisConPool>(nodes, host, atoi(port.c_str()), pwd, pool_size));
 }
 
 // ����������������Դ
@@ -75,6 +46,11 @@ RedisMgr::~RedisMgr()
     Close();
 }
 
+redisReply* RedisMgr::Command(const std::vector<std::string>& argv)
+{
+    return router_->Command(argv).release();
+}
+
 // ��ȡ��ֵ��GET���
 // 
 // ������
@@ -92,15 +68,7 @@ RedisMgr::~RedisMgr()
 //   5. �����д��value
 bool RedisMgr::Get(const std::string& key, std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Get] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    // ʹ��RAII�Զ��黹����
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "GET %s", key.c_str());
+    redisReply* reply = Command({ "GET", key });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Get] redisCommand returned NULL for key=" << key << std::endl;
         return false;
@@ -141,14 +109,7 @@ bool RedisMgr::Get(const std::string& key, std::string& value)
 //   2. ִ��SET����
 //   3. ��鷵��ֵ�Ƿ�Ϊ"OK"
 bool RedisMgr::Set(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Set] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "SET %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "SET", key, value });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Set] Execut command [ SET " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -175,14 +136,7 @@ bool RedisMgr::Set(const std::string& key, const std::string& value) {
 // ������Ϣ��Ƶ����PUBLISH channel message��
 bool RedisMgr::Publish(const std::string& channel, const std::string& message)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Publish] getConnection returned nullptr for channel=" << channel << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "PUBLISH %s %s", channel.c_str(), message.c_str());
+    redisReply* reply = Command({ "PUBLISH", channel, message });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Publish] PUBLISH failed (reply==NULL) channel=" << channel << std::endl;
         return false;
@@ -197,6 +151,65 @@ bool RedisMgr::Publish(const std::string& channel, const std::string& message)
     return ok;
 }
 
+// HSetFields：HSET 与 EXPIRE 是同一个键，在同一条连接上流水线写出，一次往返
+bool RedisMgr::HSetFields(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, int ttl_sec)
+{
+    if (fields.empty()) {
+        return true;
+    }
+    std::vector<std::vector<std::string>> cmds(1);
+    cmds[0].reserve(fields.size() * 2 + 2);
+    cmds[0].push_back("HSET");
+    cmds[0].push_back(key);
+    for (const auto& field : fields) {
+        cmds[0].push_back(field.first);
+        cmds[0].push_back(field.second);
+    }
+    if (ttl_sec > 0) {
+        cmds.push_back({ "EXPIRE", key, std::to_string(ttl_sec) });
+    }
+
+    std::vector<RedisReplyPtr> replies;
+    bool ok = router_->Exec(cmds, replies);
+    for (const auto& reply : replies) {
+        if (!reply) {
+            std::cout << "[RedisMgr::HSetFields] no reply for key=" << key << std::endl;
+            ok = false;
+        }
+        else if (reply->type == REDIS_REPLY_ERROR) {
+            std::cout << "[RedisMgr::HSetFields] key=" << key << " error: " << std::string(reply->str, reply->len) << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// XADD：参数按二进制安全的 argv 形式传递，payload 中的空格、换行不会被拆开
+bool RedisMgr::XAdd(const std::string& key, size_t maxlen,
+    const std::vector<std::pair<std::string, std::string>>& fields, std::string& id)
+{
+    std::vector<std::string> cmd = { "XADD", key, "MAXLEN", "~", std::to_string(maxlen), "*" };
+    for (const auto& field : fields) {
+        cmd.push_back(field.first);
+        cmd.push_back(field.second);
+    }
+    redisReply* reply = Command(cmd);
+    if (reply == nullptr) {
+        std::cout << "[RedisMgr::XAdd] XADD failed (reply==NULL) key=" << key << std::endl;
+        return false;
+    }
+    bool ok = (reply->type == REDIS_REPLY_STRING);
+    if (ok) {
+        id.assign(reply->str, reply->len);
+    }
+    else {
+        std::cout << "[RedisMgr::XAdd] XADD key=" << key << " failed: "
+            << (reply->type == REDIS_REPLY_ERROR ? std::string(reply->str, reply->len) : "unexpected reply") << std::endl;
+    }
+    freeReplyObject(reply);
+    return ok;
+}
+
 // ������֤��AUTH���
 // 
 // ������
@@ -206,14 +219,7 @@ bool RedisMgr::Publish(const std::string& channel, const std::string& message)
 //   ��֤�ɹ�����true�����򷵻�false
 bool RedisMgr::Auth(const std::string& password)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Auth] getConnection returned nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "AUTH %s", password.c_str());
+    redisReply* reply = Command({ "AUTH", password });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Auth] AUTH returned NULL\n";
         return false;
@@ -243,14 +249,7 @@ bool RedisMgr::Auth(const std::string& password)
 //   LPUSH���ڶ��г��������б���ˣ�ͷ��������Ԫ��
 bool RedisMgr::LPush(const std::string& key, const std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "LPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -280,14 +279,7 @@ bool RedisMgr::LPush(const std::string& key, const std::string& value)
 // ˵����
 //   LPOP���ڶ��г��������б���ˣ�ͷ��������Ԫ��
 bool RedisMgr::LPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPOP %s", key.c_str());
+    redisReply* reply = Command({ "LPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -324,14 +316,7 @@ bool RedisMgr::LPop(const std::string& key, std::string& value) {
 // ˵����
 //   RPUSH����ջ���������б��Ҷˣ�β��������Ԫ��
 bool RedisMgr::RPush(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "RPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -361,14 +346,7 @@ bool RedisMgr::RPush(const std::string& key, const std::string& value) {
 // ˵����
 //   RPOP����ջ���������б��Ҷˣ�β��������Ԫ��
 bool RedisMgr::RPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPOP %s", key.c_str());
+    redisReply* reply = Command({ "RPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -406,14 +384,7 @@ bool RedisMgr::RPop(const std::string& key, std::string& value) {
 // ˵����
 //   HSET�������ù�ϣ�е��ֶ�ֵ
 bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "HSET %s %s %s", key.c_str(), hkey.c_str(), value.c_str());
+    redisReply* reply = Command({ "HSET", key, hkey, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet " << key << "  " << hkey << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -447,26 +418,7 @@ bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::
 //   �����ڴ洢���ı����ݣ���ͼƬ����Ƶ�ȣ�
 bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet(binary)] getConnection nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    // ׼��redisCommandArgv�Ĳ���
-    const char* argv[4];
-    size_t argvlen[4];
-    argv[0] = "HSET";
-    argvlen[0] = 4;
-    argv[1] = key;
-    argvlen[1] = strlen(key);
-    argv[2] = hkey;
-    argvlen[2] = strlen(hkey);
-    argv[3] = hvalue;
-    argvlen[3] = hvaluelen;
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 4, argv, argvlen);
+    redisReply* reply = Command({ "HSET", key, hkey, std::string(hvalue, hvaluelen) });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet(binary) ] failure (reply==NULL)!\n";
         return false;
@@ -498,16 +450,8 @@ bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_
 //   3. �������ֵ>0����ʾ�ֶδ����ұ�ɾ��
 bool RedisMgr::HDel(const std::string& key, const std::string& field)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HDel] getConnection returned nullptr for key=" << key << " field=" << field << std::endl;
-        return false;
-    }
-    // RAII: ȷ�����ӻᱻ�黹�����ӳ�
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
     // ִ�� HDEL ����
-    redisReply* reply = (redisReply*)redisCommand(connect, "HDEL %s %s", key.c_str(), field.c_str());
+    redisReply* reply = Command({ "HDEL", key, field });
     if (reply == nullptr) {
         std::cout << "Execut command [ HDEL " << key << " " << field << " ] failure (reply==NULL)!\n";
         return false;
@@ -555,24 +499,7 @@ bool RedisMgr::HDel(const std::string& key, const std::string& field)
 //   3. �����ֶ�ֵ
 std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HGet] getConnection nullptr for key=" << key << std::endl;
-        return "";
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    // ׼��redisCommandArgv�Ĳ���
-    const char* argv[3];
-    size_t argvlen[3];
-    argv[0] = "HGET";
-    argvlen[0] = 4;
-    argv[1] = key.c_str();
-    argvlen[1] = key.length();
-    argv[2] = hkey.c_str();
-    argvlen[2] = hkey.length();
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 3, argv, argvlen);
+    redisReply* reply = Command({ "HGET", key, hkey });
     if (reply == nullptr) {
         std::cout << "Execut command [ HGet " << key << " " << hkey << " ] failure (reply==NULL)!\n";
         return "";
@@ -609,14 +536,7 @@ std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
 //   ɾ��ָ���ļ����������ֵ
 bool RedisMgr::Del(const std::string& key)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Del] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "DEL %s", key.c_str());
+    redisReply* reply = Command({ "DEL", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ Del " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -647,14 +567,7 @@ bool RedisMgr::Del(const std::string& key)
 //   2. ��鷵��ֵ������������>0��ʾ���ڣ�
 bool RedisMgr::ExistsKey(const std::string& key)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::ExistsKey] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "EXISTS %s", key.c_str());
+    redisReply* reply = Command({ "EXISTS", key });
     if (reply == nullptr) {
         std::cout << "Not Found [ Key " << key << " ]  ! (reply==NULL)\n";
         return false;
@@ -686,10 +599,8 @@ bool RedisMgr::ExistsKey(const std::string& key)
 //   �����û�� RedisConPool ��ʵ�֣�Ӧ���� RedisConPool::Close/���������ͷ� ctx
 void RedisMgr::Close()
 {
-    if (con_pool_) {
-        con_pool_->Close();
-        // ע�⣺RedisConPool::Close() Ӧ���ͷ����� redisContext��redisFree����
-        // �����û�� RedisConPool ��ʵ�֣�Ӧ���� RedisConPool::Close/���������ͷ� ctx
-        con_pool_.reset();
+    // 只停止连接池（之后取连接返回 nullptr），路由表和池对象留到析构时释放
+    if (router_) {
+        router_->Close();
     }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include"const.h"
+#include "RedisRouter.h"
 
 // RedisConPool类：Redis连接池
 // 
@@ -175,6 +176,11 @@ public:
     // 返回：true 表示命令执行成功（不代表有订阅者接收），false 表示执行失败
     bool Publish(const std::string& channel, const std::string& message);
 
+    // 追加一条记录到 Stream（XADD key MAXLEN ~ maxlen * field value ...）
+    // 超过 maxlen 的旧记录由 Redis 近似裁剪；成功时 id 为 Redis 分配的记录 ID
+    bool XAdd(const std::string& key, size_t maxlen,
+        const std::vector<std::pair<std::string, std::string>>& fields, std::string& id);
+
     // 身份认证
     // 参数：
     //   - password: Redis密码
@@ -237,6 +243,15 @@ public:
     //   成功返回true，否则返回false
     bool HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen);
 
+    // 一次设置多个哈希字段
+    // 参数：
+    //   - key: 哈希键名
+    //   - fields: 字段名与字段值
+    //   - ttl_sec: 大于 0 时同时设置整个哈希的过期时间
+    // 返回值：
+    //   成功返回true，否则返回false
+    bool HSetFields(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, int ttl_sec = 0);
+
     // 删除哈希字段
     // 参数：
     //   - key: 哈希键名
@@ -280,8 +295,11 @@ private:
     //   创建Redis连接池（默认5个连接）
     RedisMgr();
 
-    // Redis连接池指针
-    std::unique_ptr<RedisConPool> con_pool_;
+    // 路由执行一条命令，调用方 freeReplyObject；连接不可用时返回 nullptr
+    redisReply* Command(const std::vector<std::string>& argv);
+
+    // 单机时只有一个连接池；集群模式下按槽路由到各主节点的连接池
+    std::unique_ptr<RedisRouter<RedisConPool>> router_;
 };
 
 
@@ -52,8 +52,14 @@ private:
 };
 
 #define CODEPREFIX "code_"
-#define USERIPPREFIX "uip_"
-#define USERTOKENPREFIX "utoken_"
+// 每个在线用户一个哈希 user_<uid>（小哈希在 Redis 中以 listpack 紧凑存储，一个键代替原来的三个）：
+//   token   登录令牌（StatusServer 分配时写入）
+//   server  所在 ChatServer 名称（登录时写入，跨服投递按它路由）
+//   name / email / nick / desc / sex / icon   基础资料（不含密码），登录时一次 HMGET 取回
+// 整个哈希 USER_HASH_TTL 秒后过期，分配 token、登录时续期
+#define USER_HASH_PREFIX "user_"
+#define USER_HASH_TTL 604800
 #define IPCOUNTPREFIX "ipcount_"
-#define USER_BASE_INFO "ubaseinfo_"
 #define LOGIN_COUNT "logincount"
+#define FRIEND_STREAM_PREFIX "friend_stream_"  // 好友事件按服务器分 Stream：前缀 + 用户所在服务器名（用户哈希的 server 字段）
+#define FRIEND_STREAM_MAXLEN 10000             // 每个 Stream 近似保留的最大条数
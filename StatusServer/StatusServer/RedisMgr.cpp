@@ -17,25 +17,6 @@ namespace {
     }
 } // namespace
 
-// RAII guard��ȷ��ȡ�������ӻ�������ʱ�黹������
-class RedisConnectionGuard {
-public:
-    RedisConnectionGuard(RedisConPool* pool, redisContext* ctx) : pool_(pool), ctx_(ctx) {}
-    ~RedisConnectionGuard() {
-        if (pool_ && ctx_) {
-            pool_->returnConnection(ctx_);
-            // ���� ctx_ Ϊ nullptr����Ϊ�����󲻻�����
-        }
-    }
-    redisContext* get() const { return ctx_; }
-    // ��ֹ����
-    RedisConnectionGuard(const RedisConnectionGuard&) = delete;
-    RedisConnectionGuard& operator=(const RedisConnectionGuard&) = delete;
-private:
-    RedisConPool* pool_;
-    redisContext* ctx_;
-};
-
 // RedisMgr ����������
 RedisMgr::RedisMgr()
 {
@@ -43,11 +24,13 @@ RedisMgr::RedisMgr()
     auto host = gCfgMgr["Redis"]["Host"];
     auto port = gCfgMgr["Redis"]["Port"];
     auto pwd = gCfgMgr["Redis"]["Passwd"];
-    // 根据CPU核心数动态设置连接池大小
+    // Nodes 非空时按 Redis Cluster 路由，Host / Port 不再用于命令
+    auto nodes = gCfgMgr["Redis"]["Nodes"];
+    // 根据CPU核心数动态设置连接池大小（集群模式下每个主节点一个池）
     size_t pool_size = std::max(16u, std::thread::hardware_concurrency() * 2);
     std::cout << "[RedisMgr] CPU cores: " << std::thread::hardware_concurrency() 
               << ", Redis pool size: " << pool_size << std::endl;
-    con_pool_.reset(new RedisConPool(pool_size, host.c_str(), atoi(port.c_str()), pwd.c_str()));
+    router_.reset(new RedisRouter<RedisConPool>(nodes, host, atoi(port.c_str()), pwd, pool_size));
 }
 
 RedisMgr::~RedisMgr()
@@ -55,17 +38,15 @@ RedisMgr::~RedisMgr()
     Close();
 }
 
+redisReply* RedisMgr::Command(const std::vector<std::string>& argv)
+{
+    return router_->Command(argv).release();
+}
+
 // Get
 bool RedisMgr::Get(const std::string& key, std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Get] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "GET %s", key.c_str());
+    redisReply* reply = Command({ "GET", key });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Get] redisCommand returned NULL for key=" << key << std::endl;
         return false;
@@ -92,14 +73,7 @@ bool RedisMgr::Get(const std::string& key, std::string& value)
 
 // Set
 bool RedisMgr::Set(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Set] getConnection returned nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "SET %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "SET", key, value });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Set] Execut command [ SET " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -125,14 +99,7 @@ bool RedisMgr::Set(const std::string& key, const std::string& value) {
 // Auth
 bool RedisMgr::Auth(const std::string& password)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Auth] getConnection returned nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "AUTH %s", password.c_str());
+    redisReply* reply = Command({ "AUTH", password });
     if (reply == nullptr) {
         std::cout << "[RedisMgr::Auth] AUTH returned NULL\n";
         return false;
@@ -152,14 +119,7 @@ bool RedisMgr::Auth(const std::string& password)
 // LPush
 bool RedisMgr::LPush(const std::string& key, const std::string& value)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "LPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -178,14 +138,7 @@ bool RedisMgr::LPush(const std::string& key, const std::string& value)
 
 // LPop
 bool RedisMgr::LPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::LPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "LPOP %s", key.c_str());
+    redisReply* reply = Command({ "LPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ LPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -210,14 +163,7 @@ bool RedisMgr::LPop(const std::string& key, std::string& value) {
 
 // RPush
 bool RedisMgr::RPush(const std::string& key, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPush] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPUSH %s %s", key.c_str(), value.c_str());
+    redisReply* reply = Command({ "RPUSH", key, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPUSH " << key << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -236,14 +182,7 @@ bool RedisMgr::RPush(const std::string& key, const std::string& value) {
 
 // RPop
 bool RedisMgr::RPop(const std::string& key, std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::RPop] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "RPOP %s", key.c_str());
+    redisReply* reply = Command({ "RPOP", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ RPOP " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -268,14 +207,7 @@ bool RedisMgr::RPop(const std::string& key, std::string& value) {
 
 // HSet (string overload)
 bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::string& value) {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "HSET %s %s %s", key.c_str(), hkey.c_str(), value.c_str());
+    redisReply* reply = Command({ "HSET", key, hkey, value });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet " << key << "  " << hkey << "  " << value << " ] failure (reply==NULL)!\n";
         return false;
@@ -295,25 +227,7 @@ bool RedisMgr::HSet(const std::string& key, const std::string& hkey, const std::
 // HSet (binary overload using redisCommandArgv)
 bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HSet(binary)] getConnection nullptr\n";
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    const char* argv[4];
-    size_t argvlen[4];
-    argv[0] = "HSET";
-    argvlen[0] = 4;
-    argv[1] = key;
-    argvlen[1] = strlen(key);
-    argv[2] = hkey;
-    argvlen[2] = strlen(hkey);
-    argv[3] = hvalue;
-    argvlen[3] = hvaluelen;
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 4, argv, argvlen);
+    redisReply* reply = Command({ "HSET", key, hkey, std::string(hvalue, hvaluelen) });
     if (reply == nullptr) {
         std::cout << "Execut command [ HSet(binary) ] failure (reply==NULL)!\n";
         return false;
@@ -332,16 +246,8 @@ bool RedisMgr::HSet(const char* key, const char* hkey, const char* hvalue, size_
 
 bool RedisMgr::HDel(const std::string& key, const std::string& field)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HDel] getConnection returned nullptr for key=" << key << " field=" << field << std::endl;
-        return false;
-    }
-    // RAII: ȷ�����ӻᱻ�黹�����ӳ�
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
     // ִ�� HDEL ����
-    redisReply* reply = (redisReply*)redisCommand(connect, "HDEL %s %s", key.c_str(), field.c_str());
+    redisReply* reply = Command({ "HDEL", key, field });
     if (reply == nullptr) {
         std::cout << "Execut command [ HDEL " << key << " " << field << " ] failure (reply==NULL)!\n";
         return false;
@@ -377,23 +283,7 @@ bool RedisMgr::HDel(const std::string& key, const std::string& field)
 // HGet
 std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::HGet] getConnection nullptr for key=" << key << std::endl;
-        return "";
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    const char* argv[3];
-    size_t argvlen[3];
-    argv[0] = "HGET";
-    argvlen[0] = 4;
-    argv[1] = key.c_str();
-    argvlen[1] = key.length();
-    argv[2] = hkey.c_str();
-    argvlen[2] = hkey.length();
-
-    redisReply* reply = (redisReply*)redisCommandArgv(connect, 3, argv, argvlen);
+    redisReply* reply = Command({ "HGET", key, hkey });
     if (reply == nullptr) {
         std::cout << "Execut command [ HGet " << key << " " << hkey << " ] failure (reply==NULL)!\n";
         return "";
@@ -417,17 +307,82 @@ std::string RedisMgr::HGet(const std::string& key, const std::string& hkey)
     return value;
 }
 
-// Del
-bool RedisMgr::Del(const std::string& key)
+// HSetFields：HSET 与 EXPIRE 是同一个键，在同一条连接上流水线写出，一次往返
+bool RedisMgr::HSetFields(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, int ttl_sec)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::Del] getConnection nullptr for key=" << key << std::endl;
+    if (fields.empty()) {
+        return true;
+    }
+    std::vector<std::vector<std::string>> cmds(1);
+    cmds[0].reserve(fields.size() * 2 + 2);
+    cmds[0].push_back("HSET");
+    cmds[0].push_back(key);
+    for (const auto& field : fields) {
+        cmds[0].push_back(field.first);
+        cmds[0].push_back(field.second);
+    }
+    if (ttl_sec > 0) {
+        cmds.push_back({ "EXPIRE", key, std::to_string(ttl_sec) });
+    }
+
+    std::vector<RedisReplyPtr> replies;
+    bool ok = router_->Exec(cmds, replies);
+    for (const auto& reply : replies) {
+        if (!reply) {
+            std::cout << "[RedisMgr::HSetFields] no reply for key=" << key << std::endl;
+            ok = false;
+        }
+        else if (reply->type == REDIS_REPLY_ERROR) {
+            std::cout << "[RedisMgr::HSetFields] key=" << key << " error: " << std::string(reply->str, reply->len) << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// HMGet：一次取回多个字段
+bool RedisMgr::HMGet(const std::string& key, const std::vector<std::string>& fields,
+    std::vector<std::optional<std::string>>& values)
+{
+    values.clear();
+    if (fields.empty()) {
+        return true;
+    }
+    std::vector<std::string> cmd;
+    cmd.reserve(fields.size() + 2);
+    cmd.push_back("HMGET");
+    cmd.push_back(key);
+    cmd.insert(cmd.end(), fields.begin(), fields.end());
+
+    redisReply* reply = Command(cmd);
+    if (reply == nullptr) {
+        std::cout << "Execut command [ HMGet " << key << " ] failure (reply==NULL)!\n";
+        return false;
+    }
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != fields.size()) {
+        std::cout << "Execut command [ HMGet " << key << " ] unexpected type=" << reply->type << std::endl;
+        freeReplyObject(reply);
         return false;
     }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
 
-    redisReply* reply = (redisReply*)redisCommand(connect, "DEL %s", key.c_str());
+    values.reserve(fields.size());
+    for (size_t i = 0; i < reply->elements; ++i) {
+        redisReply* element = reply->element[i];
+        if (element && element->type == REDIS_REPLY_STRING) {
+            values.emplace_back(std::string(element->str, element->len));
+        }
+        else {
+            values.emplace_back(std::nullopt);
+        }
+    }
+    freeReplyObject(reply);
+    return true;
+}
+
+// Del
+bool RedisMgr::Del(const std::string& key)
+{
+    redisReply* reply = Command({ "DEL", key });
     if (reply == nullptr) {
         std::cout << "Execut command [ Del " << key << " ] failure (reply==NULL)!\n";
         return false;
@@ -447,14 +402,7 @@ bool RedisMgr::Del(const std::string& key)
 // ExistsKey
 bool RedisMgr::ExistsKey(const std::string& key)
 {
-    auto connect = con_pool_->getConnection();
-    if (connect == nullptr) {
-        std::cout << "[RedisMgr::ExistsKey] getConnection nullptr for key=" << key << std::endl;
-        return false;
-    }
-    RedisConnectionGuard guard(con_pool_.get(), connect);
-
-    redisReply* reply = (redisReply*)redisCommand(connect, "EXISTS %s", key.c_str());
+    redisReply* reply = Command({ "EXISTS", key });
     if (reply == nullptr) {
         std::cout << "Not Found [ Key " << key << " ]  ! (reply==NULL)\n";
         return false;
@@ -473,11 +421,9 @@ bool RedisMgr::ExistsKey(const std::string& key)
 
 void RedisMgr::Close()
 {
-    if (con_pool_) {
-        con_pool_->Close();
-        // ע�⣺RedisConPool::Close() Ӧ���ͷ����� redisContext��redisFree��
-        // ����㻹û�� RedisConPool ��ʵ���ͷţ����� RedisConPool::Close/�������ͷ� ctx
-        con_pool_.reset();
+    // 只停止连接池（之后取连接返回 nullptr），路由表和池对象留到析构时释放
+    if (router_) {
+        router_->Close();
     }
 }
 
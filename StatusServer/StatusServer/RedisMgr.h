@@ -1,6 +1,10 @@
 #pragma once
 #include"const.h"
+#include "RedisRouter.h"
 #include <queue>
+#include <optional>
+#include <string>
+#include <vector>
 
 class RedisConPool {
 public:
@@ -97,8 +101,13 @@ public:
     bool HSet(const std::string& key, const std::string& hkey, const std::string& value);
     bool HSet(const char* key, const char* hkey, const char* hvalue, size_t hvaluelen);
     bool HDel(const std::string& key, const std::string& field);
+    // HSET 多个字段；ttl_sec > 0 时同时设置整个哈希的过期时间
+    bool HSetFields(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, int ttl_sec = 0);
 
     std::string HGet(const std::string& key, const std::string& hkey);
+    // HMGET：values 与 fields 一一对应，不存在的字段为 std::nullopt
+    bool HMGet(const std::string& key, const std::vector<std::string>& fields,
+        std::vector<std::optional<std::string>>& values);
     bool Del(const std::string& key);
     bool ExistsKey(const std::string& key);
     void Close();
@@ -108,6 +117,10 @@ private:
     //redisContext* _connect;
     //redisReply* _reply;
 
-    std::unique_ptr<RedisConPool> con_pool_;
+    // 路由执行一条命令，调用方 freeReplyObject；连接不可用时返回 nullptr
+    redisReply* Command(const std::vector<std::string>& argv);
+
+    // 单机时只有一个连接池；集群模式下按槽路由到各主节点的连接池
+    std::unique_ptr<RedisRouter<RedisConPool>> router_;
 };
 
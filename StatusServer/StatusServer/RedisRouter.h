@@ -0,0 +1,550 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <hiredis/hiredis.h>
+
+struct RedisReplyDeleter {
+    void operator()(redisReply* reply) const {
+        if (reply) freeReplyObject(reply);
+    }
+};
+using RedisReplyPtr = std::unique_ptr<redisReply, RedisReplyDeleter>;
+
+constexpr int REDIS_CLUSTER_SLOTS = 16384;
+
+// CRC16-CCITT（XMODEM，多项式 0x1021），Redis Cluster 的键槽算法
+inline uint16_t RedisCrc16(const char* buf, size_t len)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= static_cast<uint16_t>(static_cast<unsigned char>(buf[i]) << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// 键所在的槽：含非空的 {tag} 时只对第一个 { 与其后第一个 } 之间的内容计算，
+// 需要在同一个脚本里访问的键用相同的 tag（如 inbox_{uid}、inbox_state_{uid}）
+inline int RedisKeySlot(const std::string& key)
+{
+    auto open = key.find('{');
+    if (open != std::string::npos) {
+        auto close = key.find('}', open + 1);
+        if (close != std::string::npos && close != open + 1) {
+            return RedisCrc16(key.data() + open + 1, close - open - 1) & (REDIS_CLUSTER_SLOTS - 1);
+        }
+    }
+    return RedisCrc16(key.data(), key.size()) & (REDIS_CLUSTER_SLOTS - 1);
+}
+
+inline bool RedisCommandIs(const std::string& arg, const char* name)
+{
+    size_t i = 0;
+    for (; i < arg.size() && name[i] != '\0'; ++i) {
+        if (std::toupper(static_cast<unsigned char>(arg[i])) != name[i]) return false;
+    }
+    return i == arg.size() && name[i] == '\0';
+}
+
+// 命令中用于路由的键：EVAL / EVALSHA 取第一个 KEYS，XREAD / XREADGROUP 取 STREAMS 之后的第一个，
+// 其余命令取第一个参数；不带键的命令（PING、SCRIPT、MULTI 等）返回 nullptr
+inline const std::string* RedisCommandKey(const std::vector<std::string>& argv)
+{
+    if (argv.size() < 2) return nullptr;
+    const std::string& cmd = argv[0];
+    if (RedisCommandIs(cmd, "EVAL") || RedisCommandIs(cmd, "EVALSHA")) {
+        if (argv.size() < 4 || std::atoi(argv[2].c_str()) <= 0) return nullptr;
+        return &argv[3];
+    }
+    if (RedisCommandIs(cmd, "XREAD") || RedisCommandIs(cmd, "XREADGROUP")) {
+        for (size_t i = 1; i + 1 < argv.size(); ++i) {
+            if (RedisCommandIs(argv[i], "STREAMS")) return &argv[i + 1];
+        }
+        return nullptr;
+    }
+    static const char* const keyless[] = { "PING", "ECHO", "AUTH", "SELECT", "INFO", "CONFIG", "CLIENT",
+        "CLUSTER", "SCRIPT", "MULTI", "EXEC", "DISCARD", "ASKING", "DBSIZE" };
+    for (const char* name : keyless) {
+        if (RedisCommandIs(cmd, name)) return nullptr;
+    }
+    return &argv[1];
+}
+
+// 解析 "MOVED 3999 127.0.0.1:6381" / "ASK 3999 127.0.0.1:6381"
+inline bool RedisParseRedirect(const std::string& error, bool& ask, int& slot, std::string& addr)
+{
+    if (error.compare(0, 6, "MOVED ") == 0) {
+        ask = false;
+    }
+    else if (error.compare(0, 4, "ASK ") == 0) {
+        ask = true;
+    }
+    else {
+        return false;
+    }
+    std::istringstream in(error);
+    std::string kind;
+    in >> kind >> slot >> addr;
+    return !in.fail() && slot >= 0 && slot < REDIS_CLUSTER_SLOTS && addr.find(':') != std::string::npos;
+}
+
+inline bool RedisParseRedirect(const redisReply* reply, bool& ask, int& slot, std::string& addr)
+{
+    if (reply == nullptr || reply->type != REDIS_REPLY_ERROR || reply->str == nullptr) return false;
+    return RedisParseRedirect(std::string(reply->str, reply->len), ask, slot, addr);
+}
+
+// "host:port" 拆成主机和端口（IPv6 地址取最后一个冒号）
+inline bool RedisSplitAddr(const std::string& addr, std::string& host, int& port)
+{
+    auto colon = addr.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 >= addr.size()) return false;
+    host = addr.substr(0, colon);
+    port = std::atoi(addr.c_str() + colon + 1);
+    return port > 0;
+}
+
+// Redis 多节点路由（Redis Cluster 协议）
+//
+// 作用：
+//   单个 Redis 的内存和单线程吞吐是所有服务共同的上限。[Redis] Nodes 配置了节点列表时按 Redis Cluster 协议路由：
+//   键按 CRC16(key) % 16384 落到槽，槽到主节点的映射用 CLUSTER SLOTS 取得，每个主节点一个连接池。
+//   Lua 脚本的所有 KEYS 必须在同一个槽，跨用户的批量操作由调用方按槽拆成多次调用。
+//
+// 重定向：
+//   槽迁移、主从切换后节点回复 MOVED slot host:port：更新这个槽、重发命令，并（至多每秒一次）重新拉取整张槽表；
+//   迁移进行中回复 ASK slot host:port：只对这一条命令在目标节点上先发 ASKING 再重发，不改槽表。
+//   每条命令最多跟随 MAX_REDIRECTS 次重定向。
+//
+// 批量：
+//   Exec 按节点把命令分组，每组在该节点的一条连接上流水线发送；各组先全部写出再依次读回，
+//   涉及多个节点的批量也只花一个往返左右。收到重定向的命令之后逐条重发。
+//   一次批量要同时持有多个池的连接，按节点序号的固定顺序获取，两个批量不会互相等待对方的连接。
+//   MULTI / EXEC 这类不带键的命令在集群模式下发往槽 0 所在的节点，不能放进批量里。
+//
+// 单机：
+//   Nodes 为空时只连 [Redis] Host / Port，所有命令走同一个连接池，不计算槽，行为与原来一致。
+//   Nodes 中的实例没有开启集群模式（CLUSTER SLOTS 报错）时，全部槽都归这个实例。
+//
+// Pool 为连接池类型：Pool(size_t poolSize, const char* host, int port, const char* pwd)、
+// getConnection()、returnConnection(redisContext*)、Close()
+template <class Pool>
+class RedisRouter {
+public:
+    RedisRouter(const std::string& nodes, const std::string& host, int port, std::string pwd, size_t poolSize)
+        : pwd_(std::move(pwd)), pool_size_(poolSize), slots_(REDIS_CLUSTER_SLOTS, 0) {
+        std::stringstream in(nodes);
+        std::string addr;
+        while (std::getline(in, addr, ',')) {
+            addr.erase(std::remove_if(addr.begin(), addr.end(), [](unsigned char c) { return std::isspace(c); }), addr.end());
+            if (!addr.empty()) seeds_.push_back(addr);
+        }
+
+        if (seeds_.empty()) {
+            single_ = NodeAt(host + ":" + std::to_string(port), false);
+            return;
+        }
+        clustered_ = true;
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        if (!RefreshSlots()) {
+            // 槽表暂时拿不到：命令先发往第一个可用的种子节点，靠 MOVED 逐步修正
+            for (const auto& seed : seeds_) {
+                if (NodeAt(seed) != nullptr) break;
+            }
+            refresh_due_ = true;
+        }
+    }
+
+    ~RedisRouter() {
+        Close();
+    }
+
+    RedisRouter(const RedisRouter&) = delete;
+    RedisRouter& operator=(const RedisRouter&) = delete;
+
+    bool Clustered() const { return clustered_; }
+
+    // 执行一条命令，按命令的键路由并跟随 MOVED / ASK；连接不可用、读写失败返回空指针
+    RedisReplyPtr Command(const std::vector<std::string>& argv) {
+        if (argv.empty()) return nullptr;
+        if (refresh_due_) MaybeRefresh();
+        Node* node = NodeFor(RedisCommandKey(argv));
+        bool asking = false;
+        for (int hop = 0; hop <= MAX_REDIRECTS; ++hop) {
+            if (node == nullptr) {
+                std::cout << "[RedisRouter] no node available for " << argv[0] << std::endl;
+                return nullptr;
+            }
+            redisContext* ctx = node->pool->getConnection();
+            if (ctx == nullptr) {
+                std::cout << "[RedisRouter] getConnection nullptr on " << node->addr << " for " << argv[0] << std::endl;
+                return nullptr;
+            }
+            if (asking) {
+                redisAppendCommand(ctx, "ASKING");
+            }
+            Append(ctx, argv);
+            RedisReplyPtr reply;
+            bool ok = true;
+            for (int n = asking ? 2 : 1; n > 0 && ok; --n) {
+                redisReply* raw = nullptr;
+                ok = redisGetReply(ctx, reinterpret_cast<void**>(&raw)) == REDIS_OK && raw != nullptr;
+                reply.reset(raw);
+            }
+            if (!ok) {
+                std::cout << "[RedisRouter] " << argv[0] << " on " << node->addr << " failed: " << ctx->errstr << std::endl;
+            }
+            node->pool->returnConnection(ctx);
+            if (!ok) return nullptr;
+
+            bool ask = false;
+            int slot = 0;
+            std::string addr;
+            if (!RedisParseRedirect(reply.get(), ask, slot, addr)) {
+                return reply;
+            }
+            if (!ask) {
+                Moved(slot, addr);
+            }
+            node = NodeAt(addr);
+            asking = ask;
+        }
+        std::cerr << "[RedisRouter] " << argv[0] << " redirected more than " << MAX_REDIRECTS << " times" << std::endl;
+        return nullptr;
+    }
+
+    // 批量执行：replies 与 cmds 一一对应，没有拿到回复的为空指针。
+    // 有命令没能发出或没读到回复时返回 false；单条命令的错误回复不影响返回值
+    bool Exec(const std::vector<std::vector<std::string>>& cmds, std::vector<RedisReplyPtr>& replies) {
+        replies.clear();
+        replies.resize(cmds.size());
+        if (cmds.empty()) return true;
+        if (refresh_due_) MaybeRefresh();
+
+        struct Group {
+            Node* node = nullptr;
+            std::vector<size_t> index;
+            redisContext* ctx = nullptr;
+            size_t appended = 0;
+        };
+        bool ok = true;
+        std::map<size_t, Group> groups;     // 按节点序号有序，取连接的顺序固定
+        for (size_t i = 0; i < cmds.size(); ++i) {
+            Node* node = cmds[i].empty() ? nullptr : NodeFor(RedisCommandKey(cmds[i]));
+            if (node == nullptr) {
+                ok = false;
+                continue;
+            }
+            auto& group = groups[node->index];
+            group.node = node;
+            group.index.push_back(i);
+        }
+
+        // 各组追加到各自连接的输出缓冲后立即写出，全部写完再读，节点之间的往返相互重叠
+        for (auto& item : groups) {
+            auto& group = item.second;
+            group.ctx = group.node->pool->getConnection();
+            if (group.ctx == nullptr) {
+                std::cout << "[RedisRouter::Exec] getConnection nullptr on " << group.node->addr << std::endl;
+                continue;
+            }
+            for (size_t i : group.index) {
+                if (Append(group.ctx, cmds[i]) != REDIS_OK) {
+                    std::cout << "[RedisRouter::Exec] redisAppendCommandArgv failed on " << group.node->addr << std::endl;
+                    break;
+                }
+                ++group.appended;
+            }
+            int done = 0;
+            while (!done && redisBufferWrite(group.ctx, &done) == REDIS_OK) {
+            }
+        }
+
+        // 已追加的命令的回复必须全部读掉，否则这条连接归还后回复会错位
+        for (auto& item : groups) {
+            auto& group = item.second;
+            if (group.ctx == nullptr) {
+                ok = false;
+                continue;
+            }
+            for (size_t k = 0; k < group.appended; ++k) {
+                redisReply* reply = nullptr;
+                if (redisGetReply(group.ctx, reinterpret_cast<void**>(&reply)) != REDIS_OK || reply == nullptr) {
+                    // 连接已出错（err 置位），之后这条连接上的命令都会直接失败，不会读到错位的回复
+                    std::cout << "[RedisRouter::Exec] redisGetReply failed on " << group.node->addr
+                        << " at " << k << "/" << group.appended << ": " << group.ctx->errstr << std::endl;
+                    break;
+                }
+                replies[group.index[k]].reset(reply);
+            }
+            group.node->pool->returnConnection(group.ctx);
+            for (size_t i : group.index) {
+                if (!replies[i]) ok = false;
+            }
+        }
+
+        // 槽已迁移的命令逐条重发
+        for (size_t i = 0; i < replies.size(); ++i) {
+            bool ask = false;
+            int slot = 0;
+            std::string addr;
+            if (!RedisParseRedirect(replies[i].get(), ask, slot, addr)) continue;
+            if (!ask) Moved(slot, addr);
+            replies[i] = Command(cmds[i]);
+            if (!replies[i]) ok = false;
+        }
+        return ok;
+    }
+
+    // 在每个已知节点上执行一次（SCRIPT LOAD 等节点级命令），返回 节点地址 -> 回复
+    std::vector<std::pair<std::string, RedisReplyPtr>> Broadcast(const std::vector<std::string>& argv) {
+        std::vector<Node*> nodes;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            for (const auto& node : nodes_) nodes.push_back(node.get());
+        }
+        std::vector<std::pair<std::string, RedisReplyPtr>> replies;
+        for (Node* node : nodes) {
+            RedisReplyPtr reply;
+            if (redisContext* ctx = node->pool->getConnection()) {
+                Append(ctx, argv);
+                redisReply* raw = nullptr;
+                if (redisGetReply(ctx, reinterpret_cast<void**>(&raw)) == REDIS_OK) reply.reset(raw);
+                node->pool->returnConnection(ctx);
+            }
+            replies.emplace_back(node->addr, std::move(reply));
+        }
+        return replies;
+    }
+
+    // 命令应发往的节点地址 host:port；没有可用节点时为空串
+    std::string NodeAddr(const std::vector<std::string>& argv) {
+        Node* node = NodeFor(RedisCommandKey(argv));
+        return node ? node->addr : std::string();
+    }
+
+    std::vector<std::string> NodeAddrs() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::vector<std::string> addrs;
+        for (const auto& node : nodes_) addrs.push_back(node->addr);
+        return addrs;
+    }
+
+    // 收到 MOVED：把这个槽指向新节点，并按需重新拉取槽表。
+    // wait 为 false 时（IO 线程）不建连接池、不拉槽表：新节点已知就只改这个槽，整张表留给下一条同步命令刷新
+    void Moved(int slot, const std::string& addr, bool wait = true) {
+        if (!clustered_ || slot < 0 || slot >= REDIS_CLUSTER_SLOTS) return;
+        refresh_due_ = true;
+        Node* node = wait ? NodeAt(addr) : Find(addr);
+        if (node != nullptr) {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            slots_[slot] = node->index;
+        }
+        if (wait) MaybeRefresh();
+    }
+
+    void Close() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (auto& node : nodes_) {
+            node->pool->Close();
+        }
+    }
+
+private:
+    struct Node {
+        size_t index = 0;
+        std::string addr;
+        std::string host;       // 连接池保存的是 host 的 c_str()，与池同寿命
+        int port = 0;
+        std::unique_ptr<Pool> pool;
+    };
+
+    static int Append(redisContext* ctx, const std::vector<std::string>& argv) {
+        std::vector<const char*> args;
+        std::vector<size_t> lens;
+        args.reserve(argv.size());
+        lens.reserve(argv.size());
+        for (const auto& arg : argv) {
+            args.push_back(arg.data());
+            lens.push_back(arg.size());
+        }
+        return redisAppendCommandArgv(ctx, static_cast<int>(args.size()), args.data(), lens.data());
+    }
+
+    // 建一条临时连接（拉槽表、探测新节点），失败返回 nullptr
+    redisContext* Connect(const std::string& host, int port) {
+        struct timeval tv = { 1, 500000 };
+        redisContext* ctx = redisConnectWithTimeout(host.c_str(), port, tv);
+        if (ctx == nullptr || ctx->err != 0) {
+            std::cout << "[RedisRouter] connect " << host << ":" << port << " failed: "
+                << (ctx ? ctx->errstr : "alloc") << std::endl;
+            if (ctx) redisFree(ctx);
+            return nullptr;
+        }
+        if (!pwd_.empty()) {
+            RedisReplyPtr reply(static_cast<redisReply*>(redisCommand(ctx, "AUTH %s", pwd_.c_str())));
+            if (!reply || reply->type == REDIS_REPLY_ERROR) {
+                std::cout << "[RedisRouter] AUTH " << host << ":" << port << " failed" << std::endl;
+                redisFree(ctx);
+                return nullptr;
+            }
+        }
+        return ctx;
+    }
+
+    Node* Find(const std::string& addr) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto iter = by_addr_.find(addr);
+        return iter == by_addr_.end() ? nullptr : nodes_[iter->second].get();
+    }
+
+    // 取节点，首次出现时建连接池。probe 为 true 时先试连一次：
+    // 连接池在一条连接都没建成时取连接会一直等待，不可达的节点不建池
+    Node* NodeAt(const std::string& addr, bool probe = true) {
+        if (Node* node = Find(addr)) return node;
+        std::lock_guard<std::mutex> create_lock(create_mutex_);
+        if (Node* node = Find(addr)) return node;
+
+        auto node = std::make_unique<Node>();
+        node->addr = addr;
+        if (!RedisSplitAddr(addr, node->host, node->port)) {
+            std::cerr << "[RedisRouter] bad node address: " << addr << std::endl;
+            return nullptr;
+        }
+        if (probe) {
+            redisContext* ctx = Connect(node->host, node->port);
+            if (ctx == nullptr) return nullptr;
+            redisFree(ctx);
+        }
+        node->pool = std::make_unique<Pool>(pool_size_, node->host.c_str(), node->port, pwd_.c_str());
+        std::cout << "[RedisRouter] node " << addr << " pool_size=" << pool_size_ << std::endl;
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        node->index = nodes_.size();
+        by_addr_[addr] = node->index;
+        nodes_.push_back(std::move(node));
+        return nodes_.back().get();
+    }
+
+    Node* NodeFor(const std::string* key) {
+        if (!clustered_) return single_;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (nodes_.empty()) return nullptr;
+        return nodes_[slots_[key ? RedisKeySlot(*key) : 0]].get();
+    }
+
+    // 至多每秒拉一次槽表；其它线程正在拉时直接返回
+    void MaybeRefresh() {
+        std::unique_lock<std::mutex> lock(refresh_mutex_, std::try_to_lock);
+        if (!lock.owns_lock() || std::chrono::steady_clock::now() - last_refresh_ < std::chrono::seconds(1)) return;
+        if (RefreshSlots()) refresh_due_ = false;
+    }
+
+    // 依次向已知节点、种子节点请求 CLUSTER SLOTS，用第一个成功的结果更新槽表。调用方持有 refresh_mutex_
+    bool RefreshSlots() {
+        last_refresh_ = std::chrono::steady_clock::now();
+        std::vector<std::string> candidates = NodeAddrs();
+        for (const auto& seed : seeds_) {
+            if (std::find(candidates.begin(), candidates.end(), seed) == candidates.end()) candidates.push_back(seed);
+        }
+
+        for (const auto& addr : candidates) {
+            std::string host;
+            int port = 0;
+            if (!RedisSplitAddr(addr, host, port)) continue;
+            redisContext* ctx = Connect(host, port);
+            if (ctx == nullptr) continue;
+            RedisReplyPtr reply(static_cast<redisReply*>(redisCommand(ctx, "CLUSTER SLOTS")));
+            redisFree(ctx);
+            if (!reply) continue;
+
+            struct Range {
+                int first;
+                int last;
+                std::string addr;
+            };
+            std::vector<Range> ranges;
+            if (reply->type == REDIS_REPLY_ERROR) {
+                std::cout << "[RedisRouter] " << addr << " is not in cluster mode ("
+                    << std::string(reply->str, reply->len) << "), all slots go to it" << std::endl;
+                ranges.push_back({ 0, REDIS_CLUSTER_SLOTS - 1, addr });
+            }
+            else if (reply->type == REDIS_REPLY_ARRAY) {
+                // 每项为 [起始槽, 结束槽, [主节点 host, port, id], 从节点...]
+                for (size_t i = 0; i < reply->elements; ++i) {
+                    const redisReply* range = reply->element[i];
+                    if (range->type != REDIS_REPLY_ARRAY || range->elements < 3) continue;
+                    const redisReply* master = range->element[2];
+                    if (master->type != REDIS_REPLY_ARRAY || master->elements < 2
+                        || master->element[1]->type != REDIS_REPLY_INTEGER) continue;
+                    std::string master_host;
+                    if (master->element[0]->type == REDIS_REPLY_STRING) {
+                        master_host.assign(master->element[0]->str, master->element[0]->len);
+                    }
+                    // 主机名为空表示与应答的节点相同
+                    if (master_host.empty() || master_host == "?") master_host = host;
+                    ranges.push_back({ static_cast<int>(range->element[0]->integer), static_cast<int>(range->element[1]->integer),
+                        master_host + ":" + std::to_string(master->element[1]->integer) });
+                }
+            }
+            if (ranges.empty()) continue;
+
+            // 先建好各主节点的连接池，再一次性改槽表
+            std::vector<std::pair<const Range*, size_t>> resolved;
+            for (const auto& range : ranges) {
+                Node* node = NodeAt(range.addr);
+                if (node == nullptr) continue;
+                resolved.emplace_back(&range, node->index);
+            }
+            if (resolved.empty()) continue;
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                for (const auto& item : resolved) {
+                    int first = std::max(item.first->first, 0);
+                    int last = std::min(item.first->last, REDIS_CLUSTER_SLOTS - 1);
+                    for (int slot = first; slot <= last; ++slot) {
+                        slots_[slot] = item.second;
+                    }
+                }
+            }
+            std::cout << "[RedisRouter] slot map from " << addr << ": " << resolved.size() << "/" << ranges.size()
+                << " ranges, " << NodeAddrs().size() << " nodes" << std::endl;
+            return resolved.size() == ranges.size();
+        }
+        std::cerr << "[RedisRouter] CLUSTER SLOTS failed on all known nodes" << std::endl;
+        return false;
+    }
+
+    static constexpr int MAX_REDIRECTS = 5;
+
+    const std::string pwd_;
+    const size_t pool_size_;
+    std::vector<std::string> seeds_;
+    bool clustered_ = false;
+    Node* single_ = nullptr;
+
+    std::shared_mutex mutex_;                       // nodes_、by_addr_、slots_
+    std::vector<std::unique_ptr<Node>> nodes_;      // 只增不删，Node* 一直有效
+    std::unordered_map<std::string, size_t> by_addr_;
+    std::vector<size_t> slots_;                     // 槽 -> nodes_ 下标
+
+    std::mutex create_mutex_;                       // 同一地址只建一个连接池
+    std::mutex refresh_mutex_;
+    std::chrono::steady_clock::time_point last_refresh_;
+    std::atomic<bool> refresh_due_{ false };
+};
@@ -11,6 +11,8 @@
 #include <climits>
 #include <sstream>
 #include <cctype>
+#include <optional>
+#include <vector>
 #include<grpc/grpc.h>
 
 // 辅助函数：去除字符串首尾的空白字符
@@ -40,13 +42,13 @@ std::string generate_unique_string() {
 //   - token: 认证令牌
 // 
 // 实现逻辑：
-//   1. 构造Redis键：USERTOKENPREFIX + uid
-//   2. 将token存储到Redis中
+//   1. 构造Redis键：USER_HASH_PREFIX + uid
+//   2. 将token写入用户哈希的 token 字段，并续期整个哈希
 void StatusServiceImpl::insertToken(int uid, std::string token)
 {
     std::string uid_str = std::to_string(uid);
-    std::string token_key = USERTOKENPREFIX + uid_str;
-    RedisMgr::GetInstance()->Set(token_key, token);
+    std::string token_key = USER_HASH_PREFIX + uid_str;
+    RedisMgr::GetInstance()->HSetFields(token_key, { { "token", token } }, USER_HASH_TTL);
     std::cout << "[insertToken] uid=" << uid << " key=" << token_key << " token=" << token << std::endl;
 }
 
@@ -61,7 +63,7 @@ void StatusServiceImpl::insertToken(int uid, std::string token)
 // 
 // 实现逻辑：
 //   1. 遍历所有ChatServer
-//   2. 从Redis读取每个ChatServer的当前连接数（HGET LOGIN_COUNT server_name）
+//   2. 一次 HMGET LOGIN_COUNT 读出所有ChatServer的当前连接数
 //   3. 选择连接数最少的ChatServer
 //   4. 如果没有记录，将连接数设为INT_MAX（优先选择有记录的服务器）
 ChatServer StatusServiceImpl::getChatServer()
@@ -77,12 +79,25 @@ ChatServer StatusServiceImpl::getChatServer()
         return best;
     }
 
+    // 所有服务器的登录计数用一次 HMGET 读出，不再每台一次 HGET
+    std::vector<std::string> names;
+    names.reserve(_servers.size());
+    for (auto& kv : _servers) {
+        names.push_back(kv.second.name);
+    }
+    std::vector<std::optional<std::string>> counts;
+    if (!RedisMgr::GetInstance()->HMGet(LOGIN_COUNT, names, counts)) {
+        counts.assign(names.size(), std::nullopt);
+    }
+
     // 遍历所有ChatServer，选择连接数最少的
+    size_t index = 0;
     for (auto& kv : _servers) {
         ChatServer s = kv.second;
 
-        // 从 Redis 读取当前服务器的登录记录数
-        std::string count_str = RedisMgr::GetInstance()->HGet(LOGIN_COUNT, s.name);
+        // 当前服务器的登录记录数
+        const auto& count = counts[index++];
+        std::string count_str = count ? *count : std::string();
         if (count_str.empty()) {
             s.con_count = INT_MAX; // 无记录 -> 视为最小值（优先选择有记录的）
         }
@@ -163,7 +178,7 @@ Status StatusServiceImpl::GetChatServer(ServerContext* context, const GetChatSer
 //   验证用户的token是否有效
 // 
 // 实现逻辑：
-//   1. 从Redis读取用户对应的token（key = USERTOKENPREFIX + uid）
+//   1. 从Redis读取用户对应的token（用户哈希 USER_HASH_PREFIX + uid 的 token 字段）
 //   2. 比较请求中的token和Redis中的token
 //   3. 如果匹配，返回成功；否则返回失败
 // 
@@ -176,12 +191,11 @@ Status StatusServiceImpl::Login(ServerContext* context, const message::LoginReq*
 
     // 构造Redis键
     std::string uid_str = std::to_string(uid);
-    std::string token_key = USERTOKENPREFIX + uid_str;
-    std::string token_value;
+    std::string token_key = USER_HASH_PREFIX + uid_str;
 
     // 从Redis读取token
-    bool got = RedisMgr::GetInstance()->Get(token_key, token_value);
-    if (!got) {
+    std::string token_value = RedisMgr::GetInstance()->HGet(token_key, "token");
+    if (token_value.empty()) {
         std::cerr << "[Login] token not found in redis for uid=" << uid << " key=" << token_key << std::endl;
         reply->set_error(ErrorCodes::TokenInvalid);
         return Status::OK;
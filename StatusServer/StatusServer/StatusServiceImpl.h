@@ -85,7 +85,7 @@ private:
     //   - token: 认证令牌
     // 
     // 实现逻辑：
-    //   将token存储到Redis中（key = USERTOKENPREFIX + uid）
+    //   将token写入Redis用户哈希（key = USER_HASH_PREFIX + uid，字段 token）
     void insertToken(int uid, std::string token);
 
     // 获取可用的ChatServer（负载均衡）
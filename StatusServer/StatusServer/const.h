@@ -62,8 +62,12 @@ private:
 
 #define CODEPREFIX "code_"
 
-#define USERIPPREFIX "uip_"
-#define USERTOKENPREFIX "utoken_"
+// 每个在线用户一个哈希 user_<uid>（小哈希在 Redis 中以 listpack 紧凑存储，一个键代替原来的三个）：
+//   token   登录令牌（StatusServer 分配时写入）
+//   server  所在 ChatServer 名称（登录时写入，跨服投递按它路由）
+//   name / email / nick / desc / sex / icon   基础资料（不含密码），登录时一次 HMGET 取回
+// 整个哈希 USER_HASH_TTL 秒后过期，分配 token、登录时续期
+#define USER_HASH_PREFIX "user_"
+#define USER_HASH_TTL 604800
 #define IPCOUNTPREFIX "ipcount_"
-#define USER_BASE_INFO "ubaseinfo_"
 #define LOGIN_COUNT "logincount"
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+离线消息确认测试（user_read_cursor）
+按服务端 MysqlDao 的 SQL 执行离线确认，检查确认语义并测量耗时：
+  - AckOfflineMessages  分页游标确认：只接受该用户已入库消息的 id
+  - AckOfflineMessage   在线消息逐条确认：游标与该 id 之间没有别的消息时才推进
+  - GetUnreadChatMessagesPage  确认后按游标做键集分页
+
+用法：
+    pip install pymysql
+    python3 bench_offline_ack.py --host 127.0.0.1 --user chatuser --password 123456 --db chat_system --unread 10000
+
+注意：会在 messages / user_read_cursor 表中为一个测试 uid 写入数据，测试结束后清理
+"""
+
+import argparse
+import time
+import sys
+
+try:
+    import pymysql
+except ImportError:
+    print("需要安装 pymysql: pip install pymysql")
+    sys.exit(1)
+
+
+# 与 MysqlDao::AckOfflineMessages 一致
+RANGE_ACK_SQL = (
+    "INSERT INTO user_read_cursor (uid, read_msg_id) "
+    "SELECT to_uid, id FROM messages WHERE to_uid = %s AND id = %s "
+    "ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id))"
+)
+
+# 与 MysqlDao::AckOfflineMessage 一致
+SINGLE_ACK_SQL = (
+    "INSERT INTO user_read_cursor (uid, read_msg_id) "
+    "SELECT m.to_uid, m.id FROM messages m WHERE m.to_uid = %s AND m.id = %s "
+    "AND NOT EXISTS (SELECT 1 FROM messages g WHERE g.to_uid = m.to_uid AND g.id < m.id "
+    "AND g.id > IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = %s), 0)) "
+    "ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id))"
+)
+
+# 与 MysqlDao::GetUnreadChatMessagesPage 一致
+PAGE_SQL = (
+    "SELECT id FROM messages "
+    "WHERE to_uid = %s AND id > GREATEST(%s, IFNULL((SELECT read_msg_id FROM user_read_cursor WHERE uid = %s), 0)) "
+    "ORDER BY id ASC LIMIT %s"
+)
+
+
+def log(msg):
+    print(f"[{time.strftime('%H:%M:%S')}] {msg}")
+
+
+def cleanup(cur, uid):
+    cur.execute("DELETE FROM messages WHERE to_uid = %s", (uid,))
+    cur.execute("DELETE FROM user_read_cursor WHERE uid = %s", (uid,))
+
+
+def insert_messages(cur, uid, count, tag):
+    """为测试用户插入 count 条消息，返回按 id 升序的 id 列表"""
+    rows = [(1, uid, '{"text_array":[]}', f"bench-{tag}-{i}") for i in range(count)]
+    for i in range(0, len(rows), 1000):
+        cur.executemany(
+            "INSERT INTO messages (from_uid, to_uid, payload, codec, client_msg_id, create_time) "
+            "VALUES (%s, %s, %s, 0, %s, NOW())",
+            rows[i:i + 1000])
+    cur.execute("SELECT id FROM messages WHERE to_uid = %s AND client_msg_id LIKE %s ORDER BY id",
+                (uid, f"bench-{tag}-%"))
+    return [row[0] for row in cur.fetchall()]
+
+
+def read_cursor(cur, uid):
+    cur.execute("SELECT read_msg_id FROM user_read_cursor WHERE uid = %s", (uid,))
+    row = cur.fetchone()
+    return row[0] if row else 0
+
+
+def timed(conn, sql, args):
+    cur = conn.cursor()
+    start = time.perf_counter()
+    cur.execute(sql, args)
+    conn.commit()
+    cost = (time.perf_counter() - start) * 1000
+    return cost, cur.rowcount
+
+
+def check(name, ok, failures):
+    log(f"{'PASS' if ok else 'FAIL'}  {name}")
+    if not ok:
+        failures.append(name)
+
+
+def check_semantics(conn, uid):
+    """确认语义：越界的确认被拒绝，在线确认不越过未确认的消息，分页从游标之后开始"""
+    failures = []
+    cur = conn.cursor()
+    cleanup(cur, uid)
+    ids = insert_messages(cur, uid, 10, "sem")
+    conn.commit()
+
+    # 老客户端拿本地时间戳确认
+    _, rows = timed(conn, RANGE_ACK_SQL, (uid, int(time.time() * 1000)))
+    check("timestamp ack rejected", rows == 0 and read_cursor(cur, uid) == 0, failures)
+
+    # 不属于该用户的 id
+    _, rows = timed(conn, RANGE_ACK_SQL, (uid, ids[-1] + 1000000))
+    check("unknown id rejected", rows == 0 and read_cursor(cur, uid) == 0, failures)
+
+    # 在线确认最后一条：前面还有 9 条没确认
+    _, rows = timed(conn, SINGLE_ACK_SQL, (uid, ids[-1], uid))
+    check("single ack with gap rejected", rows == 0 and read_cursor(cur, uid) == 0, failures)
+
+    # 在线确认第一条：连续
+    _, rows = timed(conn, SINGLE_ACK_SQL, (uid, ids[0], uid))
+    check("contiguous single ack accepted", rows > 0 and read_cursor(cur, uid) == ids[0], failures)
+
+    # 分页游标确认到第 5 条
+    _, rows = timed(conn, RANGE_ACK_SQL, (uid, ids[4]))
+    check("range ack accepted", rows > 0 and read_cursor(cur, uid) == ids[4], failures)
+
+    # 重复、回退的确认不把游标往回拨
+    timed(conn, RANGE_ACK_SQL, (uid, ids[2]))
+    check("ack never moves cursor back", read_cursor(cur, uid) == ids[4], failures)
+
+    # 分页从游标之后开始，cursor 参数更小时以已读游标为准
+    cur.execute(PAGE_SQL, (uid, 0, uid, 100))
+    page = [row[0] for row in cur.fetchall()]
+    check("page starts after read cursor", page == ids[5:], failures)
+
+    # 游标之后的下一条可以逐条确认
+    _, rows = timed(conn, SINGLE_ACK_SQL, (uid, ids[5], uid))
+    check("next single ack accepted", rows > 0 and read_cursor(cur, uid) == ids[5], failures)
+
+    cleanup(cur, uid)
+    conn.commit()
+    return failures
+
+
+def bench(conn, uid, unread, rounds):
+    """未读积压为 unread 条时，分页游标确认、逐条确认、确认后取一页的耗时"""
+    range_costs, single_costs, page_costs = [], [], []
+    for r in range(rounds):
+        cur = conn.cursor()
+        cleanup(cur, uid)
+        ids = insert_messages(cur, uid, unread, f"r{r}")
+        conn.commit()
+
+        # 确认前半，再逐条确认下一条，最后取确认后的第一页
+        mid = ids[len(ids) // 2 - 1]
+        cost, rows = timed(conn, RANGE_ACK_SQL, (uid, mid))
+        range_costs.append(cost)
+        log(f"round {r + 1}: range ack   {cost:8.2f} ms, rows={rows}")
+
+        nxt = ids[len(ids) // 2]
+        cost, rows = timed(conn, SINGLE_ACK_SQL, (uid, nxt, uid))
+        single_costs.append(cost)
+        log(f"round {r + 1}: single ack  {cost:8.2f} ms, rows={rows}")
+
+        start = time.perf_counter()
+        cur.execute(PAGE_SQL, (uid, 0, uid, 100))
+        got = cur.fetchall()
+        cost = (time.perf_counter() - start) * 1000
+        page_costs.append(cost)
+        log(f"round {r + 1}: next page   {cost:8.2f} ms, rows={len(got)}")
+    return range_costs, single_costs, page_costs
+
+
+def main():
+    parser = argparse.ArgumentParser(description='离线消息确认测试（user_read_cursor）')
+    parser.add_argument('--host', default='127.0.0.1', help='MySQL 地址 (默认: 127.0.0.1)')
+    parser.add_argument('--port', type=int, default=3306, help='MySQL 端口 (默认: 3306)')
+    parser.add_argument('--user', default='chatuser', help='用户名 (默认: chatuser)')
+    parser.add_argument('--password', default='', help='密码')
+    parser.add_argument('--db', default='chat_system', help='数据库名 (默认: chat_system)')
+    parser.add_argument('--uid', type=int, default=999999, help='测试用 uid (默认: 999999)')
+    parser.add_argument('--unread', type=int, default=10000, help='未读消息条数 (默认: 10000)')
+    parser.add_argument('--rounds', type=int, default=5, help='重复轮数 (默认: 5)')
+    args = parser.parse_args()
+
+    conn = pymysql.connect(host=args.host, port=args.port, user=args.user,
+                           password=args.password, database=args.db, autocommit=False)
+    try:
+        failures = check_semantics(conn, args.uid)
+        range_costs, single_costs, page_costs = bench(conn, args.uid, args.unread, args.rounds)
+    finally:
+        cur = conn.cursor()
+        cleanup(cur, args.uid)
+        conn.commit()
+        conn.close()
+
+    print("\n" + "=" * 70)
+    print(f"未读 {args.unread:,} 条时的平均耗时（{args.rounds} 轮）")
+    print(f"  分页游标确认 AckOfflineMessages: {sum(range_costs) / len(range_costs):8.2f} ms")
+    print(f"  逐条确认 AckOfflineMessage:      {sum(single_costs) / len(single_costs):8.2f} ms")
+    print(f"  确认后取一页:                    {sum(page_costs) / len(page_costs):8.2f} ms")
+    print(f"语义检查失败: {len(failures)}" + (f" ({', '.join(failures)})" if failures else ""))
+    print("=" * 70 + "\n")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == '__main__':
+    main()
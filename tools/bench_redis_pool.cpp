@@ -0,0 +1,167 @@
+// Redis 连接池竞争基准：32 个线程并发取还连接，对比
+//   shared   —— 线程亲和之前的写法：所有线程在一把 mutex + 条件变量上从 std::queue 取还
+//   affinity —— RedisConPool（ConnAffinity 线程槽，取还快路径不加锁）
+// 两种池子大小、连接数相同，每个线程每轮取一个连接、（ping 模式下）发一条 PING、归还。
+//
+// 模式：
+//   noop —— 只取还不发命令，测池子本身的开销和锁竞争
+//   ping —— 取还之间发一条 PING，接近真实调用（一次往返 + 两次取还）
+//
+// 连接真实的 Redis（池子构造时会 AUTH，服务端需要设置 requirepass）。
+// 锁竞争要在多核机器上才能体现，单核上线程轮流运行，两种写法的差异只剩加锁本身的开销。
+//
+// 构建（任选其一）：
+//   cmake -DBUILD_BENCHMARKS=ON ...  生成 bench_redis_pool 目标
+//   g++ -std=c++17 -O2 -IChatServer/ChatServer -I/usr/include/jsoncpp tools/bench_redis_pool.cpp -lhiredis -lpthread -o bench_redis_pool
+//
+// 用法：
+//   bench_redis_pool <host> <port> <password> [threads=32] [pool_size=16] [ops=100000] [mode=noop|ping]
+#include "RedisMgr.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // 线程亲和之前的 RedisConPool：一把锁保护共享队列
+    class SharedRedisPool {
+    public:
+        SharedRedisPool(size_t poolSize, const char* host, int port, const char* pwd) {
+            for (size_t i = 0; i < poolSize; ++i) {
+                auto* context = redisConnect(host, port);
+                if (context == nullptr || context->err != 0) {
+                    if (context != nullptr) redisFree(context);
+                    continue;
+                }
+                auto* reply = (redisReply*)redisCommand(context, "AUTH %s", pwd);
+                bool ok = reply && reply->type != REDIS_REPLY_ERROR;
+                if (reply) freeReplyObject(reply);
+                if (!ok) {
+                    redisFree(context);
+                    continue;
+                }
+                connections_.push(context);
+            }
+        }
+
+        ~SharedRedisPool() {
+            while (!connections_.empty()) {
+                redisFree(connections_.front());
+                connections_.pop();
+            }
+        }
+
+        size_t Size() const { return connections_.size(); }
+
+        redisContext* getConnection() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return !connections_.empty(); });
+            auto* context = connections_.front();
+            connections_.pop();
+            return context;
+        }
+
+        void returnConnection(redisContext* context) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.push(context);
+            cond_.notify_one();
+        }
+
+    private:
+        std::queue<redisContext*> connections_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+    };
+
+    struct Options {
+        int threads = 32;
+        int ops = 100000;
+        bool ping = false;
+    };
+
+    // 各线程同时开始，返回每秒完成的取还次数
+    template <class Pool>
+    double Run(Pool& pool, const Options& opt, unsigned long long& failed) {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool go = false;
+        std::atomic<unsigned long long> errors{ 0 };
+        std::vector<std::thread> workers;
+        for (int t = 0; t < opt.threads; ++t) {
+            workers.emplace_back([&] {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&] { return go; });
+                }
+                for (int i = 0; i < opt.ops; ++i) {
+                    auto* context = pool.getConnection();
+                    if (context == nullptr) {
+                        ++errors;
+                        continue;
+                    }
+                    if (opt.ping) {
+                        auto* reply = (redisReply*)redisCommand(context, "PING");
+                        if (reply == nullptr || reply->type != REDIS_REPLY_STATUS) ++errors;
+                        if (reply) freeReplyObject(reply);
+                    }
+                    pool.returnConnection(context);
+                }
+                });
+        }
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            go = true;
+        }
+        cond.notify_all();
+        for (auto& worker : workers) worker.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        failed = errors;
+        return opt.threads * static_cast<double>(opt.ops) / seconds;
+    }
+
+    void Report(const char* name, const Options& opt, size_t pool_size, double ops_per_sec, unsigned long long failed) {
+        std::printf("%-8s threads=%d pool=%zu mode=%s ops/thread=%d  %.0f ops/s  failed=%llu\n",
+            name, opt.threads, pool_size, opt.ping ? "ping" : "noop", opt.ops, ops_per_sec, failed);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s <host> <port> <password> [threads=32] [pool_size=16] [ops=100000] [mode=noop|ping]\n", argv[0]);
+        return 1;
+    }
+    const char* host = argv[1];
+    int port = std::atoi(argv[2]);
+    const char* pwd = argv[3];
+    Options opt;
+    if (argc > 4) opt.threads = std::max(1, std::atoi(argv[4]));
+    size_t pool_size = argc > 5 ? static_cast<size_t>(std::max(1, std::atoi(argv[5]))) : 16;
+    if (argc > 6) opt.ops = std::max(1, std::atoi(argv[6]));
+    opt.ping = argc > 7 && std::strcmp(argv[7], "ping") == 0;
+
+    unsigned long long failed = 0;
+    {
+        SharedRedisPool shared(pool_size, host, port, pwd);
+        if (shared.Size() != pool_size) {
+            std::fprintf(stderr, "connected %zu of %zu, check host/port/password\n", shared.Size(), pool_size);
+            return 1;
+        }
+        double rate = Run(shared, opt, failed);
+        Report("shared", opt, pool_size, rate, failed);
+    }
+    {
+        RedisConPool affinity(pool_size, host, port, pwd);
+        double rate = Run(affinity, opt, failed);
+        Report("affinity", opt, pool_size, rate, failed);
+        affinity.Close();
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// 预编译语句缓存基准：对比 MysqlDao 的 GetUser / IsFriend 查询在
+//   uncached —— 每次 prepareStatement + 执行 + 释放（语句缓存之前的写法）
+//   cached   —— PooledConnection::GetStatement 复用连接上缓存的语句（ConnectionGuard::prepare）
+// 两种方式下的单次查询延迟（平均 / p50 / p99，微秒）和吞吐。
+//
+// 连接真实的 MySQL，库表按 ChatClient/database_schema.sql 建好，user / friends 表里有没有数据都可以。
+// 单连接、单线程顺序执行，测的是每次查询的往返开销，不是并发吞吐。
+//
+// 构建（任选其一）：
+//   cmake -DBUILD_BENCHMARKS=ON ...  生成 bench_stmt_cache 目标
+//   g++ -std=c++17 -O2 -IChatServer/ChatServer -I/usr/include/jsoncpp tools/bench_stmt_cache.cpp -lmysqlcppconn -lpthread -o bench_stmt_cache
+//
+// 用法：
+//   bench_stmt_cache <host> <port> <user> <password> <schema> [iterations=10000] [uid=1] [friend_uid=2]
+//
+// 结果：尚未在真实 MySQL 上运行过，暂无数据。跑出来后把机器配置和输出补在这里。
+#include "MysqlDao.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+    const char* GET_USER_SQL = "SELECT uid, name, email, pwd FROM user WHERE uid = ?";
+    const char* IS_FRIEND_SQL = "SELECT COUNT(*) as count FROM friends WHERE (uid1 = ? AND uid2 = ?) OR (uid1 = ? AND uid2 = ?)";
+
+    using Bind = std::function<void(sql::PreparedStatement*)>;
+
+    // 执行一次查询并读完结果集，和 MysqlDao 里的用法一致
+    void RunOnce(sql::PreparedStatement* pstmt, const Bind& bind)
+    {
+        bind(pstmt);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) {
+        }
+    }
+
+    void Report(const char* query, const char* mode, std::vector<double>& samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        double total = 0;
+        for (double us : samples) total += us;
+        double avg = total / samples.size();
+        double p50 = samples[samples.size() / 2];
+        double p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+        std::printf("%-9s %-8s n=%zu avg=%.1fus p50=%.1fus p99=%.1fus qps=%.0f\n",
+            query, mode, samples.size(), avg, p50, p99, samples.size() / (total / 1e6));
+    }
+
+    void Bench(PooledConnection& pc, const char* name, const std::string& sql, const Bind& bind, int iterations)
+    {
+        // 预热：建立缓存条目，让两种方式都从热连接开始
+        RunOnce(pc.GetStatement(sql), bind);
+
+        std::vector<double> uncached;
+        std::vector<double> cached;
+        uncached.reserve(iterations);
+        cached.reserve(iterations);
+        // 两种方式交替执行，抵消服务端负载、缓冲池状态随时间的变化
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::unique_ptr<sql::PreparedStatement> pstmt(pc.conn->prepareStatement(sql));
+                RunOnce(pstmt.get(), bind);
+            }
+            auto mid = std::chrono::steady_clock::now();
+            RunOnce(pc.GetStatement(sql), bind);
+            auto end = std::chrono::steady_clock::now();
+            uncached.push_back(std::chrono::duration<double, std::micro>(mid - start).count());
+            cached.push_back(std::chrono::duration<double, std::micro>(end - mid).count());
+        }
+        Report(name, "uncached", uncached);
+        Report(name, "cached", cached);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 6) {
+        std::fprintf(stderr, "usage: %s <host> <port> <user> <password> <schema> [iterations=10000] [uid=1] [friend_uid=2]\n", argv[0]);
+        return 1;
+    }
+    std::string url = std::string("tcp://") + argv[1] + ":" + argv[2];
+    int iterations = argc > 6 ? std::max(1, std::atoi(argv[6])) : 10000;
+    int uid = argc > 7 ? std::atoi(argv[7]) : 1;
+    int friend_uid = argc > 8 ? std::atoi(argv[8]) : 2;
+
+    try {
+        sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
+        PooledConnection pc(std::unique_ptr<sql::Connection>(driver->connect(url, argv[3], argv[4])));
+        pc.conn->setSchema(argv[5]);
+
+        Bench(pc, "GetUser", GET_USER_SQL, [uid](sql::PreparedStatement* pstmt) {
+            pstmt->setInt(1, uid);
+            }, iterations);
+        Bench(pc, "IsFriend", IS_FRIEND_SQL, [uid, friend_uid](sql::PreparedStatement* pstmt) {
+            pstmt->setInt(1, uid);
+            pstmt->setInt(2, friend_uid);
+            pstmt->setInt(3, friend_uid);
+            pstmt->setInt(4, uid);
+            }, iterations);
+    }
+    catch (sql::SQLException& e) {
+        std::fprintf(stderr, "SQLException: %s (MySQL error code: %d)\n", e.what(), e.getErrorCode());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+在线用户 Redis 内存占用对比工具
+按旧布局（utoken_ / uip_ / ubaseinfo_ 三个字符串键，资料为 toStyledString 格式的 JSON）
+和新布局（单个哈希 user_<uid>）各写入 N 个模拟用户，统计每个在线用户的内存占用
+
+用法：
+    pip install redis
+    python3 measure_user_keys.py --host 127.0.0.1 --port 6380 --password 123456 --users 100000
+
+    # 不连 Redis，只比较两种布局写入的键名和值的字节数
+    python3 measure_user_keys.py --offline
+
+说明：
+    used_memory 的差值包含 Redis 的键空间开销（dictEntry、robj、过期表），比单纯的字节数更接近实际；
+    主字典和过期表按 2 的幂扩容，差值会随 --users 落在扩容点前后波动，MEMORY USAGE 不含这部分，更稳定；
+    写入使用 --prefix 指定的前缀，结束后删除，不影响线上数据，但建议在空闲实例上运行。
+    新布局的哈希在字段数和字段长度不超过 hash-max-listpack-entries / hash-max-listpack-value 时
+    以 listpack 存储，运行前可用 CONFIG GET hash-max-listpack-* 确认。
+"""
+
+import argparse
+import json
+import random
+import string
+import sys
+import time
+import uuid
+
+TTL = 604800
+
+
+def log(msg):
+    print(f"[{time.strftime('%H:%M:%S')}] {msg}")
+
+
+def styled_json(obj):
+    """近似 jsoncpp toStyledString：键排序、3 空格缩进、末尾换行"""
+    lines = ["{"]
+    items = sorted(obj.items())
+    for i, (k, v) in enumerate(items):
+        sep = "," if i + 1 < len(items) else ""
+        lines.append(f'   {json.dumps(k)} : {json.dumps(v, ensure_ascii=False)}{sep}')
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def fake_user(uid):
+    name = "user" + "".join(random.choices(string.ascii_lowercase, k=6))
+    return {
+        "uid": uid,
+        "name": name,
+        "email": f"{name}@example.com",
+        # GateServer 旧布局会把密码哈希写进缓存
+        "pwd": "".join(random.choices("0123456789abcdef", k=64)),
+        "nick": "",
+        "desc": "",
+        "sex": 0,
+        "icon": "",
+        "token": str(uuid.uuid4()),
+        "server": "chatserver1",
+    }
+
+
+def old_layout(prefix, u):
+    uid = u["uid"]
+    base = {k: u[k] for k in ("uid", "name", "email", "pwd", "nick", "desc", "sex", "icon")}
+    return [
+        (f"{prefix}utoken_{uid}", u["token"]),
+        (f"{prefix}uip_{uid}", u["server"]),
+        (f"{prefix}ubaseinfo_{uid}", styled_json(base)),
+    ]
+
+
+def new_layout(prefix, u):
+    fields = {
+        "token": u["token"],
+        "server": u["server"],
+        "name": u["name"],
+        "email": u["email"],
+        "nick": u["nick"],
+        "desc": u["desc"],
+        "sex": str(u["sex"]),
+        "icon": u["icon"],
+    }
+    return f"{prefix}user_{u['uid']}", fields
+
+
+def offline(args):
+    users = [fake_user(100000 + i) for i in range(args.users)]
+    old_bytes = 0
+    new_bytes = 0
+    for u in users:
+        for k, v in old_layout("", u):
+            old_bytes += len(k.encode()) + len(v.encode())
+        k, fields = new_layout("", u)
+        new_bytes += len(k.encode()) + sum(len(f.encode()) + len(v.encode()) for f, v in fields.items())
+    n = len(users)
+    log(f"users={n} keys/user old=3 new=1")
+    log(f"key+value bytes/user old={old_bytes / n:.1f} new={new_bytes / n:.1f} "
+        f"(-{(1 - new_bytes / old_bytes) * 100:.1f}%)")
+
+
+def used_memory(r):
+    return r.info("memory")["used_memory"]
+
+
+def measure(r, args, writer, label):
+    before = used_memory(r)
+    keys = []
+    per_user_keys = []
+    pipe = r.pipeline(transaction=False)
+    for i in range(args.users):
+        written = writer(pipe, fake_user(args.base_uid + i))
+        keys.extend(written)
+        if len(per_user_keys) < 1000:
+            per_user_keys.append(written)
+        if len(pipe) >= 1000:
+            pipe.execute()
+    pipe.execute()
+    after = used_memory(r)
+    # MEMORY USAGE 按用户累加（旧布局每个用户 3 个键），抽样前 1000 个用户
+    usage = sum(r.memory_usage(k, samples=0) or 0 for ks in per_user_keys for k in ks) / max(len(per_user_keys), 1)
+    per_user = (after - before) / args.users
+    log(f"{label}: used_memory delta/user={per_user:.1f} bytes, MEMORY USAGE/user={usage:.1f} bytes")
+    for i in range(0, len(keys), 1000):
+        r.delete(*keys[i:i + 1000])
+    return per_user
+
+
+def online(args):
+    try:
+        import redis
+    except ImportError:
+        print("需要安装 redis: pip install redis")
+        sys.exit(1)
+    r = redis.Redis(host=args.host, port=args.port, password=args.password or None)
+    log(f"hash-max-listpack: {r.config_get('hash-max-listpack-*') or r.config_get('hash-max-ziplist-*')}")
+
+    def write_old(pipe, u):
+        keys = []
+        for k, v in old_layout(args.prefix, u):
+            pipe.set(k, v)
+            keys.append(k)
+        return keys
+
+    def write_new(pipe, u):
+        k, fields = new_layout(args.prefix, u)
+        pipe.hset(k, mapping=fields)
+        pipe.expire(k, TTL)
+        return [k]
+
+    old = measure(r, args, write_old, "old (3 string keys)")
+    new = measure(r, args, write_new, "new (1 hash, TTL)")
+    log(f"reduction per online user: {old - new:.1f} bytes (-{(1 - new / old) * 100:.1f}%)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="对比用户键旧布局与用户哈希的内存占用")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=6380)
+    parser.add_argument("--password", default="")
+    parser.add_argument("--users", type=int, default=100000)
+    parser.add_argument("--base-uid", type=int, default=900000000)
+    parser.add_argument("--prefix", default="memtest:")
+    parser.add_argument("--offline", action="store_true", help="不连 Redis，只统计字节数")
+    args = parser.parse_args()
+    random.seed(1)
+    if args.offline:
+        offline(args)
+    else:
+        online(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+messages 表重新分片 / 回填工具
+把用户的消息和已读游标从旧分片（to_uid % old_count）搬到新分片（to_uid % new_count）
+
+分片配置读取 ChatServer 的 config.ini：
+    [MsgShard] Count 以及 [MsgShard0] ... [MsgShardN-1]，Host 为空或未配置的项沿用 [Mysql]
+旧分片布局用 --old-config 指定（不分片时 Count = 1，即全部数据在 [Mysql] 主库）
+
+用法（先停掉所有 ChatServer，搬迁期间不能有新消息写入）：
+    pip install pymysql
+    python3 reshard_messages.py --old-config old_config.ini --new-config config.ini          # 只统计，不改数据
+    python3 reshard_messages.py --old-config old_config.ini --new-config config.ini --apply  # 执行搬迁
+    python3 reshard_messages.py ... --apply --delete                                         # 搬迁后删除源数据
+
+搬迁逻辑（逐个用户）：
+    1. 读出用户在源分片上的已读游标 c，按 id 顺序读出全部消息
+    2. 目标分片上各分片 id 独立自增，消息拿到新 id：
+       先写入已读部分（id <= c），把目标游标设为最后一条已读消息的新 id，再写入未读部分，
+       保证搬迁后未读集合不变
+    3. --delete 时删除源分片上该用户的消息和游标
+同一个用户搬迁失败时回滚目标分片上的写入；带 --delete 执行时可以中断后重跑（已搬完的用户源数据已删除，会被跳过），
+不带 --delete 重跑会在目标分片上产生重复消息
+"""
+
+import argparse
+import configparser
+import sys
+import time
+
+try:
+    import pymysql
+except ImportError:
+    print("需要安装 pymysql: pip install pymysql")
+    sys.exit(1)
+
+BATCH = 500
+
+
+def log(msg):
+    print(f"[{time.strftime('%H:%M:%S')}] {msg}")
+
+
+def load_shards(path):
+    """返回分片连接参数列表，下标即分片号"""
+    cfg = configparser.ConfigParser(inline_comment_prefixes=('#',))
+    cfg.optionxform = str
+    with open(path, encoding='utf-8-sig') as f:
+        cfg.read_file(f)
+
+    def value(section, key):
+        v = cfg.get(section, key, fallback='').strip()
+        return v if v else cfg.get('Mysql', key, fallback='').strip()
+
+    try:
+        count = int(cfg.get('MsgShard', 'Count', fallback='1'))
+    except ValueError:
+        count = 1
+    count = max(count, 1)
+
+    shards = []
+    for i in range(count):
+        section = f'MsgShard{i}' if count > 1 else 'Mysql'
+        if not cfg.has_section(section):
+            section = 'Mysql'
+        shards.append({
+            'host': value(section, 'Host'),
+            'port': int(value(section, 'Port') or 3306),
+            'user': value(section, 'User'),
+            'password': value(section, 'Passwd'),
+            'database': value(section, 'Schema'),
+        })
+    return shards
+
+
+def same_db(a, b):
+    return (a['host'], a['port'], a['database']) == (b['host'], b['port'], b['database'])
+
+
+def connect(shard):
+    return pymysql.connect(host=shard['host'], port=shard['port'], user=shard['user'],
+                           password=shard['password'], database=shard['database'],
+                           autocommit=False, charset='utf8mb4')
+
+
+def move_user(src, dst, uid, delete):
+    """把一个用户的消息和游标从 src 搬到 dst，返回 (已读条数, 未读条数)"""
+    with src.cursor() as cur:
+        cur.execute("SELECT read_msg_id FROM user_read_cursor WHERE uid = %s", (uid,))
+        row = cur.fetchone()
+        cursor = row[0] if row else 0
+        cur.execute("SELECT id, from_uid, payload, codec, create_time, client_msg_id FROM messages WHERE to_uid = %s ORDER BY id", (uid,))
+        rows = cur.fetchall()
+
+    read_rows = [r for r in rows if r[0] <= cursor]
+    unread_rows = [r for r in rows if r[0] > cursor]
+
+    try:
+        with dst.cursor() as cur:
+            new_cursor = None
+            for i in range(0, len(read_rows), BATCH):
+                chunk = read_rows[i:i + BATCH]
+                cur.executemany(
+                    "INSERT INTO messages (from_uid, to_uid, payload, codec, create_time, client_msg_id) "
+                    "VALUES (%s, %s, %s, %s, %s, %s)",
+                    [(r[1], uid, r[2], r[3], r[4], r[5]) for r in chunk])
+            if read_rows:
+                cur.execute("SELECT MAX(id) FROM messages WHERE to_uid = %s", (uid,))
+                new_cursor = cur.fetchone()[0]
+            elif cursor > 0:
+                # 没有已读历史但有游标：游标设到目标表当前最大 id，之后写入的都是未读
+                cur.execute("SELECT IFNULL(MAX(id), 0) FROM messages")
+                new_cursor = cur.fetchone()[0]
+            if new_cursor is not None:
+                cur.execute(
+                    "INSERT INTO user_read_cursor (uid, read_msg_id) VALUES (%s, %s) "
+                    "ON DUPLICATE KEY UPDATE read_msg_id = GREATEST(read_msg_id, VALUES(read_msg_id))",
+                    (uid, new_cursor))
+            for i in range(0, len(unread_rows), BATCH):
+                chunk = unread_rows[i:i + BATCH]
+                cur.executemany(
+                    "INSERT INTO messages (from_uid, to_uid, payload, codec, create_time, client_msg_id) "
+                    "VALUES (%s, %s, %s, %s, %s, %s)",
+                    [(r[1], uid, r[2], r[3], r[4], r[5]) for r in chunk])
+        dst.commit()
+    except Exception:
+        dst.rollback()
+        raise
+
+    if delete:
+        with src.cursor() as cur:
+            cur.execute("DELETE FROM messages WHERE to_uid = %s", (uid,))
+            cur.execute("DELETE FROM user_read_cursor WHERE uid = %s", (uid,))
+        src.commit()
+    return len(read_rows), len(unread_rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='messages 表重新分片')
+    parser.add_argument('--old-config', required=True, help='旧分片布局的 config.ini')
+    parser.add_argument('--new-config', required=True, help='新分片布局的 config.ini')
+    parser.add_argument('--apply', action='store_true', help='执行搬迁（默认只统计）')
+    parser.add_argument('--delete', action='store_true', help='搬迁成功后删除源分片上的数据')
+    args = parser.parse_args()
+
+    old_shards = load_shards(args.old_config)
+    new_shards = load_shards(args.new_config)
+    log(f"old shards={len(old_shards)} new shards={len(new_shards)}")
+
+    new_conns = [connect(s) for s in new_shards]
+    total_users = total_read = total_unread = 0
+    for src_idx, src_shard in enumerate(old_shards):
+        src = connect(src_shard)
+        with src.cursor() as cur:
+            cur.execute("SELECT DISTINCT to_uid FROM messages UNION SELECT uid FROM user_read_cursor")
+            uids = [r[0] for r in cur.fetchall()]
+
+        moving = []
+        for uid in uids:
+            dst_idx = uid % len(new_shards)
+            if not same_db(src_shard, new_shards[dst_idx]):
+                moving.append((uid, dst_idx))
+        log(f"old shard {src_idx}: users={len(uids)} to move={len(moving)}")
+
+        if args.apply:
+            for uid, dst_idx in moving:
+                read_cnt, unread_cnt = move_user(src, new_conns[dst_idx], uid, args.delete)
+                total_users += 1
+                total_read += read_cnt
+                total_unread += unread_cnt
+                if total_users % 1000 == 0:
+                    log(f"moved {total_users} users")
+        src.close()
+
+    for conn in new_conns:
+        conn.close()
+
+    print("\n" + "=" * 70)
+    if args.apply:
+        print(f"搬迁完成：用户 {total_users:,}，已读消息 {total_read:,}，未读消息 {total_unread:,}")
+        if not args.delete:
+            print("源分片数据未删除，确认无误后可加 --delete 重新执行清理")
+    else:
+        print("仅统计，未修改数据；加 --apply 执行搬迁")
+    print("=" * 70 + "\n")
+
+
+if __name__ == '__main__':
+    main()
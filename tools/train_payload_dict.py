@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+messages.payload 压缩字典训练工具
+从已有消息中抽样，按 ChatServer 的存储编码（protobuf TextChatMsgReq，只含 textmsgs）重新编码，
+统计高频片段生成 zlib 预置字典，并对比有无字典时的压缩效果
+
+用法：
+    pip install pymysql
+    python3 train_payload_dict.py --host 127.0.0.1 --user chatuser --password 123456 --db chat_system \\
+        --samples 50000 --out dicts
+
+生成的字典文件名为 <adler32>.dict，填到 ChatServer config.ini：
+    [MsgCodec]
+    DictFiles = dicts/123456789.dict
+换新字典时把新文件放在 DictFiles 最前面，旧字典继续保留（老数据解压需要）
+"""
+
+import argparse
+import collections
+import json
+import os
+import sys
+import time
+import zlib
+
+try:
+    import pymysql
+except ImportError:
+    print("需要安装 pymysql: pip install pymysql")
+    sys.exit(1)
+
+DICT_MAX = 32 * 1024      # zlib 只用得到窗口内最后 32KB
+SEGMENT = 16              # 统计的片段长度
+
+
+def log(msg):
+    print(f"[{time.strftime('%H:%M:%S')}] {msg}")
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        b = n & 0x7F
+        n >>= 7
+        if n:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def field(num, data):
+    """length-delimited 字段"""
+    return varint((num << 3) | 2) + varint(len(data)) + data
+
+
+def encode_payload(payload):
+    """JSON 消息体 -> TextChatMsgReq{ textmsgs = 3 { msgid = 1, msgcontent = 2 } }，结构不符返回 None"""
+    try:
+        root = json.loads(payload)
+    except (ValueError, UnicodeDecodeError):
+        return None
+    if not isinstance(root, dict) or not isinstance(root.get("text_array"), list):
+        return None
+    out = bytearray()
+    for item in root["text_array"]:
+        if not isinstance(item, dict):
+            return None
+        text = b""
+        if item.get("msgid"):
+            text += field(1, str(item["msgid"]).encode())
+        if item.get("content"):
+            text += field(2, str(item["content"]).encode())
+        out += field(3, text)
+    return bytes(out)
+
+
+def load_samples(args):
+    conn = pymysql.connect(host=args.host, port=args.port, user=args.user, password=args.password,
+                           database=args.db, charset='utf8mb4')
+    samples = []
+    with conn.cursor() as cur:
+        # codec: 0 JSON 原文，1 protobuf；2 已压缩的不参与训练
+        cur.execute("SELECT payload, codec FROM messages WHERE codec IN (0, 1) ORDER BY id DESC LIMIT %s",
+                    (args.samples,))
+        for payload, codec in cur.fetchall():
+            if codec == 1:
+                samples.append(bytes(payload))
+            else:
+                if isinstance(payload, (bytes, bytearray)):
+                    payload = payload.decode('utf-8', errors='replace')
+                encoded = encode_payload(payload)
+                if encoded:
+                    samples.append(encoded)
+    conn.close()
+    return samples
+
+
+def train(samples, size):
+    """按 频次 * 长度 挑选高频片段；zlib 对字典末尾的内容匹配距离最短，最常用的放在最后"""
+    counter = collections.Counter()
+    for data in samples:
+        seen = set()
+        for i in range(0, max(len(data) - SEGMENT + 1, 0), 4):
+            seg = data[i:i + SEGMENT]
+            if seg not in seen:
+                seen.add(seg)
+                counter[seg] += 1
+
+    picked = []
+    total = 0
+    for seg, count in counter.most_common():
+        if count < 2 or total + len(seg) > size:
+            break
+        picked.append(seg)
+        total += len(seg)
+    return b"".join(reversed(picked))
+
+
+def ratio(samples, dictionary=None):
+    raw = zipped = 0
+    for data in samples:
+        c = zlib.compressobj(6, zdict=dictionary) if dictionary else zlib.compressobj(6)
+        raw += len(data)
+        zipped += len(c.compress(data) + c.flush())
+    return zipped / raw if raw else 1.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='训练 messages.payload 压缩字典')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=3306)
+    parser.add_argument('--user', default='chatuser')
+    parser.add_argument('--password', default='123456')
+    parser.add_argument('--db', default='chat_system')
+    parser.add_argument('--samples', type=int, default=50000, help='抽样条数（取最新的消息）')
+    parser.add_argument('--size', type=int, default=DICT_MAX, help='字典字节数上限')
+    parser.add_argument('--out', default='.', help='字典输出目录')
+    args = parser.parse_args()
+
+    samples = load_samples(args)
+    if not samples:
+        log("no samples")
+        return
+    log(f"samples={len(samples):,} bytes={sum(len(s) for s in samples):,}")
+
+    # 一半训练，一半评估，避免字典过拟合训练集
+    train_set, eval_set = samples[::2], samples[1::2] or samples
+    dictionary = train(train_set, min(args.size, DICT_MAX))
+    dict_id = zlib.adler32(dictionary)
+    os.makedirs(args.out, exist_ok=True)
+    path = os.path.join(args.out, f"{dict_id}.dict")
+    with open(path, 'wb') as f:
+        f.write(dictionary)
+
+    print("\n" + "=" * 70)
+    print(f"字典: {path} ({len(dictionary):,} bytes, id={dict_id})")
+    print(f"压缩率（压缩后/原始）: 无字典 {ratio(eval_set):.2%}，有字典 {ratio(eval_set, dictionary):.2%}")
+    print("=" * 70 + "\n")
+
+
+if __name__ == '__main__':
+    main()